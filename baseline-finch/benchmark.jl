@@ -13,46 +13,126 @@ include("libunzip_kernels.jl")
 const CONFIG = (
     sparsities = [0.01, 0.02, 0.05, 0.10],
     sizes = [100, 200, 500, 1000],
+    threads = [1, 2, 4, 8],
+    # Width of the unzip position/coordinate arrays; run with INDEX_BITS=32 for the 32-bit build
+    index_bits = parse(Int, get(ENV, "INDEX_BITS", "64")),
+    # Unzip value type: "double", "float" or "mixed" (float storage, double accumulation)
+    value_type = get(ENV, "VALUE_TYPE", "double"),
+    # Unzip inputs are generated once into this directory and mapped by later runs; set TENSOR_CACHE_DIR= to disable
+    tensor_cache = get(ENV, "TENSOR_CACHE_DIR", "tensor_cache"),
+    # Directory of Matrix Market (.mtx) files; when set, every square matrix M in it replaces the uniform inputs as
+    # B = C = D = M (workload = file name) and permute_contract, whose inputs are 3D, is skipped
+    mtx_dir = get(ENV, "MTX_DIR", ""),
+    # Structures of the generated inputs (UnzipUtils.WORKLOADS, plus "transposed": a uniform B and every other operand
+    # with the pattern of B transposed); permute_contract, whose inputs are 3D, runs on "uniform" only
+    workloads = ["uniform", "power_law", "banded", "block_diagonal", "transposed"],
 )
 
 # DEBUG CONFIG
 # const CONFIG = (
 #     sparsities=[0.5, 0.8],
 #     sizes=[10, 20],
+#     threads=[1, 2],
+#     index_bits=64,
+#     value_type="double",
+#     tensor_cache="",
+#     mtx_dir="",
+#     workloads=["uniform", "transposed"],
 # )
 
-function save_results(results, kernel_name)
+# Benchmark inputs, one per suite entry: the generated matrices of every configured (workload, sparsity, size), or the
+# square matrices of CONFIG.mtx_dir with sparsity = nnz / size^2
+function input_cases()
+    if isempty(CONFIG.mtx_dir)
+        return [(workload=workload, sparsity=sparsity, size=size, path="") for workload in CONFIG.workloads
+                for sparsity in CONFIG.sparsities for size in CONFIG.sizes]
+    end
+    cases = []
+    for file in sort(filter(f -> endswith(f, ".mtx"), readdir(CONFIG.mtx_dir)))
+        path = joinpath(CONFIG.mtx_dir, file)
+        tensor = UnzipUtils.read_mtx_csr(path)
+        tensor == C_NULL && continue
+        nrows, ncols, nnz = UnzipUtils.csr_shape(tensor)
+        UnzipUtils.free_csr(tensor)
+        if nrows != ncols
+            println("Skipping $(file): $(nrows) x $(ncols) is not square")
+            continue
+        end
+        push!(cases, (workload=file[1:end-4], sparsity=nnz / nrows^2, size=nrows, path=path))
+    end
+    return cases
+end
+
+# Suite group of one input case: suite[workload][sparsity][size]
+function case_group(suite, case)
+    workload_group = haskey(suite, case.workload) ? suite[case.workload] : (suite[case.workload] = BenchmarkGroup())
+    sparsity_group = haskey(workload_group, case.sparsity) ? workload_group[case.sparsity] :
+                     (workload_group[case.sparsity] = BenchmarkGroup())
+    return sparsity_group[case.size] = BenchmarkGroup()
+end
+
+# Finch and unzip copies of one 2D input: the case's workload generated from `seed`, or its .mtx matrix. Structured
+# workloads are generated by unzip and copied to Finch; in "transposed" the seed 42 operand (B) is uniform and every
+# other operand holds the pattern of its transpose.
+function csr_input(case, seed)
+    n = Csize_t(case.size)
+    if !isempty(case.path)
+        unzip = UnzipUtils.read_mtx_csr(case.path)
+    elseif case.workload == "uniform"
+        finch = FinchUtils.generate_csr(n, n, Cdouble(case.sparsity), Cuint(seed))
+        unzip = UnzipUtils.cached_csr(CONFIG.tensor_cache, n, n, Cdouble(case.sparsity), Cuint(seed))
+        return finch, unzip
+    elseif case.workload == "transposed" && seed != 42
+        unzip = UnzipUtils.cached_csr_transposed(CONFIG.tensor_cache, "uniform", n, n, Cdouble(case.sparsity), Cuint(42), Cuint(seed))
+    else
+        workload = case.workload == "transposed" ? "uniform" : case.workload
+        unzip = UnzipUtils.cached_csr_workload(CONFIG.tensor_cache, workload, n, n, Cdouble(case.sparsity), Cuint(seed))
+    end
+    rows, cols, vals = UnzipUtils.csr_entries(unzip)
+    return FinchUtils.csr_from_entries(rows, cols, vals, (case.size, case.size)), unzip
+end
+
+# `extra` maps (workload, sparsity, size) to a NamedTuple of additional columns, e.g. flop counts
+function save_results(results, kernel_name, cases; extra=Dict())
     rows = []
-    for sparsity in CONFIG.sparsities
-        for size in CONFIG.sizes
-            group = results[sparsity][size]
-            finch_jit_results = group["finch_jit"]
-            finch_aot_results = group["finch_aot"]
-            unzip_results = group["unzip"]
-
-            push!(rows, (
-                sparsity=sparsity,
-                size=size,
-                finch_jit_min=minimum(finch_jit_results).time / 1e6,
-                finch_aot_min=minimum(finch_aot_results).time / 1e6,
-                unzip_min=minimum(unzip_results).time / 1e6,
-                finch_jit_med=median(finch_jit_results).time / 1e6,
-                finch_aot_med=median(finch_aot_results).time / 1e6,
-                unzip_med=median(unzip_results).time / 1e6,
-            ))
+    for case in cases
+        group = results[case.workload][case.sparsity][case.size]
+        # Baseline implementations first, then any extra variants in a stable order
+        impls = ["finch_jit", "finch_aot", "unzip"]
+        append!(impls, sort([k for k in keys(group) if !(k in impls)]))
+
+        names = Symbol[:workload, :sparsity, :size, :index_bits, :value_type]
+        vals = Any[case.workload, case.sparsity, case.size, CONFIG.index_bits, CONFIG.value_type]
+        for impl in impls
+            push!(names, Symbol("$(impl)_min"))
+            push!(vals, minimum(group[impl]).time / 1e6)
+        end
+        for impl in impls
+            push!(names, Symbol("$(impl)_med"))
+            push!(vals, median(group[impl]).time / 1e6)
         end
+        for (name, val) in pairs(get(extra, (case.workload, case.sparsity, case.size), (;)))
+            push!(names, name)
+            push!(vals, val)
+        end
+        push!(rows, NamedTuple{Tuple(names)}(Tuple(vals)))
     end
 
     results_dir = "results"
     if !isdir(results_dir)
         mkpath(results_dir)
     end
-    CSV.write(joinpath(results_dir, "$(kernel_name).csv"), rows)
+    # 32-bit index, float/mixed value and Matrix Market runs are kept next to the default ones for comparison
+    suffix = (CONFIG.index_bits == 64 ? "" : "_idx$(CONFIG.index_bits)") *
+             (CONFIG.value_type == "double" ? "" : "_$(CONFIG.value_type)") *
+             (isempty(CONFIG.mtx_dir) ? "" : "_mtx")
+    CSV.write(joinpath(results_dir, "$(kernel_name)$(suffix).csv"), rows)
 end
 
 function run_benchmarks()
-    UnzipUtils.setup()
-    UnzipKernels.setup()
+    UnzipUtils.setup(index_bits=CONFIG.index_bits, value_type=CONFIG.value_type)
+    UnzipKernels.setup(index_bits=CONFIG.index_bits, value_type=CONFIG.value_type)
+    cases = input_cases()
 
     # --- Hadamard Transpose ---
     println("\n" * "="^80)
@@ -60,24 +140,20 @@ function run_benchmarks()
     println("="^80)
 
     k1_suite = BenchmarkGroup()
-    for sparsity in CONFIG.sparsities
-        sparsity_group = k1_suite[sparsity] = BenchmarkGroup()
-        for size in CONFIG.sizes
-            size_group = sparsity_group[size] = BenchmarkGroup()
-            B_finch = FinchUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(42))
-            C_finch = FinchUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(43))
-            size_group["finch_jit"] = @benchmarkable(FinchKernelsJIT.hadamard_transpose(A, $B_finch, $C_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
-            size_group["finch_aot"] = @benchmarkable(FinchKernelsAOT.hadamard_transpose(A, $B_finch, $C_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
-
-            B_unzip = UnzipUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(42))
-            C_unzip = UnzipUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(43))
-            res_unzip = UnzipUtils.allocate_csr(Csize_t(size), Csize_t(size), Csize_t(floor(size * sparsity)))
-            size_group["unzip"] = @benchmarkable(UnzipKernels.hadamard_transpose($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
-        end
+    for case in cases
+        size_group = case_group(k1_suite, case)
+        B_finch, B_unzip = csr_input(case, 42)
+        C_finch, C_unzip = csr_input(case, 43)
+        size_group["finch_jit"] = @benchmarkable(FinchKernelsJIT.hadamard_transpose(A, $B_finch, $C_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
+        size_group["finch_aot"] = @benchmarkable(FinchKernelsAOT.hadamard_transpose(A, $B_finch, $C_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
+
+        res_unzip = UnzipUtils.allocate_csr(Csize_t(case.size), Csize_t(case.size), Csize_t(0))
+        UnzipUtils.reserve_csr(res_unzip, UnzipKernels.hadamard_transpose_count(B_unzip, C_unzip))
+        size_group["unzip"] = @benchmarkable(UnzipKernels.hadamard_transpose($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
     end
 
     k1_results = BenchmarkTools.run(k1_suite, verbose=true)
-    save_results(k1_results, "hadamard_transpose")
+    save_results(k1_results, "hadamard_transpose", cases)
 
     # --- Matrix Multiplication ---
     println("\n" * "="^80)
@@ -85,24 +161,26 @@ function run_benchmarks()
     println("="^80)
 
     k2_suite = BenchmarkGroup()
-    for sparsity in CONFIG.sparsities
-        sparsity_group = k2_suite[sparsity] = BenchmarkGroup()
-        for size in CONFIG.sizes
-            size_group = sparsity_group[size] = BenchmarkGroup()
-            B_finch = FinchUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(42))
-            C_finch = FinchUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(43))
-            size_group["finch_jit"] = @benchmarkable(FinchKernelsJIT.matmul(A, $B_finch, $C_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
-            size_group["finch_aot"] = @benchmarkable(FinchKernelsAOT.matmul(A, $B_finch, $C_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
-
-            B_unzip = UnzipUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(42))
-            C_unzip = UnzipUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(43))
-            res_unzip = UnzipUtils.allocate_csr(Csize_t(size), Csize_t(size), Csize_t(floor(size * sparsity * sparsity * size) + 1))
-            size_group["unzip"] = @benchmarkable(UnzipKernels.matmul($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+    for case in cases
+        size_group = case_group(k2_suite, case)
+        B_finch, B_unzip = csr_input(case, 42)
+        C_finch, C_unzip = csr_input(case, 43)
+        size_group["finch_jit"] = @benchmarkable(FinchKernelsJIT.matmul(A, $B_finch, $C_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
+        size_group["finch_aot"] = @benchmarkable(FinchKernelsAOT.matmul(A, $B_finch, $C_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
+
+        res_unzip = UnzipUtils.allocate_csr(Csize_t(case.size), Csize_t(case.size), Csize_t(0))
+        UnzipUtils.reserve_csr(res_unzip, UnzipKernels.matmul_count(B_unzip, C_unzip))
+        size_group["unzip"] = @benchmarkable(UnzipKernels.matmul($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+        size_group["unzip_spa"] = @benchmarkable(UnzipKernels.matmul_spa($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+        size_group["unzip_spa_sorted"] = @benchmarkable(UnzipKernels.matmul_spa_sorted($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+        size_group["unzip_hybrid"] = @benchmarkable(UnzipKernels.matmul_hybrid($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+        for threads in CONFIG.threads
+            size_group["unzip_parallel_$(threads)"] = @benchmarkable(UnzipKernels.matmul_parallel($B_unzip, $C_unzip, $res_unzip), setup = (UnzipKernels.set_num_threads(Cint($threads)); UnzipUtils.reset_csr($res_unzip)))
         end
     end
 
     k2_results = BenchmarkTools.run(k2_suite, verbose=true)
-    save_results(k2_results, "matmul")
+    save_results(k2_results, "matmul", cases)
 
     # --- Matrix Multiplication with Hadamard ---
     println("\n" * "="^80)
@@ -110,26 +188,31 @@ function run_benchmarks()
     println("="^80)
 
     k3_suite = BenchmarkGroup()
-    for sparsity in CONFIG.sparsities
-        sparsity_group = k3_suite[sparsity] = BenchmarkGroup()
-        for size in CONFIG.sizes
-            size_group = sparsity_group[size] = BenchmarkGroup()
-            B_finch = FinchUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(42))
-            C_finch = FinchUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(43))
-            D_finch = FinchUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(44))
-            size_group["finch_jit"] = @benchmarkable(FinchKernelsJIT.matmul_hadamard(A, $B_finch, $C_finch, $D_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
-            size_group["finch_aot"] = @benchmarkable(FinchKernelsAOT.matmul_hadamard(A, $B_finch, $C_finch, $D_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
-
-            B_unzip = UnzipUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(42))
-            C_unzip = UnzipUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(43))
-            D_unzip = UnzipUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(44))
-            res_unzip = UnzipUtils.allocate_csr(Csize_t(size), Csize_t(size), Csize_t(floor(size * sparsity * sparsity * size) + 1))
-            size_group["unzip"] = @benchmarkable(UnzipKernels.matmul_hadamard($B_unzip, $C_unzip, $D_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+    k3_flops = Dict()
+    for case in cases
+        size_group = case_group(k3_suite, case)
+        B_finch, B_unzip = csr_input(case, 42)
+        C_finch, C_unzip = csr_input(case, 43)
+        D_finch, D_unzip = csr_input(case, 44)
+        size_group["finch_jit"] = @benchmarkable(FinchKernelsJIT.matmul_hadamard(A, $B_finch, $C_finch, $D_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
+        size_group["finch_aot"] = @benchmarkable(FinchKernelsAOT.matmul_hadamard(A, $B_finch, $C_finch, $D_finch), setup = (A = Tensor(SparseList(Dense(Element(0.0))))))
+
+        res_unzip = UnzipUtils.allocate_csr(Csize_t(case.size), Csize_t(case.size), Csize_t(0))
+        UnzipUtils.reserve_csr(res_unzip, UnzipKernels.matmul_hadamard_count(B_unzip, C_unzip, D_unzip))
+        size_group["unzip"] = @benchmarkable(UnzipKernels.matmul_hadamard($B_unzip, $C_unzip, $D_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+        size_group["unzip_spa"] = @benchmarkable(UnzipKernels.matmul_hadamard_spa($B_unzip, $C_unzip, $D_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+        size_group["unzip_spa_sorted"] = @benchmarkable(UnzipKernels.matmul_hadamard_spa_sorted($B_unzip, $C_unzip, $D_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+        size_group["unzip_hybrid"] = @benchmarkable(UnzipKernels.matmul_hadamard_hybrid($B_unzip, $C_unzip, $D_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+        size_group["unzip_fused"] = @benchmarkable(UnzipKernels.matmul_hadamard_fused($B_unzip, $C_unzip, $D_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+        size_group["unzip_adaptive"] = @benchmarkable(UnzipKernels.matmul_hadamard_adaptive($B_unzip, $C_unzip, $D_unzip, $res_unzip), setup = (UnzipUtils.reset_csr($res_unzip)))
+        k3_flops[(case.workload, case.sparsity, case.size)] = UnzipKernels.matmul_hadamard_flops(B_unzip, C_unzip, D_unzip)
+        for threads in CONFIG.threads
+            size_group["unzip_parallel_$(threads)"] = @benchmarkable(UnzipKernels.matmul_hadamard_parallel($B_unzip, $C_unzip, $D_unzip, $res_unzip), setup = (UnzipKernels.set_num_threads(Cint($threads)); UnzipUtils.reset_csr($res_unzip)))
         end
     end
 
     k3_results = BenchmarkTools.run(k3_suite, verbose=true)
-    save_results(k3_results, "matmul_hadamard")
+    save_results(k3_results, "matmul_hadamard", cases; extra=k3_flops)
 
     # --- Hadamard Transpose Reduce ---
     println("\n" * "="^80)
@@ -137,49 +220,50 @@ function run_benchmarks()
     println("="^80)
 
     k4_suite = BenchmarkGroup()
-    for sparsity in CONFIG.sparsities
-        sparsity_group = k4_suite[sparsity] = BenchmarkGroup()
-        for size in CONFIG.sizes
-            size_group = sparsity_group[size] = BenchmarkGroup()
-            B_finch = FinchUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(42))
-            C_finch = FinchUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(43))
-            size_group["finch_jit"] = @benchmarkable(FinchKernelsJIT.hadamard_transpose_reduce(y, $B_finch, $C_finch), setup = (y = Tensor(Dense(Element(0.0)))))
-            size_group["finch_aot"] = @benchmarkable(FinchKernelsAOT.hadamard_transpose_reduce(y, $B_finch, $C_finch), setup = (y = Tensor(Dense(Element(0.0)))))
-
-            B_unzip = UnzipUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(42))
-            C_unzip = UnzipUtils.generate_csr(Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(43))
-            res_unzip = UnzipUtils.allocate_dense(Csize_t(size))
-            size_group["unzip"] = @benchmarkable(UnzipKernels.hadamard_transpose_reduce($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_dense($res_unzip)))
-        end
+    for case in cases
+        size_group = case_group(k4_suite, case)
+        B_finch, B_unzip = csr_input(case, 42)
+        C_finch, C_unzip = csr_input(case, 43)
+        size_group["finch_jit"] = @benchmarkable(FinchKernelsJIT.hadamard_transpose_reduce(y, $B_finch, $C_finch), setup = (y = Tensor(Dense(Element(0.0)))))
+        size_group["finch_aot"] = @benchmarkable(FinchKernelsAOT.hadamard_transpose_reduce(y, $B_finch, $C_finch), setup = (y = Tensor(Dense(Element(0.0)))))
+
+        res_unzip = UnzipUtils.allocate_dense(Csize_t(case.size))
+        size_group["unzip"] = @benchmarkable(UnzipKernels.hadamard_transpose_reduce($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_dense($res_unzip)))
     end
 
     k4_results = BenchmarkTools.run(k4_suite, verbose=true)
-    save_results(k4_results, "hadamard_transpose_reduce")
+    save_results(k4_results, "hadamard_transpose_reduce", cases)
 
     # --- Permute Contract ---
-    println("\n" * "="^80)
-    println("BENCHMARKING: permute_contract")
-    println("="^80)
+    # The inputs are 3D, so only the uniform workload runs it (and Matrix Market inputs skip it)
+    csf_cases = filter(case -> case.workload == "uniform", cases)
+    if !isempty(csf_cases)
+        println("\n" * "="^80)
+        println("BENCHMARKING: permute_contract")
+        println("="^80)
 
-    k5_suite = BenchmarkGroup()
-    for sparsity in CONFIG.sparsities
-        sparsity_group = k5_suite[sparsity] = BenchmarkGroup()
-        for size in CONFIG.sizes
-            size_group = sparsity_group[size] = BenchmarkGroup()
-            B_finch = FinchUtils.generate_csf(Csize_t(size), Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(42))
-            C_finch = FinchUtils.generate_csf(Csize_t(size), Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(43))
+        k5_suite = BenchmarkGroup()
+        for case in csf_cases
+            size_group = case_group(k5_suite, case)
+            B_finch = FinchUtils.generate_csf(Csize_t(case.size), Csize_t(case.size), Csize_t(case.size), Cdouble(case.sparsity), Cuint(42))
+            C_finch = FinchUtils.generate_csf(Csize_t(case.size), Csize_t(case.size), Csize_t(case.size), Cdouble(case.sparsity), Cuint(43))
             size_group["finch_jit"] = @benchmarkable(FinchKernelsJIT.permute_contract(y, $B_finch, $C_finch), setup = (y = Tensor(Dense(Element(0.0)))))
             size_group["finch_aot"] = @benchmarkable(FinchKernelsAOT.permute_contract(y, $B_finch, $C_finch), setup = (y = Tensor(Dense(Element(0.0)))))
 
-            B_unzip = UnzipUtils.generate_csf(Csize_t(size), Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(42))
-            C_unzip = UnzipUtils.generate_csf(Csize_t(size), Csize_t(size), Csize_t(size), Cdouble(sparsity), Cuint(43))
-            res_unzip = UnzipUtils.allocate_dense(Csize_t(size))
+            B_unzip = UnzipUtils.cached_csf(CONFIG.tensor_cache, Csize_t(case.size), Csize_t(case.size), Csize_t(case.size), Cdouble(case.sparsity), Cuint(42))
+            C_unzip = UnzipUtils.cached_csf(CONFIG.tensor_cache, Csize_t(case.size), Csize_t(case.size), Csize_t(case.size), Cdouble(case.sparsity), Cuint(43))
+            res_unzip = UnzipUtils.allocate_dense(Csize_t(case.size))
             size_group["unzip"] = @benchmarkable(UnzipKernels.permute_contract($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_dense($res_unzip)))
+            size_group["unzip_transposed"] = @benchmarkable(UnzipKernels.permute_contract_transposed($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_dense($res_unzip)))
+            size_group["unzip_dense"] = @benchmarkable(UnzipKernels.permute_contract_dense($B_unzip, $C_unzip, $res_unzip), setup = (UnzipUtils.reset_dense($res_unzip)))
+            for threads in CONFIG.threads
+                size_group["unzip_parallel_$(threads)"] = @benchmarkable(UnzipKernels.permute_contract_parallel($B_unzip, $C_unzip, $res_unzip), setup = (UnzipKernels.set_num_threads(Cint($threads)); UnzipUtils.reset_dense($res_unzip)))
+            end
         end
-    end
 
-    k5_results = BenchmarkTools.run(k5_suite, verbose=true)
-    save_results(k5_results, "permute_contract")
+        k5_results = BenchmarkTools.run(k5_suite, verbose=true)
+        save_results(k5_results, "permute_contract", csf_cases)
+    end
 
     UnzipKernels.teardown()
     UnzipUtils.teardown()
@@ -36,8 +36,13 @@ function generate_csr(ndim1::Csize_t, ndim2::Csize_t, sparsity::Cdouble, seed::C
         end
     end
 
+    return csr_from_entries(dim1_crds, dim2_crds, vals, (Int(ndim1), Int(ndim2)))
+end
+
+# CSR tensor (SparseList(Dense(Element(0.0)))) from 1-based COO entries, e.g. a matrix read by UnzipUtils.read_mtx_csr
+function csr_from_entries(dim1_crds::Vector{Int}, dim2_crds::Vector{Int}, vals::Vector{Cdouble}, shape::Tuple{Int,Int})
     # Create COO tensor using fsparse, then convert to CSR format
-    coo_tensor = fsparse(dim1_crds, dim2_crds, vals, (Int(ndim1), Int(ndim2)))
+    coo_tensor = fsparse(dim1_crds, dim2_crds, vals, shape)
     csr_tensor = Tensor(SparseList(Dense(Element(0.0))), coo_tensor)
 
     return csr_tensor
@@ -2,15 +2,24 @@ module UnzipKernels
 
 using Libdl: dlopen, dlsym, dlclose, RTLD_LAZY, RTLD_GLOBAL
 
-export setup, teardown, hadamard_transpose, matmul, matmul_hadamard, hadamard_transpose_reduce, permute_contract
+export setup, teardown, hadamard_transpose, matmul, matmul_hadamard, hadamard_transpose_count, matmul_count, matmul_hadamard_count, matmul_spa, matmul_spa_sorted, matmul_hybrid, matmul_hadamard_spa, matmul_hadamard_spa_sorted, matmul_hadamard_hybrid, matmul_parallel, matmul_hadamard_parallel, matmul_hadamard_fused, matmul_hadamard_adaptive, matmul_hadamard_flops, set_num_threads, hadamard_transpose_reduce, permute_contract, permute_contract_transposed, permute_contract_dense, permute_contract_parallel
 
 const LIB_HANDLE = Ref{Ptr{Cvoid}}(C_NULL)
 
-function setup()
-    println("Compiling Unzipping kernels library...")
+# Storage/accumulation value types and their compile flags (see unzip_formats.h)
+const VALUE_FLAGS = Dict("double" => String[], "float" => ["-DVALUE_FLOAT"], "mixed" => ["-DVALUE_MIXED"])
+
+# Apple clang ships without OpenMP; the parallel kernels then run on one thread
+const OPENMP_FLAGS = Sys.isapple() ? String[] : ["-fopenmp"]
+
+# `index_bits` selects the width of the position and coordinate arrays (-DINDEX_BITS) and `value_type` the type of
+# the values ("double", "float" or "mixed"); both must match UnzipUtils.setup
+function setup(; index_bits=64, value_type="double")
+    println("Compiling Unzipping kernels library ($(index_bits)-bit indices, $(value_type) values)...")
     lib_ext = Sys.isapple() ? "dylib" : "so"
-    lib_name = "libunzip_kernels.$(lib_ext)"
-    run(`cc -shared -O3 -fPIC unzip_kernels.c -o $lib_name`)
+    lib_suffix = (index_bits == 64 ? "" : "_idx$(index_bits)") * (value_type == "double" ? "" : "_$(value_type)")
+    lib_name = "libunzip_kernels$(lib_suffix).$(lib_ext)"
+    run(`cc -shared -O3 -fPIC -DINDEX_BITS=$(index_bits) $(VALUE_FLAGS[value_type]) $(OPENMP_FLAGS) unzip_kernels.c -o $lib_name`)
     println("Compiled library: $lib_name")
     lib_path = joinpath(@__DIR__, lib_name)
     LIB_HANDLE[] = dlopen(lib_path, RTLD_LAZY | RTLD_GLOBAL)
@@ -37,6 +46,85 @@ function matmul_hadamard(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Pt
     ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
 end
 
+function hadamard_transpose_count(t1::Ptr{Cvoid}, t2::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :hadamard_transpose_count)
+    return ccall(func, Csize_t, (Ptr{Cvoid}, Ptr{Cvoid}), t1, t2)
+end
+
+function matmul_count(t1::Ptr{Cvoid}, t2::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_count)
+    return ccall(func, Csize_t, (Ptr{Cvoid}, Ptr{Cvoid}), t1, t2)
+end
+
+function matmul_hadamard_count(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_count)
+    return ccall(func, Csize_t, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3)
+end
+
+function matmul_spa(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_spa)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function matmul_spa_sorted(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_spa_sorted)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function matmul_hybrid(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hybrid)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function matmul_hadamard_spa(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_spa)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+function matmul_hadamard_spa_sorted(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_spa_sorted)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+function matmul_hadamard_hybrid(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_hybrid)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+function matmul_hadamard_fused(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_fused)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+function matmul_hadamard_adaptive(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_adaptive)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+# Multiplications of the unfused and fused matmul_hadamard pipelines
+function matmul_hadamard_flops(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_flops)
+    unfused = Ref{Csize_t}(0)
+    fused = Ref{Csize_t}(0)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ref{Csize_t}, Ref{Csize_t}), t1, t2, t3, unfused, fused)
+    return (flops_unfused=Int(unfused[]), flops_fused=Int(fused[]))
+end
+
+function matmul_parallel(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_parallel)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function matmul_hadamard_parallel(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_parallel)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+function set_num_threads(num_threads::Cint)
+    func = dlsym(LIB_HANDLE[], :set_num_threads)
+    ccall(func, Cvoid, (Cint,), num_threads)
+end
+
 function hadamard_transpose_reduce(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
     func = dlsym(LIB_HANDLE[], :hadamard_transpose_reduce)
     ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
@@ -47,4 +135,19 @@ function permute_contract(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
     ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
 end
 
+function permute_contract_transposed(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :permute_contract_transposed)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function permute_contract_dense(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :permute_contract_dense)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function permute_contract_parallel(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :permute_contract_parallel)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
 end # module
@@ -2,15 +2,22 @@ module UnzipKernelsTest
 
 using Libdl: dlopen, dlsym, dlclose, RTLD_LAZY, RTLD_GLOBAL
 
-export setup, teardown, test_hadamard_transpose, test_matmul, test_matmul_hadamard, test_hadamard_transpose_reduce, test_permute_contract
+export setup, teardown, test_hadamard_transpose, test_matmul, test_matmul_hadamard, test_matmul_accumulators, test_matmul_hadamard_accumulators, test_matmul_hash_accumulator, test_hadamard_transpose_reduce, test_permute_contract, test_permute_contract_variants, test_kernel_counts, test_tensor_files
 
 const LIB_HANDLE = Ref{Ptr{Cvoid}}(C_NULL)
 
-function setup()
-    println("Compiling Unzipping kernels test library...")
+# Storage/accumulation value types and their compile flags (see unzip_formats.h)
+const VALUE_FLAGS = Dict("double" => String[], "float" => ["-DVALUE_FLOAT"], "mixed" => ["-DVALUE_MIXED"])
+
+# Apple clang ships without OpenMP; the parallel kernels then run on one thread
+const OPENMP_FLAGS = Sys.isapple() ? String[] : ["-fopenmp"]
+
+function setup(; index_bits=64, value_type="double")
+    println("Compiling Unzipping kernels test library ($(index_bits)-bit indices, $(value_type) values)...")
     lib_ext = Sys.isapple() ? "dylib" : "so"
-    lib_name = "libunzip_kernels_test.$(lib_ext)"
-    run(`cc -shared -O3 -fPIC unzip_kernels_test.c unzip_kernels.c -o $lib_name`)
+    lib_suffix = (index_bits == 64 ? "" : "_idx$(index_bits)") * (value_type == "double" ? "" : "_$(value_type)")
+    lib_name = "libunzip_kernels_test$(lib_suffix).$(lib_ext)"
+    run(`cc -shared -O3 -fPIC -DINDEX_BITS=$(index_bits) $(VALUE_FLAGS[value_type]) $(OPENMP_FLAGS) unzip_kernels_test.c unzip_kernels.c unzip_utils.c -lm -o $lib_name`)
     println("Compiled library: $lib_name")
     lib_path = joinpath(@__DIR__, lib_name)
     LIB_HANDLE[] = dlopen(lib_path, RTLD_LAZY | RTLD_GLOBAL)
@@ -37,6 +44,21 @@ function test_matmul_hadamard()
     ccall(func, Cvoid, ())
 end
 
+function test_matmul_accumulators()
+    func = dlsym(LIB_HANDLE[], :test_matmul_accumulators)
+    ccall(func, Cvoid, ())
+end
+
+function test_matmul_hadamard_accumulators()
+    func = dlsym(LIB_HANDLE[], :test_matmul_hadamard_accumulators)
+    ccall(func, Cvoid, ())
+end
+
+function test_matmul_hash_accumulator()
+    func = dlsym(LIB_HANDLE[], :test_matmul_hash_accumulator)
+    ccall(func, Cvoid, ())
+end
+
 function test_hadamard_transpose_reduce()
     func = dlsym(LIB_HANDLE[], :test_hadamard_transpose_reduce)
     ccall(func, Cvoid, ())
@@ -47,4 +69,19 @@ function test_permute_contract()
     ccall(func, Cvoid, ())
 end
 
+function test_permute_contract_variants()
+    func = dlsym(LIB_HANDLE[], :test_permute_contract_variants)
+    ccall(func, Cvoid, ())
+end
+
+function test_kernel_counts()
+    func = dlsym(LIB_HANDLE[], :test_kernel_counts)
+    ccall(func, Cvoid, ())
+end
+
+function test_tensor_files()
+    func = dlsym(LIB_HANDLE[], :test_tensor_files)
+    ccall(func, Cvoid, ())
+end
+
 end # module
@@ -2,18 +2,33 @@ module UnzipUtils
 
 using Libdl: dlopen, dlsym, dlclose, RTLD_LAZY, RTLD_GLOBAL
 
-export setup, teardown, allocate_dense, free_dense, reset_dense, allocate_csr, free_csr, reset_csr, generate_csr, allocate_csf, free_csf, reset_csf, generate_csf
+export setup, teardown, allocate_dense, free_dense, reset_dense, allocate_csr, free_csr, reset_csr, reserve_csr, generate_csr, allocate_csf, free_csf, reset_csf, generate_csf, save_dense, load_dense, save_csr, load_csr, save_csf, load_csf, cached_csr, cached_csf, WORKLOADS, generate_csr_workload, generate_csr_transposed, cached_csr_workload, cached_csr_transposed, read_mtx_csr, write_mtx_csr, csr_shape, csr_entries
 
 const LIB_HANDLE = Ref{Ptr{Cvoid}}(C_NULL)
 
-function setup()
-    println("Compiling Unzipping utils library...")
+# Storage/accumulation value types and their compile flags (see unzip_formats.h)
+const VALUE_FLAGS = Dict("double" => String[], "float" => ["-DVALUE_FLOAT"], "mixed" => ["-DVALUE_MIXED"])
+
+# The Matrix Market reader and writer parse and format in parallel; without OpenMP they run on one thread
+const OPENMP_FLAGS = Sys.isapple() ? String[] : ["-fopenmp"]
+
+# Element types of the index and value arrays of the loaded build, for reading tensors from Julia (see csr_entries)
+const INDEX_TYPE = Ref{DataType}(UInt64)
+const VALUE_TYPE = Ref{DataType}(Float64)
+
+# `index_bits` selects the width of the position and coordinate arrays (-DINDEX_BITS) and `value_type` the type of
+# the values ("double", "float" or "mixed"); both must match UnzipKernels.setup
+function setup(; index_bits=64, value_type="double")
+    println("Compiling Unzipping utils library ($(index_bits)-bit indices, $(value_type) values)...")
     lib_ext = Sys.isapple() ? "dylib" : "so"
-    lib_name = "libunzip_utils.$(lib_ext)"
-    run(`cc -shared -O3 -fPIC unzip_utils.c -o $lib_name`)
+    lib_suffix = (index_bits == 64 ? "" : "_idx$(index_bits)") * (value_type == "double" ? "" : "_$(value_type)")
+    lib_name = "libunzip_utils$(lib_suffix).$(lib_ext)"
+    run(`cc -shared -O3 -fPIC -DINDEX_BITS=$(index_bits) $(VALUE_FLAGS[value_type]) $(OPENMP_FLAGS) unzip_utils.c -lm -o $lib_name`)
     println("Compiled library: $lib_name")
     lib_path = joinpath(@__DIR__, lib_name)
     LIB_HANDLE[] = dlopen(lib_path, RTLD_LAZY | RTLD_GLOBAL)
+    INDEX_TYPE[] = index_bits == 32 ? UInt32 : UInt64
+    VALUE_TYPE[] = value_type == "double" ? Float64 : Float32
     println("Loaded library: $lib_path")
     println()
 end
@@ -52,6 +67,11 @@ function reset_csr(tensor::Ptr{Cvoid})
     ccall(func, Cvoid, (Ptr{Cvoid},), tensor)
 end
 
+function reserve_csr(tensor::Ptr{Cvoid}, nnz::Csize_t)
+    func = dlsym(LIB_HANDLE[], :reserve_csr)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Csize_t), tensor, nnz)
+end
+
 function generate_csr(ndim1::Csize_t, ndim2::Csize_t, sparsity::Cdouble, seed::Cuint)
     func = dlsym(LIB_HANDLE[], :generate_csr)
     return ccall(func, Ptr{Cvoid}, (Csize_t, Csize_t, Cdouble, Cuint), ndim1, ndim2, sparsity, seed)
@@ -77,4 +97,123 @@ function generate_csf(ndim1::Csize_t, ndim2::Csize_t, ndim3::Csize_t, sparsity::
     return ccall(func, Ptr{Cvoid}, (Csize_t, Csize_t, Csize_t, Cdouble, Cuint), ndim1, ndim2, ndim3, sparsity, seed)
 end
 
+# Binary tensor files (see struct tensor_file_header): save_* returns 0 on success, load_* C_NULL if the file is
+# missing or was written for another index width / value type
+function save_dense(tensor::Ptr{Cvoid}, path::AbstractString)
+    func = dlsym(LIB_HANDLE[], :save_dense)
+    return ccall(func, Cint, (Ptr{Cvoid}, Cstring), tensor, path)
+end
+
+function load_dense(path::AbstractString)
+    func = dlsym(LIB_HANDLE[], :load_dense)
+    return ccall(func, Ptr{Cvoid}, (Cstring,), path)
+end
+
+function save_csr(tensor::Ptr{Cvoid}, path::AbstractString)
+    func = dlsym(LIB_HANDLE[], :save_csr)
+    return ccall(func, Cint, (Ptr{Cvoid}, Cstring), tensor, path)
+end
+
+function load_csr(path::AbstractString)
+    func = dlsym(LIB_HANDLE[], :load_csr)
+    return ccall(func, Ptr{Cvoid}, (Cstring,), path)
+end
+
+function save_csf(tensor::Ptr{Cvoid}, path::AbstractString)
+    func = dlsym(LIB_HANDLE[], :save_csf)
+    return ccall(func, Cint, (Ptr{Cvoid}, Cstring), tensor, path)
+end
+
+function load_csf(path::AbstractString)
+    func = dlsym(LIB_HANDLE[], :load_csf)
+    return ccall(func, Ptr{Cvoid}, (Cstring,), path)
+end
+
+# generate_csr / generate_csf backed by the cache directory `dir`: the first run saves the tensor, later runs map it.
+# An empty `dir` generates without caching.
+function cached_csr(dir::AbstractString, ndim1::Csize_t, ndim2::Csize_t, sparsity::Cdouble, seed::Cuint)
+    isempty(dir) && return generate_csr(ndim1, ndim2, sparsity, seed)
+    func = dlsym(LIB_HANDLE[], :cached_csr)
+    return ccall(func, Ptr{Cvoid}, (Cstring, Csize_t, Csize_t, Cdouble, Cuint), dir, ndim1, ndim2, sparsity, seed)
+end
+
+function cached_csf(dir::AbstractString, ndim1::Csize_t, ndim2::Csize_t, ndim3::Csize_t, sparsity::Cdouble, seed::Cuint)
+    isempty(dir) && return generate_csf(ndim1, ndim2, ndim3, sparsity, seed)
+    func = dlsym(LIB_HANDLE[], :cached_csf)
+    return ccall(func, Ptr{Cvoid}, (Cstring, Csize_t, Csize_t, Csize_t, Cdouble, Cuint), dir, ndim1, ndim2, ndim3, sparsity, seed)
+end
+
+# Structured workloads of generate_csr_workload, in the order of enum workload (unzip_formats.h)
+const WORKLOADS = ["uniform", "power_law", "banded", "block_diagonal"]
+
+workload_id(workload::AbstractString) = Cint(findfirst(==(workload), WORKLOADS) - 1)
+
+function generate_csr_workload(workload::AbstractString, ndim1::Csize_t, ndim2::Csize_t, sparsity::Cdouble, seed::Cuint)
+    func = dlsym(LIB_HANDLE[], :generate_csr_workload)
+    return ccall(func, Ptr{Cvoid}, (Cint, Csize_t, Csize_t, Cdouble, Cuint), workload_id(workload), ndim1, ndim2, sparsity, seed)
+end
+
+# ndim1 x ndim2 matrix with the pattern of generate_csr_workload(workload, ndim2, ndim1, sparsity, pattern_seed)
+# transposed and values from `seed`
+function generate_csr_transposed(workload::AbstractString, ndim1::Csize_t, ndim2::Csize_t, sparsity::Cdouble, pattern_seed::Cuint, seed::Cuint)
+    func = dlsym(LIB_HANDLE[], :generate_csr_transposed)
+    return ccall(func, Ptr{Cvoid}, (Cint, Csize_t, Csize_t, Cdouble, Cuint, Cuint), workload_id(workload), ndim1, ndim2, sparsity, pattern_seed, seed)
+end
+
+function cached_csr_workload(dir::AbstractString, workload::AbstractString, ndim1::Csize_t, ndim2::Csize_t, sparsity::Cdouble, seed::Cuint)
+    isempty(dir) && return generate_csr_workload(workload, ndim1, ndim2, sparsity, seed)
+    func = dlsym(LIB_HANDLE[], :cached_csr_workload)
+    return ccall(func, Ptr{Cvoid}, (Cstring, Cint, Csize_t, Csize_t, Cdouble, Cuint), dir, workload_id(workload), ndim1, ndim2, sparsity, seed)
+end
+
+function cached_csr_transposed(dir::AbstractString, workload::AbstractString, ndim1::Csize_t, ndim2::Csize_t, sparsity::Cdouble, pattern_seed::Cuint, seed::Cuint)
+    isempty(dir) && return generate_csr_transposed(workload, ndim1, ndim2, sparsity, pattern_seed, seed)
+    func = dlsym(LIB_HANDLE[], :cached_csr_transposed)
+    return ccall(func, Ptr{Cvoid}, (Cstring, Cint, Csize_t, Csize_t, Cdouble, Cuint, Cuint), dir, workload_id(workload), ndim1, ndim2, sparsity, pattern_seed, seed)
+end
+
+# Matrix Market (.mtx) coordinate files: read_mtx_csr returns C_NULL (after reporting why) for unsupported or
+# malformed files, write_mtx_csr 0 on success
+function read_mtx_csr(path::AbstractString)
+    func = dlsym(LIB_HANDLE[], :read_mtx_csr)
+    return ccall(func, Ptr{Cvoid}, (Cstring,), path)
+end
+
+function write_mtx_csr(tensor::Ptr{Cvoid}, path::AbstractString)
+    func = dlsym(LIB_HANDLE[], :write_mtx_csr)
+    return ccall(func, Cint, (Ptr{Cvoid}, Cstring), tensor, path)
+end
+
+# Field layout of struct csr (unzip_formats.h)
+struct CSR
+    lvl1_size::Csize_t
+    lvl1_pos::Ptr{Cvoid}
+    lvl2_size::Csize_t
+    lvl2_nnz::Csize_t
+    lvl2_crd::Ptr{Cvoid}
+    vals::Ptr{Cvoid}
+    mapping::Ptr{Cvoid}
+    mapping_size::Csize_t
+end
+
+# (rows, cols, nnz) of a CSR tensor
+function csr_shape(tensor::Ptr{Cvoid})
+    t = unsafe_load(Ptr{CSR}(tensor))
+    return Int(t.lvl1_size), Int(t.lvl2_size), Int(unsafe_load(Ptr{INDEX_TYPE[]}(t.lvl1_pos), t.lvl1_size + 1))
+end
+
+# Copies of a CSR tensor's entries as 1-based (rows, cols, vals), e.g. to build the Finch input of the same matrix
+function csr_entries(tensor::Ptr{Cvoid})
+    t = unsafe_load(Ptr{CSR}(tensor))
+    nnz = Int(unsafe_load(Ptr{INDEX_TYPE[]}(t.lvl1_pos), t.lvl1_size + 1))
+    pos = unsafe_wrap(Array, Ptr{INDEX_TYPE[]}(t.lvl1_pos), t.lvl1_size + 1)
+    crd = unsafe_wrap(Array, Ptr{INDEX_TYPE[]}(t.lvl2_crd), nnz)
+    vals = unsafe_wrap(Array, Ptr{VALUE_TYPE[]}(t.vals), nnz)
+    rows = Vector{Int}(undef, nnz)
+    for i in 1:t.lvl1_size
+        rows[pos[i]+1:pos[i+1]] .= i
+    end
+    return rows, Int.(crd) .+ 1, Float64.(vals)
+end
+
 end # module
@@ -7,7 +7,7 @@ include("finch_kernels_test.jl")
 
 
 function run_tests()
-    UnzipKernelsTest.setup()
+    UnzipKernelsTest.setup(index_bits=parse(Int, get(ENV, "INDEX_BITS", "64")), value_type=get(ENV, "VALUE_TYPE", "double"))
 
     println("="^80)
     println("TEST 1: Hadamard Transpose")
@@ -46,6 +46,9 @@ function run_tests()
 
     println("\n------ Unzipping Result ------")
     UnzipKernelsTest.test_matmul()
+
+    println("\n------ Unzipping Accumulator Results (spa, spa_sorted, hybrid, parallel) ------")
+    UnzipKernelsTest.test_matmul_accumulators()
     println("="^80)
     println()
 
@@ -67,6 +70,21 @@ function run_tests()
 
     println("\n------ Unzipping Result ------")
     UnzipKernelsTest.test_matmul_hadamard()
+
+    println("\n------ Unzipping Accumulator Results (spa, spa_sorted, hybrid, parallel, fused, adaptive) ------")
+    UnzipKernelsTest.test_matmul_hadamard_accumulators()
+    println("="^80)
+    println()
+
+    println("="^80)
+    println("TEST 3b: Hash Accumulator (rows with few flops against a wide C)")
+    println("B = [1 2; 0 3]")
+    println("C: 2 x 64 with C(0,5)=1, C(0,20)=2, C(1,20)=3, C(1,31)=4; D: C's pattern, all 2")
+    println("A(i,j) = B(i,k) * C(k,j) (* D(k,j))")
+    println("Expected: (0,5) 1.0 (0,20) 8.0 (0,31) 8.0 (1,20) 9.0 (1,31) 12.0 for matmul, doubled for matmul_hadamard")
+
+    println("\n------ Unzipping Results (spa_sorted, hybrid, hadamard spa_sorted, hadamard hybrid) ------")
+    UnzipKernelsTest.test_matmul_hash_accumulator()
     println("="^80)
     println()
 
@@ -107,6 +125,30 @@ function run_tests()
 
     println("\n------ Unzipping Result ------")
     UnzipKernelsTest.test_permute_contract()
+
+    println("\n------ Unzipping Slice View Results (transposed, dense, parallel) ------")
+    UnzipKernelsTest.test_permute_contract_variants()
+    println("="^80)
+    println()
+
+    println("="^80)
+    println("TEST 6: Output Counts")
+    println("Generated B, C, D (CSR, 41 x 41); A allocated empty and reserved with hadamard_transpose_count, matmul_count")
+    println("or matmul_hadamard_count before each kernel")
+    println("Expected: same for each (the kernel stores exactly the counted entries)")
+
+    println("\n------ Unzipping Result ------")
+    UnzipKernelsTest.test_kernel_counts()
+    println("="^80)
+    println()
+
+    println("="^80)
+    println("TEST 7: Tensor Files")
+    println("Generated CSR (37 x 29) and CSF (9 x 8 x 7) through save/load, the tensor cache and write/read_mtx_csr")
+    println("Expected: same for each")
+
+    println("\n------ Unzipping Result ------")
+    UnzipKernelsTest.test_tensor_files()
     println("="^80)
     println()
 
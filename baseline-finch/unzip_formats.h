@@ -2,45 +2,127 @@
 #define FORMATS_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+// Index type of the position and coordinate arrays; build with -DINDEX_BITS=32 to halve their memory traffic when
+// every dimension and nnz count fits in 32 bits
+#ifndef INDEX_BITS
+#define INDEX_BITS 64
+#endif
+
+#if INDEX_BITS == 32
+typedef uint32_t index_t;
+#elif INDEX_BITS == 64
+typedef uint64_t index_t;
+#else
+#error "INDEX_BITS must be 32 or 64"
+#endif
+
+// Type of the stored values and of the reductions over them (matmul, hadamard_transpose_reduce, permute_contract):
+// double by default, -DVALUE_FLOAT stores and accumulates in float, -DVALUE_MIXED stores in float and accumulates
+// in double
+#if defined(VALUE_FLOAT) && defined(VALUE_MIXED)
+#error "VALUE_FLOAT and VALUE_MIXED are mutually exclusive"
+#elif defined(VALUE_FLOAT)
+typedef float value_t;
+typedef float acc_t;
+#elif defined(VALUE_MIXED)
+typedef float value_t;
+typedef double acc_t;
+#else
+typedef double value_t;
+typedef double acc_t;
+#endif
+
+// Version of the generate_* output: bumped whenever the same arguments produce different tensors, so cached inputs of
+// an older version are regenerated (see cached_csr)
+#define GENERATOR_VERSION 2
+
+// Structures of generate_csr_workload: the uniform pattern of generate_csr, Zipf-distributed row degrees, a band around
+// the diagonal and diagonal blocks, all with generate_csr's number of non-zeros (see unzip_utils.c)
+enum workload {
+  WORKLOAD_UNIFORM,
+  WORKLOAD_POWER_LAW,
+  WORKLOAD_BANDED,
+  WORKLOAD_BLOCK_DIAGONAL,
+};
+
+#define NUM_WORKLOADS 4
 
 // 1D Dense Vector
 struct dense {
   size_t size;  // size of the vector
-  double *vals; // values (size: size)
+  value_t *vals; // values (size: size)
+
+  void *mapping;       // load_dense: file mapping vals points into, NULL for heap tensors
+  size_t mapping_size; // bytes in mapping
 };
 
 // 2D Sparse Matrix in CSR (Compressed Sparse Row) format
 struct csr {
   // Level 1: rows
   size_t lvl1_size; // size of dimension 1 (rows)
-  size_t *lvl1_pos; // position array (size: lvl1_size + 1)
+  index_t *lvl1_pos; // position array (size: lvl1_size + 1)
 
   // Level 2: columns
   size_t lvl2_size; // size of dimension 2 (cols)
   size_t lvl2_nnz;  // number of non-zero elements
-  size_t *lvl2_crd; // coordinate array (size: lvl2_nnz)
+  index_t *lvl2_crd; // coordinate array (size: lvl2_nnz)
 
-  double *vals; // values (size: lvl2_nnz)
+  value_t *vals; // values (size: lvl2_nnz)
+
+  void *mapping;       // load_csr: file mapping the arrays point into, NULL for heap tensors
+  size_t mapping_size; // bytes in mapping
 };
 
 // 3D Sparse Tensor in CSF (Compressed Sparse Fiber) format
 struct csf {
   // Level 1: dim1 dimension
   size_t lvl1_size; // size of dimension 1 (rows)
-  size_t *lvl1_pos; // position array (size: lvl1_size + 1)
+  index_t *lvl1_pos; // position array (size: lvl1_size + 1)
 
   // Level 2: dim2 dimension within each dim1
   size_t lvl2_size; // size of dimension 2
   size_t lvl2_nnz;  // number of non-zero (dim1,dim2) fibers
-  size_t *lvl2_pos; // position array (size: lvl2_nnz + 1)
-  size_t *lvl2_crd; // coordinate array (size: lvl2_nnz)
+  index_t *lvl2_pos; // position array (size: lvl2_nnz + 1)
+  index_t *lvl2_crd; // coordinate array (size: lvl2_nnz)
 
   // Level 3: dim3 dimension within each (dim1,dim2)
   size_t lvl3_size; // size of dimension 3
   size_t lvl3_nnz;  // number of non-zero elements
-  size_t *lvl3_crd; // coordinate array (size: lvl3_nnz)
+  index_t *lvl3_crd; // coordinate array (size: lvl3_nnz)
+
+  value_t *vals; // values (size: lvl3_nnz)
+
+  void *mapping;       // load_csf: file mapping the arrays point into, NULL for heap tensors
+  size_t mapping_size; // bytes in mapping
+};
+
+// Binary tensor file (save_* / load_* in unzip_utils.c): this header, then the tensor's arrays in struct order, each
+// starting on a TENSOR_FILE_ALIGN byte boundary so a loaded tensor can point straight into a private mapping of the
+// file. Loaded tensors are kernel inputs: they can be reset but not reserved.
+#define TENSOR_FILE_MAGIC "UNZIPTNS"
+#define TENSOR_FILE_VERSION 1
+#define TENSOR_FILE_ALIGN 64
+#define TENSOR_FILE_SECTIONS 5
+
+enum tensor_file_format {
+  TENSOR_FILE_DENSE = 1,
+  TENSOR_FILE_CSR = 2,
+  TENSOR_FILE_CSF = 5,
+};
+
+struct tensor_file_header {
+  char magic[8];        // TENSOR_FILE_MAGIC, not NUL-terminated
+  uint32_t version;     // TENSOR_FILE_VERSION
+  uint32_t format;      // enum tensor_file_format
+  uint32_t index_bytes; // sizeof(index_t) of the writer, must match the reader
+  uint32_t value_bytes; // sizeof(value_t) of the writer, must match the reader
+  uint64_t sizes[6];    // lvl*_size / lvl*_nnz of the format, in struct order
 
-  double *vals; // values (size: lvl3_nnz)
+  // Arrays in struct order; offsets count from the start of the file
+  uint64_t offset[TENSOR_FILE_SECTIONS];
+  uint64_t bytes[TENSOR_FILE_SECTIONS];
 };
 
 #endif /* FORMATS_H */
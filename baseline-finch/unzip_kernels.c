@@ -1,5 +1,10 @@
 #include "unzip_kernels.h"
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
 
 /* A(i,j) = B(i,j) * C(j,i) */
 void hadamard_transpose(struct csr *t1, struct csr *t2, struct csr *res) {
@@ -9,14 +14,14 @@ void hadamard_transpose(struct csr *t1, struct csr *t2, struct csr *res) {
     size_t t1_lvl1_pos_end = t1->lvl1_pos[t1_lvl1_idx + 1];
     for (size_t t1_lvl1_pos_idx = t1_lvl1_pos_start; t1_lvl1_pos_idx < t1_lvl1_pos_end; ++t1_lvl1_pos_idx) {
       size_t t1_lvl2_crd = t1->lvl2_crd[t1_lvl1_pos_idx];
-      double t1_val = t1->vals[t1_lvl1_pos_idx];
+      value_t t1_val = t1->vals[t1_lvl1_pos_idx];
       // Locate matching j in C(j,i)
       size_t t2_lvl1_pos_start = t2->lvl1_pos[t1_lvl2_crd];
       size_t t2_lvl1_pos_end = t2->lvl1_pos[t1_lvl2_crd + 1];
       for (size_t t2_lvl1_pos_idx = t2_lvl1_pos_start; t2_lvl1_pos_idx < t2_lvl1_pos_end; ++t2_lvl1_pos_idx) {
         size_t t2_lvl2_crd = t2->lvl2_crd[t2_lvl1_pos_idx];
         if (t2_lvl2_crd == t1_lvl1_idx) {
-          double t2_val = t2->vals[t2_lvl1_pos_idx];
+          value_t t2_val = t2->vals[t2_lvl1_pos_idx];
           // Set A(i,j)
           if (t1_val != 0.0 && t2_val != 0.0) {
             size_t nnz = res->lvl2_nnz;
@@ -31,12 +36,33 @@ void hadamard_transpose(struct csr *t1, struct csr *t2, struct csr *res) {
   }
 }
 
+/* nnz(A) for A(i,j) = B(i,j) * C(j,i) */
+size_t hadamard_transpose_count(struct csr *t1, struct csr *t2) {
+  size_t nnz = 0;
+  for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < t1->lvl1_size; ++t1_lvl1_idx) {
+    // Iterate over i in B(i,j)
+    for (size_t t1_lvl1_pos_idx = t1->lvl1_pos[t1_lvl1_idx]; t1_lvl1_pos_idx < t1->lvl1_pos[t1_lvl1_idx + 1];
+         ++t1_lvl1_pos_idx) {
+      size_t t1_lvl2_crd = t1->lvl2_crd[t1_lvl1_pos_idx];
+      if (t1->vals[t1_lvl1_pos_idx] == 0.0)
+        continue;
+      // Count matching j in C(j,i)
+      for (size_t t2_lvl1_pos_idx = t2->lvl1_pos[t1_lvl2_crd]; t2_lvl1_pos_idx < t2->lvl1_pos[t1_lvl2_crd + 1];
+           ++t2_lvl1_pos_idx) {
+        if (t2->lvl2_crd[t2_lvl1_pos_idx] == t1_lvl1_idx && t2->vals[t2_lvl1_pos_idx] != 0.0)
+          ++nnz;
+      }
+    }
+  }
+  return nnz;
+}
+
 /* A(i, j) = B(i, k) * C(k, j) */
 void matmul(struct csr *t1, struct csr *t2, struct csr *res) {
   // Allocate dense accumulation buffers for output dimension j (columns)
   // Reducing over dimension k (shared dimension between B and C)
-  double *lvl2_acc = (double *)calloc(res->lvl2_size, sizeof(double));
-  size_t *lvl2_mkr = (size_t *)calloc(res->lvl2_size, sizeof(size_t));
+  acc_t *lvl2_acc = (acc_t *)calloc(res->lvl2_size, sizeof(acc_t));
+  index_t *lvl2_mkr = (index_t *)calloc(res->lvl2_size, sizeof(index_t));
 
   for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < t1->lvl1_size; ++t1_lvl1_idx) {
     // Phase 1: Accumulate into dense buffer
@@ -45,23 +71,23 @@ void matmul(struct csr *t1, struct csr *t2, struct csr *res) {
     size_t t1_lvl1_pos_end = t1->lvl1_pos[t1_lvl1_idx + 1];
     for (size_t t1_lvl1_pos_idx = t1_lvl1_pos_start; t1_lvl1_pos_idx < t1_lvl1_pos_end; ++t1_lvl1_pos_idx) {
       size_t t1_lvl2_crd = t1->lvl2_crd[t1_lvl1_pos_idx];
-      double t1_val = t1->vals[t1_lvl1_pos_idx];
+      value_t t1_val = t1->vals[t1_lvl1_pos_idx];
       // Iterate over k in C(k,j)
       size_t t2_lvl1_pos_start = t2->lvl1_pos[t1_lvl2_crd];
       size_t t2_lvl1_pos_end = t2->lvl1_pos[t1_lvl2_crd + 1];
       for (size_t t2_lvl1_pos_idx = t2_lvl1_pos_start; t2_lvl1_pos_idx < t2_lvl1_pos_end; ++t2_lvl1_pos_idx) {
         size_t t2_lvl2_crd = t2->lvl2_crd[t2_lvl1_pos_idx];
-        double t2_val = t2->vals[t2_lvl1_pos_idx];
+        value_t t2_val = t2->vals[t2_lvl1_pos_idx];
         // Accumulate into buffer for A(i,j)
         lvl2_mkr[t2_lvl2_crd] = t1_lvl1_idx + 1; // Mark as touched in this dim
-        lvl2_acc[t2_lvl2_crd] += t1_val * t2_val;
+        lvl2_acc[t2_lvl2_crd] += (acc_t)t1_val * t2_val;
       }
     }
 
     // Phase 2: Compress buffer into CSR output
     for (size_t lvl2_idx = 0; lvl2_idx < res->lvl2_size; ++lvl2_idx) {
       size_t lvl2_marker_crd = lvl2_mkr[lvl2_idx];
-      double t2_val = lvl2_acc[lvl2_idx];
+      acc_t t2_val = lvl2_acc[lvl2_idx];
       if (lvl2_marker_crd == t1_lvl1_idx + 1 && t2_val != 0.0) {
         size_t nnz = res->lvl2_nnz;
         res->lvl2_crd[nnz] = lvl2_idx;
@@ -80,8 +106,8 @@ void matmul(struct csr *t1, struct csr *t2, struct csr *res) {
 /* A(i, j) = B(i, k) * C(k, j) * D(k, j) */
 void matmul_hadamard(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res) {
   // Allocate dense accumulation buffer for one row
-  double *lvl2_acc = (double *)calloc(res->lvl2_size, sizeof(double));
-  size_t *lvl2_mkr = (size_t *)calloc(res->lvl2_size, sizeof(size_t));
+  acc_t *lvl2_acc = (acc_t *)calloc(res->lvl2_size, sizeof(acc_t));
+  index_t *lvl2_mkr = (index_t *)calloc(res->lvl2_size, sizeof(index_t));
 
   for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < t1->lvl1_size; ++t1_lvl1_idx) {
     // Phase 1: Accumulate into dense buffer
@@ -90,23 +116,23 @@ void matmul_hadamard(struct csr *t1, struct csr *t2, struct csr *t3, struct csr
     size_t t1_lvl1_pos_end = t1->lvl1_pos[t1_lvl1_idx + 1];
     for (size_t t1_lvl1_pos_idx = t1_lvl1_pos_start; t1_lvl1_pos_idx < t1_lvl1_pos_end; ++t1_lvl1_pos_idx) {
       size_t t1_lvl2_crd = t1->lvl2_crd[t1_lvl1_pos_idx];
-      double t1_val = t1->vals[t1_lvl1_pos_idx];
+      value_t t1_val = t1->vals[t1_lvl1_pos_idx];
       // Iterate over k in C(k,j)
       size_t t2_lvl1_pos_start = t2->lvl1_pos[t1_lvl2_crd];
       size_t t2_lvl1_pos_end = t2->lvl1_pos[t1_lvl2_crd + 1];
       for (size_t t2_lvl1_pos_idx = t2_lvl1_pos_start; t2_lvl1_pos_idx < t2_lvl1_pos_end; ++t2_lvl1_pos_idx) {
         size_t t2_lvl2_crd = t2->lvl2_crd[t2_lvl1_pos_idx];
-        double t2_val = t2->vals[t2_lvl1_pos_idx];
+        value_t t2_val = t2->vals[t2_lvl1_pos_idx];
         // Locate matching j in D(k,j)
         size_t t3_lvl1_pos_start = t3->lvl1_pos[t1_lvl2_crd];
         size_t t3_lvl1_pos_end = t3->lvl1_pos[t1_lvl2_crd + 1];
         for (size_t t3_lvl1_pos_idx = t3_lvl1_pos_start; t3_lvl1_pos_idx < t3_lvl1_pos_end; ++t3_lvl1_pos_idx) {
           size_t t3_lvl2_crd = t3->lvl2_crd[t3_lvl1_pos_idx];
           if (t3_lvl2_crd == t2_lvl2_crd) {
-            double t3_val = t3->vals[t3_lvl1_pos_idx];
+            value_t t3_val = t3->vals[t3_lvl1_pos_idx];
             // Accumulate into buffer for A(i,j)
             lvl2_mkr[t2_lvl2_crd] = t1_lvl1_idx + 1;
-            lvl2_acc[t2_lvl2_crd] += t1_val * t2_val * t3_val;
+            lvl2_acc[t2_lvl2_crd] += (acc_t)t1_val * t2_val * t3_val;
             break;
           }
         }
@@ -116,7 +142,7 @@ void matmul_hadamard(struct csr *t1, struct csr *t2, struct csr *t3, struct csr
     // Phase 2: Compress buffer into CSR output
     for (size_t t2_lvl1_idx = 0; t2_lvl1_idx < t2->lvl1_size; ++t2_lvl1_idx) {
       size_t lvl2_marker_crd = lvl2_mkr[t2_lvl1_idx];
-      double t2_val = lvl2_acc[t2_lvl1_idx];
+      acc_t t2_val = lvl2_acc[t2_lvl1_idx];
       if (lvl2_marker_crd == t1_lvl1_idx + 1 && t2_val != 0.0) {
         size_t nnz = res->lvl2_nnz;
         res->lvl2_crd[nnz] = t2_lvl1_idx;
@@ -133,28 +159,412 @@ void matmul_hadamard(struct csr *t1, struct csr *t2, struct csr *t3, struct csr
   free(lvl2_mkr);
 }
 
+// Rows whose estimated flops are at most lvl2_size / HASH_FLOPS_RATIO accumulate in the hash table
+#define HASH_FLOPS_RATIO 16
+#define HASH_EMPTY ((index_t)-1)
+
+// Sparse accumulator: dense values and markers over the output columns, plus the columns touched by the current row
+struct spa {
+  acc_t *acc;
+  size_t *mkr; // row markers, size_t like row_mkr: the parallel kernels' numeric pass offsets them by lvl1_size
+  index_t *touched;
+  size_t num_touched;
+};
+
+// Hash accumulator: open-addressing table from output column to value, sized for rows with few flops
+struct hash_acc {
+  size_t mask;
+  index_t *keys;
+  acc_t *vals;
+  index_t *used; // slots filled by the current row, in insertion order
+  size_t num_used;
+};
+
+static void spa_init(struct spa *spa, size_t size) {
+  spa->acc = (acc_t *)malloc(size * sizeof(acc_t));
+  spa->mkr = (size_t *)calloc(size, sizeof(size_t));
+  spa->touched = (index_t *)malloc(size * sizeof(index_t));
+  spa->num_touched = 0;
+}
+
+static void spa_free(struct spa *spa) {
+  free(spa->acc);
+  free(spa->mkr);
+  free(spa->touched);
+}
+
+static inline void spa_add(struct spa *spa, size_t row_mkr, size_t crd, acc_t val) {
+  if (spa->mkr[crd] != row_mkr) {
+    spa->mkr[crd] = row_mkr;
+    spa->acc[crd] = val;
+    spa->touched[spa->num_touched++] = crd;
+  } else {
+    spa->acc[crd] += val;
+  }
+}
+
+static int compare_crd(const void *a, const void *b) {
+  index_t crd_a = *(const index_t *)a;
+  index_t crd_b = *(const index_t *)b;
+  return (crd_a > crd_b) - (crd_a < crd_b);
+}
+
+// Write the touched columns of the current row to res starting at nnz, clear the touched list and return the end
+static inline size_t spa_compress(struct spa *spa, struct csr *res, size_t nnz, bool sorted) {
+  if (sorted) {
+    qsort(spa->touched, spa->num_touched, sizeof(index_t), compare_crd);
+  }
+  for (size_t touched_idx = 0; touched_idx < spa->num_touched; ++touched_idx) {
+    size_t lvl2_idx = spa->touched[touched_idx];
+    acc_t val = spa->acc[lvl2_idx];
+    if (val != 0.0) {
+      res->lvl2_crd[nnz] = lvl2_idx;
+      res->vals[nnz] = val;
+      ++nnz;
+    }
+  }
+  spa->num_touched = 0;
+  return nnz;
+}
+
+// Count the entries spa_compress would write for the current row and clear the touched list
+static inline size_t spa_count(struct spa *spa) {
+  size_t count = 0;
+  for (size_t touched_idx = 0; touched_idx < spa->num_touched; ++touched_idx)
+    count += spa->acc[spa->touched[touched_idx]] != 0.0;
+  spa->num_touched = 0;
+  return count;
+}
+
+static void hash_init(struct hash_acc *hash, size_t max_entries) {
+  // Keep the load factor at or below 1/2
+  size_t num_slots = 2;
+  while (num_slots < 2 * max_entries)
+    num_slots <<= 1;
+  hash->mask = num_slots - 1;
+  hash->keys = (index_t *)malloc(num_slots * sizeof(index_t));
+  hash->vals = (acc_t *)malloc(num_slots * sizeof(acc_t));
+  hash->used = (index_t *)malloc(num_slots * sizeof(index_t));
+  hash->num_used = 0;
+  for (size_t slot = 0; slot < num_slots; ++slot)
+    hash->keys[slot] = HASH_EMPTY;
+}
+
+static void hash_free(struct hash_acc *hash) {
+  free(hash->keys);
+  free(hash->vals);
+  free(hash->used);
+}
+
+static inline void hash_add(struct hash_acc *hash, size_t crd, acc_t val) {
+  size_t slot = (crd * 0x9E3779B97F4A7C15ULL >> 32) & hash->mask;
+  for (;;) {
+    size_t key = hash->keys[slot];
+    if (key == crd) {
+      hash->vals[slot] += val;
+      return;
+    }
+    if (key == HASH_EMPTY) {
+      hash->keys[slot] = crd;
+      hash->vals[slot] = val;
+      hash->used[hash->num_used++] = slot;
+      return;
+    }
+    slot = (slot + 1) & hash->mask;
+  }
+}
+
+// Append the entries of the current row to res and empty the table
+static inline void hash_compress(struct hash_acc *hash, struct csr *res) {
+  for (size_t used_idx = 0; used_idx < hash->num_used; ++used_idx) {
+    size_t slot = hash->used[used_idx];
+    acc_t val = hash->vals[slot];
+    if (val != 0.0) {
+      size_t nnz = res->lvl2_nnz;
+      res->lvl2_crd[nnz] = hash->keys[slot];
+      res->vals[nnz] = val;
+      res->lvl2_nnz = nnz + 1;
+    }
+    hash->keys[slot] = HASH_EMPTY;
+  }
+  hash->num_used = 0;
+}
+
+// Upper bound on the products row i of A(i, j) = B(i, k) * C(k, j) accumulates
+static inline size_t row_flops(struct csr *t1, struct csr *t2, size_t t1_lvl1_idx) {
+  size_t flops = 0;
+  for (size_t t1_lvl1_pos_idx = t1->lvl1_pos[t1_lvl1_idx]; t1_lvl1_pos_idx < t1->lvl1_pos[t1_lvl1_idx + 1];
+       ++t1_lvl1_pos_idx) {
+    size_t t1_lvl2_crd = t1->lvl2_crd[t1_lvl1_pos_idx];
+    flops += t2->lvl1_pos[t1_lvl2_crd + 1] - t2->lvl1_pos[t1_lvl2_crd];
+  }
+  return flops;
+}
+
+// Accumulate row i of B(i, k) * C(k, j), times D(k, j) when t3 is given, into the hash table if given, else the SPA
+// marking touched columns with row_mkr
+static inline void accumulate_row(struct csr *t1, struct csr *t2, struct csr *t3, size_t t1_lvl1_idx, size_t row_mkr,
+                                  struct spa *spa, struct hash_acc *hash) {
+  // Iterate over i in B(i,k)
+  size_t t1_lvl1_pos_start = t1->lvl1_pos[t1_lvl1_idx];
+  size_t t1_lvl1_pos_end = t1->lvl1_pos[t1_lvl1_idx + 1];
+  for (size_t t1_lvl1_pos_idx = t1_lvl1_pos_start; t1_lvl1_pos_idx < t1_lvl1_pos_end; ++t1_lvl1_pos_idx) {
+    size_t t1_lvl2_crd = t1->lvl2_crd[t1_lvl1_pos_idx];
+    value_t t1_val = t1->vals[t1_lvl1_pos_idx];
+    // Iterate over k in C(k,j)
+    size_t t2_lvl1_pos_start = t2->lvl1_pos[t1_lvl2_crd];
+    size_t t2_lvl1_pos_end = t2->lvl1_pos[t1_lvl2_crd + 1];
+    for (size_t t2_lvl1_pos_idx = t2_lvl1_pos_start; t2_lvl1_pos_idx < t2_lvl1_pos_end; ++t2_lvl1_pos_idx) {
+      size_t t2_lvl2_crd = t2->lvl2_crd[t2_lvl1_pos_idx];
+      acc_t val = (acc_t)t1_val * t2->vals[t2_lvl1_pos_idx];
+      if (t3) {
+        // Locate matching j in D(k,j)
+        size_t t3_lvl1_pos_idx = t3->lvl1_pos[t1_lvl2_crd];
+        size_t t3_lvl1_pos_end = t3->lvl1_pos[t1_lvl2_crd + 1];
+        while (t3_lvl1_pos_idx < t3_lvl1_pos_end && t3->lvl2_crd[t3_lvl1_pos_idx] != t2_lvl2_crd)
+          ++t3_lvl1_pos_idx;
+        if (t3_lvl1_pos_idx == t3_lvl1_pos_end)
+          continue;
+        val *= t3->vals[t3_lvl1_pos_idx];
+      }
+      // Accumulate into buffer for A(i,j)
+      if (hash)
+        hash_add(hash, t2_lvl2_crd, val);
+      else
+        spa_add(spa, row_mkr, t2_lvl2_crd, val);
+    }
+  }
+}
+
+// Gustavson SpGEMM over a sparse accumulator, optionally switching to the hash accumulator on rows with few flops
+static void matmul_sparse_acc(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res, bool sorted,
+                              bool hybrid) {
+  struct spa spa;
+  spa_init(&spa, res->lvl2_size);
+  struct hash_acc hash = {0};
+  size_t hash_max_flops = res->lvl2_size / HASH_FLOPS_RATIO;
+  if (hybrid)
+    hash_init(&hash, hash_max_flops);
+
+  for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < t1->lvl1_size; ++t1_lvl1_idx) {
+    if (hybrid && row_flops(t1, t2, t1_lvl1_idx) <= hash_max_flops) {
+      accumulate_row(t1, t2, t3, t1_lvl1_idx, 0, NULL, &hash);
+      hash_compress(&hash, res);
+    } else {
+      accumulate_row(t1, t2, t3, t1_lvl1_idx, t1_lvl1_idx + 1, &spa, NULL);
+      res->lvl2_nnz = spa_compress(&spa, res, res->lvl2_nnz, sorted);
+    }
+    res->lvl1_pos[t1_lvl1_idx + 1] = res->lvl2_nnz;
+  }
+
+  spa_free(&spa);
+  if (hybrid)
+    hash_free(&hash);
+}
+
+void matmul_spa(struct csr *t1, struct csr *t2, struct csr *res) { matmul_sparse_acc(t1, t2, NULL, res, false, false); }
+
+void matmul_spa_sorted(struct csr *t1, struct csr *t2, struct csr *res) {
+  matmul_sparse_acc(t1, t2, NULL, res, true, false);
+}
+
+void matmul_hybrid(struct csr *t1, struct csr *t2, struct csr *res) {
+  matmul_sparse_acc(t1, t2, NULL, res, false, true);
+}
+
+void matmul_hadamard_spa(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res) {
+  matmul_sparse_acc(t1, t2, t3, res, false, false);
+}
+
+void matmul_hadamard_spa_sorted(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res) {
+  matmul_sparse_acc(t1, t2, t3, res, true, false);
+}
+
+void matmul_hadamard_hybrid(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res) {
+  matmul_sparse_acc(t1, t2, t3, res, false, true);
+}
+
+// Row-parallel Gustavson SpGEMM: each thread owns a sparse accumulator; a symbolic pass computes the exact
+// entries per row, a prefix sum turns them into res->lvl1_pos and a numeric pass writes every row into its slice
+static void matmul_sparse_acc_parallel(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res) {
+  size_t lvl1_size = t1->lvl1_size;
+  size_t nnz_start = res->lvl2_nnz;
+
+#pragma omp parallel
+  {
+    struct spa spa;
+    spa_init(&spa, res->lvl2_size);
+
+    // Phase 1: Count the entries of each row into lvl1_pos[i + 1]
+#pragma omp for schedule(dynamic, 64)
+    for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < lvl1_size; ++t1_lvl1_idx) {
+      accumulate_row(t1, t2, t3, t1_lvl1_idx, t1_lvl1_idx + 1, &spa, NULL);
+      res->lvl1_pos[t1_lvl1_idx + 1] = spa_count(&spa);
+    }
+
+#pragma omp single
+    {
+      res->lvl1_pos[0] = nnz_start;
+      for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < lvl1_size; ++t1_lvl1_idx)
+        res->lvl1_pos[t1_lvl1_idx + 1] += res->lvl1_pos[t1_lvl1_idx];
+      res->lvl2_nnz = res->lvl1_pos[lvl1_size];
+    }
+
+    // Phase 2: Accumulate each row again and compress it into its slice; markers are offset past phase 1's
+#pragma omp for schedule(dynamic, 64)
+    for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < lvl1_size; ++t1_lvl1_idx) {
+      accumulate_row(t1, t2, t3, t1_lvl1_idx, lvl1_size + t1_lvl1_idx + 1, &spa, NULL);
+      spa_compress(&spa, res, res->lvl1_pos[t1_lvl1_idx], false);
+    }
+
+    spa_free(&spa);
+  }
+}
+
+void matmul_parallel(struct csr *t1, struct csr *t2, struct csr *res) {
+  matmul_sparse_acc_parallel(t1, t2, NULL, res);
+}
+
+void matmul_hadamard_parallel(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res) {
+  matmul_sparse_acc_parallel(t1, t2, t3, res);
+}
+
+// Fused matmul_hadamard: E(k,j) = C(k,j) * D(k,j) row by row, then A = B * E through the sparse accumulator.
+// Worth it once locating D(k,j) inside every flop costs more than one pass over C and D; see matmul_hadamard_adaptive.
+
+// E(k,j) = C(k,j) * D(k,j): scatter row k of D (first entry per column, like the linear search), then filter row k
+// of C through it. E keeps C's entry order so accumulation order matches the unfused kernels.
+static struct csr *hadamard_rows(struct csr *t2, struct csr *t3) {
+  struct csr *res = (struct csr *)malloc(sizeof(struct csr));
+  res->lvl1_size = t2->lvl1_size;
+  res->lvl2_size = t2->lvl2_size;
+  res->lvl1_pos = (index_t *)malloc((t2->lvl1_size + 1) * sizeof(index_t));
+  res->lvl2_crd = (index_t *)malloc(t2->lvl1_pos[t2->lvl1_size] * sizeof(index_t));
+  res->vals = (value_t *)malloc(t2->lvl1_pos[t2->lvl1_size] * sizeof(value_t));
+  res->lvl1_pos[0] = 0;
+  res->lvl2_nnz = 0;
+
+  index_t *lvl2_mkr = (index_t *)calloc(t3->lvl2_size, sizeof(index_t));
+  index_t *lvl2_pos = (index_t *)malloc(t3->lvl2_size * sizeof(index_t));
+  for (size_t lvl1_idx = 0; lvl1_idx < t2->lvl1_size; ++lvl1_idx) {
+    // Scatter row k of D
+    for (size_t t3_pos_idx = t3->lvl1_pos[lvl1_idx]; t3_pos_idx < t3->lvl1_pos[lvl1_idx + 1]; ++t3_pos_idx) {
+      size_t t3_lvl2_crd = t3->lvl2_crd[t3_pos_idx];
+      if (lvl2_mkr[t3_lvl2_crd] != lvl1_idx + 1) {
+        lvl2_mkr[t3_lvl2_crd] = lvl1_idx + 1;
+        lvl2_pos[t3_lvl2_crd] = t3_pos_idx;
+      }
+    }
+    // Keep the entries of row k of C that D also has
+    for (size_t t2_pos_idx = t2->lvl1_pos[lvl1_idx]; t2_pos_idx < t2->lvl1_pos[lvl1_idx + 1]; ++t2_pos_idx) {
+      size_t t2_lvl2_crd = t2->lvl2_crd[t2_pos_idx];
+      if (lvl2_mkr[t2_lvl2_crd] == lvl1_idx + 1) {
+        size_t nnz = res->lvl2_nnz;
+        res->lvl2_crd[nnz] = t2_lvl2_crd;
+        res->vals[nnz] = t2->vals[t2_pos_idx] * t3->vals[lvl2_pos[t2_lvl2_crd]];
+        res->lvl2_nnz = nnz + 1;
+      }
+    }
+    res->lvl1_pos[lvl1_idx + 1] = res->lvl2_nnz;
+  }
+  free(lvl2_mkr);
+  free(lvl2_pos);
+  return res;
+}
+
+static void free_hadamard_rows(struct csr *tensor) {
+  free(tensor->lvl1_pos);
+  free(tensor->lvl2_crd);
+  free(tensor->vals);
+  free(tensor);
+}
+
+// Multiplications B * C performs: for every B(i,k), the entries of row k of C
+static size_t matmul_products(struct csr *t1, struct csr *t2) {
+  size_t flops = 0;
+  for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < t1->lvl1_size; ++t1_lvl1_idx)
+    flops += row_flops(t1, t2, t1_lvl1_idx);
+  return flops;
+}
+
+void matmul_hadamard_fused(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res) {
+  struct csr *fused = hadamard_rows(t2, t3);
+  matmul_sparse_acc(t1, fused, NULL, res, false, false);
+  free_hadamard_rows(fused);
+}
+
+void matmul_hadamard_adaptive(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res) {
+  // Unfused, each B(i,k) * C(k,j) scans about half of row k of D, nnz(D) / (2 rows) entries. Fused, one pass over C
+  // and D replaces the scans and leaves at most as many flops.
+  size_t t2_nnz = t2->lvl1_pos[t2->lvl1_size];
+  size_t t3_nnz = t3->lvl1_pos[t3->lvl1_size];
+  size_t flops = matmul_products(t1, t2);
+  if (2 * (t2_nnz + t3_nnz) * t3->lvl1_size < flops * t3_nnz)
+    matmul_hadamard_fused(t1, t2, t3, res);
+  else
+    matmul_hadamard_spa(t1, t2, t3, res);
+}
+
+void matmul_hadamard_flops(struct csr *t1, struct csr *t2, struct csr *t3, size_t *unfused, size_t *fused) {
+  // Unfused: one multiply per B(i,k) * C(k,j) after its search of row k of D
+  *unfused = matmul_products(t1, t2);
+  // Fused: one multiply per entry of C * D, then one per B(i,k) * E(k,j)
+  struct csr *t23 = hadamard_rows(t2, t3);
+  *fused = t23->lvl2_nnz + matmul_products(t1, t23);
+  free_hadamard_rows(t23);
+}
+
+// Entries the accumulator kernels write: distinct touched columns per row whose sum is non-zero
+static size_t matmul_sparse_acc_count(struct csr *t1, struct csr *t2, struct csr *t3) {
+  struct spa spa;
+  spa_init(&spa, t2->lvl2_size);
+  size_t nnz = 0;
+  for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < t1->lvl1_size; ++t1_lvl1_idx) {
+    accumulate_row(t1, t2, t3, t1_lvl1_idx, t1_lvl1_idx + 1, &spa, NULL);
+    nnz += spa_count(&spa);
+  }
+  spa_free(&spa);
+  return nnz;
+}
+
+size_t matmul_count(struct csr *t1, struct csr *t2) { return matmul_sparse_acc_count(t1, t2, NULL); }
+
+size_t matmul_hadamard_count(struct csr *t1, struct csr *t2, struct csr *t3) {
+  return matmul_sparse_acc_count(t1, t2, t3);
+}
+
+void set_num_threads(int num_threads) {
+#if defined(_OPENMP)
+  omp_set_num_threads(num_threads);
+#else
+  (void)num_threads;
+#endif
+}
+
 /* y(i) = B(i, j) * C(j, i) */
 void hadamard_transpose_reduce(struct csr *t1, struct csr *t2, struct dense *res) {
   for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < t1->lvl1_size; ++t1_lvl1_idx) {
+    acc_t acc = 0.0;
     // Iterate over i in B(i,j)
     size_t t1_lvl1_pos_start = t1->lvl1_pos[t1_lvl1_idx];
     size_t t1_lvl1_pos_end = t1->lvl1_pos[t1_lvl1_idx + 1];
     for (size_t t1_lvl1_pos_idx = t1_lvl1_pos_start; t1_lvl1_pos_idx < t1_lvl1_pos_end; ++t1_lvl1_pos_idx) {
       size_t t1_lvl2_crd = t1->lvl2_crd[t1_lvl1_pos_idx];
-      double t1_val = t1->vals[t1_lvl1_pos_idx];
+      value_t t1_val = t1->vals[t1_lvl1_pos_idx];
       // Locate matching j in C(j,i)
       size_t t2_lvl1_pos_start = t2->lvl1_pos[t1_lvl2_crd];
       size_t t2_lvl1_pos_end = t2->lvl1_pos[t1_lvl2_crd + 1];
       for (size_t t2_lvl1_pos_idx = t2_lvl1_pos_start; t2_lvl1_pos_idx < t2_lvl1_pos_end; ++t2_lvl1_pos_idx) {
         size_t t2_lvl2_crd = t2->lvl2_crd[t2_lvl1_pos_idx];
         if (t2_lvl2_crd == t1_lvl1_idx) {
-          double t2_val = t2->vals[t2_lvl1_pos_idx];
+          value_t t2_val = t2->vals[t2_lvl1_pos_idx];
           // Accumulate into y(i)
-          res->vals[t1_lvl1_idx] += t1_val * t2_val;
+          acc += (acc_t)t1_val * t2_val;
           break;
         }
       }
     }
+    res->vals[t1_lvl1_idx] += acc;
   }
 }
 
@@ -162,6 +572,7 @@ void hadamard_transpose_reduce(struct csr *t1, struct csr *t2, struct dense *res
 void permute_contract(struct csf *t1, struct csf *t2, struct dense *res) {
   // Iterate over i in B and C
   for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < t1->lvl1_size; ++t1_lvl1_idx) {
+    acc_t acc = 0.0;
     size_t t2_lvl1_pos_start = t2->lvl1_pos[t1_lvl1_idx];
     size_t t2_lvl1_pos_end = t2->lvl1_pos[t1_lvl1_idx + 1];
     // Iterate over j in B(i,j,k)
@@ -170,7 +581,7 @@ void permute_contract(struct csf *t1, struct csf *t2, struct dense *res) {
       size_t t1_lvl2_pos_start = t1->lvl2_pos[t1_lvl1_pos_idx];
       size_t t1_lvl2_pos_end = t1->lvl2_pos[t1_lvl1_pos_idx + 1];
       // Iterate over k in C(i,k,j)
-      for (size_t t2_lvl1_pos_idx = t2->lvl1_pos[t1_lvl1_idx]; t2_lvl1_pos_idx < t2->lvl1_pos[t1_lvl1_idx + 1]; ++t2_lvl1_pos_idx) {
+      for (size_t t2_lvl1_pos_idx = t2_lvl1_pos_start; t2_lvl1_pos_idx < t2_lvl1_pos_end; ++t2_lvl1_pos_idx) {
         size_t t2_lvl2_crd = t2->lvl2_crd[t2_lvl1_pos_idx]; // k dimension in C(i,k,j)
         size_t t2_lvl2_pos_start = t2->lvl2_pos[t2_lvl1_pos_idx];
         size_t t2_lvl2_pos_end = t2->lvl2_pos[t2_lvl1_pos_idx + 1];
@@ -178,14 +589,14 @@ void permute_contract(struct csf *t1, struct csf *t2, struct dense *res) {
         for (size_t t1_lvl3_crd_idx = t1_lvl2_pos_start; t1_lvl3_crd_idx < t1_lvl2_pos_end; ++t1_lvl3_crd_idx) {
           size_t t1_lvl3_crd = t1->lvl3_crd[t1_lvl3_crd_idx];
           if (t1_lvl3_crd == t2_lvl2_crd) { // k indices match
-            double t1_val = t1->vals[t1_lvl3_crd_idx];
+            value_t t1_val = t1->vals[t1_lvl3_crd_idx];
             // Locate matching j in C(i,k,j)
             for (size_t t2_lvl3_crd_idx = t2_lvl2_pos_start; t2_lvl3_crd_idx < t2_lvl2_pos_end; ++t2_lvl3_crd_idx) {
               size_t t2_lvl3_crd = t2->lvl3_crd[t2_lvl3_crd_idx];
               if (t2_lvl3_crd == t1_lvl2_crd) { // j indices match
-                double t2_val = t2->vals[t2_lvl3_crd_idx];
+                value_t t2_val = t2->vals[t2_lvl3_crd_idx];
                 // Accumulate into y(i)
-                res->vals[t1_lvl1_idx] += t1_val * t2_val;
+                acc += (acc_t)t1_val * t2_val;
                 break;
               }
             }
@@ -194,5 +605,218 @@ void permute_contract(struct csf *t1, struct csf *t2, struct dense *res) {
         }
       }
     }
+    res->vals[t1_lvl1_idx] += acc;
   }
 }
+
+// Slice-local views of C(i,:,:) for permute_contract. The original kernel pairs every fiber j of B(i,j,:) with every
+// fiber k of C(i,k,:), scanning both; here each i-slice of C is first re-indexed by (j, k) so that every B(i,j,k)
+// finds its partners directly. Duplicates behave as in permute_contract: within a fiber only the first entry of a
+// coordinate counts, and every fiber of C with coordinate k contributes.
+
+// Largest K x J table of acc_t for the dense view (512 KiB with double accumulators, 256 KiB with float ones); beyond
+// that the random lookups miss cache and the transposed view is faster
+#define PERMUTE_DENSE_MAX_ENTRIES ((size_t)1 << 16)
+
+struct permute_workspace {
+  // Transposed view: entries (k, C(i,k,j)) of the slice grouped by j
+  index_t *row_pos; // size: lvl3_size(C) + 1
+  index_t *row_crd; // size: largest slice of C
+  value_t *row_vals;
+  // Dense view: C(i,k,j) at table[k * lvl3_size(C) + j]
+  acc_t *table; // size: lvl2_size(C) * lvl3_size(C), NULL when unused
+  // First-occurrence stamps within the current fiber
+  size_t *j_mkr; // size: lvl3_size(C)
+  size_t *k_mkr; // size: lvl3_size(B)
+  value_t *k_vals;
+};
+
+static inline size_t csf_slice_nnz(struct csf *tensor, size_t lvl1_idx) {
+  return tensor->lvl2_pos[tensor->lvl1_pos[lvl1_idx + 1]] - tensor->lvl2_pos[tensor->lvl1_pos[lvl1_idx]];
+}
+
+static void permute_workspace_init(struct permute_workspace *ws, struct csf *t1, struct csf *t2, bool dense) {
+  size_t max_slice_nnz = 0;
+  for (size_t lvl1_idx = 0; lvl1_idx < t2->lvl1_size; ++lvl1_idx) {
+    size_t slice_nnz = csf_slice_nnz(t2, lvl1_idx);
+    if (slice_nnz > max_slice_nnz)
+      max_slice_nnz = slice_nnz;
+  }
+  ws->row_pos = (index_t *)malloc((t2->lvl3_size + 1) * sizeof(index_t));
+  ws->row_crd = (index_t *)malloc(max_slice_nnz * sizeof(index_t));
+  ws->row_vals = (value_t *)malloc(max_slice_nnz * sizeof(value_t));
+  ws->table = dense ? (acc_t *)calloc(t2->lvl2_size * t2->lvl3_size, sizeof(acc_t)) : NULL;
+  ws->j_mkr = (size_t *)calloc(t2->lvl3_size, sizeof(size_t));
+  ws->k_mkr = (size_t *)calloc(t1->lvl3_size, sizeof(size_t));
+  ws->k_vals = (value_t *)malloc(t1->lvl3_size * sizeof(value_t));
+}
+
+static void permute_workspace_free(struct permute_workspace *ws) {
+  free(ws->row_pos);
+  free(ws->row_crd);
+  free(ws->row_vals);
+  free(ws->table);
+  free(ws->j_mkr);
+  free(ws->k_mkr);
+  free(ws->k_vals);
+}
+
+// y(i) through the transposed view: counting sort of the slice of C by j, then per fiber j of B a scatter of its k's
+// intersected with row j of the view
+static acc_t permute_slice_transposed(struct csf *t1, struct csf *t2, size_t lvl1_idx, struct permute_workspace *ws) {
+  size_t t2_fiber_start = t2->lvl1_pos[lvl1_idx];
+  size_t t2_fiber_end = t2->lvl1_pos[lvl1_idx + 1];
+
+  // Count first occurrences of each j per fiber k of C; stamps 2f+1 here and 2f+2 below keep the passes apart
+  memset(ws->row_pos, 0, (t2->lvl3_size + 1) * sizeof(index_t));
+  for (size_t t2_fiber = t2_fiber_start; t2_fiber < t2_fiber_end; ++t2_fiber) {
+    for (size_t t2_idx = t2->lvl2_pos[t2_fiber]; t2_idx < t2->lvl2_pos[t2_fiber + 1]; ++t2_idx) {
+      size_t t2_lvl3_crd = t2->lvl3_crd[t2_idx];
+      if (ws->j_mkr[t2_lvl3_crd] != 2 * t2_fiber + 1) {
+        ws->j_mkr[t2_lvl3_crd] = 2 * t2_fiber + 1;
+        ws->row_pos[t2_lvl3_crd + 1]++;
+      }
+    }
+  }
+  for (size_t j = 0; j < t2->lvl3_size; ++j)
+    ws->row_pos[j + 1] += ws->row_pos[j];
+
+  // Scatter (k, value) into row j, advancing row_pos[j]; afterwards row j spans [row_pos[j - 1], row_pos[j])
+  for (size_t t2_fiber = t2_fiber_start; t2_fiber < t2_fiber_end; ++t2_fiber) {
+    size_t t2_lvl2_crd = t2->lvl2_crd[t2_fiber];
+    for (size_t t2_idx = t2->lvl2_pos[t2_fiber]; t2_idx < t2->lvl2_pos[t2_fiber + 1]; ++t2_idx) {
+      size_t t2_lvl3_crd = t2->lvl3_crd[t2_idx];
+      if (ws->j_mkr[t2_lvl3_crd] != 2 * t2_fiber + 2) {
+        ws->j_mkr[t2_lvl3_crd] = 2 * t2_fiber + 2;
+        size_t row_idx = ws->row_pos[t2_lvl3_crd]++;
+        ws->row_crd[row_idx] = t2_lvl2_crd;
+        ws->row_vals[row_idx] = t2->vals[t2_idx];
+      }
+    }
+  }
+
+  acc_t acc = 0.0;
+  for (size_t t1_fiber = t1->lvl1_pos[lvl1_idx]; t1_fiber < t1->lvl1_pos[lvl1_idx + 1]; ++t1_fiber) {
+    size_t t1_lvl2_crd = t1->lvl2_crd[t1_fiber];
+    // Scatter the first value of each k in fiber j of B
+    for (size_t t1_idx = t1->lvl2_pos[t1_fiber]; t1_idx < t1->lvl2_pos[t1_fiber + 1]; ++t1_idx) {
+      size_t t1_lvl3_crd = t1->lvl3_crd[t1_idx];
+      if (ws->k_mkr[t1_lvl3_crd] != t1_fiber + 1) {
+        ws->k_mkr[t1_lvl3_crd] = t1_fiber + 1;
+        ws->k_vals[t1_lvl3_crd] = t1->vals[t1_idx];
+      }
+    }
+    // Intersect with row j of the view
+    size_t row_start = t1_lvl2_crd == 0 ? 0 : ws->row_pos[t1_lvl2_crd - 1];
+    size_t row_end = ws->row_pos[t1_lvl2_crd];
+    for (size_t row_idx = row_start; row_idx < row_end; ++row_idx) {
+      size_t k = ws->row_crd[row_idx];
+      if (ws->k_mkr[k] == t1_fiber + 1)
+        acc += (acc_t)ws->k_vals[k] * ws->row_vals[row_idx];
+    }
+  }
+  return acc;
+}
+
+// y(i) through the dense view: the slice of C is written into the K x J table, looked up once per entry of B and
+// cleared again
+static acc_t permute_slice_dense(struct csf *t1, struct csf *t2, size_t lvl1_idx, struct permute_workspace *ws) {
+  size_t t2_fiber_start = t2->lvl1_pos[lvl1_idx];
+  size_t t2_fiber_end = t2->lvl1_pos[lvl1_idx + 1];
+  size_t num_j = t2->lvl3_size;
+
+  for (size_t t2_fiber = t2_fiber_start; t2_fiber < t2_fiber_end; ++t2_fiber) {
+    acc_t *table_row = ws->table + t2->lvl2_crd[t2_fiber] * num_j;
+    for (size_t t2_idx = t2->lvl2_pos[t2_fiber]; t2_idx < t2->lvl2_pos[t2_fiber + 1]; ++t2_idx) {
+      size_t t2_lvl3_crd = t2->lvl3_crd[t2_idx];
+      if (ws->j_mkr[t2_lvl3_crd] != t2_fiber + 1) {
+        ws->j_mkr[t2_lvl3_crd] = t2_fiber + 1;
+        table_row[t2_lvl3_crd] += t2->vals[t2_idx];
+      }
+    }
+  }
+
+  acc_t acc = 0.0;
+  for (size_t t1_fiber = t1->lvl1_pos[lvl1_idx]; t1_fiber < t1->lvl1_pos[lvl1_idx + 1]; ++t1_fiber) {
+    size_t t1_lvl2_crd = t1->lvl2_crd[t1_fiber];
+    for (size_t t1_idx = t1->lvl2_pos[t1_fiber]; t1_idx < t1->lvl2_pos[t1_fiber + 1]; ++t1_idx) {
+      size_t t1_lvl3_crd = t1->lvl3_crd[t1_idx];
+      if (ws->k_mkr[t1_lvl3_crd] != t1_fiber + 1) {
+        ws->k_mkr[t1_lvl3_crd] = t1_fiber + 1;
+        acc += t1->vals[t1_idx] * ws->table[t1_lvl3_crd * num_j + t1_lvl2_crd];
+      }
+    }
+  }
+
+  for (size_t t2_fiber = t2_fiber_start; t2_fiber < t2_fiber_end; ++t2_fiber) {
+    acc_t *table_row = ws->table + t2->lvl2_crd[t2_fiber] * num_j;
+    for (size_t t2_idx = t2->lvl2_pos[t2_fiber]; t2_idx < t2->lvl2_pos[t2_fiber + 1]; ++t2_idx)
+      table_row[t2->lvl3_crd[t2_idx]] = 0.0;
+  }
+  return acc;
+}
+
+static inline bool permute_fits_dense(struct csf *t2) {
+  return t2->lvl2_size * t2->lvl3_size <= PERMUTE_DENSE_MAX_ENTRIES;
+}
+
+void permute_contract_transposed(struct csf *t1, struct csf *t2, struct dense *res) {
+  struct permute_workspace ws;
+  permute_workspace_init(&ws, t1, t2, false);
+  for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < t1->lvl1_size; ++t1_lvl1_idx)
+    res->vals[t1_lvl1_idx] += permute_slice_transposed(t1, t2, t1_lvl1_idx, &ws);
+  permute_workspace_free(&ws);
+}
+
+void permute_contract_dense(struct csf *t1, struct csf *t2, struct dense *res) {
+  if (!permute_fits_dense(t2)) {
+    permute_contract_transposed(t1, t2, res);
+    return;
+  }
+  struct permute_workspace ws;
+  permute_workspace_init(&ws, t1, t2, true);
+  for (size_t t1_lvl1_idx = 0; t1_lvl1_idx < t1->lvl1_size; ++t1_lvl1_idx)
+    res->vals[t1_lvl1_idx] += permute_slice_dense(t1, t2, t1_lvl1_idx, &ws);
+  permute_workspace_free(&ws);
+}
+
+void permute_contract_parallel(struct csf *t1, struct csf *t2, struct dense *res) {
+  size_t lvl1_size = t1->lvl1_size;
+  bool dense = permute_fits_dense(t2);
+
+  // Slice costs: entries of B and C in each i-slice, as a prefix sum for splitting
+  size_t *cost = (size_t *)malloc((lvl1_size + 1) * sizeof(size_t));
+  cost[0] = 0;
+  for (size_t lvl1_idx = 0; lvl1_idx < lvl1_size; ++lvl1_idx)
+    cost[lvl1_idx + 1] = cost[lvl1_idx] + csf_slice_nnz(t1, lvl1_idx) + csf_slice_nnz(t2, lvl1_idx) + 1;
+
+#pragma omp parallel
+  {
+    size_t num_threads = 1;
+    size_t thread_id = 0;
+#if defined(_OPENMP)
+    num_threads = omp_get_num_threads();
+    thread_id = omp_get_thread_num();
+#endif
+    // Contiguous block of slices holding about 1 / num_threads of the entries
+    size_t target_first = cost[lvl1_size] * thread_id / num_threads;
+    size_t target_last = cost[lvl1_size] * (thread_id + 1) / num_threads;
+    size_t first = 0;
+    while (first < lvl1_size && cost[first] < target_first)
+      ++first;
+    size_t last = first;
+    while (last < lvl1_size && cost[last] < target_last)
+      ++last;
+    if (thread_id == num_threads - 1)
+      last = lvl1_size;
+
+    struct permute_workspace ws;
+    permute_workspace_init(&ws, t1, t2, dense);
+    for (size_t t1_lvl1_idx = first; t1_lvl1_idx < last; ++t1_lvl1_idx)
+      res->vals[t1_lvl1_idx] += dense ? permute_slice_dense(t1, t2, t1_lvl1_idx, &ws)
+                                      : permute_slice_transposed(t1, t2, t1_lvl1_idx, &ws);
+    permute_workspace_free(&ws);
+  }
+
+  free(cost);
+}
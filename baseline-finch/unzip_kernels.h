@@ -8,16 +8,62 @@
 /* A(i,j) = B(i,j) * C(j,i) - Hadamard product with transpose */
 void hadamard_transpose(struct csr *t1, struct csr *t2, struct csr *res);
 
+/* Exact nnz of the result, so that res can be allocated once before calling the kernel. The matmul counts hold for
+ * every matmul / matmul_hadamard variant. */
+size_t hadamard_transpose_count(struct csr *t1, struct csr *t2);
+size_t matmul_count(struct csr *t1, struct csr *t2);
+size_t matmul_hadamard_count(struct csr *t1, struct csr *t2, struct csr *t3);
+
 /* A(i, j) = B(i, k) * C(k, j) - Matrix multiplication */
 void matmul(struct csr *t1, struct csr *t2, struct csr *res);
 
 /* A(i, j) = B(i, k) * C(k, j) * D(k, j) - Matrix multiplication with Hadamard */
 void matmul_hadamard(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res);
 
+/* Sparse-accumulator variants: only the columns touched by a row are compressed, in touch order */
+void matmul_spa(struct csr *t1, struct csr *t2, struct csr *res);
+void matmul_hadamard_spa(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res);
+
+/* Sparse-accumulator variants with the touched columns of each row sorted before compression */
+void matmul_spa_sorted(struct csr *t1, struct csr *t2, struct csr *res);
+void matmul_hadamard_spa_sorted(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res);
+
+/* Hybrid variants: rows with few estimated flops accumulate in a small hash table, the others in the sparse
+ * accumulator; columns come out in touch order */
+void matmul_hybrid(struct csr *t1, struct csr *t2, struct csr *res);
+void matmul_hadamard_hybrid(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res);
+
+/* Fused variant: E = C * D row by row first, then A = B * E with the sparse accumulator; columns in touch order */
+void matmul_hadamard_fused(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res);
+
+/* Fused variant when its one pass over C and D costs less than the per-flop searches of D, else matmul_hadamard_spa */
+void matmul_hadamard_adaptive(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res);
+
+/* Multiplications of the unfused (B * C, each after a search of D) and fused (C * D, then B * E) pipelines */
+void matmul_hadamard_flops(struct csr *t1, struct csr *t2, struct csr *t3, size_t *unfused, size_t *fused);
+
+/* Row-parallel variants (OpenMP): per-thread sparse accumulators, a symbolic pass for exact row counts and a
+ * numeric pass writing each row into its slice of res; columns come out in touch order */
+void matmul_parallel(struct csr *t1, struct csr *t2, struct csr *res);
+void matmul_hadamard_parallel(struct csr *t1, struct csr *t2, struct csr *t3, struct csr *res);
+
+/* Number of threads used by the parallel variants; a no-op when built without OpenMP */
+void set_num_threads(int num_threads);
+
 /* y(i) = B(i, j) * C(j, i) - Hadamard transpose with reduction to vector */
 void hadamard_transpose_reduce(struct csr *t1, struct csr *t2, struct dense *res);
 
 /* y(i) = B(i, j, k) * C(i, k, j) - 3D tensor contraction with permutation */
 void permute_contract(struct csf *t1, struct csf *t2, struct dense *res);
 
+/* permute_contract over a slice-local view of C(i,:,:) indexed by (j, k): the transposed view groups the slice's
+ * entries by j and intersects each fiber of B with its row, the dense view stores the slice in a K x J table for O(1)
+ * lookups (falling back to the transposed view when the table would be too large) */
+void permute_contract_transposed(struct csf *t1, struct csf *t2, struct dense *res);
+void permute_contract_dense(struct csf *t1, struct csf *t2, struct dense *res);
+
+/* Slice-parallel variant (OpenMP): contiguous blocks of i-slices with equal numbers of entries per thread, each thread
+ * with its own slice view */
+void permute_contract_parallel(struct csf *t1, struct csf *t2, struct dense *res);
+
 #endif /* KERNELS_H */
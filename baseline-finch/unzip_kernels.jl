@@ -2,18 +2,28 @@ module UnzipKernels
 
 using Libdl: dlopen, dlsym, dlclose, RTLD_LAZY, RTLD_GLOBAL
 
-export setup, teardown, hadamard_transpose, matmul, matmul_hadamard, hadamard_transpose_reduce, permute_contract, allocate_dense, free_dense, reset_dense, allocate_csr, free_csr, reset_csr, generate_csr, allocate_csf, free_csf, reset_csf, generate_csf
+export setup, teardown, hadamard_transpose, matmul, matmul_hadamard, hadamard_transpose_count, matmul_count, matmul_hadamard_count, matmul_spa, matmul_spa_sorted, matmul_hybrid, matmul_hadamard_spa, matmul_hadamard_spa_sorted, matmul_hadamard_hybrid, matmul_parallel, matmul_hadamard_parallel, matmul_hadamard_fused, matmul_hadamard_adaptive, matmul_hadamard_flops, set_num_threads, hadamard_transpose_reduce, permute_contract, permute_contract_transposed, permute_contract_dense, permute_contract_parallel, allocate_dense, free_dense, reset_dense, allocate_csr, free_csr, reset_csr, reserve_csr, generate_csr, allocate_csf, free_csf, reset_csf, generate_csf
 
 const LIB_HANDLE = Ref{Ptr{Cvoid}}(C_NULL)
 
-function setup(lib_basename)
-    println("Compiling Unzipping kernels library...")
+# Storage/accumulation value types and their compile flags (see unzip_formats.h)
+const VALUE_FLAGS = Dict("double" => String[], "float" => ["-DVALUE_FLOAT"], "mixed" => ["-DVALUE_MIXED"])
+
+# Apple clang ships without OpenMP; the parallel kernels then run on one thread
+const OPENMP_FLAGS = Sys.isapple() ? String[] : ["-fopenmp"]
+
+# `index_bits` selects the width of the position and coordinate arrays (-DINDEX_BITS) and `value_type` the type of
+# the values ("double", "float" or "mixed")
+function setup(lib_basename; index_bits=64, value_type="double")
+    println("Compiling Unzipping kernels library ($(index_bits)-bit indices, $(value_type) values)...")
     lib_ext = Sys.isapple() ? "dylib" : "so"
-    lib_name = "$(lib_basename).$(lib_ext)"
+    lib_suffix = (index_bits == 64 ? "" : "_idx$(index_bits)") * (value_type == "double" ? "" : "_$(value_type)")
+    lib_name = "$(lib_basename)$(lib_suffix).$(lib_ext)"
+    type_flags = ["-DINDEX_BITS=$(index_bits)"; VALUE_FLAGS[value_type]]
     if lib_basename == "libunzip"
-        run(`cc -shared -O3 -fPIC unzip_kernels.c unzip_utils.c -o $lib_name`)
+        run(`cc -shared -O3 -fPIC $(type_flags) $(OPENMP_FLAGS) unzip_kernels.c unzip_utils.c -o $lib_name`)
     elseif lib_basename == "libunzip_test"
-        run(`cc -shared -O3 -fPIC unzip_kernels_test.c unzip_kernels.c unzip_utils.c -o $lib_name`)
+        run(`cc -shared -O3 -fPIC $(type_flags) $(OPENMP_FLAGS) unzip_kernels_test.c unzip_kernels.c unzip_utils.c -o $lib_name`)
     else
         error("Unknown library to compile: $lib_basename")
     end
@@ -58,6 +68,11 @@ function reset_csr(tensor::Ptr{Cvoid})
     ccall(func, Cvoid, (Ptr{Cvoid},), tensor)
 end
 
+function reserve_csr(tensor::Ptr{Cvoid}, nnz::Csize_t)
+    func = dlsym(LIB_HANDLE[], :reserve_csr)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Csize_t), tensor, nnz)
+end
+
 function generate_csr(ndim1::Csize_t, ndim2::Csize_t, sparsity::Cdouble, seed::Cuint)
     func = dlsym(LIB_HANDLE[], :generate_csr)
     return ccall(func, Ptr{Cvoid}, (Csize_t, Csize_t, Cdouble, Cuint), ndim1, ndim2, sparsity, seed)
@@ -98,6 +113,85 @@ function matmul_hadamard(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Pt
     ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
 end
 
+function hadamard_transpose_count(t1::Ptr{Cvoid}, t2::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :hadamard_transpose_count)
+    return ccall(func, Csize_t, (Ptr{Cvoid}, Ptr{Cvoid}), t1, t2)
+end
+
+function matmul_count(t1::Ptr{Cvoid}, t2::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_count)
+    return ccall(func, Csize_t, (Ptr{Cvoid}, Ptr{Cvoid}), t1, t2)
+end
+
+function matmul_hadamard_count(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_count)
+    return ccall(func, Csize_t, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3)
+end
+
+function matmul_spa(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_spa)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function matmul_spa_sorted(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_spa_sorted)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function matmul_hybrid(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hybrid)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function matmul_hadamard_spa(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_spa)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+function matmul_hadamard_spa_sorted(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_spa_sorted)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+function matmul_hadamard_hybrid(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_hybrid)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+function matmul_hadamard_fused(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_fused)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+function matmul_hadamard_adaptive(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_adaptive)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+# Multiplications of the unfused and fused matmul_hadamard pipelines
+function matmul_hadamard_flops(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_flops)
+    unfused = Ref{Csize_t}(0)
+    fused = Ref{Csize_t}(0)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ref{Csize_t}, Ref{Csize_t}), t1, t2, t3, unfused, fused)
+    return (flops_unfused=Int(unfused[]), flops_fused=Int(fused[]))
+end
+
+function matmul_parallel(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_parallel)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function matmul_hadamard_parallel(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, t3::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :matmul_hadamard_parallel)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, t3, res)
+end
+
+function set_num_threads(num_threads::Cint)
+    func = dlsym(LIB_HANDLE[], :set_num_threads)
+    ccall(func, Cvoid, (Cint,), num_threads)
+end
+
 function hadamard_transpose_reduce(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
     func = dlsym(LIB_HANDLE[], :hadamard_transpose_reduce)
     ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
@@ -108,4 +202,19 @@ function permute_contract(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
     ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
 end
 
+function permute_contract_transposed(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :permute_contract_transposed)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function permute_contract_dense(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :permute_contract_dense)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
+function permute_contract_parallel(t1::Ptr{Cvoid}, t2::Ptr{Cvoid}, res::Ptr{Cvoid})
+    func = dlsym(LIB_HANDLE[], :permute_contract_parallel)
+    ccall(func, Cvoid, (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}), t1, t2, res)
+end
+
 end # module
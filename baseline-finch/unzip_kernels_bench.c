@@ -0,0 +1,478 @@
+// Roofline benchmark of the five unzip kernels (hadamard_transpose, matmul, matmul_hadamard,
+// hadamard_transpose_reduce, permute_contract) on the inputs of benchmark.jl, without Julia in the loop. Every row of
+// the CSV on stdout carries the call's median time, the bytes it reads and writes, its flops, and the achieved GB/s,
+// GFLOP/s and percentage of this machine's roofline, whose peaks are probed at startup.
+//
+// Build:
+//   cc -O3 -march=native -fopenmp -o unzip_kernels_bench unzip_kernels_bench.c unzip_kernels.c unzip_utils.c
+//     ../unzip-complete/roofline.c ../unzip-complete/bench_harness.c -lm
+// (unzip-complete's roofline probe and benchmark harness), adding the -DINDEX_BITS=32, -DVALUE_FLOAT or
+// -DVALUE_MIXED of the unzip library to compare with, and -DDEBUG for the small debug configuration. -DSCALING builds
+// the thread scaling benchmark of the parallel variants instead (see bench_scaling); unzip-complete's make
+// bench-scaling-baseline builds and runs it with the pinning of its other scaling runs.
+//
+// Environment: TENSOR_CACHE_DIR as in benchmark.jl (default tensor_cache, empty to generate every input),
+// BENCH_WARMUP, BENCH_TARGET_CV and BENCH_TIME_BUDGET_MS for the timing loop, ROOFLINE_GBS and ROOFLINE_GFLOPS to pin
+// the peaks instead of probing them; SCALING_THREADS, SCALING_SIZE and SCALING_SPARSITY for -DSCALING, whose threads
+// are placed by OMP_PLACES and OMP_PROC_BIND (close for compact pinning, spread for scatter).
+
+#include "unzip_kernels.h"
+#include "../unzip-complete/bench_harness.h"
+#include "../unzip-complete/roofline.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+// unzip_utils.c (declared by hand like the Julia wrappers in libunzip_utils.jl)
+struct dense *allocate_dense(size_t n);
+void free_dense(struct dense *tensor);
+void reset_dense(struct dense *tensor);
+struct csr *allocate_csr(size_t ndim1, size_t ndim2, size_t dim2_nnz);
+void free_csr(struct csr *tensor);
+void reset_csr(struct csr *tensor);
+void reserve_csr(struct csr *tensor, size_t nnz);
+void free_csf(struct csf *tensor);
+struct csr *cached_csr(const char *dir, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed);
+struct csf *cached_csf(const char *dir, size_t ndim1, size_t ndim2, size_t ndim3, double sparsity, unsigned int seed);
+struct csr *cached_csr_workload(const char *dir, int workload, size_t ndim1, size_t ndim2, double sparsity,
+                                unsigned int seed);
+struct csr *cached_csr_transposed(const char *dir, int workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int pattern_seed, unsigned int seed);
+
+// Configuration of benchmark.jl (DEBUG: its commented-out debug configuration)
+#ifdef DEBUG
+static const double SPARSITIES[] = {0.5, 0.8};
+static const size_t SIZES[] = {10, 20};
+static const char *const WORKLOADS[] = {"uniform", "transposed"};
+#else
+static const double SPARSITIES[] = {0.01, 0.02, 0.05, 0.10};
+static const size_t SIZES[] = {100, 200, 500, 1000};
+static const char *const WORKLOADS[] = {"uniform", "power_law", "banded", "block_diagonal", "transposed"};
+#endif
+#define NUM_SPARSITIES (sizeof(SPARSITIES) / sizeof(SPARSITIES[0]))
+#define NUM_SIZES (sizeof(SIZES) / sizeof(SIZES[0]))
+#define NUM_BENCH_WORKLOADS (sizeof(WORKLOADS) / sizeof(WORKLOADS[0]))
+
+// Seeds of B, C and D, as in benchmark.jl
+#define SEED_B 42
+#define SEED_C 43
+#define SEED_D 44
+
+#if defined(VALUE_FLOAT)
+#define VALUE_TYPE_NAME "float"
+#elif defined(VALUE_MIXED)
+#define VALUE_TYPE_NAME "mixed"
+#else
+#define VALUE_TYPE_NAME "double"
+#endif
+
+// Timed calls per kernel (see timing_options), set up in main
+static struct timing_options timing;
+
+// Peaks of this machine, probed in main; the kernels are serial, so rows are placed against one thread's roof
+static struct roofline roofline;
+
+enum kernel {
+  KERNEL_HADAMARD_TRANSPOSE,
+  KERNEL_MATMUL,
+  KERNEL_MATMUL_HADAMARD,
+  KERNEL_HADAMARD_TRANSPOSE_REDUCE,
+  KERNEL_PERMUTE_CONTRACT,
+  // Parallel variants, timed by the scaling benchmark
+  KERNEL_MATMUL_PARALLEL,
+  KERNEL_MATMUL_HADAMARD_PARALLEL,
+  KERNEL_PERMUTE_CONTRACT_PARALLEL,
+  NUM_KERNELS
+};
+
+static const char *const KERNEL_NAMES[NUM_KERNELS] = {
+    "hadamard_transpose",     "matmul",          "matmul_hadamard",          "hadamard_transpose_reduce",
+    "permute_contract",       "matmul_parallel", "matmul_hadamard_parallel", "permute_contract_parallel"};
+
+// Operands of one kernel call: B, C and D for the 2D kernels, B3 and C3 for permute_contract; the output is A or y
+struct operands {
+  struct csr *B, *C, *D, *A;
+  struct csf *B3, *C3;
+  struct dense *y;
+};
+
+static void reset_output(struct operands *ops) {
+  if (ops->A)
+    reset_csr(ops->A);
+  else
+    reset_dense(ops->y);
+}
+
+static void run_kernel(enum kernel kernel, struct operands *ops) {
+  switch (kernel) {
+  case KERNEL_HADAMARD_TRANSPOSE:
+    hadamard_transpose(ops->B, ops->C, ops->A);
+    break;
+  case KERNEL_MATMUL:
+    matmul(ops->B, ops->C, ops->A);
+    break;
+  case KERNEL_MATMUL_HADAMARD:
+    matmul_hadamard(ops->B, ops->C, ops->D, ops->A);
+    break;
+  case KERNEL_HADAMARD_TRANSPOSE_REDUCE:
+    hadamard_transpose_reduce(ops->B, ops->C, ops->y);
+    break;
+  case KERNEL_PERMUTE_CONTRACT:
+    permute_contract(ops->B3, ops->C3, ops->y);
+    break;
+  case KERNEL_MATMUL_PARALLEL:
+    matmul_parallel(ops->B, ops->C, ops->A);
+    break;
+  case KERNEL_MATMUL_HADAMARD_PARALLEL:
+    matmul_hadamard_parallel(ops->B, ops->C, ops->D, ops->A);
+    break;
+  default:
+    permute_contract_parallel(ops->B3, ops->C3, ops->y);
+    break;
+  }
+}
+
+struct kernel_call {
+  enum kernel kernel;
+  struct operands *ops;
+};
+
+static void reset_call(void *arg) { reset_output(((struct kernel_call *)arg)->ops); }
+
+static void run_call(void *arg) {
+  struct kernel_call *call = arg;
+  run_kernel(call->kernel, call->ops);
+}
+
+static struct timing time_kernel(enum kernel kernel, struct operands *ops) {
+  struct kernel_call call = {kernel, ops};
+  return time_runs(&timing, reset_call, run_call, &call);
+}
+
+// Traffic and work of one call. Each operand is streamed once (pos, crd and vals at their widths), except that the
+// matmuls read row k of C (and of D) again for every B(i, k), as Gustavson's algorithm does; accumulators are taken to
+// stay in cache. Flops count multiplies and the adds of the reductions.
+struct traffic {
+  size_t bytes_read, bytes_written, flops;
+};
+
+static size_t csr_bytes(const struct csr *t) {
+  return (t->lvl1_size + 1) * sizeof(index_t) + t->lvl2_nnz * (sizeof(index_t) + sizeof(value_t));
+}
+
+static size_t csf_bytes(const struct csf *t) {
+  return (t->lvl1_size + 1) * sizeof(index_t) + t->lvl2_nnz * sizeof(index_t) + (t->lvl2_nnz + 1) * sizeof(index_t) +
+         t->lvl3_nnz * (sizeof(index_t) + sizeof(value_t));
+}
+
+// Entries of the rows of t2 that the entries of t1 select: B * C's multiplies, and the entries matmul re-reads
+static size_t selected_entries(const struct csr *t1, const struct csr *t2) {
+  size_t entries = 0;
+  for (size_t k = 0; k < t1->lvl1_pos[t1->lvl1_size]; ++k) {
+    size_t row = t1->lvl2_crd[k];
+    entries += t2->lvl1_pos[row + 1] - t2->lvl1_pos[row];
+  }
+  return entries;
+}
+
+// Entries (i, j, k) of B that meet C(i, k, j): permute_contract's multiply-adds
+static size_t permute_matches(const struct csf *t1, const struct csf *t2) {
+  size_t ndim_k = t2->lvl2_size, ndim_j = t2->lvl3_size;
+  bool *seen = calloc(ndim_k * ndim_j, sizeof(bool));
+  size_t matches = 0;
+  for (size_t i = 0; i < t1->lvl1_size; ++i) {
+    for (size_t f = t2->lvl1_pos[i]; f < t2->lvl1_pos[i + 1]; ++f)
+      for (size_t e = t2->lvl2_pos[f]; e < t2->lvl2_pos[f + 1]; ++e)
+        seen[t2->lvl2_crd[f] * ndim_j + t2->lvl3_crd[e]] = true;
+    for (size_t f = t1->lvl1_pos[i]; f < t1->lvl1_pos[i + 1]; ++f)
+      for (size_t e = t1->lvl2_pos[f]; e < t1->lvl2_pos[f + 1]; ++e)
+        matches += t1->lvl3_crd[e] < ndim_k && t1->lvl2_crd[f] < ndim_j &&
+                   seen[t1->lvl3_crd[e] * ndim_j + t1->lvl2_crd[f]];
+    for (size_t f = t2->lvl1_pos[i]; f < t2->lvl1_pos[i + 1]; ++f)
+      for (size_t e = t2->lvl2_pos[f]; e < t2->lvl2_pos[f + 1]; ++e)
+        seen[t2->lvl2_crd[f] * ndim_j + t2->lvl3_crd[e]] = false;
+  }
+  free(seen);
+  return matches;
+}
+
+// Traffic of the call that produced the current output of ops
+static struct traffic kernel_traffic(enum kernel kernel, const struct operands *ops) {
+  struct traffic traffic = {0};
+  size_t row_pos = 2 * sizeof(index_t), entry = sizeof(index_t) + sizeof(value_t);
+  switch (kernel) {
+  case KERNEL_HADAMARD_TRANSPOSE:
+    traffic.bytes_read = csr_bytes(ops->B) + csr_bytes(ops->C);
+    traffic.bytes_written = csr_bytes(ops->A);
+    traffic.flops = ops->A->lvl2_nnz;
+    break;
+  case KERNEL_MATMUL:
+  case KERNEL_MATMUL_PARALLEL: {
+    size_t products = selected_entries(ops->B, ops->C);
+    traffic.bytes_read = csr_bytes(ops->B) + ops->B->lvl2_nnz * row_pos + products * entry;
+    traffic.bytes_written = csr_bytes(ops->A);
+    traffic.flops = 2 * products;
+    break;
+  }
+  case KERNEL_MATMUL_HADAMARD:
+  case KERNEL_MATMUL_HADAMARD_PARALLEL: {
+    size_t products = selected_entries(ops->B, ops->C);
+    traffic.bytes_read =
+        csr_bytes(ops->B) + 2 * ops->B->lvl2_nnz * row_pos + (products + selected_entries(ops->B, ops->D)) * entry;
+    traffic.bytes_written = csr_bytes(ops->A);
+    traffic.flops = 3 * products;
+    break;
+  }
+  case KERNEL_HADAMARD_TRANSPOSE_REDUCE:
+    traffic.bytes_read = csr_bytes(ops->B) + csr_bytes(ops->C);
+    traffic.bytes_written = ops->y->size * sizeof(value_t);
+    traffic.flops = 2 * hadamard_transpose_count(ops->B, ops->C);
+    break;
+  default:
+    traffic.bytes_read = csf_bytes(ops->B3) + csf_bytes(ops->C3);
+    traffic.bytes_written = ops->y->size * sizeof(value_t);
+    traffic.flops = 2 * permute_matches(ops->B3, ops->C3);
+    break;
+  }
+  return traffic;
+}
+
+// Achieved GB/s and GFLOP/s at the median time, and their share of one thread's roof (see roofline_point)
+static void print_row(enum kernel kernel, const char *workload, double sparsity, size_t size, struct operands *ops) {
+  struct timing t = time_kernel(kernel, ops);
+  struct traffic traffic = kernel_traffic(kernel, ops);
+  struct roofline_point point =
+      roofline_point(&roofline, traffic.bytes_read + traffic.bytes_written, traffic.flops, t.median, 1);
+  printf("%s,%s,%g,%zu,%d,%s,%.6g,%.6g,%d,%zu,%zu,%zu,%.4g,%.4g,%.4g\n", KERNEL_NAMES[kernel], workload, sparsity, size,
+         INDEX_BITS, VALUE_TYPE_NAME, t.median, t.min, t.runs, traffic.bytes_read, traffic.bytes_written, traffic.flops,
+         point.gbs, point.gflops, point.percent);
+  fflush(stdout);
+}
+
+static int workload_index(const char *name) {
+  static const char *const names[NUM_WORKLOADS] = {"uniform", "power_law", "banded", "block_diagonal"};
+  for (int w = 0; w < NUM_WORKLOADS; ++w)
+    if (strcmp(names[w], name) == 0)
+      return w;
+  return -1;
+}
+
+// 2D operand of csr_input in benchmark.jl: the workload generated from seed, or in "transposed" a uniform B (seed 42)
+// and the other operands with the pattern of B transposed
+static struct csr *csr_input(const char *cache_dir, const char *workload, size_t n, double sparsity,
+                             unsigned int seed) {
+  if (strcmp(workload, "uniform") == 0)
+    return cached_csr(cache_dir, n, n, sparsity, seed);
+  if (strcmp(workload, "transposed") == 0)
+    return seed == SEED_B ? cached_csr(cache_dir, n, n, sparsity, seed)
+                          : cached_csr_transposed(cache_dir, WORKLOAD_UNIFORM, n, n, sparsity, SEED_B, seed);
+  return cached_csr_workload(cache_dir, workload_index(workload), n, n, sparsity, seed);
+}
+
+static void bench_2d(const char *cache_dir, const char *workload, double sparsity, size_t n) {
+  struct operands ops = {0};
+  ops.B = csr_input(cache_dir, workload, n, sparsity, SEED_B);
+  ops.C = csr_input(cache_dir, workload, n, sparsity, SEED_C);
+  ops.D = csr_input(cache_dir, workload, n, sparsity, SEED_D);
+
+  ops.A = allocate_csr(n, n, 0);
+  reserve_csr(ops.A, hadamard_transpose_count(ops.B, ops.C));
+  print_row(KERNEL_HADAMARD_TRANSPOSE, workload, sparsity, n, &ops);
+  reserve_csr(ops.A, matmul_count(ops.B, ops.C));
+  print_row(KERNEL_MATMUL, workload, sparsity, n, &ops);
+  reserve_csr(ops.A, matmul_hadamard_count(ops.B, ops.C, ops.D));
+  print_row(KERNEL_MATMUL_HADAMARD, workload, sparsity, n, &ops);
+  free_csr(ops.A);
+  ops.A = NULL;
+
+  ops.y = allocate_dense(n);
+  print_row(KERNEL_HADAMARD_TRANSPOSE_REDUCE, workload, sparsity, n, &ops);
+  free_dense(ops.y);
+
+  free_csr(ops.B);
+  free_csr(ops.C);
+  free_csr(ops.D);
+}
+
+// permute_contract's inputs are 3D, so like benchmark.jl it runs on uniform inputs only
+static void bench_3d(const char *cache_dir, double sparsity, size_t n) {
+  struct operands ops = {0};
+  ops.B3 = cached_csf(cache_dir, n, n, n, sparsity, SEED_B);
+  ops.C3 = cached_csf(cache_dir, n, n, n, sparsity, SEED_C);
+  ops.y = allocate_dense(n);
+  print_row(KERNEL_PERMUTE_CONTRACT, "uniform", sparsity, n, &ops);
+  free_dense(ops.y);
+  free_csf(ops.B3);
+  free_csf(ops.C3);
+}
+
+#if defined(SCALING)
+// Thread scaling of the parallel variants: each runs on 1..SCALING_THREADS threads (default: every CPU the process
+// may use) for every workload at SCALING_SIZE and sparsity SCALING_SPARSITY. The strong sweep keeps that size; the
+// weak sweep grows the inputs with the threads so that every thread gets the same share of work, and its last run is
+// the strong one. At a fixed sparsity s the work of all three kernels grows with n^3: the matmuls multiply each of the
+// n^2 s entries of B with the n s entries of a row of C, and permute_contract's operands hold n^3 s entries. So the
+// weak sweep runs at n x cbrt(threads / SCALING_THREADS), and rounding n is corrected for with the flops column, the
+// work each run measured. Speedup and efficiency are against the 1-thread run of the same sweep: T1 / Tp and
+// T1 / (p Tp) for the strong one, W T1 / Tp (scaled speedup) and W T1 / (p Tp) for the weak one, where W is the run's
+// flops over the 1-thread run's (p when the sizing is exact).
+static const enum kernel SCALING_KERNELS[] = {KERNEL_MATMUL_PARALLEL, KERNEL_MATMUL_HADAMARD_PARALLEL,
+                                             KERNEL_PERMUTE_CONTRACT_PARALLEL};
+#define NUM_SCALING_KERNELS (sizeof(SCALING_KERNELS) / sizeof(SCALING_KERNELS[0]))
+
+static size_t scaled_size(size_t size, int threads, int max_threads) {
+  size_t n = (size_t)round(size * cbrt((double)threads / max_threads));
+  return n ? n : 1;
+}
+
+// Inputs of kernel at size n, with its output sized for the call
+static void load_operands(const char *cache_dir, enum kernel kernel, const char *workload, double sparsity, size_t n,
+                          struct operands *ops) {
+  *ops = (struct operands){0};
+  if (kernel == KERNEL_PERMUTE_CONTRACT_PARALLEL) {
+    ops->B3 = cached_csf(cache_dir, n, n, n, sparsity, SEED_B);
+    ops->C3 = cached_csf(cache_dir, n, n, n, sparsity, SEED_C);
+    ops->y = allocate_dense(n);
+    return;
+  }
+  ops->B = csr_input(cache_dir, workload, n, sparsity, SEED_B);
+  ops->C = csr_input(cache_dir, workload, n, sparsity, SEED_C);
+  ops->A = allocate_csr(n, n, 0);
+  if (kernel == KERNEL_MATMUL_HADAMARD_PARALLEL) {
+    ops->D = csr_input(cache_dir, workload, n, sparsity, SEED_D);
+    reserve_csr(ops->A, matmul_hadamard_count(ops->B, ops->C, ops->D));
+  } else {
+    reserve_csr(ops->A, matmul_count(ops->B, ops->C));
+  }
+}
+
+static void free_operands(struct operands *ops) {
+  if (ops->B3) {
+    free_csf(ops->B3);
+    free_csf(ops->C3);
+    free_dense(ops->y);
+    return;
+  }
+  free_csr(ops->B);
+  free_csr(ops->C);
+  if (ops->D)
+    free_csr(ops->D);
+  free_csr(ops->A);
+}
+
+static void scale_kernel(const char *cache_dir, enum kernel kernel, const char *workload, bool weak) {
+  int max_threads = (int)env_or("SCALING_THREADS", 0);
+#if defined(_OPENMP)
+  if (max_threads <= 0)
+    max_threads = omp_get_num_procs();
+#endif
+  if (max_threads <= 0)
+    max_threads = 1;
+  if (max_threads > MAX_SCALING_THREADS)
+    max_threads = MAX_SCALING_THREADS;
+  size_t size = (size_t)env_or("SCALING_SIZE", 1000);
+  double sparsity = env_or("SCALING_SPARSITY", 0.05);
+
+  struct operands ops;
+  if (!weak)
+    load_operands(cache_dir, kernel, workload, sparsity, size, &ops);
+  double base_ms = 0.0, base_flops = 0.0;
+  for (int threads = 1; threads <= max_threads; ++threads) {
+    size_t n = weak ? scaled_size(size, threads, max_threads) : size;
+    if (weak)
+      load_operands(cache_dir, kernel, workload, sparsity, n, &ops);
+
+    set_num_threads(threads);
+    char cpus[8 * MAX_SCALING_THREADS];
+    thread_cpus(threads, cpus, sizeof(cpus));
+    struct timing t = time_kernel(kernel, &ops);
+    struct traffic traffic = kernel_traffic(kernel, &ops);
+    if (threads == 1) {
+      base_ms = t.median;
+      base_flops = traffic.flops;
+    }
+    double ratio = t.median > 0.0 ? base_ms / t.median : 0.0;
+    double work = base_flops > 0.0 ? traffic.flops / base_flops : threads;
+    double speedup = weak ? work * ratio : ratio;
+    double efficiency = speedup / threads;
+    struct roofline_point point =
+        roofline_point(&roofline, traffic.bytes_read + traffic.bytes_written, traffic.flops, t.median, threads);
+    printf("%s,%s,%g,%s,%s,%s,%d,%zu,%d,%s,%.6g,%.6g,%d,%.4f,%.4f,%zu,%zu,%zu,%.4g,%.4g\n", KERNEL_NAMES[kernel],
+           workload, sparsity, weak ? "weak" : "strong", pinning(), cpus, threads, n, INDEX_BITS, VALUE_TYPE_NAME,
+           t.median, t.min, t.runs, speedup, efficiency, traffic.bytes_read, traffic.bytes_written, traffic.flops,
+           point.gbs, point.gflops);
+    fflush(stdout);
+
+    if (weak)
+      free_operands(&ops);
+  }
+  if (!weak)
+    free_operands(&ops);
+}
+
+static void bench_scaling(const char *cache_dir) {
+  fprintf(stderr, "Unzip kernels scaling benchmark (INDEX_BITS=%d, VALUE_TYPE=%s, pinning %s)\n", INDEX_BITS,
+          VALUE_TYPE_NAME, pinning());
+  printf("kernel,workload,sparsity,scaling,pinning,cpus,threads,size,index_bits,value_type,median_time_ms,min_time_ms,"
+         "runs,speedup,efficiency,bytes_read,bytes_written,flops,gb_per_s,gflop_per_s\n");
+  for (size_t k = 0; k < NUM_SCALING_KERNELS; ++k) {
+    // permute_contract's inputs are 3D and uniform only, as in bench_3d
+    size_t num_workloads = SCALING_KERNELS[k] == KERNEL_PERMUTE_CONTRACT_PARALLEL ? 1 : NUM_BENCH_WORKLOADS;
+    for (size_t w = 0; w < num_workloads; ++w) {
+      for (int weak = 0; weak <= 1; ++weak) {
+        fprintf(stderr, "Scaling %s on %s (%s)...\n", KERNEL_NAMES[SCALING_KERNELS[k]], WORKLOADS[w],
+                weak ? "weak" : "strong");
+        scale_kernel(cache_dir, SCALING_KERNELS[k], WORKLOADS[w], weak);
+      }
+    }
+  }
+}
+#endif
+
+int main(void) {
+  timing = timing_options(1, 0.02, 500);
+  const char *cache_dir = getenv("TENSOR_CACHE_DIR");
+  if (!cache_dir)
+    cache_dir = "tensor_cache";
+  else if (!*cache_dir)
+    cache_dir = NULL;
+
+#if defined(SCALING)
+  fprintf(stderr, "Timing: %d warmup call(s), %d to %d timed calls until CV <= %.3g or %.0f ms spent\n", timing.warmup,
+          MIN_RUNS, MAX_RUNS, timing.target_cv, timing.time_budget_ms);
+  bench_scaling(cache_dir);
+  fprintf(stderr, "\nBenchmark complete!\n");
+  return 0;
+#endif
+
+  measure_roofline(&roofline);
+
+  fprintf(stderr, "Unzip kernels roofline benchmark (INDEX_BITS=%d, VALUE_TYPE=%s)\n", INDEX_BITS, VALUE_TYPE_NAME);
+  fprintf(stderr, "Roofline: %.1f GB/s STREAM triad, %.1f GFLOP/s multiply-add\n", roofline.bandwidth_gbs,
+          roofline.gflops);
+  fprintf(stderr, "Timing: %d warmup call(s), %d to %d timed calls until CV <= %.3g or %.0f ms spent\n", timing.warmup,
+          MIN_RUNS, MAX_RUNS, timing.target_cv, timing.time_budget_ms);
+  fprintf(stderr, "Tensor cache: %s\n", cache_dir ? cache_dir : "(none, generating inputs)");
+
+  printf("kernel,workload,sparsity,size,index_bits,value_type,median_time_ms,min_time_ms,runs,bytes_read,"
+         "bytes_written,flops,gb_per_s,gflop_per_s,roofline_pct\n");
+  for (size_t w = 0; w < NUM_BENCH_WORKLOADS; ++w) {
+    for (size_t s = 0; s < NUM_SPARSITIES; ++s) {
+      for (size_t n = 0; n < NUM_SIZES; ++n) {
+        fprintf(stderr, "Testing %s, sparsity %g, size %zu...\n", WORKLOADS[w], SPARSITIES[s], SIZES[n]);
+        bench_2d(cache_dir, WORKLOADS[w], SPARSITIES[s], SIZES[n]);
+        if (strcmp(WORKLOADS[w], "uniform") == 0)
+          bench_3d(cache_dir, SPARSITIES[s], SIZES[n]);
+      }
+    }
+  }
+
+  fprintf(stderr, "\nBenchmark complete!\n");
+  return 0;
+}
@@ -1,6 +1,26 @@
 #include "unzip_kernels.h"
+#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// unzip_utils.c (declared by hand like the Julia wrappers in libunzip_utils.jl)
+struct csr *allocate_csr(size_t ndim1, size_t ndim2, size_t dim2_nnz);
+void free_csr(struct csr *tensor);
+void reset_csr(struct csr *tensor);
+void reserve_csr(struct csr *tensor, size_t nnz);
+void free_csf(struct csf *tensor);
+struct csr *generate_csr(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed);
+struct csf *generate_csf(size_t ndim1, size_t ndim2, size_t ndim3, double sparsity, unsigned int seed);
+int save_csr(struct csr *tensor, const char *path);
+int save_csf(struct csf *tensor, const char *path);
+struct csr *load_csr(const char *path);
+struct csf *load_csf(const char *path);
+struct csr *cached_csr(const char *dir, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed);
+struct csf *cached_csf(const char *dir, size_t ndim1, size_t ndim2, size_t ndim3, double sparsity, unsigned int seed);
+struct csr *read_mtx_csr(const char *path);
+int write_mtx_csr(struct csr *tensor, const char *path);
 
 static void print_csr(struct csr *tensor) {
   for (int row_idx = 0; row_idx < tensor->lvl1_size; row_idx++) {
@@ -22,179 +42,253 @@ static void print_csr(struct csr *tensor) {
   }
 }
 
+// Entries of a CSR tensor as "(i,j) v", each row in column order whatever order the kernel stored it in
+static void print_csr_entries(struct csr *tensor) {
+  for (size_t row_idx = 0; row_idx < tensor->lvl1_size; row_idx++) {
+    size_t col_idx = 0;
+    for (;;) {
+      size_t next = tensor->lvl1_pos[row_idx + 1];
+      for (size_t nnz_idx = tensor->lvl1_pos[row_idx]; nnz_idx < tensor->lvl1_pos[row_idx + 1]; nnz_idx++) {
+        if (tensor->lvl2_crd[nnz_idx] >= col_idx &&
+            (next == tensor->lvl1_pos[row_idx + 1] || tensor->lvl2_crd[nnz_idx] < tensor->lvl2_crd[next]))
+          next = nnz_idx;
+      }
+      if (next == tensor->lvl1_pos[row_idx + 1])
+        break;
+      printf(" (%zu,%zu) %.1f", row_idx, (size_t)tensor->lvl2_crd[next], tensor->vals[next]);
+      col_idx = tensor->lvl2_crd[next] + 1;
+    }
+  }
+  printf("\n");
+}
+
 static void print_dense(struct dense *tensor) {
   for (int i = 0; i < tensor->size; i++) {
     printf("y[%d] = %.1f\n", i, tensor->vals[i]);
   }
 }
 
+// Fixtures: each operand views static arrays, so every test and variant loop below shares one copy
+
+// 2 x 2 CSR view of pos (3 entries), crd and vals
+static struct csr csr_view(index_t *lvl1_pos, index_t *lvl2_crd, value_t *vals) {
+  struct csr tensor = {0};
+  tensor.vals = vals;
+  tensor.lvl2_crd = lvl2_crd;
+  tensor.lvl1_pos = lvl1_pos;
+  tensor.lvl1_size = 2;
+  tensor.lvl2_size = 2;
+  tensor.lvl2_nnz = lvl1_pos[2];
+  return tensor;
+}
+
+// B = [1 2; 0 3]
+static struct csr fixture_b() {
+  static value_t vals[3] = {1, 2, 3};
+  static index_t lvl2_crd[3] = {0, 1, 1};
+  static index_t lvl1_pos[3] = {0, 2, 3};
+  return csr_view(lvl1_pos, lvl2_crd, vals);
+}
+
+// C = [4 0; 5 6]
+static struct csr fixture_transpose_c() {
+  static value_t vals[3] = {4, 5, 6};
+  static index_t lvl2_crd[3] = {0, 0, 1};
+  static index_t lvl1_pos[3] = {0, 1, 3};
+  return csr_view(lvl1_pos, lvl2_crd, vals);
+}
+
+// B = [1 1; 0 0]
+static struct csr fixture_matmul_b() {
+  static value_t vals[2] = {1, 1};
+  static index_t lvl2_crd[2] = {0, 1};
+  static index_t lvl1_pos[3] = {0, 2, 2};
+  return csr_view(lvl1_pos, lvl2_crd, vals);
+}
+
+// C = [1 0; 1 0]
+static struct csr fixture_matmul_c() {
+  static value_t vals[2] = {1, 1};
+  static index_t lvl2_crd[2] = {0, 0};
+  static index_t lvl1_pos[3] = {0, 1, 2};
+  return csr_view(lvl1_pos, lvl2_crd, vals);
+}
+
+// C = [1 0; 0 1]
+static struct csr fixture_hadamard_c() {
+  static value_t vals[2] = {1, 1};
+  static index_t lvl2_crd[2] = {0, 1};
+  static index_t lvl1_pos[3] = {0, 1, 2};
+  return csr_view(lvl1_pos, lvl2_crd, vals);
+}
+
+// D = [2 0; 0 2]
+static struct csr fixture_hadamard_d() {
+  static value_t vals[2] = {2, 2};
+  static index_t lvl2_crd[2] = {0, 1};
+  static index_t lvl1_pos[3] = {0, 1, 2};
+  return csr_view(lvl1_pos, lvl2_crd, vals);
+}
+
+// B has non-zeros at: B[0,0,0]=1, B[0,0,1]=2, B[1,1,1]=3
+static struct csf fixture_permute_b() {
+  static value_t vals[3] = {1, 2, 3};
+  static index_t lvl3_crd[3] = {0, 1, 1};
+  static index_t lvl2_crd[3] = {0, 0, 1};
+  static index_t lvl2_pos[3] = {0, 2, 3};
+  static index_t lvl1_pos[3] = {0, 1, 2};
+  struct csf tensor = {0};
+  tensor.vals = vals;
+  tensor.lvl3_crd = lvl3_crd;
+  tensor.lvl2_crd = lvl2_crd;
+  tensor.lvl2_pos = lvl2_pos;
+  tensor.lvl1_pos = lvl1_pos;
+  tensor.lvl1_size = 2;
+  tensor.lvl2_size = 2;
+  tensor.lvl3_size = 2;
+  tensor.lvl2_nnz = 2;
+  tensor.lvl3_nnz = 3;
+  return tensor;
+}
+
+// C has non-zeros at: C[0,0,0]=4, C[1,0,1]=5, C[1,1,1]=6
+static struct csf fixture_permute_c() {
+  static value_t vals[3] = {4, 5, 6};
+  static index_t lvl3_crd[3] = {0, 1, 1};
+  static index_t lvl2_crd[3] = {0, 0, 1};
+  static index_t lvl2_pos[3] = {0, 1, 3};
+  static index_t lvl1_pos[3] = {0, 1, 2};
+  struct csf tensor = {0};
+  tensor.vals = vals;
+  tensor.lvl3_crd = lvl3_crd;
+  tensor.lvl2_crd = lvl2_crd;
+  tensor.lvl2_pos = lvl2_pos;
+  tensor.lvl1_pos = lvl1_pos;
+  tensor.lvl1_size = 2;
+  tensor.lvl2_size = 2;
+  tensor.lvl3_size = 2;
+  tensor.lvl2_nnz = 2;
+  tensor.lvl3_nnz = 3;
+  return tensor;
+}
+
+// Result storage for up to 10 entries of a 2 x ncols A, emptied by clear_result before each kernel
+struct result {
+  struct csr A;
+  value_t vals[10];
+  index_t lvl2_crd[10];
+  index_t lvl1_pos[3];
+};
+
+static struct csr *clear_result(struct result *res, size_t ncols) {
+  memset(res, 0, sizeof(*res));
+  res->A.vals = res->vals;
+  res->A.lvl2_crd = res->lvl2_crd;
+  res->A.lvl1_pos = res->lvl1_pos;
+  res->A.lvl1_size = 2;
+  res->A.lvl2_size = ncols;
+  return &res->A;
+}
+
 void test_hadamard_transpose() {
-  // B = [1 2; 0 3]
-  struct csr B;
-  double b_vals[3] = {1, 2, 3};
-  size_t b_lvl2_crd[3] = {0, 1, 1};
-  size_t b_lvl1_pos[3] = {0, 2, 3};
-  B.vals = b_vals;
-  B.lvl2_crd = b_lvl2_crd;
-  B.lvl1_pos = b_lvl1_pos;
-  B.lvl1_size = 2;
-  B.lvl2_size = 2;
-  B.lvl2_nnz = 3;
-
-  // C = [4 0; 5 6]
-  struct csr C;
-  double c_vals[3] = {4, 5, 6};
-  size_t c_lvl2_crd[3] = {0, 0, 1};
-  size_t c_lvl1_pos[3] = {0, 1, 3};
-  C.vals = c_vals;
-  C.lvl2_crd = c_lvl2_crd;
-  C.lvl1_pos = c_lvl1_pos;
-  C.lvl1_size = 2;
-  C.lvl2_size = 2;
-  C.lvl2_nnz = 3;
-
-  // A(i,j) = B(i,j) * C(j,i)
+  // A(i,j) = B(i,j) * C(j,i) with B = [1 2; 0 3], C = [4 0; 5 6]
   // Expected: A = [4 10; 0 18]
-  struct csr A;
-  double res_vals[4] = {0};
-  size_t res_lvl2_crd[4] = {0};
-  size_t res_lvl1_pos[3] = {0};
-  A.vals = res_vals;
-  A.lvl2_crd = res_lvl2_crd;
-  A.lvl1_pos = res_lvl1_pos;
-  A.lvl1_size = 2;
-  A.lvl2_size = 2;
-  A.lvl2_nnz = 0;
+  struct csr B = fixture_b(), C = fixture_transpose_c();
+  struct result res;
+  struct csr *A = clear_result(&res, 2);
+  hadamard_transpose(&B, &C, A);
+  print_csr(A);
+}
 
-  hadamard_transpose(&B, &C, &A);
-  print_csr(&A);
+// A(i,j) = B(i,k) * C(k,j) with B = [1 1; 0 0], C = [1 0; 1 0], for each kernel
+// Expected: A = [2 0; 0 0]
+static void run_matmul(int num_kernels, void (*kernels[])(struct csr *, struct csr *, struct csr *)) {
+  struct csr B = fixture_matmul_b(), C = fixture_matmul_c();
+  for (int kernel_idx = 0; kernel_idx < num_kernels; kernel_idx++) {
+    struct result res;
+    struct csr *A = clear_result(&res, 2);
+    kernels[kernel_idx](&B, &C, A);
+    print_csr(A);
+  }
 }
 
 void test_matmul() {
-  // B = [1 1; 0 0]
-  struct csr B;
-  double b_vals[2] = {1, 1};
-  size_t b_lvl2_crd[2] = {0, 1};
-  size_t b_lvl1_pos[3] = {0, 2, 2};
-  B.vals = b_vals;
-  B.lvl2_crd = b_lvl2_crd;
-  B.lvl1_pos = b_lvl1_pos;
-  B.lvl1_size = 2;
-  B.lvl2_size = 2;
-  B.lvl2_nnz = 2;
-
-  // C = [1 0; 1 0]
-  struct csr C;
-  double c_vals[2] = {1, 1};
-  size_t c_lvl2_crd[2] = {0, 0};
-  size_t c_lvl1_pos[3] = {0, 1, 2};
-  C.vals = c_vals;
-  C.lvl2_crd = c_lvl2_crd;
-  C.lvl1_pos = c_lvl1_pos;
-  C.lvl1_size = 2;
-  C.lvl2_size = 2;
-  C.lvl2_nnz = 2;
-
-  // A(i,j) = B(i,k) * C(k,j)
-  // Expected: A = [2 0; 0 0]
-  struct csr A;
-  double res_vals[10] = {0};
-  size_t res_lvl2_crd[10] = {0};
-  size_t res_lvl1_pos[3] = {0};
-  A.vals = res_vals;
-  A.lvl2_crd = res_lvl2_crd;
-  A.lvl1_pos = res_lvl1_pos;
-  A.lvl1_size = 2;
-  A.lvl2_size = 2;
-  A.lvl2_nnz = 0;
+  void (*kernels[1])(struct csr *, struct csr *, struct csr *) = {matmul};
+  run_matmul(1, kernels);
+}
+
+void test_matmul_accumulators() {
+  // The spa, spa_sorted, hybrid and parallel accumulators
+  void (*kernels[4])(struct csr *, struct csr *, struct csr *) = {matmul_spa, matmul_spa_sorted, matmul_hybrid,
+                                                                  matmul_parallel};
+  run_matmul(4, kernels);
+}
 
-  matmul(&B, &C, &A);
-  print_csr(&A);
+// A(i,j) = B(i,k) * C(k,j) * D(k,j) with B = [1 2; 0 3], C = [1 0; 0 1], D = [2 0; 0 2], for each kernel
+// Expected: A = [2 0; 0 6]
+static void run_matmul_hadamard(int num_kernels,
+                                void (*kernels[])(struct csr *, struct csr *, struct csr *, struct csr *)) {
+  struct csr B = fixture_b(), C = fixture_hadamard_c(), D = fixture_hadamard_d();
+  for (int kernel_idx = 0; kernel_idx < num_kernels; kernel_idx++) {
+    struct result res;
+    struct csr *A = clear_result(&res, 2);
+    kernels[kernel_idx](&B, &C, &D, A);
+    print_csr(A);
+  }
 }
 
 void test_matmul_hadamard() {
+  void (*kernels[1])(struct csr *, struct csr *, struct csr *, struct csr *) = {matmul_hadamard};
+  run_matmul_hadamard(1, kernels);
+}
+
+void test_matmul_hadamard_accumulators() {
+  // The spa, spa_sorted, hybrid, parallel, fused and adaptive kernels
+  void (*kernels[6])(struct csr *, struct csr *, struct csr *, struct csr *) = {
+      matmul_hadamard_spa,      matmul_hadamard_spa_sorted, matmul_hadamard_hybrid,
+      matmul_hadamard_parallel, matmul_hadamard_fused,      matmul_hadamard_adaptive};
+  run_matmul_hadamard(6, kernels);
+}
+
+void test_matmul_hash_accumulator() {
   // B = [1 2; 0 3]
-  struct csr B;
-  double b_vals[3] = {1, 2, 3};
-  size_t b_lvl2_crd[3] = {0, 1, 1};
-  size_t b_lvl1_pos[3] = {0, 2, 3};
-  B.vals = b_vals;
-  B.lvl2_crd = b_lvl2_crd;
-  B.lvl1_pos = b_lvl1_pos;
-  B.lvl1_size = 2;
-  B.lvl2_size = 2;
-  B.lvl2_nnz = 3;
-
-  // C = [1 0; 0 1]
-  struct csr C;
-  double c_vals[2] = {1, 1};
-  size_t c_lvl2_crd[2] = {0, 1};
-  size_t c_lvl1_pos[3] = {0, 1, 2};
-  C.vals = c_vals;
-  C.lvl2_crd = c_lvl2_crd;
-  C.lvl1_pos = c_lvl1_pos;
-  C.lvl1_size = 2;
-  C.lvl2_size = 2;
-  C.lvl2_nnz = 2;
-
-  // D = [2 0; 0 2]
-  struct csr D;
-  double d_vals[2] = {2, 2};
-  size_t d_lvl2_crd[2] = {0, 1};
-  size_t d_lvl1_pos[3] = {0, 1, 2};
+  struct csr B = fixture_b();
+
+  // C is 2 x 64 with two entries per row: C(0,5) = 1, C(0,20) = 2, C(1,20) = 3, C(1,31) = 4. Rows of A take at most
+  // 4 flops, and 4 <= 64 / HASH_FLOPS_RATIO, so the hybrid kernels accumulate every row in the hash table.
+  value_t c_vals[4] = {1, 2, 3, 4};
+  index_t c_lvl2_crd[4] = {5, 20, 20, 31};
+  index_t c_lvl1_pos[3] = {0, 2, 4};
+  struct csr C = csr_view(c_lvl1_pos, c_lvl2_crd, c_vals);
+  C.lvl2_size = 64;
+
+  // D has C's pattern, every value 2
+  struct csr D = C;
+  value_t d_vals[4] = {2, 2, 2, 2};
   D.vals = d_vals;
-  D.lvl2_crd = d_lvl2_crd;
-  D.lvl1_pos = d_lvl1_pos;
-  D.lvl1_size = 2;
-  D.lvl2_size = 2;
-  D.lvl2_nnz = 2;
-
-  // A(i,j) = B(i,k) * C(k,j) * D(k,j)
-  // Expected: A = [2 0; 0 6]
-  struct csr A;
-  double res_vals[10] = {0};
-  size_t res_lvl2_crd[10] = {0};
-  size_t res_lvl1_pos[3] = {0};
-  A.vals = res_vals;
-  A.lvl2_crd = res_lvl2_crd;
-  A.lvl1_pos = res_lvl1_pos;
-  A.lvl1_size = 2;
-  A.lvl2_size = 2;
-  A.lvl2_nnz = 0;
 
-  matmul_hadamard(&B, &C, &D, &A);
-  print_csr(&A);
+  // A(i,j) = B(i,k) * C(k,j) (* D(k,j)) with the spa_sorted reference and the hybrid accumulator
+  // Expected: (0,5) 1.0 (0,20) 8.0 (0,31) 8.0 (1,20) 9.0 (1,31) 12.0, and twice that with D
+  void (*kernels[2])(struct csr *, struct csr *, struct csr *) = {matmul_spa_sorted, matmul_hybrid};
+  void (*hadamard_kernels[2])(struct csr *, struct csr *, struct csr *, struct csr *) = {matmul_hadamard_spa_sorted,
+                                                                                        matmul_hadamard_hybrid};
+  for (int kernel_idx = 0; kernel_idx < 4; kernel_idx++) {
+    struct result res;
+    struct csr *A = clear_result(&res, 64);
+    if (kernel_idx < 2)
+      kernels[kernel_idx](&B, &C, A);
+    else
+      hadamard_kernels[kernel_idx - 2](&B, &C, &D, A);
+    print_csr_entries(A);
+  }
 }
 
 void test_hadamard_transpose_reduce() {
-  // B = [1 2; 0 3]
-  struct csr B;
-  double b_vals[3] = {1, 2, 3};
-  size_t b_lvl2_crd[3] = {0, 1, 1};
-  size_t b_lvl1_pos[3] = {0, 2, 3};
-  B.vals = b_vals;
-  B.lvl2_crd = b_lvl2_crd;
-  B.lvl1_pos = b_lvl1_pos;
-  B.lvl1_size = 2;
-  B.lvl2_size = 2;
-  B.lvl2_nnz = 3;
-
-  // C = [4 0; 5 6]
-  struct csr C;
-  double c_vals[3] = {4, 5, 6};
-  size_t c_lvl2_crd[3] = {0, 0, 1};
-  size_t c_lvl1_pos[3] = {0, 1, 3};
-  C.vals = c_vals;
-  C.lvl2_crd = c_lvl2_crd;
-  C.lvl1_pos = c_lvl1_pos;
-  C.lvl1_size = 2;
-  C.lvl2_size = 2;
-  C.lvl2_nnz = 3;
-
-  // y(i) = sum_j B(i,j) * C(j,i)
+  // y(i) = sum_j B(i,j) * C(j,i) with B = [1 2; 0 3], C = [4 0; 5 6]
   // Expected: y = [14, 18]
+  struct csr B = fixture_b(), C = fixture_transpose_c();
   struct dense y;
-  double res_vals[2] = {0};
+  value_t res_vals[2] = {0};
   y.vals = res_vals;
   y.size = 2;
 
@@ -202,50 +296,157 @@ void test_hadamard_transpose_reduce() {
   print_dense(&y);
 }
 
+// y(i) = sum_jk B(i,j,k) * C(i,k,j) with the B and C of fixture_permute_*, for each kernel
+// Expected: y = [4, 18]
+static void run_permute_contract(int num_kernels, void (*kernels[])(struct csf *, struct csf *, struct dense *)) {
+  struct csf B = fixture_permute_b(), C = fixture_permute_c();
+  for (int kernel_idx = 0; kernel_idx < num_kernels; kernel_idx++) {
+    struct dense y;
+    value_t res_vals[2] = {0};
+    y.vals = res_vals;
+    y.size = 2;
+
+    kernels[kernel_idx](&B, &C, &y);
+    print_dense(&y);
+  }
+}
+
 void test_permute_contract() {
-  // B has non-zeros at: B[0,0,0]=1, B[0,0,1]=2, B[1,1,1]=3
-  struct csf B;
-  double b_vals[3] = {1, 2, 3};
-  size_t b_lvl3_crd[3] = {0, 1, 1};
-  size_t b_lvl2_crd[3] = {0, 0, 1};
-  size_t b_lvl2_pos[3] = {0, 2, 3};
-  size_t b_lvl1_pos[3] = {0, 1, 2};
-  B.vals = b_vals;
-  B.lvl3_crd = b_lvl3_crd;
-  B.lvl2_crd = b_lvl2_crd;
-  B.lvl2_pos = b_lvl2_pos;
-  B.lvl1_pos = b_lvl1_pos;
-  B.lvl1_size = 2;
-  B.lvl2_size = 2;
-  B.lvl3_size = 2;
-  B.lvl2_nnz = 2;
-  B.lvl3_nnz = 3;
-
-  // C has non-zeros at: C[0,0,0]=4, C[1,0,1]=5, C[1,1,1]=6
-  struct csf C;
-  double c_vals[3] = {4, 5, 6};
-  size_t c_lvl3_crd[3] = {0, 1, 1};
-  size_t c_lvl2_crd[3] = {0, 0, 1};
-  size_t c_lvl2_pos[3] = {0, 1, 3};
-  size_t c_lvl1_pos[3] = {0, 1, 2};
-  C.vals = c_vals;
-  C.lvl3_crd = c_lvl3_crd;
-  C.lvl2_crd = c_lvl2_crd;
-  C.lvl2_pos = c_lvl2_pos;
-  C.lvl1_pos = c_lvl1_pos;
-  C.lvl1_size = 2;
-  C.lvl2_size = 2;
-  C.lvl3_size = 2;
-  C.lvl2_nnz = 2;
-  C.lvl3_nnz = 3;
-
-  // y(i) = sum_jk B(i,j,k) * C(i,k,j)
-  // Expected: y = [4, 18]
-  struct dense y;
-  double res_vals[2] = {0};
-  y.vals = res_vals;
-  y.size = 2;
+  void (*kernels[1])(struct csf *, struct csf *, struct dense *) = {permute_contract};
+  run_permute_contract(1, kernels);
+}
 
-  permute_contract(&B, &C, &y);
-  print_dense(&y);
+void test_permute_contract_variants() {
+  // The transposed, dense and parallel slice views
+  void (*kernels[3])(struct csf *, struct csf *, struct dense *) = {permute_contract_transposed, permute_contract_dense,
+                                                                    permute_contract_parallel};
+  run_permute_contract(3, kernels);
+}
+
+static int same_arrays(const void *a, const void *b, size_t bytes) { return memcmp(a, b, bytes) == 0; }
+
+static int same_csr(struct csr *a, struct csr *b) {
+  return b && a->lvl1_size == b->lvl1_size && a->lvl2_size == b->lvl2_size && a->lvl2_nnz == b->lvl2_nnz &&
+         same_arrays(a->lvl1_pos, b->lvl1_pos, (a->lvl1_size + 1) * sizeof(index_t)) &&
+         same_arrays(a->lvl2_crd, b->lvl2_crd, a->lvl2_nnz * sizeof(index_t)) &&
+         same_arrays(a->vals, b->vals, a->lvl2_nnz * sizeof(value_t));
+}
+
+static int same_csf(struct csf *a, struct csf *b) {
+  return b && a->lvl1_size == b->lvl1_size && a->lvl2_size == b->lvl2_size && a->lvl2_nnz == b->lvl2_nnz &&
+         a->lvl3_size == b->lvl3_size && a->lvl3_nnz == b->lvl3_nnz &&
+         same_arrays(a->lvl1_pos, b->lvl1_pos, (a->lvl1_size + 1) * sizeof(index_t)) &&
+         same_arrays(a->lvl2_pos, b->lvl2_pos, (a->lvl2_nnz + 1) * sizeof(index_t)) &&
+         same_arrays(a->lvl2_crd, b->lvl2_crd, a->lvl2_nnz * sizeof(index_t)) &&
+         same_arrays(a->lvl3_crd, b->lvl3_crd, a->lvl3_nnz * sizeof(index_t)) &&
+         same_arrays(a->vals, b->vals, a->lvl3_nnz * sizeof(value_t));
+}
+
+static void print_same(const char *name, int same) { printf("%s: %s\n", name, same ? "same" : "DIFFERENT"); }
+
+// Removes the files of a cache directory and the directory itself
+static void remove_cache(const char *dir) {
+  DIR *entries = opendir(dir);
+  for (struct dirent *entry; entries && (entry = readdir(entries));) {
+    char file[4096];
+    if (entry->d_name[0] != '.' && snprintf(file, sizeof(file), "%s/%s", dir, entry->d_name) < (int)sizeof(file))
+      unlink(file);
+  }
+  if (entries)
+    closedir(entries);
+  rmdir(dir);
+}
+
+void test_tensor_files() {
+  // Generated B (CSR, 37 x 29) and T (CSF, 9 x 8 x 7) written and read back through every file path of unzip_utils.c
+  // Expected: "same" for each
+  struct csr *B = generate_csr(37, 29, 0.3, 1);
+  struct csf *T = generate_csf(9, 8, 7, 0.5, 2);
+  char path[] = "/tmp/unzip_kernels_test_XXXXXX";
+  char dir[] = "/tmp/unzip_kernels_cache_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0 || !mkdtemp(dir)) {
+    perror("mkstemp");
+    return;
+  }
+  close(fd);
+
+  // save_* replaces the file atomically, so the mapping of a loaded tensor outlives the next save
+  struct csr *loaded_csr = save_csr(B, path) == 0 ? load_csr(path) : NULL;
+  print_same("save_csr/load_csr", same_csr(B, loaded_csr));
+  struct csf *loaded_csf = save_csf(T, path) == 0 ? load_csf(path) : NULL;
+  print_same("save_csf/load_csf", same_csf(T, loaded_csf));
+
+  // The first call generates and saves, the second maps what the first saved
+  for (int run = 0; run < 2; run++) {
+    struct csr *cached_b = cached_csr(dir, 37, 29, 0.3, 1);
+    struct csf *cached_t = cached_csf(dir, 9, 8, 7, 0.5, 2);
+    print_same(run ? "cached_csr (hit)" : "cached_csr (miss)", cached_b->mapping && same_csr(B, cached_b));
+    print_same(run ? "cached_csf (hit)" : "cached_csf (miss)", cached_t->mapping && same_csf(T, cached_t));
+    free_csr(cached_b);
+    free_csf(cached_t);
+  }
+
+  struct csr *read_csr = write_mtx_csr(B, path) == 0 ? read_mtx_csr(path) : NULL;
+  print_same("write_mtx_csr/read_mtx_csr", same_csr(B, read_csr));
+
+  if (loaded_csr)
+    free_csr(loaded_csr);
+  if (loaded_csf)
+    free_csf(loaded_csf);
+  if (read_csr)
+    free_csr(read_csr);
+  free_csr(B);
+  free_csf(T);
+  unlink(path);
+  remove_cache(dir);
+}
+
+void test_kernel_counts() {
+  // Generated B, C, D (CSR, 41 x 41, 4 entries per row); each kernel writes into an A allocated empty and reserved with
+  // its count, as the benchmarks do, and must store exactly that many entries
+  // Expected: "same" for each
+  size_t n = 41;
+  struct csr *B = generate_csr(n, n, 0.1, 3);
+  struct csr *C = generate_csr(n, n, 0.1, 4);
+  struct csr *D = generate_csr(n, n, 0.1, 5);
+  struct csr *A = allocate_csr(n, n, 0);
+
+  size_t count = hadamard_transpose_count(B, C);
+  reserve_csr(A, count);
+  reset_csr(A);
+  hadamard_transpose(B, C, A);
+  print_same("hadamard_transpose_count", A->lvl1_pos[n] == count);
+
+  const char *names[5] = {"matmul_count (matmul)", "matmul_count (spa)",    "matmul_count (spa_sorted)",
+                          "matmul_count (hybrid)", "matmul_count (parallel)"};
+  void (*kernels[5])(struct csr *, struct csr *, struct csr *) = {matmul, matmul_spa, matmul_spa_sorted, matmul_hybrid,
+                                                                  matmul_parallel};
+  count = matmul_count(B, C);
+  for (int kernel_idx = 0; kernel_idx < 5; kernel_idx++) {
+    reserve_csr(A, count);
+    reset_csr(A);
+    kernels[kernel_idx](B, C, A);
+    print_same(names[kernel_idx], A->lvl1_pos[n] == count);
+  }
+
+  const char *hadamard_names[7] = {
+      "matmul_hadamard_count (matmul_hadamard)", "matmul_hadamard_count (spa)",   "matmul_hadamard_count (spa_sorted)",
+      "matmul_hadamard_count (hybrid)",          "matmul_hadamard_count (parallel)", "matmul_hadamard_count (fused)",
+      "matmul_hadamard_count (adaptive)"};
+  void (*hadamard_kernels[7])(struct csr *, struct csr *, struct csr *, struct csr *) = {
+      matmul_hadamard,          matmul_hadamard_spa,   matmul_hadamard_spa_sorted, matmul_hadamard_hybrid,
+      matmul_hadamard_parallel, matmul_hadamard_fused, matmul_hadamard_adaptive};
+  count = matmul_hadamard_count(B, C, D);
+  for (int kernel_idx = 0; kernel_idx < 7; kernel_idx++) {
+    reserve_csr(A, count);
+    reset_csr(A);
+    hadamard_kernels[kernel_idx](B, C, D, A);
+    print_same(hadamard_names[kernel_idx], A->lvl1_pos[n] == count);
+  }
+
+  free_csr(A);
+  free_csr(B);
+  free_csr(C);
+  free_csr(D);
 }
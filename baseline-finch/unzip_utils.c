@@ -1,96 +1,197 @@
 #include "unzip_formats.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-static inline double rand_double() {
-  return (double)rand() / RAND_MAX;
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+// Counter-based random numbers: draw c of a stream is the splitmix64 finalizer applied to key + c * golden ratio, so it
+// depends only on (seed, level, stream, c). The generators give every slice its own stream and fill slices in parallel
+// with the same output for any thread count.
+struct rng {
+  uint64_t key;
+  uint64_t counter;
+};
+
+static inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// Stream of slice `stream` at tensor level `level`; streams of different levels of one tensor do not overlap
+static inline struct rng rng_stream(unsigned int seed, uint64_t level, uint64_t stream) {
+  struct rng rng = {mix64(mix64((uint64_t)seed << 8 | level) + stream * 0x9E3779B97F4A7C15ULL), 0};
+  return rng;
+}
+
+static inline uint64_t rng_next(struct rng *rng) {
+  return mix64(rng->key + ++rng->counter * 0x9E3779B97F4A7C15ULL);
 }
 
-static inline size_t rand_size_t() {
-  size_t result = 0;
-  for (size_t i = 0; i < sizeof(size_t); ++i)
-    result = (result << 8) | (rand() & 0xFF);
-  return result;
+// Uniform in [0, n) by multiply-shift (bias below n / 2^64)
+static inline size_t rng_uniform(struct rng *rng, size_t n) {
+  return (size_t)(((unsigned __int128)rng_next(rng) * n) >> 64);
 }
 
-static inline size_t rand_uniform(size_t n) {
-  return rand_size_t() % n;
+// Uniform in [0, 1)
+static inline value_t rng_value(struct rng *rng) {
+  return (value_t)((rng_next(rng) >> 11) * 0x1.0p-53);
+}
+
+// k distinct coordinates of [0, n) in ascending order into crd: Floyd's sampling marks them in bitmap (n bits, zero on
+// entry), then a word scan collects them and clears bitmap again. O(k + n / 64).
+static void sample_sorted(struct rng *rng, size_t n, size_t k, uint64_t *bitmap, index_t *crd) {
+  for (size_t j = n - k; j < n; ++j) {
+    size_t t = rng_uniform(rng, j + 1);
+    size_t pick = (bitmap[t >> 6] >> (t & 63)) & 1 ? j : t;
+    bitmap[pick >> 6] |= (uint64_t)1 << (pick & 63);
+  }
+  size_t out = 0;
+  for (size_t w = 0; out < k; ++w) {
+    uint64_t word = bitmap[w];
+    bitmap[w] = 0;
+    for (; word; word &= word - 1)
+      crd[out++] = (w << 6) + __builtin_ctzll(word);
+  }
+}
+
+// Slice s of [0, num_slices) gets per_slice sorted, distinct coordinates of [0, extent) at crd + s * per_slice and (if
+// vals is not NULL) as many values, all drawn from stream (seed, level, s)
+static void fill_slices(unsigned int seed, uint64_t level, size_t num_slices, size_t per_slice, size_t extent,
+                        index_t *crd, value_t *vals) {
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+  {
+    uint64_t *bitmap = calloc((extent + 63) / 64, sizeof(uint64_t));
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 64)
+#endif
+    for (size_t s = 0; s < num_slices; ++s) {
+      struct rng rng = rng_stream(seed, level, s);
+      sample_sorted(&rng, extent, per_slice, bitmap, crd + s * per_slice);
+      if (vals)
+        for (size_t e = s * per_slice; e < (s + 1) * per_slice; ++e)
+          vals[e] = rng_value(&rng);
+    }
+    free(bitmap);
+  }
 }
 
 // Dense tensor utilities
 struct dense *allocate_dense(size_t n) {
   struct dense *tensor = malloc(sizeof(struct dense));
   tensor->size = n;
-  tensor->vals = calloc(n, sizeof(double));
+  tensor->vals = calloc(n, sizeof(value_t));
+  tensor->mapping = NULL;
+  tensor->mapping_size = 0;
   return tensor;
 }
 
 void free_dense(struct dense *tensor) {
   if (tensor) {
-    free(tensor->vals);
+    if (tensor->mapping)
+      munmap(tensor->mapping, tensor->mapping_size);
+    else
+      free(tensor->vals);
     free(tensor);
   }
 }
 
 void reset_dense(struct dense *tensor) {
-  memset(tensor->vals, 0, tensor->size * sizeof(double));
+  memset(tensor->vals, 0, tensor->size * sizeof(value_t));
 }
 
 // CSR tensor utilities
 struct csr *allocate_csr(size_t ndim1, size_t ndim2, size_t dim2_nnz) {
   struct csr *tensor = malloc(sizeof(struct csr));
   tensor->lvl1_size = ndim1;
-  tensor->lvl1_pos = malloc((ndim1 + 1) * sizeof(size_t));
+  tensor->lvl1_pos = malloc((ndim1 + 1) * sizeof(index_t));
   tensor->lvl1_pos[0] = 0;
 
   tensor->lvl2_size = ndim2;
   tensor->lvl2_nnz = ndim1 * dim2_nnz;
-  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(size_t));
-  tensor->vals = calloc(tensor->lvl2_nnz, sizeof(double));
+  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(index_t));
+  tensor->vals = calloc(tensor->lvl2_nnz, sizeof(value_t));
+  tensor->mapping = NULL;
+  tensor->mapping_size = 0;
   return tensor;
 }
 
 void free_csr(struct csr *tensor) {
   if (tensor) {
-    free(tensor->lvl1_pos);
-    free(tensor->lvl2_crd);
-    free(tensor->vals);
+    if (tensor->mapping) {
+      munmap(tensor->mapping, tensor->mapping_size);
+    } else {
+      free(tensor->lvl1_pos);
+      free(tensor->lvl2_crd);
+      free(tensor->vals);
+    }
     free(tensor);
   }
 }
 
 void reset_csr(struct csr *tensor) {
   tensor->lvl2_nnz = 0;
-  memset(tensor->lvl1_pos, 0, (tensor->lvl1_size + 1) * sizeof(size_t));
+  memset(tensor->lvl1_pos, 0, (tensor->lvl1_size + 1) * sizeof(index_t));
+}
+
+// Resize the entry storage of res to exactly nnz entries (e.g. from a kernel's *_count)
+void reserve_csr(struct csr *tensor, size_t nnz) {
+  tensor->lvl2_crd = realloc(tensor->lvl2_crd, nnz * sizeof(index_t));
+  tensor->vals = realloc(tensor->vals, nnz * sizeof(value_t));
+  tensor->lvl2_nnz = nnz;
 }
 
 // CSF tensor utilities
 struct csf *allocate_csf(size_t ndim1, size_t ndim2, size_t ndim3, size_t dim2_nnz, size_t dim3_nnz) {
   struct csf *tensor = malloc(sizeof(struct csf));
   tensor->lvl1_size = ndim1;
-  tensor->lvl1_pos = malloc((ndim1 + 1) * sizeof(size_t));
+  tensor->lvl1_pos = malloc((ndim1 + 1) * sizeof(index_t));
   tensor->lvl1_pos[0] = 0;
 
   tensor->lvl2_size = ndim2;
   tensor->lvl2_nnz = ndim1 * dim2_nnz;
-  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(size_t));
-  tensor->lvl2_pos = malloc((tensor->lvl2_nnz + 1) * sizeof(size_t));
+  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(index_t));
+  tensor->lvl2_pos = malloc((tensor->lvl2_nnz + 1) * sizeof(index_t));
   tensor->lvl2_pos[0] = 0;
 
   tensor->lvl3_size = ndim3;
   tensor->lvl3_nnz = tensor->lvl2_nnz * dim3_nnz;
-  tensor->lvl3_crd = malloc(tensor->lvl3_nnz * sizeof(size_t));
-  tensor->vals = calloc(tensor->lvl3_nnz, sizeof(double));
+  tensor->lvl3_crd = malloc(tensor->lvl3_nnz * sizeof(index_t));
+  tensor->vals = calloc(tensor->lvl3_nnz, sizeof(value_t));
+  tensor->mapping = NULL;
+  tensor->mapping_size = 0;
   return tensor;
 }
 
 void free_csf(struct csf *tensor) {
   if (tensor) {
-    free(tensor->lvl1_pos);
-    free(tensor->lvl2_crd);
-    free(tensor->lvl2_pos);
-    free(tensor->lvl3_crd);
-    free(tensor->vals);
+    if (tensor->mapping) {
+      munmap(tensor->mapping, tensor->mapping_size);
+    } else {
+      free(tensor->lvl1_pos);
+      free(tensor->lvl2_crd);
+      free(tensor->lvl2_pos);
+      free(tensor->lvl3_crd);
+      free(tensor->vals);
+    }
     free(tensor);
   }
 }
@@ -98,16 +199,15 @@ void free_csf(struct csf *tensor) {
 void reset_csf(struct csf *tensor) {
   tensor->lvl2_nnz = 0;
   tensor->lvl3_nnz = 0;
-  memset(tensor->lvl1_pos, 0, (tensor->lvl1_size + 1) * sizeof(size_t));
-  memset(tensor->lvl2_pos, 0, (tensor->lvl1_size + 1) * sizeof(size_t));
+  memset(tensor->lvl1_pos, 0, (tensor->lvl1_size + 1) * sizeof(index_t));
+  memset(tensor->lvl2_pos, 0, (tensor->lvl1_size + 1) * sizeof(index_t));
 }
 
+// Exactly dim2_nnz distinct non-zeros per row, sorted by column
 struct csr *generate_csr(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
-  srand(seed);
-
   struct csr *tensor = malloc(sizeof(struct csr));
   tensor->lvl1_size = ndim1;
-  tensor->lvl1_pos = malloc((ndim1 + 1) * sizeof(size_t));
+  tensor->lvl1_pos = malloc((ndim1 + 1) * sizeof(index_t));
   tensor->lvl1_pos[0] = 0;
 
   size_t dim2_nnz = (size_t)(ndim2 * sparsity);
@@ -118,24 +218,19 @@ struct csr *generate_csr(size_t ndim1, size_t ndim2, double sparsity, unsigned i
 
   tensor->lvl2_size = ndim2;
   tensor->lvl2_nnz = ndim1 * dim2_nnz;
-  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(size_t));
-  tensor->vals = calloc(tensor->lvl2_nnz, sizeof(double));
-
-  for (size_t lvl1_idx = 0; lvl1_idx < ndim1; ++lvl1_idx) {
-    // Generate exactly dim2_nnz non-zeros per row
-    for (size_t dim2_n = 0; dim2_n < dim2_nnz; ++dim2_n) {
-      size_t lvl2_idx = lvl1_idx * dim2_nnz + dim2_n;
-      tensor->lvl2_crd[lvl2_idx] = rand_uniform(ndim2);
-      tensor->vals[lvl2_idx] = rand_double();
-    }
+  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(index_t));
+  tensor->vals = calloc(tensor->lvl2_nnz, sizeof(value_t));
+  tensor->mapping = NULL;
+  tensor->mapping_size = 0;
+
+  for (size_t lvl1_idx = 0; lvl1_idx < ndim1; ++lvl1_idx)
     tensor->lvl1_pos[lvl1_idx + 1] = (lvl1_idx + 1) * dim2_nnz;
-  }
+  fill_slices(seed, 2, ndim1, dim2_nnz, ndim2, tensor->lvl2_crd, tensor->vals);
   return tensor;
 }
 
+// Every slice holds dim2_nnz distinct fibers and every fiber dim3_nnz distinct elements, both sorted
 struct csf *generate_csf(size_t ndim1, size_t ndim2, size_t ndim3, double sparsity, unsigned int seed) {
-  srand(seed);
-
   size_t dim2_nnz = ndim2 * sparsity;
   if (dim2_nnz < 1)
     dim2_nnz = 1;
@@ -150,35 +245,845 @@ struct csf *generate_csf(size_t ndim1, size_t ndim2, size_t ndim3, double sparsi
 
   struct csf *tensor = malloc(sizeof(struct csf));
   tensor->lvl1_size = ndim1;
-  tensor->lvl1_pos = malloc((ndim1 + 1) * sizeof(size_t));
+  tensor->lvl1_pos = malloc((ndim1 + 1) * sizeof(index_t));
   tensor->lvl1_pos[0] = 0;
 
   tensor->lvl2_size = ndim2;
   tensor->lvl2_nnz = ndim1 * dim2_nnz; // total fibers
-  tensor->lvl2_pos = malloc((tensor->lvl2_nnz + 1) * sizeof(size_t));
+  tensor->lvl2_pos = malloc((tensor->lvl2_nnz + 1) * sizeof(index_t));
   tensor->lvl2_pos[0] = 0;
-  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(size_t));
+  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(index_t));
 
   tensor->lvl3_size = ndim3;
   tensor->lvl3_nnz = tensor->lvl2_nnz * dim3_nnz; // total elements
-  tensor->lvl3_crd = malloc(tensor->lvl3_nnz * sizeof(size_t));
-  tensor->vals = calloc(tensor->lvl3_nnz, sizeof(double));
-
-  for (size_t lvl1_idx = 0; lvl1_idx < ndim1; ++lvl1_idx) {
-    // Generate exactly lvl2_fiber_nnz fibers per slice
-    for (size_t dim2_n = 0; dim2_n < dim2_nnz; ++dim2_n) {
-      size_t lvl2_idx = lvl1_idx * dim2_nnz + dim2_n;
-      tensor->lvl2_crd[lvl2_idx] = rand_uniform(ndim2);
-      // Generate exactly lvl3_row_nnz elements per fiber
-      for (size_t dim3_n = 0; dim3_n < dim3_nnz; ++dim3_n) {
-        size_t lvl3_idx = lvl2_idx * dim3_nnz + dim3_n;
-        tensor->lvl3_crd[lvl3_idx] = rand_uniform(ndim3);
-        tensor->vals[lvl3_idx] = rand_double();
+  tensor->lvl3_crd = malloc(tensor->lvl3_nnz * sizeof(index_t));
+  tensor->vals = calloc(tensor->lvl3_nnz, sizeof(value_t));
+  tensor->mapping = NULL;
+  tensor->mapping_size = 0;
+
+  for (size_t lvl1_idx = 0; lvl1_idx < ndim1; ++lvl1_idx)
+    tensor->lvl1_pos[lvl1_idx + 1] = (lvl1_idx + 1) * dim2_nnz;
+  for (size_t lvl2_idx = 0; lvl2_idx < tensor->lvl2_nnz; ++lvl2_idx)
+    tensor->lvl2_pos[lvl2_idx + 1] = (lvl2_idx + 1) * dim3_nnz;
+  fill_slices(seed, 2, ndim1, dim2_nnz, ndim2, tensor->lvl2_crd, NULL);
+  fill_slices(seed, 3, tensor->lvl2_nnz, dim3_nnz, ndim3, tensor->lvl3_crd, tensor->vals);
+
+  return tensor;
+}
+// Structured workloads: an ndim1 x ndim2 matrix generated row by row, with generate_csr's ndim1 * ndim2 * sparsity
+// non-zeros (at least one per row) arranged as the enum workload says; columns are distinct and sorted
+static const char *const WORKLOAD_NAMES[NUM_WORKLOADS] = {"uniform", "power_law", "banded", "block_diagonal"};
+
+// Zipf exponent of the power-law row degrees: the rank-k row gets a share proportional to (k + 1)^-POWER_LAW_EXPONENT
+#define POWER_LAW_EXPONENT 1.0
+
+// Power-law row degrees in pos adding up to ndim1 * row_nnz: the scale of the Zipf shares is bisected so the degrees,
+// clamped to [1, ndim2], reach that total, the heaviest rows give back the rounding excess, and the ranks go to the
+// rows in a random order
+static void power_law_pos(size_t ndim1, size_t ndim2, size_t row_nnz, unsigned int seed, index_t *pos) {
+  size_t total = ndim1 * row_nnz;
+  double *share = malloc(ndim1 * sizeof(double));
+  size_t *degree = malloc(ndim1 * sizeof(size_t));
+  for (size_t k = 0; k < ndim1; ++k)
+    share[k] = pow((double)(k + 1), -POWER_LAW_EXPONENT);
+
+  double lo = 0, hi = ndim2 * pow((double)ndim1, POWER_LAW_EXPONENT);
+  for (int iter = 0; iter < 64; ++iter) {
+    double scale = (lo + hi) / 2;
+    size_t sum = 0;
+    for (size_t k = 0; k < ndim1; ++k) {
+      double d = share[k] * scale;
+      sum += d < 1 ? 1 : d > ndim2 ? ndim2 : (size_t)d;
+    }
+    if (sum >= total)
+      hi = scale;
+    else
+      lo = scale;
+  }
+  size_t sum = 0;
+  for (size_t k = 0; k < ndim1; ++k) {
+    double d = share[k] * hi;
+    degree[k] = d < 1 ? 1 : d > ndim2 ? ndim2 : (size_t)d;
+    sum += degree[k];
+  }
+  for (size_t k = 0; sum > total; k = k + 1 < ndim1 ? k + 1 : 0)
+    if (degree[k] > 1) {
+      --degree[k];
+      --sum;
+    }
+
+  struct rng rng = rng_stream(seed, 1, 0);
+  for (size_t k = ndim1; k > 1; --k) {
+    size_t other = rng_uniform(&rng, k);
+    size_t tmp = degree[k - 1];
+    degree[k - 1] = degree[other];
+    degree[other] = tmp;
+  }
+  pos[0] = 0;
+  for (size_t row = 0; row < ndim1; ++row)
+    pos[row + 1] = pos[row] + degree[row];
+  free(degree);
+  free(share);
+}
+
+// Row r of the workload gets pos[r + 1] - pos[r] sorted, distinct columns of the width columns starting at offset[r]
+// (banded: a band twice as wide as the row's entries around the diagonal; block-diagonal: column blocks of at least
+// twice the row's entries matched to row blocks) and as many values, all drawn from stream (seed, 2, r)
+struct csr *generate_csr_workload(int workload, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
+  size_t row_nnz = (size_t)(ndim2 * sparsity);
+  if (row_nnz < 1)
+    row_nnz = 1;
+  if (row_nnz > ndim2)
+    row_nnz = ndim2;
+
+  struct csr *tensor = allocate_csr(ndim1, ndim2, 0);
+  index_t *pos = tensor->lvl1_pos;
+  index_t *offset = calloc(ndim1, sizeof(index_t));
+  size_t width = ndim2;
+  if (workload == WORKLOAD_POWER_LAW) {
+    power_law_pos(ndim1, ndim2, row_nnz, seed, pos);
+  } else {
+    for (size_t row = 0; row <= ndim1; ++row)
+      pos[row] = row * row_nnz;
+  }
+  if (workload == WORKLOAD_BANDED) {
+    width = 2 * row_nnz < ndim2 ? 2 * row_nnz : ndim2;
+    for (size_t row = 0; row < ndim1; ++row) {
+      size_t center = (2 * row + 1) * ndim2 / (2 * ndim1);
+      size_t start = center > width / 2 ? center - width / 2 : 0;
+      offset[row] = start < ndim2 - width ? start : ndim2 - width;
+    }
+  } else if (workload == WORKLOAD_BLOCK_DIAGONAL) {
+    size_t num_blocks = ndim2 / (2 * row_nnz);
+    if (num_blocks < 1)
+      num_blocks = 1;
+    width = ndim2 / num_blocks;
+    for (size_t row = 0; row < ndim1; ++row)
+      offset[row] = row * num_blocks / ndim1 * width;
+  }
+  reserve_csr(tensor, pos[ndim1]);
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+  {
+    uint64_t *bitmap = calloc((width + 63) / 64, sizeof(uint64_t));
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 64)
+#endif
+    for (size_t row = 0; row < ndim1; ++row) {
+      struct rng rng = rng_stream(seed, 2, row);
+      sample_sorted(&rng, width, pos[row + 1] - pos[row], bitmap, tensor->lvl2_crd + pos[row]);
+      for (size_t e = pos[row]; e < pos[row + 1]; ++e) {
+        tensor->lvl2_crd[e] += offset[row];
+        tensor->vals[e] = rng_value(&rng);
       }
-      tensor->lvl2_pos[lvl2_idx + 1] = (lvl2_idx + 1) * dim3_nnz;
     }
-    tensor->lvl1_pos[lvl1_idx + 1] = (lvl1_idx + 1) * dim2_nnz;
+    free(bitmap);
+  }
+  free(offset);
+  return tensor;
+}
+
+// ndim1 x ndim2 matrix with the pattern of the transpose of generate_csr_workload(workload, ndim2, ndim1, sparsity,
+// pattern_seed) and values drawn from seed: as the C of hadamard_transpose for that B, every entry of B meets one of C
+struct csr *generate_csr_transposed(int workload, size_t ndim1, size_t ndim2, double sparsity,
+                                    unsigned int pattern_seed, unsigned int seed) {
+  struct csr *pattern = generate_csr_workload(workload, ndim2, ndim1, sparsity, pattern_seed);
+  struct csr *tensor = allocate_csr(ndim1, ndim2, 0);
+  reserve_csr(tensor, pattern->lvl2_nnz);
+
+  // Counting sort by column; scanning the pattern's rows in order leaves every row of the result sorted
+  index_t *pos = tensor->lvl1_pos;
+  memset(pos, 0, (ndim1 + 1) * sizeof(index_t));
+  for (size_t e = 0; e < pattern->lvl2_nnz; ++e)
+    ++pos[pattern->lvl2_crd[e] + 1];
+  for (size_t row = 0; row < ndim1; ++row)
+    pos[row + 1] += pos[row];
+  for (size_t col = 0; col < ndim2; ++col) {
+    struct rng rng = rng_stream(seed, 2, col);
+    for (size_t e = pattern->lvl1_pos[col]; e < pattern->lvl1_pos[col + 1]; ++e) {
+      size_t dst = pos[pattern->lvl2_crd[e]]++;
+      tensor->lvl2_crd[dst] = col;
+      tensor->vals[dst] = rng_value(&rng);
+    }
+  }
+  memmove(pos + 1, pos, ndim1 * sizeof(index_t));
+  pos[0] = 0;
+  free_csr(pattern);
+  return tensor;
+}
+
+// Binary tensor files (see struct tensor_file_header)
+struct section {
+  const void *data;
+  size_t bytes;
+};
+
+static inline size_t round_up(size_t bytes, size_t align) {
+  return (bytes + align - 1) & ~(align - 1);
+}
+
+// Write the header and sections to a temporary file next to path and rename it into place, so concurrent readers of
+// path see either no file or a complete one. Returns 0 on success, -1 (with errno set) on failure.
+static int write_tensor_file(const char *path, struct tensor_file_header *header, const struct section *sections,
+                             size_t num_sections) {
+  memcpy(header->magic, TENSOR_FILE_MAGIC, sizeof(header->magic));
+  header->version = TENSOR_FILE_VERSION;
+  header->index_bytes = sizeof(index_t);
+  header->value_bytes = sizeof(value_t);
+
+  size_t offset = round_up(sizeof(*header), TENSOR_FILE_ALIGN);
+  for (size_t s = 0; s < num_sections; ++s) {
+    header->offset[s] = offset;
+    header->bytes[s] = sections[s].bytes;
+    offset += round_up(sections[s].bytes, TENSOR_FILE_ALIGN);
+  }
+
+  char tmp_path[PATH_MAX];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(tmp_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  FILE *file = fopen(tmp_path, "wb");
+  if (!file)
+    return -1;
+
+  static const char padding[TENSOR_FILE_ALIGN] = {0};
+  bool ok = fwrite(header, sizeof(*header), 1, file) == 1;
+  size_t written = sizeof(*header);
+  for (size_t s = 0; ok && s < num_sections; ++s) {
+    size_t pad = header->offset[s] - written;
+    ok = fwrite(padding, 1, pad, file) == pad;
+    if (ok && sections[s].bytes > 0)
+      ok = fwrite(sections[s].data, 1, sections[s].bytes, file) == sections[s].bytes;
+    written = header->offset[s] + sections[s].bytes;
+  }
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    int err = errno;
+    unlink(tmp_path);
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+int save_dense(struct dense *tensor, const char *path) {
+  struct tensor_file_header header = {.format = TENSOR_FILE_DENSE, .sizes = {tensor->size}};
+  struct section sections[] = {{tensor->vals, tensor->size * sizeof(value_t)}};
+  return write_tensor_file(path, &header, sections, 1);
+}
+
+int save_csr(struct csr *tensor, const char *path) {
+  struct tensor_file_header header = {.format = TENSOR_FILE_CSR,
+                                      .sizes = {tensor->lvl1_size, tensor->lvl2_size, tensor->lvl2_nnz}};
+  struct section sections[] = {
+      {tensor->lvl1_pos, (tensor->lvl1_size + 1) * sizeof(index_t)},
+      {tensor->lvl2_crd, tensor->lvl2_nnz * sizeof(index_t)},
+      {tensor->vals, tensor->lvl2_nnz * sizeof(value_t)},
+  };
+  return write_tensor_file(path, &header, sections, 3);
+}
+
+int save_csf(struct csf *tensor, const char *path) {
+  struct tensor_file_header header = {
+      .format = TENSOR_FILE_CSF,
+      .sizes = {tensor->lvl1_size, tensor->lvl2_size, tensor->lvl2_nnz, tensor->lvl3_size, tensor->lvl3_nnz}};
+  struct section sections[] = {
+      {tensor->lvl1_pos, (tensor->lvl1_size + 1) * sizeof(index_t)},
+      {tensor->lvl2_pos, (tensor->lvl2_nnz + 1) * sizeof(index_t)},
+      {tensor->lvl2_crd, tensor->lvl2_nnz * sizeof(index_t)},
+      {tensor->lvl3_crd, tensor->lvl3_nnz * sizeof(index_t)},
+      {tensor->vals, tensor->lvl3_nnz * sizeof(value_t)},
+  };
+  return write_tensor_file(path, &header, sections, 5);
+}
+
+// Map path privately (writes such as reset_* are copied on write and never reach the file) and check that it holds
+// a tensor of the given format whose sections lie inside the file. Returns the header at the start of the mapping.
+static struct tensor_file_header *map_tensor_file(const char *path, uint32_t format, size_t num_sections,
+                                                  size_t *map_size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct tensor_file_header)) {
+    close(fd);
+    return NULL;
+  }
+
+  int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+  // Fault the pages in now rather than inside the first timed kernel call
+  flags |= MAP_POPULATE;
+#endif
+  void *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, flags, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  size_t size = st.st_size;
+  struct tensor_file_header *header = base;
+  bool ok = memcmp(header->magic, TENSOR_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+            header->version == TENSOR_FILE_VERSION && header->format == format &&
+            header->index_bytes == sizeof(index_t) && header->value_bytes == sizeof(value_t);
+  for (size_t s = 0; ok && s < num_sections; ++s)
+    ok = header->offset[s] % TENSOR_FILE_ALIGN == 0 && header->offset[s] <= size &&
+         header->bytes[s] <= size - header->offset[s];
+  if (!ok) {
+    munmap(base, size);
+    return NULL;
   }
+  *map_size = size;
+  return header;
+}
 
+// Address of section s if it holds exactly bytes, NULL otherwise
+static void *section_at(struct tensor_file_header *header, size_t s, size_t bytes) {
+  return header->bytes[s] == bytes ? (char *)header + header->offset[s] : NULL;
+}
+
+// NULL if the file is missing, truncated, of another format or written with another INDEX_BITS / value type
+struct dense *load_dense(const char *path) {
+  size_t map_size;
+  struct tensor_file_header *header = map_tensor_file(path, TENSOR_FILE_DENSE, 1, &map_size);
+  if (!header)
+    return NULL;
+  value_t *vals = section_at(header, 0, header->sizes[0] * sizeof(value_t));
+  if (!vals) {
+    munmap(header, map_size);
+    return NULL;
+  }
+
+  struct dense *tensor = malloc(sizeof(struct dense));
+  tensor->size = header->sizes[0];
+  tensor->vals = vals;
+  tensor->mapping = header;
+  tensor->mapping_size = map_size;
   return tensor;
-}
\ No newline at end of file
+}
+
+struct csr *load_csr(const char *path) {
+  size_t map_size;
+  struct tensor_file_header *header = map_tensor_file(path, TENSOR_FILE_CSR, 3, &map_size);
+  if (!header)
+    return NULL;
+  size_t lvl1_size = header->sizes[0];
+  size_t lvl2_nnz = header->sizes[2];
+  index_t *lvl1_pos = section_at(header, 0, (lvl1_size + 1) * sizeof(index_t));
+  index_t *lvl2_crd = section_at(header, 1, lvl2_nnz * sizeof(index_t));
+  value_t *vals = section_at(header, 2, lvl2_nnz * sizeof(value_t));
+  if (!lvl1_pos || !lvl2_crd || !vals) {
+    munmap(header, map_size);
+    return NULL;
+  }
+
+  struct csr *tensor = malloc(sizeof(struct csr));
+  tensor->lvl1_size = lvl1_size;
+  tensor->lvl1_pos = lvl1_pos;
+  tensor->lvl2_size = header->sizes[1];
+  tensor->lvl2_nnz = lvl2_nnz;
+  tensor->lvl2_crd = lvl2_crd;
+  tensor->vals = vals;
+  tensor->mapping = header;
+  tensor->mapping_size = map_size;
+  return tensor;
+}
+
+struct csf *load_csf(const char *path) {
+  size_t map_size;
+  struct tensor_file_header *header = map_tensor_file(path, TENSOR_FILE_CSF, 5, &map_size);
+  if (!header)
+    return NULL;
+  size_t lvl1_size = header->sizes[0];
+  size_t lvl2_nnz = header->sizes[2];
+  size_t lvl3_nnz = header->sizes[4];
+  index_t *lvl1_pos = section_at(header, 0, (lvl1_size + 1) * sizeof(index_t));
+  index_t *lvl2_pos = section_at(header, 1, (lvl2_nnz + 1) * sizeof(index_t));
+  index_t *lvl2_crd = section_at(header, 2, lvl2_nnz * sizeof(index_t));
+  index_t *lvl3_crd = section_at(header, 3, lvl3_nnz * sizeof(index_t));
+  value_t *vals = section_at(header, 4, lvl3_nnz * sizeof(value_t));
+  if (!lvl1_pos || !lvl2_pos || !lvl2_crd || !lvl3_crd || !vals) {
+    munmap(header, map_size);
+    return NULL;
+  }
+
+  struct csf *tensor = malloc(sizeof(struct csf));
+  tensor->lvl1_size = lvl1_size;
+  tensor->lvl1_pos = lvl1_pos;
+  tensor->lvl2_size = header->sizes[1];
+  tensor->lvl2_nnz = lvl2_nnz;
+  tensor->lvl2_pos = lvl2_pos;
+  tensor->lvl2_crd = lvl2_crd;
+  tensor->lvl3_size = header->sizes[3];
+  tensor->lvl3_nnz = lvl3_nnz;
+  tensor->lvl3_crd = lvl3_crd;
+  tensor->vals = vals;
+  tensor->mapping = header;
+  tensor->mapping_size = map_size;
+  return tensor;
+}
+
+// A cache that cannot be written only costs the next run a regeneration, so failures are reported and ignored
+static bool cache_dir_ready(const char *dir) {
+  if (mkdir(dir, 0777) == 0 || errno == EEXIST)
+    return true;
+  fprintf(stderr, "Warning: cannot create tensor cache %s: %s\n", dir, strerror(errno));
+  return false;
+}
+
+// status is the result of save_*
+static bool cache_saved(const char *path, int status) {
+  if (status != 0)
+    fprintf(stderr, "Warning: cannot save %s: %s\n", path, strerror(errno));
+  return status == 0;
+}
+
+// dir/<name>_<tag>.bin into path (PATH_MAX bytes), the tag naming INDEX_BITS, the value width and GENERATOR_VERSION;
+// false if it does not fit
+static bool cache_path(char *path, const char *dir, const char *name_fmt, ...) {
+  char name[PATH_MAX];
+  va_list args;
+  va_start(args, name_fmt);
+  int len = vsnprintf(name, sizeof(name), name_fmt, args);
+  va_end(args);
+  return len < (int)sizeof(name) && snprintf(path, PATH_MAX, "%s/%s_idx%d_f%d_g%d.bin", dir, name, INDEX_BITS,
+                                             (int)(8 * sizeof(value_t)), GENERATOR_VERSION) < PATH_MAX;
+}
+
+// On a miss the generated tensor is saved and mapped back, so every run benchmarks the same backing
+
+static struct csr *cache_store_csr(const char *dir, const char *path, struct csr *tensor) {
+  struct csr *loaded = cache_dir_ready(dir) && cache_saved(path, save_csr(tensor, path)) ? load_csr(path) : NULL;
+  if (!loaded)
+    return tensor;
+  free_csr(tensor);
+  return loaded;
+}
+
+static struct csf *cache_store_csf(const char *dir, const char *path, struct csf *tensor) {
+  struct csf *loaded = cache_dir_ready(dir) && cache_saved(path, save_csf(tensor, path)) ? load_csf(path) : NULL;
+  if (!loaded)
+    return tensor;
+  free_csf(tensor);
+  return loaded;
+}
+
+// generate_* backed by the cache directory dir: map the tensor if an earlier run saved it, otherwise generate and store
+// it. A NULL dir generates without caching.
+struct csr *cached_csr(const char *dir, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "csr_%zux%zu_sp%g_seed%u", ndim1, ndim2, sparsity, seed))
+    return generate_csr(ndim1, ndim2, sparsity, seed);
+  struct csr *tensor = load_csr(path);
+  if (tensor)
+    return tensor;
+  return cache_store_csr(dir, path, generate_csr(ndim1, ndim2, sparsity, seed));
+}
+
+struct csf *cached_csf(const char *dir, size_t ndim1, size_t ndim2, size_t ndim3, double sparsity, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "csf_%zux%zux%zu_sp%g_seed%u", ndim1, ndim2, ndim3, sparsity, seed))
+    return generate_csf(ndim1, ndim2, ndim3, sparsity, seed);
+  struct csf *tensor = load_csf(path);
+  if (tensor)
+    return tensor;
+  return cache_store_csf(dir, path, generate_csf(ndim1, ndim2, ndim3, sparsity, seed));
+}
+
+struct csr *cached_csr_workload(const char *dir, int workload, size_t ndim1, size_t ndim2, double sparsity,
+                                unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir ||
+      !cache_path(path, dir, "csr_%s_%zux%zu_sp%g_seed%u", WORKLOAD_NAMES[workload], ndim1, ndim2, sparsity, seed))
+    return generate_csr_workload(workload, ndim1, ndim2, sparsity, seed);
+  struct csr *tensor = load_csr(path);
+  if (tensor)
+    return tensor;
+  return cache_store_csr(dir, path, generate_csr_workload(workload, ndim1, ndim2, sparsity, seed));
+}
+
+struct csr *cached_csr_transposed(const char *dir, int workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int pattern_seed, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "csr_%s_t_%zux%zu_sp%g_seed%u_%u", WORKLOAD_NAMES[workload], ndim1, ndim2,
+                          sparsity, pattern_seed, seed))
+    return generate_csr_transposed(workload, ndim1, ndim2, sparsity, pattern_seed, seed);
+  struct csr *tensor = load_csr(path);
+  if (tensor)
+    return tensor;
+  return cache_store_csr(dir, path, generate_csr_transposed(workload, ndim1, ndim2, sparsity, pattern_seed, seed));
+}
+
+// Matrix Market (.mtx) coordinate files
+enum mtx_symmetry { MTX_GENERAL, MTX_SYMMETRIC, MTX_SKEW_SYMMETRIC };
+
+struct mtx_header {
+  size_t nrows, ncols, nnz; // size line: entry lines in the file, before symmetric expansion
+  bool pattern;             // no value column
+  enum mtx_symmetry symmetry;
+};
+
+// Files below this many bytes per chunk are parsed with fewer chunks
+#define MTX_MIN_CHUNK_BYTES ((size_t)1 << 16)
+
+static inline const char *skip_blanks(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    ++p;
+  return p;
+}
+
+static inline const char *line_end(const char *p, const char *end) {
+  if (p >= end)
+    return end;
+  const char *newline = memchr(p, '\n', (size_t)(end - p));
+  return newline ? newline : end;
+}
+
+// Blank lines and % comments carry no entry
+static inline bool is_entry_line(const char *p, const char *end) {
+  p = skip_blanks(p, end);
+  return p < end && *p != '%' && *p != '\n';
+}
+
+// Copy the next whitespace-delimited token of [*p, end) into buf (NUL-terminated) and advance *p past it
+static bool next_token(const char **p, const char *end, char *buf, size_t len) {
+  const char *start = skip_blanks(*p, end);
+  const char *q = start;
+  while (q < end && *q != ' ' && *q != '\t' && *q != '\r' && *q != '\n')
+    ++q;
+  if (q == start || (size_t)(q - start) >= len)
+    return false;
+  memcpy(buf, start, q - start);
+  buf[q - start] = '\0';
+  *p = q;
+  return true;
+}
+
+static bool parse_size(const char **p, const char *end, size_t *out) {
+  const char *q = skip_blanks(*p, end);
+  if (q == end || *q < '0' || *q > '9')
+    return false;
+  size_t value = 0;
+  for (; q < end && *q >= '0' && *q <= '9'; ++q)
+    value = value * 10 + (*q - '0');
+  *p = q;
+  *out = value;
+  return true;
+}
+
+static bool parse_real(const char **p, const char *end, double *out) {
+  char buf[64];
+  char *parsed;
+  if (!next_token(p, end, buf, sizeof(buf)))
+    return false;
+  *out = strtod(buf, &parsed);
+  return *parsed == '\0';
+}
+
+// Parse the banner, comments and size line; returns the first byte after the size line, or NULL
+static const char *parse_mtx_header(const char *p, const char *end, struct mtx_header *header, const char *path) {
+  char object[32], format[32], field[32], symmetry[32];
+  const char *eol = line_end(p, end);
+  if (!next_token(&p, eol, object, sizeof(object)) || strcmp(object, "%%MatrixMarket") != 0 ||
+      !next_token(&p, eol, object, sizeof(object)) || !next_token(&p, eol, format, sizeof(format)) ||
+      !next_token(&p, eol, field, sizeof(field)) || !next_token(&p, eol, symmetry, sizeof(symmetry))) {
+    fprintf(stderr, "%s: missing %%%%MatrixMarket banner\n", path);
+    return NULL;
+  }
+  if (strcasecmp(object, "matrix") != 0 || strcasecmp(format, "coordinate") != 0) {
+    fprintf(stderr, "%s: only coordinate matrices are supported (got %s %s)\n", path, object, format);
+    return NULL;
+  }
+  header->pattern = strcasecmp(field, "pattern") == 0;
+  if (!header->pattern && strcasecmp(field, "real") != 0 && strcasecmp(field, "double") != 0 &&
+      strcasecmp(field, "integer") != 0) {
+    fprintf(stderr, "%s: unsupported field %s\n", path, field);
+    return NULL;
+  }
+  if (strcasecmp(symmetry, "general") == 0) {
+    header->symmetry = MTX_GENERAL;
+  } else if (strcasecmp(symmetry, "symmetric") == 0) {
+    header->symmetry = MTX_SYMMETRIC;
+  } else if (strcasecmp(symmetry, "skew-symmetric") == 0) {
+    header->symmetry = MTX_SKEW_SYMMETRIC;
+  } else {
+    fprintf(stderr, "%s: unsupported symmetry %s\n", path, symmetry);
+    return NULL;
+  }
+
+  // Comments run up to the size line
+  p = eol < end ? eol + 1 : end;
+  while (p < end && !is_entry_line(p, end)) {
+    eol = line_end(p, end);
+    p = eol < end ? eol + 1 : end;
+  }
+  eol = line_end(p, end);
+  if (!parse_size(&p, eol, &header->nrows) || !parse_size(&p, eol, &header->ncols) ||
+      !parse_size(&p, eol, &header->nnz)) {
+    fprintf(stderr, "%s: missing size line\n", path);
+    return NULL;
+  }
+  size_t max_index = INDEX_BITS == 32 ? UINT32_MAX : SIZE_MAX;
+  if (header->nrows > max_index || header->ncols > max_index) {
+    fprintf(stderr, "%s: %zu x %zu does not fit INDEX_BITS=%d\n", path, header->nrows, header->ncols, INDEX_BITS);
+    return NULL;
+  }
+  // Row positions count the entries of both triangles of symmetric files
+  size_t expand = header->symmetry == MTX_GENERAL ? 1 : 2;
+  if (header->nnz > max_index / expand) {
+    fprintf(stderr, "%s: %zu entries do not fit INDEX_BITS=%d\n", path, header->nnz, INDEX_BITS);
+    return NULL;
+  }
+  return eol < end ? eol + 1 : end;
+}
+
+static size_t count_entry_lines(const char *p, const char *end) {
+  size_t count = 0;
+  while (p < end) {
+    const char *eol = line_end(p, end);
+    count += is_entry_line(p, eol);
+    p = eol < end ? eol + 1 : end;
+  }
+  return count;
+}
+
+// Parse the entry lines of [p, end) into the 0-based rows/cols/vals arrays from position pos on; *emitted counts the
+// entries written (mirrored entries of symmetric files included)
+static bool parse_mtx_entries(const char *p, const char *end, const struct mtx_header *header, index_t *rows,
+                              index_t *cols, value_t *vals, size_t pos, size_t *emitted) {
+  size_t start = pos;
+  while (p < end) {
+    const char *eol = line_end(p, end);
+    if (is_entry_line(p, eol)) {
+      size_t row, col;
+      double val = 1.0;
+      if (!parse_size(&p, eol, &row) || !parse_size(&p, eol, &col) || row < 1 || row > header->nrows || col < 1 ||
+          col > header->ncols || (!header->pattern && !parse_real(&p, eol, &val)))
+        return false;
+
+      rows[pos] = row - 1;
+      cols[pos] = col - 1;
+      vals[pos] = (value_t)val;
+      ++pos;
+      if (header->symmetry != MTX_GENERAL && row != col) {
+        rows[pos] = col - 1;
+        cols[pos] = row - 1;
+        vals[pos] = (value_t)(header->symmetry == MTX_SKEW_SYMMETRIC ? -val : val);
+        ++pos;
+      }
+    }
+    p = eol < end ? eol + 1 : end;
+  }
+  *emitted = pos - start;
+  return true;
+}
+
+// Read a coordinate .mtx file into CSR (pattern files get value 1, symmetric files both triangles). The file is mapped
+// and split at line boundaries into chunks that are counted and parsed in parallel; rows are then counted in parallel
+// and filled in file order. NULL (after reporting why on stderr) for unsupported or malformed files.
+struct csr *read_mtx_csr(const char *path) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+    fprintf(stderr, "%s: %s\n", path, fd < 0 ? strerror(errno) : "empty file");
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  size_t size = st.st_size;
+  const char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+  const char *end = base + size;
+
+  struct mtx_header header;
+  const char *data = parse_mtx_header(base, end, &header, path);
+  if (!data) {
+    munmap((void *)base, size);
+    return NULL;
+  }
+
+  // Chunk boundaries move forward to the next line start, so every line belongs to exactly one chunk
+  size_t num_chunks = 1;
+#if defined(_OPENMP)
+  num_chunks = 4 * (size_t)omp_get_max_threads();
+#endif
+  if ((size_t)(end - data) < num_chunks * MTX_MIN_CHUNK_BYTES)
+    num_chunks = (end - data) / MTX_MIN_CHUNK_BYTES + 1;
+  const char **chunk = malloc((num_chunks + 1) * sizeof(*chunk));
+  size_t *lines = calloc(num_chunks + 1, sizeof(size_t));
+  size_t *emitted = calloc(num_chunks, sizeof(size_t));
+  chunk[0] = data;
+  chunk[num_chunks] = end;
+  for (size_t c = 1; c < num_chunks; ++c) {
+    const char *p = data + (end - data) * c / num_chunks;
+    if (p < chunk[c - 1])
+      p = chunk[c - 1];
+    if (p > data && p[-1] != '\n') {
+      p = line_end(p, end);
+      p = p < end ? p + 1 : end;
+    }
+    chunk[c] = p;
+  }
+
+  // Pass 1: entry lines per chunk, prefix-summed into each chunk's first line
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (size_t c = 0; c < num_chunks; ++c)
+    lines[c + 1] = count_entry_lines(chunk[c], chunk[c + 1]);
+  for (size_t c = 0; c < num_chunks; ++c)
+    lines[c + 1] += lines[c];
+
+  struct csr *tensor = NULL;
+  index_t *rows = NULL, *cols = NULL;
+  value_t *vals = NULL;
+  if (lines[num_chunks] != header.nnz) {
+    fprintf(stderr, "%s: size line announces %zu entries, found %zu\n", path, header.nnz, lines[num_chunks]);
+    goto done;
+  }
+
+  // Pass 2: parse each chunk into its own range (room for both triangles)
+  size_t expand = header.symmetry == MTX_GENERAL ? 1 : 2;
+  rows = malloc(expand * header.nnz * sizeof(index_t));
+  cols = malloc(expand * header.nnz * sizeof(index_t));
+  vals = malloc(expand * header.nnz * sizeof(value_t));
+  bool failed = false;
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1) reduction(|| : failed)
+#endif
+  for (size_t c = 0; c < num_chunks; ++c)
+    failed = !parse_mtx_entries(chunk[c], chunk[c + 1], &header, rows, cols, vals, expand * lines[c], &emitted[c]) ||
+             failed;
+  if (failed) {
+    fprintf(stderr, "%s: malformed or out-of-range entry\n", path);
+    goto done;
+  }
+
+  size_t nnz = 0;
+  for (size_t c = 0; c < num_chunks; ++c)
+    nnz += emitted[c];
+  tensor = allocate_csr(header.nrows, header.ncols, 0);
+  reserve_csr(tensor, nnz);
+  memset(tensor->lvl1_pos, 0, (header.nrows + 1) * sizeof(index_t));
+
+  // Entries per row, then a stable fill so every row keeps the file's order
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (size_t c = 0; c < num_chunks; ++c) {
+    for (size_t k = expand * lines[c]; k < expand * lines[c] + emitted[c]; ++k) {
+#if defined(_OPENMP)
+#pragma omp atomic
+#endif
+      ++tensor->lvl1_pos[rows[k] + 1];
+    }
+  }
+  for (size_t i = 0; i < header.nrows; ++i)
+    tensor->lvl1_pos[i + 1] += tensor->lvl1_pos[i];
+  index_t *cursor = malloc(header.nrows * sizeof(index_t));
+  memcpy(cursor, tensor->lvl1_pos, header.nrows * sizeof(index_t));
+  for (size_t c = 0; c < num_chunks; ++c) {
+    for (size_t k = expand * lines[c]; k < expand * lines[c] + emitted[c]; ++k) {
+      index_t dst = cursor[rows[k]]++;
+      tensor->lvl2_crd[dst] = cols[k];
+      tensor->vals[dst] = vals[k];
+    }
+  }
+  free(cursor);
+
+done:
+  free(rows);
+  free(cols);
+  free(vals);
+  free(chunk);
+  free(lines);
+  free(emitted);
+  munmap((void *)base, size);
+  return tensor;
+}
+
+// Longest formatted entry line: two 20-digit coordinates, a value and separators
+#define MTX_LINE_MAX 96
+
+// Write a CSR matrix as a "coordinate real general" .mtx file, formatting row blocks in parallel and replacing path
+// atomically. Blocks go in rounds of one per thread into buffers reused across rounds, so memory stays bounded by the
+// largest blocks rather than the matrix. Returns 0 on success, -1 (with errno set) on failure.
+int write_mtx_csr(struct csr *tensor, const char *path) {
+  char tmp_path[PATH_MAX];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(tmp_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  FILE *file = fopen(tmp_path, "w");
+  if (!file)
+    return -1;
+  bool ok = fprintf(file, "%%%%MatrixMarket matrix coordinate real general\n%zu %zu %zu\n", tensor->lvl1_size,
+                    tensor->lvl2_size, (size_t)tensor->lvl1_pos[tensor->lvl1_size]) > 0;
+
+  // Each block of rows of a round formats into its slot's buffer; the slots are written in row order
+  const size_t block_rows = 1024;
+  size_t num_blocks = (tensor->lvl1_size + block_rows - 1) / block_rows;
+  size_t slots = 1;
+#if defined(_OPENMP)
+  slots = (size_t)omp_get_max_threads();
+#endif
+  char **buffer = calloc(slots, sizeof(char *));
+  size_t *capacity = calloc(slots, sizeof(size_t));
+  size_t *length = calloc(slots, sizeof(size_t));
+  int digits = sizeof(value_t) == sizeof(float) ? 9 : 17;
+  for (size_t round = 0; ok && round < num_blocks; round += slots) {
+    size_t round_blocks = round + slots < num_blocks ? slots : num_blocks - round;
+    bool failed = false;
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1) reduction(|| : failed)
+#endif
+    for (size_t slot = 0; slot < round_blocks; ++slot) {
+      size_t first = (round + slot) * block_rows;
+      size_t last = first + block_rows < tensor->lvl1_size ? first + block_rows : tensor->lvl1_size;
+      size_t entries = tensor->lvl1_pos[last] - tensor->lvl1_pos[first];
+      if (entries * MTX_LINE_MAX + 1 > capacity[slot]) {
+        char *grown = realloc(buffer[slot], entries * MTX_LINE_MAX + 1);
+        if (!grown) {
+          failed = true;
+          continue;
+        }
+        buffer[slot] = grown;
+        capacity[slot] = entries * MTX_LINE_MAX + 1;
+      }
+      char *out = buffer[slot];
+      size_t len = 0;
+      for (size_t i = first; i < last; ++i)
+        for (size_t k = tensor->lvl1_pos[i]; k < tensor->lvl1_pos[i + 1]; ++k)
+          len += snprintf(out + len, MTX_LINE_MAX, "%zu %zu %.*g\n", i + 1, (size_t)tensor->lvl2_crd[k] + 1, digits,
+                          (double)tensor->vals[k]);
+      length[slot] = len;
+    }
+    if (failed) {
+      errno = ENOMEM;
+      ok = false;
+    }
+    for (size_t slot = 0; ok && slot < round_blocks; ++slot)
+      ok = fwrite(buffer[slot], 1, length[slot], file) == length[slot];
+  }
+  for (size_t slot = 0; slot < slots; ++slot)
+    free(buffer[slot]);
+  free(buffer);
+  free(capacity);
+  free(length);
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    int err = errno;
+    unlink(tmp_path);
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,116 @@
+#define _GNU_SOURCE // sched_getcpu
+#include "bench_harness.h"
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+double get_time_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+double env_or(const char *name, double fallback) {
+  const char *value = getenv(name);
+  return value && *value ? atof(value) : fallback;
+}
+
+struct timing_options timing_options(int warmup, double target_cv, double time_budget_ms) {
+  struct timing_options options = {(int)env_or("BENCH_WARMUP", warmup), env_or("BENCH_TARGET_CV", target_cv),
+                                   env_or("BENCH_TIME_BUDGET_MS", time_budget_ms)};
+  return options;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static struct timing summarize(double *samples, int runs) {
+  struct timing t = {.runs = runs};
+  for (int r = 0; r < runs; ++r)
+    t.mean += samples[r];
+  t.mean /= runs;
+  for (int r = 0; r < runs; ++r)
+    t.stddev += (samples[r] - t.mean) * (samples[r] - t.mean);
+  t.stddev = runs > 1 ? sqrt(t.stddev / (runs - 1)) : 0.0;
+
+  qsort(samples, runs, sizeof(double), compare_doubles);
+  t.min = samples[0];
+  t.median = runs % 2 ? samples[runs / 2] : (samples[runs / 2 - 1] + samples[runs / 2]) / 2;
+  t.p90 = samples[(int)ceil(0.9 * runs) - 1];
+  return t;
+}
+
+struct timing time_runs(const struct timing_options *options, void (*reset)(void *), void (*run)(void *), void *arg) {
+  // Warmup
+  for (int w = 0; w < options->warmup; ++w) {
+    if (reset)
+      reset(arg);
+    run(arg);
+  }
+
+  // Benchmark runs, with running sums for the coefficient of variation
+  static double samples[MAX_RUNS];
+  double sum = 0.0, sum_sq = 0.0;
+  double budget_end = get_time_us() + options->time_budget_ms * 1e3;
+  int runs = 0;
+  while (runs < MAX_RUNS) {
+    if (reset)
+      reset(arg);
+    double start = get_time_us();
+    run(arg);
+    double end = get_time_us();
+    double ms = (end - start) / 1e3;
+    samples[runs++] = ms;
+    sum += ms;
+    sum_sq += ms * ms;
+
+    if (runs >= MIN_RUNS) {
+      double mean = sum / runs;
+      double variance = fmax(0.0, (sum_sq - runs * mean * mean) / (runs - 1));
+      if ((mean > 0.0 && sqrt(variance) / mean <= options->target_cv) || end >= budget_end)
+        break;
+    }
+  }
+
+  return summarize(samples, runs);
+}
+
+const char *pinning(void) {
+#if defined(_OPENMP)
+  switch (omp_get_proc_bind()) {
+  case omp_proc_bind_false:
+    return "none";
+  case omp_proc_bind_close:
+    return "compact";
+  case omp_proc_bind_spread:
+    return "scatter";
+  default:
+    return "primary";
+  }
+#else
+  return "none";
+#endif
+}
+
+void thread_cpus(int threads, char *cpus, size_t len) {
+  int cpu[MAX_SCALING_THREADS];
+#if defined(_OPENMP)
+#pragma omp parallel num_threads(threads)
+  cpu[omp_get_thread_num()] = sched_getcpu();
+#else
+  threads = 1;
+  cpu[0] = sched_getcpu();
+#endif
+  size_t used = 0;
+  cpus[0] = '\0';
+  for (int t = 0; t < threads && used < len; ++t)
+    used += snprintf(cpus + used, len - used, "%s%d", t ? ";" : "", cpu[t]);
+}
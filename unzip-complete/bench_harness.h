@@ -0,0 +1,49 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stddef.h>
+
+// What every benchmark binary shares (hadamard_transpose_bench.c, kernels_bench.c and baseline-finch's
+// unzip_kernels_bench.c): the clock, numeric environment overrides, the adaptive timing loop and where the threads of
+// the scaling runs are placed.
+
+// Wall-clock time in microseconds from the raw monotonic clock: nanosecond resolution, system time included and no NTP
+// slewing. Wall-clock time also suits the parallel runs, where CPU time would add up over threads.
+double get_time_us(void);
+
+// $name as a number, or fallback when it is unset or empty
+double env_or(const char *name, double fallback);
+
+// Timed calls per kernel: warmup untimed ones, then at least MIN_RUNS timed ones, then more until their coefficient of
+// variation drops to target_cv, time_budget_ms is spent or MAX_RUNS is reached
+#define MIN_RUNS 3
+#define MAX_RUNS 1000
+
+struct timing_options {
+  int warmup;
+  double target_cv, time_budget_ms;
+};
+
+// The given defaults, overridden by $BENCH_WARMUP, $BENCH_TARGET_CV and $BENCH_TIME_BUDGET_MS
+struct timing_options timing_options(int warmup, double target_cv, double time_budget_ms);
+
+// Distribution of the timed calls of one kernel, in milliseconds
+struct timing {
+  double mean, min, median, p90, stddev;
+  int runs;
+};
+
+// Time calls of run(arg) under options; reset(arg), when given, runs untimed before every call
+struct timing time_runs(const struct timing_options *options, void (*reset)(void *), void (*run)(void *), void *arg);
+
+// Most threads a scaling run places
+#define MAX_SCALING_THREADS 256
+
+// Pinning OpenMP gives the threads: compact for close binding, scatter for spread, none when they float (or without
+// OpenMP)
+const char *pinning(void);
+
+// CPU each thread of a team of threads (at most MAX_SCALING_THREADS) runs on, ';'-separated in thread order
+void thread_cpus(int threads, char *cpus, size_t len);
+
+#endif /* BENCH_HARNESS_H */
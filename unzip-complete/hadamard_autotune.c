@@ -0,0 +1,719 @@
+#include "hadamard_autotune.h"
+#include "bench_harness.h"
+#include "tensor_io.h"
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// Cost model
+// =============================================================================
+
+void default_cost_model(struct cost_model *model) {
+  for (size_t v = 0; v < MAX_HADAMARD_VARIANTS; ++v)
+    for (size_t f = 0; f < COST_FEATURES; ++f)
+      model->kernel_ns[v][f] = 1.0;
+  model->to_coo_ns = 2.0;
+  model->from_coo_ns = 10.0;
+  model->sort_ns = 15.0;
+  model->index_ns = 20.0;
+}
+
+int load_cost_model(struct cost_model *model, const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return -1;
+
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    char kind[16], name[64];
+    double w[COST_FEATURES];
+    if (sscanf(line, "kernel %63s %lf %lf %lf %lf", name, &w[0], &w[1], &w[2], &w[3]) == 1 + COST_FEATURES) {
+      const struct hadamard_variant *variant = find_hadamard_variant_named(name);
+      if (variant)
+        memcpy(model->kernel_ns[variant - hadamard_variants], w, sizeof(w));
+    } else if (sscanf(line, "convert %15s %lf", kind, &w[0]) == 2) {
+      if (strcmp(kind, "to_coo") == 0)
+        model->to_coo_ns = w[0];
+      else if (strcmp(kind, "from_coo") == 0)
+        model->from_coo_ns = w[0];
+      else if (strcmp(kind, "sort") == 0)
+        model->sort_ns = w[0];
+      else if (strcmp(kind, "index") == 0)
+        model->index_ns = w[0];
+    }
+  }
+  fclose(file);
+  return 0;
+}
+
+int save_cost_model(const struct cost_model *model, const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file)
+    return -1;
+
+  fprintf(file, "# hadamard_transpose cost model (ns): kernel <config> const nnz_B nnz_C locate_steps\n");
+  for (size_t v = 0; v < num_hadamard_variants; ++v) {
+    fprintf(file, "kernel %s", hadamard_variants[v].name);
+    for (size_t f = 0; f < COST_FEATURES; ++f)
+      fprintf(file, " %.6g", model->kernel_ns[v][f]);
+    fprintf(file, "\n");
+  }
+  fprintf(file, "convert to_coo %.6g\n", model->to_coo_ns);
+  fprintf(file, "convert from_coo %.6g\n", model->from_coo_ns);
+  fprintf(file, "convert sort %.6g\n", model->sort_ns);
+  fprintf(file, "convert index %.6g\n", model->index_ns);
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+// =============================================================================
+// Operand statistics
+// =============================================================================
+
+static void slice_histogram(struct operand_stats *stats, size_t length, size_t *longest) {
+  unsigned bucket = 0;
+  while (length >> bucket)
+    ++bucket;
+  stats->histogram[bucket < 32 ? bucket : 31]++;
+  if (length > *longest)
+    *longest = length;
+}
+
+void gather_operand_stats(struct operand_stats *stats, enum tensor_format format, const void *T, size_t nrows,
+                          size_t ncols) {
+  memset(stats, 0, sizeof(*stats));
+  stats->format = format;
+  size_t longest = 0;
+
+  if (format == TENSOR_CSR || format == TENSOR_CSC) {
+    // Slices come from pos alone
+    const struct csr *csr = T;
+    const struct csc *csc = T;
+    const index_t *pos = format == TENSOR_CSR ? csr->lvl2_pos : csc->lvl2_pos;
+    stats->nnz = format == TENSOR_CSR ? csr->lvl2_nnz : csc->lvl2_nnz;
+    stats->num_slices = format == TENSOR_CSR ? csr->lvl1_size : csc->lvl1_size;
+    stats->sorted = format == TENSOR_CSR ? csr->sorted : csc->sorted;
+    for (size_t s = 0; s < stats->num_slices; ++s)
+      slice_histogram(stats, pos[s + 1] - pos[s], &longest);
+  } else {
+    const struct coo *t = T;
+    stats->nnz = t->lvl1_nnz;
+    stats->num_slices = nrows;
+    stats->indexed = t->index_slots != NULL;
+    stats->sorted = true;
+    size_t *lengths = calloc(nrows ? nrows : 1, sizeof(size_t));
+    for (size_t k = 0; k < t->lvl1_nnz; ++k) {
+      lengths[t->lvl1_crd[k]]++;
+      if (k > 0 && (t->lvl1_crd[k] < t->lvl1_crd[k - 1] ||
+                    (t->lvl1_crd[k] == t->lvl1_crd[k - 1] && t->lvl2_crd[k] < t->lvl2_crd[k - 1])))
+        stats->sorted = false;
+    }
+    for (size_t row = 0; row < nrows; ++row)
+      slice_histogram(stats, lengths[row], &longest);
+    free(lengths);
+  }
+  (void)ncols;
+
+  stats->mean_slice = stats->num_slices ? (double)stats->nnz / stats->num_slices : 0.0;
+  stats->skew = 0;
+  while (stats->mean_slice > 0 && longest > stats->mean_slice * (double)(2u << stats->skew))
+    ++stats->skew;
+}
+
+// Slices of an operand converted to format: B is nrows x ncols, C is ncols x nrows
+static size_t slices_as(enum tensor_format format, bool is_c, size_t nrows, size_t ncols) {
+  bool by_rows = format != TENSOR_CSC;
+  return by_rows != is_c ? nrows : ncols;
+}
+
+// Statistics after a conversion through COO: same entries, spread over the new format's slices, sorted, no index
+static struct operand_stats converted_stats(const struct operand_stats *from, enum tensor_format format, bool is_c,
+                                            size_t nrows, size_t ncols) {
+  struct operand_stats stats = *from;
+  stats.format = format;
+  stats.num_slices = slices_as(format, is_c, nrows, ncols);
+  stats.mean_slice = stats.num_slices ? (double)stats.nnz / stats.num_slices : 0.0;
+  stats.sorted = true;
+  stats.indexed = false;
+  return stats;
+}
+
+// Feature vector of a configuration on operands with statistics b and c (see COST_FEATURES)
+static void variant_features(const struct hadamard_variant *variant, const struct operand_stats *b,
+                             const struct operand_stats *c, double *features) {
+  const struct operand_stats *iterated = variant->search == HADAMARD_SEARCH_B ? c : b;
+  const struct operand_stats *located = variant->search == HADAMARD_SEARCH_B ? b : c;
+
+  double steps_per_lookup;
+  if (variant->search == HADAMARD_SEARCH_MERGE)
+    steps_per_lookup = 0.0;
+  else if (variant->search == HADAMARD_SEARCH_HASH)
+    steps_per_lookup = HASH_PROBE_STEPS;
+  else if (located->format == TENSOR_COO)
+    steps_per_lookup = (double)located->nnz;
+  else
+    steps_per_lookup = located->mean_slice;
+
+  features[0] = 1.0;
+  features[1] = (double)b->nnz;
+  features[2] = (double)c->nnz;
+  features[3] = (double)iterated->nnz * steps_per_lookup;
+}
+
+static double kernel_cost(const struct cost_model *model, const struct hadamard_variant *variant,
+                          const double *features) {
+  const double *w = model->kernel_ns[variant - hadamard_variants];
+  double ns = 0.0;
+  for (size_t f = 0; f < COST_FEATURES; ++f)
+    ns += w[f] * features[f];
+  return ns;
+}
+
+// =============================================================================
+// Planning
+// =============================================================================
+
+struct plan_signature {
+  enum tensor_format a, b, c;
+  bool b_sorted, c_sorted, c_indexed;
+  unsigned rows, cols, b_nnz, c_nnz; // quarter-octave buckets
+  unsigned b_skew, c_skew;
+};
+
+struct plan_cache_entry {
+  struct plan_signature signature;
+  struct hadamard_plan plan;
+};
+
+static unsigned size_bucket(size_t n) { return (unsigned)floor(4.0 * log2((double)n + 1.0)); }
+
+static struct plan_signature make_signature(enum tensor_format a, size_t nrows, size_t ncols,
+                                            const struct operand_stats *b, const struct operand_stats *c) {
+  struct plan_signature signature;
+  memset(&signature, 0, sizeof(signature)); // padding is compared too
+  signature.a = a;
+  signature.b = b->format;
+  signature.c = c->format;
+  signature.b_sorted = b->sorted;
+  signature.c_sorted = c->sorted;
+  signature.c_indexed = c->indexed;
+  signature.rows = size_bucket(nrows);
+  signature.cols = size_bucket(ncols);
+  signature.b_nnz = size_bucket(b->nnz);
+  signature.c_nnz = size_bucket(c->nnz);
+  signature.b_skew = b->skew;
+  signature.c_skew = c->skew;
+  return signature;
+}
+
+void init_hadamard_tuner(struct hadamard_tuner *tuner, const struct cost_model *model) {
+  memset(tuner, 0, sizeof(*tuner));
+  if (model) {
+    tuner->model = *model;
+    return;
+  }
+  default_cost_model(&tuner->model);
+  const char *path = getenv("HADAMARD_COST_MODEL");
+  if (path && *path && load_cost_model(&tuner->model, path) != 0)
+    fprintf(stderr, "Cannot read HADAMARD_COST_MODEL %s: %s, using the default model\n", path, strerror(errno));
+}
+
+void free_hadamard_tuner(struct hadamard_tuner *tuner) {
+  free(tuner->cache);
+  tuner->cache = NULL;
+  tuner->cache_len = tuner->cache_cap = 0;
+}
+
+static struct hadamard_plan cheapest_plan(const struct cost_model *model, enum tensor_format a, size_t nrows,
+                                          size_t ncols, const struct operand_stats *b, const struct operand_stats *c) {
+  struct hadamard_plan best = {0};
+  for (size_t v = 0; v < num_hadamard_variants; ++v) {
+    const struct hadamard_variant *variant = &hadamard_variants[v];
+    if (variant->a != a)
+      continue;
+
+    struct hadamard_plan plan = {.variant = variant};
+    double ns = 0.0;
+    struct operand_stats vb = *b, vc = *c;
+    if (variant->b != b->format) {
+      plan.convert_b = true;
+      ns += (b->format != TENSOR_COO ? model->to_coo_ns : 0.0) * b->nnz;
+      ns += (variant->b != TENSOR_COO ? model->from_coo_ns : 0.0) * b->nnz;
+      vb = converted_stats(b, variant->b, false, nrows, ncols);
+    }
+    if (variant->c != c->format) {
+      plan.convert_c = true;
+      ns += (c->format != TENSOR_COO ? model->to_coo_ns : 0.0) * c->nnz;
+      ns += (variant->c != TENSOR_COO ? model->from_coo_ns : 0.0) * c->nnz;
+      vc = converted_stats(c, variant->c, true, nrows, ncols);
+    }
+    if (variant->search == HADAMARD_SEARCH_MERGE) {
+      plan.sort_b = !vb.sorted;
+      plan.sort_c = !vc.sorted;
+      ns += (plan.sort_b ? model->sort_ns * vb.nnz : 0.0) + (plan.sort_c ? model->sort_ns * vc.nnz : 0.0);
+    }
+    if (variant->search == HADAMARD_SEARCH_HASH && !vc.indexed) {
+      plan.build_index = true;
+      ns += model->index_ns * vc.nnz;
+    }
+
+    double features[COST_FEATURES];
+    variant_features(variant, &vb, &vc, features);
+    plan.predicted_ns = ns + kernel_cost(model, variant, features);
+    if (!best.variant || plan.predicted_ns < best.predicted_ns)
+      best = plan;
+  }
+  return best;
+}
+
+struct hadamard_plan plan_hadamard_transpose(struct hadamard_tuner *tuner, enum tensor_format a, size_t nrows,
+                                             size_t ncols, enum tensor_format b, const void *B,
+                                             enum tensor_format c, const void *C) {
+  struct operand_stats b_stats, c_stats;
+  gather_operand_stats(&b_stats, b, B, nrows, ncols);
+  gather_operand_stats(&c_stats, c, C, ncols, nrows);
+  struct plan_signature signature = make_signature(a, nrows, ncols, &b_stats, &c_stats);
+
+  for (size_t e = 0; e < tuner->cache_len; ++e) {
+    if (memcmp(&tuner->cache[e].signature, &signature, sizeof(signature)) == 0) {
+      tuner->cache_hits++;
+      return tuner->cache[e].plan;
+    }
+  }
+
+  struct hadamard_plan plan = cheapest_plan(&tuner->model, a, nrows, ncols, &b_stats, &c_stats);
+  if (tuner->cache_len == tuner->cache_cap) {
+    tuner->cache_cap = tuner->cache_cap ? 2 * tuner->cache_cap : 16;
+    tuner->cache = realloc(tuner->cache, tuner->cache_cap * sizeof(struct plan_cache_entry));
+  }
+  tuner->cache[tuner->cache_len++] = (struct plan_cache_entry){signature, plan};
+  return plan;
+}
+
+// =============================================================================
+// Running a plan
+// =============================================================================
+
+static void free_operand(enum tensor_format format, void *T) {
+  if (format == TENSOR_CSR)
+    free_tensor((struct csr *)T);
+  else if (format == TENSOR_CSC)
+    free_tensor((struct csc *)T);
+  else
+    free_tensor((struct coo *)T);
+}
+
+static void sort_operand(enum tensor_format format, void *T) {
+  if (format == TENSOR_CSR)
+    sort_tensor((struct csr *)T);
+  else if (format == TENSOR_CSC)
+    sort_tensor((struct csc *)T);
+}
+
+// T (nrows x ncols, format from) in format to, through COO; a new tensor
+static void *convert_operand(enum tensor_format from, void *T, enum tensor_format to, size_t nrows, size_t ncols) {
+  struct coo *coo = from == TENSOR_CSR ? csr_to_coo(T) : from == TENSOR_CSC ? csc_to_coo(T) : T;
+  void *converted;
+  if (to == TENSOR_CSR)
+    converted = coo_to_csr(coo, nrows, ncols);
+  else if (to == TENSOR_CSC)
+    converted = coo_to_csc(coo, nrows, ncols);
+  else
+    return coo; // from is CSR or CSC here
+  if (coo != T)
+    free_tensor(coo);
+  return converted;
+}
+
+void *hadamard_transpose_auto(struct hadamard_tuner *tuner, enum tensor_format a, size_t nrows, size_t ncols,
+                              enum tensor_format b, void *B, enum tensor_format c, void *C, bool parallel) {
+  struct hadamard_plan plan = plan_hadamard_transpose(tuner, a, nrows, ncols, b, B, c, C);
+  const struct hadamard_variant *variant = plan.variant;
+  if (!variant)
+    return NULL;
+
+  void *vB = plan.convert_b ? convert_operand(b, B, variant->b, nrows, ncols) : B;
+  void *vC = plan.convert_c ? convert_operand(c, C, variant->c, ncols, nrows) : C;
+  if (plan.sort_b)
+    sort_operand(variant->b, vB);
+  if (plan.sort_c)
+    sort_operand(variant->c, vC);
+  if (plan.build_index)
+    build_coo_index(vC);
+
+  void *A;
+  if (a == TENSOR_CSR)
+    A = allocate_csr(nrows, 0);
+  else if (a == TENSOR_CSC)
+    A = allocate_csc(ncols, 0);
+  else
+    A = allocate_coo(0);
+
+  if (parallel) {
+    // The parallel kernels size A themselves
+    if (a == TENSOR_CSR)
+      reset_tensor((struct csr *)A);
+    else if (a == TENSOR_CSC)
+      reset_tensor((struct csc *)A);
+    else
+      reset_tensor((struct coo *)A);
+    variant->run_parallel(A, vB, vC);
+  } else {
+    size_t nnz = variant->count(A, vB, vC);
+    if (a == TENSOR_CSR) {
+      reserve_tensor((struct csr *)A, nnz);
+      reset_tensor((struct csr *)A);
+    } else if (a == TENSOR_CSC) {
+      reserve_tensor((struct csc *)A, nnz);
+      reset_tensor((struct csc *)A);
+    } else {
+      reserve_tensor((struct coo *)A, nnz);
+      reset_tensor((struct coo *)A);
+    }
+    variant->run(A, vB, vC);
+  }
+
+  if (vB != B)
+    free_operand(variant->b, vB);
+  if (vC != C)
+    free_operand(variant->c, vC);
+  return A;
+}
+
+// =============================================================================
+// Calibration
+// =============================================================================
+
+#define MAX_CSV_FIELDS 64
+
+// Columns of the benchmark CSVs read by the calibration, found by name in the header line
+enum bench_column {
+  COL_A,
+  COL_B,
+  COL_C,
+  COL_SEARCH,
+  COL_INDEX_BITS,
+  COL_VALUE_TYPE,
+  COL_ALLOC,
+  COL_WORKLOAD,
+  COL_SIZE,
+  COL_B_SPARSITY,
+  COL_C_SPARSITY,
+  COL_INDEX_BUILD,
+  COL_TIME,
+  COL_MEDIAN_TIME, // optional: preferred over the mean when present
+  COL_THREADS,     // parallel benchmarks only
+  NUM_BENCH_COLUMNS
+};
+
+static const char *const BENCH_COLUMN_NAMES[NUM_BENCH_COLUMNS] = {
+    "A_format", "B_format", "C_format", "search_in", "index_bits", "value_type", "alloc", "workload", "size",
+    "B_sparsity", "C_sparsity", "index_build_ms", "avg_time_ms", "median_time_ms", "threads"};
+
+struct sample {
+  double features[COST_FEATURES];
+  double ns;
+};
+
+struct sample_set {
+  struct sample *samples;
+  size_t len, cap;
+};
+
+// Statistics of a size x size benchmark input with nnz entries
+static struct operand_stats bench_stats(enum tensor_format format, size_t size, size_t nnz) {
+  struct operand_stats stats = {.format = format, .nnz = nnz, .num_slices = size, .sorted = true};
+  stats.mean_slice = size ? (double)nnz / size : 0.0;
+  return stats;
+}
+
+// Entries of a generated size x size input (see generate_* and generate_*_workload)
+static size_t bench_nnz(bool uniform, enum tensor_format format, size_t size, double sparsity) {
+  if (uniform && format == TENSOR_COO) {
+    size_t nnz = (size_t)(size * size * sparsity);
+    return nnz < 1 ? 1 : nnz > size * size ? size * size : nnz;
+  }
+  size_t row_nnz = (size_t)(size * sparsity);
+  row_nnz = row_nnz < 1 ? 1 : row_nnz > size ? size : row_nnz;
+  return size * row_nnz;
+}
+
+static int parse_format(const char *name, enum tensor_format *format) {
+  for (int f = 0; f < 3; ++f)
+    if (strcmp(name, TENSOR_FORMAT_NAMES[f]) == 0)
+      return *format = f, 0;
+  return -1;
+}
+
+// Split a CSV line in place, keeping empty fields; returns the number of fields
+static size_t split_csv(char *line, char **fields) {
+  line[strcspn(line, "\r\n")] = '\0';
+  size_t num_fields = 0;
+  for (char *rest = line; rest && num_fields < MAX_CSV_FIELDS;)
+    fields[num_fields++] = strsep(&rest, ",");
+  return num_fields;
+}
+
+// Position of every bench_column in a header line, -1 for a column it lacks; returns 0 if only optional ones are missing
+static int bench_columns(char *header, int *column) {
+  char *fields[MAX_CSV_FIELDS];
+  size_t num_fields = split_csv(header, fields);
+  int status = 0;
+  for (int col = 0; col < NUM_BENCH_COLUMNS; ++col) {
+    column[col] = -1;
+    for (size_t f = 0; f < num_fields; ++f)
+      if (strcmp(fields[f], BENCH_COLUMN_NAMES[col]) == 0)
+        column[col] = (int)f;
+    if (column[col] < 0 && col != COL_MEDIAN_TIME && col != COL_THREADS)
+      status = -1;
+  }
+  return status;
+}
+
+// One CSV row of a benchmark result file with the given columns; returns the configuration and fills sample, or NULL
+// to skip the row
+static const struct hadamard_variant *parse_bench_row(char *line, const int *column, struct sample *sample,
+                                                      double *index_ns) {
+  char *row[MAX_CSV_FIELDS];
+  size_t num_fields = split_csv(line, row);
+  const char *fields[NUM_BENCH_COLUMNS];
+  for (int col = 0; col < NUM_BENCH_COLUMNS; ++col) {
+    if (column[col] >= (int)num_fields)
+      return NULL;
+    fields[col] = column[col] >= 0 ? row[column[col]] : "";
+  }
+
+  // Only the serial time of this build's index width, value type and allocator
+  if (atoi(fields[COL_INDEX_BITS]) != INDEX_BITS || strcmp(fields[COL_VALUE_TYPE], VALUE_TYPE_NAME) != 0 ||
+      strcmp(fields[COL_ALLOC], ALLOC_NAME) != 0)
+    return NULL;
+  if (column[COL_THREADS] >= 0 && atoi(fields[COL_THREADS]) != 1)
+    return NULL;
+
+  char name[64];
+  snprintf(name, sizeof(name), "%s_%s_%s_%s", fields[COL_A], fields[COL_B], fields[COL_C], fields[COL_SEARCH]);
+  for (char *p = name; *p; ++p)
+    *p = (char)(*p >= 'A' && *p <= 'Z' ? *p - 'A' + 'a' : *p);
+  const struct hadamard_variant *variant = find_hadamard_variant_named(name);
+  enum tensor_format b, c;
+  if (!variant || parse_format(fields[COL_B], &b) != 0 || parse_format(fields[COL_C], &c) != 0)
+    return NULL;
+
+  // Generated inputs only: the entries of Matrix Market inputs are not in the file
+  const char *workload = fields[COL_WORKLOAD];
+  bool uniform = strcmp(workload, WORKLOAD_NAMES[WORKLOAD_UNIFORM]) == 0;
+  bool transposed = strcmp(workload, "transposed") == 0;
+  bool known = uniform || transposed;
+  for (int w = 0; w < NUM_WORKLOADS; ++w)
+    known |= strcmp(workload, WORKLOAD_NAMES[w]) == 0;
+  size_t size = strtoul(fields[COL_SIZE], NULL, 10);
+  double b_sparsity = atof(fields[COL_B_SPARSITY]), c_sparsity = atof(fields[COL_C_SPARSITY]);
+  double index_ms = atof(fields[COL_INDEX_BUILD]), time_ms = atof(fields[COL_TIME]);
+  if (atof(fields[COL_MEDIAN_TIME]) > 0.0)
+    time_ms = atof(fields[COL_MEDIAN_TIME]);
+  if (!known || size == 0 || time_ms <= 0.0)
+    return NULL;
+
+  // Transposed inputs: C has the pattern of B's transpose, generated like a structured workload
+  size_t b_nnz = bench_nnz(uniform, b, size, b_sparsity);
+  size_t c_nnz = transposed ? bench_nnz(false, c, size, b_sparsity) : bench_nnz(uniform, c, size, c_sparsity);
+  struct operand_stats b_stats = bench_stats(b, size, b_nnz), c_stats = bench_stats(c, size, c_nnz);
+  variant_features(variant, &b_stats, &c_stats, sample->features);
+  sample->ns = time_ms * 1e6;
+  *index_ns = variant->search == HADAMARD_SEARCH_HASH && index_ms > 0.0 ? index_ms * 1e6 / c_nnz : 0.0;
+  return variant;
+}
+
+// Solve the n x n system m x = r in place (Gaussian elimination with partial pivoting); -1 if it is singular
+static int solve(double m[COST_FEATURES][COST_FEATURES], double *r, size_t n, double *x) {
+  for (size_t col = 0; col < n; ++col) {
+    size_t pivot = col;
+    for (size_t row = col + 1; row < n; ++row)
+      if (fabs(m[row][col]) > fabs(m[pivot][col]))
+        pivot = row;
+    if (fabs(m[pivot][col]) < 1e-12)
+      return -1;
+    for (size_t k = 0; k < n; ++k) {
+      double t = m[col][k];
+      m[col][k] = m[pivot][k];
+      m[pivot][k] = t;
+    }
+    double t = r[col];
+    r[col] = r[pivot];
+    r[pivot] = t;
+    for (size_t row = col + 1; row < n; ++row) {
+      double factor = m[row][col] / m[col][col];
+      for (size_t k = col; k < n; ++k)
+        m[row][k] -= factor * m[col][k];
+      r[row] -= factor * r[col];
+    }
+  }
+  for (size_t col = n; col-- > 0;) {
+    double sum = r[col];
+    for (size_t k = col + 1; k < n; ++k)
+      sum -= m[col][k] * x[k];
+    x[col] = sum / m[col][col];
+  }
+  return 0;
+}
+
+// Non-negative least squares on relative error: minimise sum ((w . f - ns) / ns)^2 over w >= 0. With COST_FEATURES
+// unknowns the exact solution is the best non-negative unconstrained fit over all subsets of the features.
+static int fit_samples(const struct sample_set *set, double *weights) {
+  if (set->len < COST_FEATURES)
+    return -1;
+
+  // Columns scaled to unit norm, so features of very different magnitudes stay well conditioned
+  double scale[COST_FEATURES] = {0};
+  for (size_t s = 0; s < set->len; ++s)
+    for (size_t f = 0; f < COST_FEATURES; ++f)
+      scale[f] += pow(set->samples[s].features[f] / set->samples[s].ns, 2);
+  for (size_t f = 0; f < COST_FEATURES; ++f)
+    scale[f] = sqrt(scale[f]);
+
+  double best_residual = INFINITY;
+  for (unsigned subset = 1; subset < 1u << COST_FEATURES; ++subset) {
+    size_t cols[COST_FEATURES], n = 0;
+    for (size_t f = 0; f < COST_FEATURES; ++f)
+      if (subset >> f & 1) {
+        if (scale[f] == 0.0)
+          break;
+        cols[n++] = f;
+      }
+    if (n != (size_t)__builtin_popcount(subset))
+      continue;
+
+    double m[COST_FEATURES][COST_FEATURES] = {{0}}, r[COST_FEATURES] = {0}, x[COST_FEATURES];
+    for (size_t s = 0; s < set->len; ++s) {
+      const struct sample *sample = &set->samples[s];
+      for (size_t i = 0; i < n; ++i) {
+        double fi = sample->features[cols[i]] / sample->ns / scale[cols[i]];
+        r[i] += fi;
+        for (size_t j = 0; j < n; ++j)
+          m[i][j] += fi * sample->features[cols[j]] / sample->ns / scale[cols[j]];
+      }
+    }
+    if (solve(m, r, n, x) != 0)
+      continue;
+    bool feasible = true;
+    for (size_t i = 0; i < n; ++i)
+      feasible &= x[i] >= 0.0;
+    if (!feasible)
+      continue;
+
+    double w[COST_FEATURES] = {0};
+    for (size_t i = 0; i < n; ++i)
+      w[cols[i]] = x[i] / scale[cols[i]];
+    double residual = 0.0;
+    for (size_t s = 0; s < set->len; ++s) {
+      double predicted = 0.0;
+      for (size_t f = 0; f < COST_FEATURES; ++f)
+        predicted += w[f] * set->samples[s].features[f];
+      residual += pow(predicted / set->samples[s].ns - 1.0, 2);
+    }
+    if (residual < best_residual) {
+      best_residual = residual;
+      memcpy(weights, w, sizeof(w));
+    }
+  }
+  return isinf(best_residual) ? -1 : 0;
+}
+
+// Conversion costs per entry on a generated uniform 2000 x 2000 matrix, timed with the benchmarks' clock
+static void measure_conversions(struct cost_model *model) {
+  const size_t size = 2000;
+  struct csr *csr = generate_csr(size, size, 0.05, 42);
+  double nnz = (double)csr->lvl2_nnz;
+
+  double start = get_time_us();
+  struct coo *coo = csr_to_coo(csr);
+  model->to_coo_ns = (get_time_us() - start) * 1e3 / nnz;
+
+  start = get_time_us();
+  struct csr *back = coo_to_csr(coo, size, size);
+  model->from_coo_ns = (get_time_us() - start) * 1e3 / nnz;
+
+  // Reverse every row, so sort_tensor has work to do
+  for (size_t row = 0; row < size; ++row)
+    for (size_t k = back->lvl2_pos[row], l = back->lvl2_pos[row + 1]; k + 1 < l; ++k, --l) {
+      index_t crd = back->lvl2_crd[k];
+      back->lvl2_crd[k] = back->lvl2_crd[l - 1];
+      back->lvl2_crd[l - 1] = crd;
+    }
+  back->sorted = false;
+  start = get_time_us();
+  sort_tensor(back);
+  model->sort_ns = (get_time_us() - start) * 1e3 / nnz;
+
+  start = get_time_us();
+  build_coo_index(coo);
+  model->index_ns = (get_time_us() - start) * 1e3 / nnz;
+
+  free_tensor(back);
+  free_tensor(coo);
+  free_tensor(csr);
+}
+
+long calibrate_cost_model(struct cost_model *model, const char *results_dir) {
+  DIR *dir = opendir(results_dir);
+  if (!dir)
+    return -1;
+
+  struct sample_set sets[MAX_HADAMARD_VARIANTS] = {{0}};
+  double index_ns_sum = 0.0;
+  size_t index_rows = 0;
+  long rows = 0;
+
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    size_t len = strlen(entry->d_name);
+    if (len < 4 || strcmp(entry->d_name + len - 4, ".csv") != 0)
+      continue;
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", results_dir, entry->d_name);
+    FILE *file = fopen(path, "r");
+    if (!file)
+      continue;
+
+    char line[1024];
+    int column[NUM_BENCH_COLUMNS];
+    if (fgets(line, sizeof(line), file) && bench_columns(line, column) == 0) {
+      while (fgets(line, sizeof(line), file)) {
+        struct sample sample;
+        double index_ns;
+        const struct hadamard_variant *variant = parse_bench_row(line, column, &sample, &index_ns);
+        if (!variant)
+          continue;
+        struct sample_set *set = &sets[variant - hadamard_variants];
+        if (set->len == set->cap) {
+          set->cap = set->cap ? 2 * set->cap : 64;
+          set->samples = realloc(set->samples, set->cap * sizeof(struct sample));
+        }
+        set->samples[set->len++] = sample;
+        if (index_ns > 0.0) {
+          index_ns_sum += index_ns;
+          index_rows++;
+        }
+        rows++;
+      }
+    }
+    fclose(file);
+  }
+  closedir(dir);
+
+  for (size_t v = 0; v < num_hadamard_variants; ++v) {
+    double weights[COST_FEATURES] = {0};
+    if (fit_samples(&sets[v], weights) == 0)
+      memcpy(model->kernel_ns[v], weights, sizeof(weights));
+    free(sets[v].samples);
+  }
+
+  measure_conversions(model);
+  // Index builds at the benchmark's sizes, when the results have them, over the one microbenchmark
+  if (index_rows > 0)
+    model->index_ns = index_ns_sum / index_rows;
+  return rows;
+}
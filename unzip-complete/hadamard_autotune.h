@@ -0,0 +1,93 @@
+#ifndef HADAMARD_AUTOTUNE_H
+#define HADAMARD_AUTOTUNE_H
+
+#include "hadamard_dispatch.h"
+
+// Cost-model autotuning over the libhadamard configurations: for a call A = B .* C^T with A's format fixed by the
+// caller, every configuration producing that format is priced on cheap statistics of B and C, together with the
+// conversions it needs (format change through COO, sort for MERGE, index for HASH), and the cheapest plan runs.
+// Decisions are cached by input signature, so repeated calls on similar inputs skip the planning.
+
+// Kernel time of a configuration in ns: a non-negative combination of
+//   1, nnz(B), nnz(C),
+//   locate steps: entries iterated times the entries scanned per lookup (mean slice length of the searched
+//                 operand, its nnz when it is COO, HASH_PROBE_STEPS through an index, none for MERGE)
+#define COST_FEATURES 4
+#define HASH_PROBE_STEPS 4
+#define MAX_HADAMARD_VARIANTS 128
+
+struct cost_model {
+  double kernel_ns[MAX_HADAMARD_VARIANTS][COST_FEATURES]; // coefficients, indexed like hadamard_variants
+
+  // Conversion costs in ns per entry
+  double to_coo_ns;   // CSR/CSC -> COO
+  double from_coo_ns; // COO -> sorted CSR/CSC
+  double sort_ns;     // sort_tensor of an unsorted CSR/CSC
+  double index_ns;    // build_coo_index
+};
+
+// Uncalibrated model: unit costs per step, with conversions priced a few steps per entry
+void default_cost_model(struct cost_model *model);
+
+// Text model file: "kernel <config> <coefficient> x COST_FEATURES" and "convert <to_coo|from_coo|sort|index> <ns>"
+// lines; configurations missing from the file keep their current coefficients. Return 0 on success, -1 (with errno
+// set) if the file cannot be read or written.
+int load_cost_model(struct cost_model *model, const char *path);
+int save_cost_model(const struct cost_model *model, const char *path);
+
+// Offline calibration: fit every configuration's coefficients (non-negative least squares on relative error) to the
+// serial times (median if the CSV has it, else mean) of the benchmark CSVs in results_dir that match this build's
+// index bits, value type and allocator, and measure the conversion costs on a generated input. Configurations with
+// too few rows keep their coefficients.
+// Returns the number of CSV rows used, or -1 if results_dir cannot be read.
+long calibrate_cost_model(struct cost_model *model, const char *results_dir);
+
+// Statistics of one operand, gathered in O(slices) for CSR/CSC and O(nnz) for COO
+struct operand_stats {
+  enum tensor_format format;
+  size_t nnz;
+  size_t num_slices;     // rows of CSR and COO, columns of CSC
+  double mean_slice;     // nnz / num_slices
+  unsigned skew;         // log2 of the longest slice over the mean slice
+  size_t histogram[32];  // slices by length: [0] empty, [k] lengths in [2^(k-1), 2^k)
+  bool sorted;           // coordinates ascending within slices (COO: row-major order)
+  bool indexed;          // COO index built
+};
+
+void gather_operand_stats(struct operand_stats *stats, enum tensor_format format, const void *T, size_t nrows,
+                          size_t ncols);
+
+// What the autotuner runs: convert B and C (when their format differs from the configuration's), sort and index
+// them as needed, then run the configuration
+struct hadamard_plan {
+  const struct hadamard_variant *variant; // NULL if no configuration produces the requested format
+  bool convert_b, convert_c;
+  bool sort_b, sort_c;
+  bool build_index;
+  double predicted_ns;
+};
+
+struct plan_cache_entry;
+
+struct hadamard_tuner {
+  struct cost_model model;
+  struct plan_cache_entry *cache;
+  size_t cache_len, cache_cap;
+  size_t cache_hits;
+};
+
+// model NULL: the file named by $HADAMARD_COST_MODEL if it is set and readable, the default model otherwise
+void init_hadamard_tuner(struct hadamard_tuner *tuner, const struct cost_model *model);
+void free_hadamard_tuner(struct hadamard_tuner *tuner);
+
+// Cheapest plan for A (nrows x ncols, format a) = B .* C^T
+struct hadamard_plan plan_hadamard_transpose(struct hadamard_tuner *tuner, enum tensor_format a, size_t nrows,
+                                             size_t ncols, enum tensor_format b, const void *B,
+                                             enum tensor_format c, const void *C);
+
+// Plan and run: returns a new A in format a, or NULL if no configuration produces a. B and C may be sorted and C's
+// COO index built in place; conversions go to temporaries. parallel runs hadamard_transpose_parallel.
+void *hadamard_transpose_auto(struct hadamard_tuner *tuner, enum tensor_format a, size_t nrows, size_t ncols,
+                              enum tensor_format b, void *B, enum tensor_format c, void *C, bool parallel);
+
+#endif /* HADAMARD_AUTOTUNE_H */
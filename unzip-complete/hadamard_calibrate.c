@@ -0,0 +1,37 @@
+#include "hadamard_autotune.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+// Offline calibration of the autotuner: fits the cost model to the benchmark CSVs in a results directory and writes
+// it as a model file for HADAMARD_COST_MODEL.
+//   calibrate [results_dir [model_path]]   (defaults: results, <results_dir>/cost_model.txt)
+
+int main(int argc, char **argv) {
+  const char *results_dir = argc > 1 ? argv[1] : "results";
+  char default_path[4096];
+  snprintf(default_path, sizeof(default_path), "%s/cost_model.txt", results_dir);
+  const char *model_path = argc > 2 ? argv[2] : default_path;
+
+  struct cost_model model;
+  default_cost_model(&model);
+  long rows = calibrate_cost_model(&model, results_dir);
+  if (rows < 0) {
+    fprintf(stderr, "Cannot read %s: %s\n", results_dir, strerror(errno));
+    return 1;
+  }
+  if (rows == 0)
+    fprintf(stderr, "No benchmark rows for INDEX_BITS=%d, VALUE_TYPE=%s, ALLOC=%s in %s: kernel costs left at the "
+                    "defaults\n",
+            INDEX_BITS, VALUE_TYPE_NAME, ALLOC_NAME, results_dir);
+
+  if (save_cost_model(&model, model_path) != 0) {
+    fprintf(stderr, "Cannot write %s: %s\n", model_path, strerror(errno));
+    return 1;
+  }
+  fprintf(stderr, "Calibrated from %ld benchmark rows; conversions per entry: to COO %.2f ns, from COO %.2f ns, "
+                  "sort %.2f ns, index %.2f ns\n",
+          rows, model.to_coo_ns, model.from_coo_ns, model.sort_ns, model.index_ns);
+  printf("Cost model saved to %s\n", model_path);
+  return 0;
+}
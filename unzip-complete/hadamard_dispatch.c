@@ -0,0 +1,80 @@
+#include "hadamard_dispatch.h"
+#include <string.h>
+
+// Configurations compiled into libhadamard: the library rule of the Makefile passes CONFIGS as
+// -DHADAMARD_CONFIG_LIST(X)=X(a,b,c,s) ..., so the table lists exactly the variants it builds
+#ifndef HADAMARD_CONFIG_LIST
+#error "HADAMARD_CONFIG_LIST is not defined: build hadamard_dispatch.c through the libhadamard rule of the Makefile"
+#endif
+
+#define STRUCT_csr struct csr
+#define STRUCT_csc struct csc
+#define STRUCT_coo struct coo
+
+#define FORMAT_csr TENSOR_CSR
+#define FORMAT_csc TENSOR_CSC
+#define FORMAT_coo TENSOR_COO
+
+#define SEARCH_b HADAMARD_SEARCH_B
+#define SEARCH_c HADAMARD_SEARCH_C
+#define SEARCH_merge HADAMARD_SEARCH_MERGE
+#define SEARCH_hash HADAMARD_SEARCH_HASH
+
+// Declarations of the suffixed entry points (see VARIANT in hadamard_transpose.h) and untyped wrappers for the table
+#define DECLARE_VARIANT(a, b, c, s)                                                                                    \
+  void hadamard_transpose_##a##_##b##_##c##_##s(STRUCT_##a *A, STRUCT_##b *B, STRUCT_##c *C);                          \
+  size_t hadamard_transpose_count_##a##_##b##_##c##_##s(STRUCT_##a *A, STRUCT_##b *B, STRUCT_##c *C);                  \
+  void hadamard_transpose_parallel_##a##_##b##_##c##_##s(STRUCT_##a *A, STRUCT_##b *B, STRUCT_##c *C);                 \
+  static void run_##a##_##b##_##c##_##s(void *A, void *B, void *C) {                                                   \
+    hadamard_transpose_##a##_##b##_##c##_##s(A, B, C);                                                                 \
+  }                                                                                                                    \
+  static size_t count_##a##_##b##_##c##_##s(void *A, void *B, void *C) {                                               \
+    return hadamard_transpose_count_##a##_##b##_##c##_##s(A, B, C);                                                    \
+  }                                                                                                                    \
+  static void run_parallel_##a##_##b##_##c##_##s(void *A, void *B, void *C) {                                          \
+    hadamard_transpose_parallel_##a##_##b##_##c##_##s(A, B, C);                                                        \
+  }
+
+#define VARIANT_ENTRY(a, b, c, s)                                                                                      \
+  {FORMAT_##a,                                                                                                         \
+   FORMAT_##b,                                                                                                         \
+   FORMAT_##c,                                                                                                         \
+   SEARCH_##s,                                                                                                         \
+   #a "_" #b "_" #c "_" #s,                                                                                            \
+   run_##a##_##b##_##c##_##s,                                                                                          \
+   count_##a##_##b##_##c##_##s,                                                                                        \
+   run_parallel_##a##_##b##_##c##_##s},
+
+HADAMARD_CONFIG_LIST(DECLARE_VARIANT)
+
+const struct hadamard_variant hadamard_variants[] = {HADAMARD_CONFIG_LIST(VARIANT_ENTRY)};
+const size_t num_hadamard_variants = sizeof(hadamard_variants) / sizeof(hadamard_variants[0]);
+
+const char *const TENSOR_FORMAT_NAMES[3] = {"csr", "csc", "coo"};
+const char *const HADAMARD_SEARCH_NAMES[4] = {"b", "c", "merge", "hash"};
+
+const struct hadamard_variant *find_hadamard_variant(enum tensor_format a, enum tensor_format b, enum tensor_format c,
+                                                     enum hadamard_search search) {
+  for (size_t v = 0; v < num_hadamard_variants; ++v) {
+    const struct hadamard_variant *variant = &hadamard_variants[v];
+    if (variant->a == a && variant->b == b && variant->c == c && variant->search == search)
+      return variant;
+  }
+  return NULL;
+}
+
+const struct hadamard_variant *find_hadamard_variant_named(const char *name) {
+  for (size_t v = 0; v < num_hadamard_variants; ++v)
+    if (strcmp(hadamard_variants[v].name, name) == 0)
+      return &hadamard_variants[v];
+  return NULL;
+}
+
+int hadamard_transpose_dispatch(enum tensor_format a, enum tensor_format b, enum tensor_format c,
+                                enum hadamard_search search, void *A, void *B, void *C) {
+  const struct hadamard_variant *variant = find_hadamard_variant(a, b, c, search);
+  if (!variant)
+    return -1;
+  variant->run(A, B, C);
+  return 0;
+}
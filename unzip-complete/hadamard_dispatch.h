@@ -0,0 +1,43 @@
+#ifndef HADAMARD_DISPATCH_H
+#define HADAMARD_DISPATCH_H
+
+#include "tensor_formats.h"
+
+// Runtime selection of a hadamard_transpose configuration. libhadamard (make lib) compiles hadamard_transpose.c once
+// per configuration of the Makefile's CONFIGS with -DVARIANT and -DPARALLEL, and this table maps a configuration's
+// (A, B, C, search) to its entry points, so one process can run every configuration on the same inputs.
+
+enum tensor_format { TENSOR_CSR, TENSOR_CSC, TENSOR_COO };
+
+// The SEARCH_* flags of hadamard_transpose.h
+enum hadamard_search { HADAMARD_SEARCH_B, HADAMARD_SEARCH_C, HADAMARD_SEARCH_MERGE, HADAMARD_SEARCH_HASH };
+
+// One configuration. A, B and C point to the structs of a, b and c; the entry points have the preconditions of
+// hadamard_transpose.h (A reset and sized with count, sorted operands for MERGE, C's COO index built for HASH).
+struct hadamard_variant {
+  enum tensor_format a, b, c;
+  enum hadamard_search search;
+  const char *name; // configuration name as in CONFIGS, e.g. "csr_csr_csc_merge"
+
+  void (*run)(void *A, void *B, void *C);
+  size_t (*count)(void *A, void *B, void *C);
+  void (*run_parallel)(void *A, void *B, void *C);
+};
+
+extern const struct hadamard_variant hadamard_variants[];
+extern const size_t num_hadamard_variants;
+
+// Lowercase names of the formats and searches, as used in configuration names ("csr", "merge", ...)
+extern const char *const TENSOR_FORMAT_NAMES[3];
+extern const char *const HADAMARD_SEARCH_NAMES[4];
+
+// Table entry of a configuration, NULL if it is not implemented
+const struct hadamard_variant *find_hadamard_variant(enum tensor_format a, enum tensor_format b, enum tensor_format c,
+                                                     enum hadamard_search search);
+const struct hadamard_variant *find_hadamard_variant_named(const char *name);
+
+// hadamard_transpose of the (a, b, c, search) configuration; returns 0, or -1 if it is not implemented
+int hadamard_transpose_dispatch(enum tensor_format a, enum tensor_format b, enum tensor_format c,
+                                enum hadamard_search search, void *A, void *B, void *C);
+
+#endif /* HADAMARD_DISPATCH_H */
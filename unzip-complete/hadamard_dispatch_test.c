@@ -0,0 +1,240 @@
+#include "hadamard_autotune.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Runs every configuration of libhadamard through the dispatch table on the same generated inputs and compares A,
+// serial and parallel, with the Hadamard product of B and C transposed computed from their dense images. The
+// autotuner is checked on the same inputs.
+
+#define NDIM1 37
+#define NDIM2 29
+
+// Dense row-major image of an nrows x ncols matrix in format fmt
+static void image(enum tensor_format fmt, const void *T, size_t nrows, size_t ncols, double *out) {
+  for (size_t k = 0; k < nrows * ncols; ++k)
+    out[k] = 0;
+  if (fmt == TENSOR_CSR) {
+    const struct csr *t = T;
+    for (size_t row = 0; row < t->lvl1_size; ++row)
+      for (size_t k = t->lvl2_pos[row]; k < t->lvl2_pos[row + 1]; ++k)
+        out[row * ncols + t->lvl2_crd[k]] += t->vals[k];
+  } else if (fmt == TENSOR_CSC) {
+    const struct csc *t = T;
+    for (size_t col = 0; col < t->lvl1_size; ++col)
+      for (size_t k = t->lvl2_pos[col]; k < t->lvl2_pos[col + 1]; ++k)
+        out[t->lvl2_crd[k] * ncols + col] += t->vals[k];
+  } else {
+    const struct coo *t = T;
+    for (size_t k = 0; k < t->lvl1_nnz; ++k)
+      out[t->lvl1_crd[k] * ncols + t->lvl2_crd[k]] += t->vals[k];
+  }
+}
+
+// B (NDIM1 x NDIM2) and C (NDIM2 x NDIM1) are banded, so C transposed overlaps B around the diagonal
+static void *generate_operand(enum tensor_format fmt, bool is_c) {
+  switch (fmt) {
+  case TENSOR_CSR:
+    return is_c ? (void *)generate_csr_workload(WORKLOAD_BANDED, NDIM2, NDIM1, 0.3, 5)
+                : (void *)generate_csr_workload(WORKLOAD_BANDED, NDIM1, NDIM2, 0.3, 4);
+  case TENSOR_CSC:
+    return is_c ? (void *)generate_csc_workload(WORKLOAD_BANDED, NDIM2, NDIM1, 0.3, 5)
+                : (void *)generate_csc_workload(WORKLOAD_BANDED, NDIM1, NDIM2, 0.3, 4);
+  default:
+    return is_c ? (void *)generate_coo_workload(WORKLOAD_BANDED, NDIM2, NDIM1, 0.3, 5)
+                : (void *)generate_coo_workload(WORKLOAD_BANDED, NDIM1, NDIM2, 0.3, 4);
+  }
+}
+
+static void *allocate_output(enum tensor_format fmt) {
+  switch (fmt) {
+  case TENSOR_CSR:
+    return allocate_csr(NDIM1, 0);
+  case TENSOR_CSC:
+    return allocate_csc(NDIM2, 0);
+  default:
+    return allocate_coo(0);
+  }
+}
+
+static void reserve_output(enum tensor_format fmt, void *A, size_t nnz) {
+  if (fmt == TENSOR_CSR)
+    reserve_tensor((struct csr *)A, nnz);
+  else if (fmt == TENSOR_CSC)
+    reserve_tensor((struct csc *)A, nnz);
+  else
+    reserve_tensor((struct coo *)A, nnz);
+}
+
+static void reset_output(enum tensor_format fmt, void *A) {
+  if (fmt == TENSOR_CSR)
+    reset_tensor((struct csr *)A);
+  else if (fmt == TENSOR_CSC)
+    reset_tensor((struct csc *)A);
+  else
+    reset_tensor((struct coo *)A);
+}
+
+static void free_operand(enum tensor_format fmt, void *T) {
+  if (fmt == TENSOR_CSR)
+    free_tensor((struct csr *)T);
+  else if (fmt == TENSOR_CSC)
+    free_tensor((struct csc *)T);
+  else
+    free_tensor((struct coo *)T);
+}
+
+static int same_image(const double *a, const double *b) {
+  for (size_t k = 0; k < NDIM1 * NDIM2; ++k)
+    if (fabs(a[k] - b[k]) > 1e-6)
+      return 0;
+  return 1;
+}
+
+// Dense image of B .* C^T
+static void expected_image(enum tensor_format b, const void *B, enum tensor_format c, const void *C, double *out) {
+  double *b_image = malloc(NDIM1 * NDIM2 * sizeof(double));
+  double *c_image = malloc(NDIM1 * NDIM2 * sizeof(double));
+  image(b, B, NDIM1, NDIM2, b_image);
+  image(c, C, NDIM2, NDIM1, c_image);
+  for (size_t i = 0; i < NDIM1; ++i)
+    for (size_t j = 0; j < NDIM2; ++j)
+      out[i * NDIM2 + j] = b_image[i * NDIM2 + j] * c_image[j * NDIM1 + i];
+  free(b_image);
+  free(c_image);
+}
+
+static int verify_variant(const struct hadamard_variant *variant) {
+  void *B = generate_operand(variant->b, false);
+  void *C = generate_operand(variant->c, true);
+  if (variant->search == HADAMARD_SEARCH_HASH)
+    build_coo_index(C);
+
+  double *expected = malloc(NDIM1 * NDIM2 * sizeof(double));
+  double *actual = malloc(NDIM1 * NDIM2 * sizeof(double));
+  expected_image(variant->b, B, variant->c, C, expected);
+
+  void *A = allocate_output(variant->a);
+  size_t nnz = variant->count(A, B, C);
+  reserve_output(variant->a, A, nnz);
+  reset_output(variant->a, A);
+  int status = hadamard_transpose_dispatch(variant->a, variant->b, variant->c, variant->search, A, B, C);
+  image(variant->a, A, NDIM1, NDIM2, actual);
+  int passed = status == 0 && same_image(expected, actual);
+
+  reset_output(variant->a, A);
+  variant->run_parallel(A, B, C);
+  image(variant->a, A, NDIM1, NDIM2, actual);
+  passed &= same_image(expected, actual);
+
+  printf("  %s %s (%zu entries)\n", passed ? "PASS" : "FAIL", variant->name, nnz);
+  free(expected);
+  free(actual);
+  free_operand(variant->a, A);
+  free_operand(variant->b, B);
+  free_operand(variant->c, C);
+  return passed;
+}
+
+// The autotuner on a COO B and a CSR C: serial and parallel results, the plan cache, a model that favours one
+// configuration, and a model file round trip
+static int verify_autotune(void) {
+  void *B = generate_operand(TENSOR_COO, false);
+  void *C = generate_operand(TENSOR_CSR, true);
+  double *expected = malloc(NDIM1 * NDIM2 * sizeof(double));
+  double *actual = malloc(NDIM1 * NDIM2 * sizeof(double));
+  expected_image(TENSOR_COO, B, TENSOR_CSR, C, expected);
+
+  struct cost_model model;
+  default_cost_model(&model);
+  struct hadamard_tuner tuner;
+  init_hadamard_tuner(&tuner, &model);
+  int passed = 1;
+  for (int parallel = 0; parallel < 2; ++parallel) {
+    for (enum tensor_format a = TENSOR_CSR; a <= TENSOR_COO; ++a) {
+      void *A = hadamard_transpose_auto(&tuner, a, NDIM1, NDIM2, TENSOR_COO, B, TENSOR_CSR, C, parallel);
+      image(a, A, NDIM1, NDIM2, actual);
+      passed &= same_image(expected, actual);
+      free_operand(a, A);
+    }
+  }
+  passed &= tuner.cache_len == 3 && tuner.cache_hits == 3;
+  struct hadamard_plan plan = plan_hadamard_transpose(&tuner, TENSOR_CSR, NDIM1, NDIM2, TENSOR_COO, B, TENSOR_CSR, C);
+  printf("  %s autotune: csr from coo/csr runs %s (predicted %.0f ns)\n", passed ? "PASS" : "FAIL", plan.variant->name,
+         plan.predicted_ns);
+  free_hadamard_tuner(&tuner);
+
+  // Every other configuration priced out: the plan converts both operands to reach csr_csr_csc_merge
+  const struct hadamard_variant *favoured = find_hadamard_variant_named("csr_csr_csc_merge");
+  for (size_t v = 0; v < num_hadamard_variants; ++v)
+    for (size_t f = 0; f < COST_FEATURES; ++f)
+      model.kernel_ns[v][f] = &hadamard_variants[v] == favoured ? 0.25 : 1e6;
+  init_hadamard_tuner(&tuner, &model);
+  plan = plan_hadamard_transpose(&tuner, TENSOR_CSR, NDIM1, NDIM2, TENSOR_COO, B, TENSOR_CSR, C);
+  int favoured_passed = plan.variant == favoured && plan.convert_b && plan.convert_c && !plan.sort_b && !plan.sort_c;
+  void *A = hadamard_transpose_auto(&tuner, TENSOR_CSR, NDIM1, NDIM2, TENSOR_COO, B, TENSOR_CSR, C, false);
+  image(TENSOR_CSR, A, NDIM1, NDIM2, actual);
+  favoured_passed &= same_image(expected, actual);
+  free_operand(TENSOR_CSR, A);
+  free_hadamard_tuner(&tuner);
+  printf("  %s autotune: cost model selects %s\n", favoured_passed ? "PASS" : "FAIL", favoured->name);
+  passed &= favoured_passed;
+
+  // Save and load
+  model.to_coo_ns = 1.5;
+  model.index_ns = 32.25;
+  char path[] = "/tmp/cost_model_XXXXXX";
+  int fd = mkstemp(path);
+  struct cost_model loaded;
+  default_cost_model(&loaded);
+  int round_trip = fd >= 0 && save_cost_model(&model, path) == 0 && load_cost_model(&loaded, path) == 0;
+  for (size_t v = 0; v < num_hadamard_variants; ++v)
+    for (size_t f = 0; f < COST_FEATURES; ++f)
+      round_trip &= loaded.kernel_ns[v][f] == model.kernel_ns[v][f];
+  round_trip &= loaded.to_coo_ns == model.to_coo_ns && loaded.index_ns == model.index_ns &&
+                loaded.from_coo_ns == model.from_coo_ns && loaded.sort_ns == model.sort_ns;
+  if (fd >= 0) {
+    close(fd);
+    unlink(path);
+  }
+  printf("  %s autotune: cost model file round trip\n", round_trip ? "PASS" : "FAIL");
+  passed &= round_trip;
+
+  free(expected);
+  free(actual);
+  free_operand(TENSOR_COO, B);
+  free_operand(TENSOR_CSR, C);
+  return passed;
+}
+
+int main() {
+  int passed = 1;
+
+  printf("Running Hadamard Transpose Dispatch Test\n");
+  printf("=========================================\n");
+
+  for (size_t v = 0; v < num_hadamard_variants; ++v) {
+    const struct hadamard_variant *variant = &hadamard_variants[v];
+    passed &= verify_variant(variant);
+    passed &= find_hadamard_variant(variant->a, variant->b, variant->c, variant->search) == variant &&
+              find_hadamard_variant_named(variant->name) == variant;
+  }
+  // A combination without an implementation is reported, not run
+  passed &= find_hadamard_variant(TENSOR_COO, TENSOR_COO, TENSOR_COO, HADAMARD_SEARCH_MERGE) == NULL;
+  passed &=
+      hadamard_transpose_dispatch(TENSOR_COO, TENSOR_COO, TENSOR_COO, HADAMARD_SEARCH_MERGE, NULL, NULL, NULL) == -1;
+  passed &= verify_autotune();
+
+  // Every tensor above was freed, so the allocation accounting is back to zero
+  struct tensor_memory memory = tensor_memory();
+  int released = memory.live_bytes == 0 && memory.peak_bytes > 0 && memory.allocations > 0;
+  printf("  %s tensor memory: %zu allocations released, peak %zu bytes\n", released ? "PASS" : "FAIL",
+         memory.allocations, memory.peak_bytes);
+  passed &= released;
+
+  release_arena_pool();
+  printf("\n=========================================\n");
+  printf("Test Result: %s\n", passed ? "PASSED" : "FAILED");
+  return passed ? 0 : 1;
+}
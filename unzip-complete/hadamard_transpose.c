@@ -1,4 +1,32 @@
 #include "hadamard_transpose.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(PARALLEL)
+#include <omp.h>
+#endif
+
+// Appending kernels grow A as they go in GROWABLE_OUTPUT builds; otherwise A must already have room for every entry
+// (see hadamard_transpose_count). Kernels that know the exact nnz before writing reserve it in either build.
+#if defined(GROWABLE_OUTPUT)
+#define GROW_OUTPUT(T, nnz) grow_tensor(T, nnz)
+#else
+#define GROW_OUTPUT(T, nnz)
+#endif
+
+// Kernel workspace (merge cursors, per-thread offsets). The kernels return no status, so running out of memory ends
+// the program, as it does for tensor storage.
+static void *workspace_alloc(size_t bytes) {
+  void *workspace = malloc(bytes);
+  if (!workspace && bytes > 0) {
+    fprintf(stderr, "hadamard_transpose: cannot allocate %zu bytes of workspace: %s\n", bytes, strerror(errno));
+    exit(1);
+  }
+  return workspace;
+}
 
 // =============================================================================
 // FORMAT_A=CSR, FORMAT_B=CSR, FORMAT_C=CSR
@@ -14,14 +42,15 @@ void hadamard_transpose(struct csr *A, struct csr *B, struct csr *C) {
     size_t b_row_end = B->lvl2_pos[i + 1];
     for (size_t b_idx = b_row_start; b_idx < b_row_end; ++b_idx) {
       size_t j = B->lvl2_crd[b_idx];
-      double b_val = B->vals[b_idx];
+      value_t b_val = B->vals[b_idx];
       // Locate C(j,i): search row j of C for column i
       size_t c_row_start = C->lvl2_pos[j];
       size_t c_row_end = C->lvl2_pos[j + 1];
       for (size_t c_idx = c_row_start; c_idx < c_row_end; ++c_idx) {
         if (C->lvl2_crd[c_idx] == i) {
-          double c_val = C->vals[c_idx];
+          value_t c_val = C->vals[c_idx];
           size_t nnz = A->lvl2_nnz;
+          GROW_OUTPUT(A, nnz + 1);
           A->lvl2_crd[nnz] = j;
           A->vals[nnz] = b_val * c_val;
           A->lvl2_nnz = nnz + 1;
@@ -32,34 +61,290 @@ void hadamard_transpose(struct csr *A, struct csr *B, struct csr *C) {
     A->lvl2_pos[i + 1] = A->lvl2_nnz;
   }
 }
+
+#define INDEPENDENT_SLICES
+// Matches in row i of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csr *A, struct csr *B, struct csr *C, size_t i,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  for (size_t b_idx = B->lvl2_pos[i]; b_idx < B->lvl2_pos[i + 1]; ++b_idx) {
+    size_t j = B->lvl2_crd[b_idx];
+    for (size_t c_idx = C->lvl2_pos[j]; c_idx < C->lvl2_pos[j + 1]; ++c_idx) {
+      if (C->lvl2_crd[c_idx] == i) {
+        if (emit) {
+          A->lvl2_crd[offset + count] = j;
+          A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+        }
+        ++count;
+        break;
+      }
+    }
+  }
+  return count;
+}
 #elif defined(SEARCH_B)
 #define IMPLEMENTED
 // Iterate C(j,i) in CSR, locate B(i,j) in CSR, output A(i,j) in CSR
+// C is visited row j by row j, so matches arrive out of A's row order: count them per row of A first, then scatter
+// each match into its row using A->lvl2_pos[i] as the insertion cursor. Expects A to have been reset.
 void hadamard_transpose(struct csr *A, struct csr *B, struct csr *C) {
+  // Pass 1: count matches per row i of A
   for (size_t j = 0; j < C->lvl1_size; ++j) {
     size_t c_row_start = C->lvl2_pos[j];
     size_t c_row_end = C->lvl2_pos[j + 1];
     for (size_t c_idx = c_row_start; c_idx < c_row_end; ++c_idx) {
       size_t i = C->lvl2_crd[c_idx];
-      double c_val = C->vals[c_idx];
       // Locate B(i,j): search row i of B for column j
       size_t b_row_start = B->lvl2_pos[i];
       size_t b_row_end = B->lvl2_pos[i + 1];
       for (size_t b_idx = b_row_start; b_idx < b_row_end; ++b_idx) {
         if (B->lvl2_crd[b_idx] == j) {
-          double b_val = B->vals[b_idx];
-          size_t nnz = A->lvl2_nnz;
+          A->lvl2_pos[i + 1]++;
+          break;
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < A->lvl1_size; ++i) {
+    A->lvl2_pos[i + 1] += A->lvl2_pos[i];
+  }
+  reserve_tensor(A, A->lvl2_pos[A->lvl1_size]);
+
+  // Pass 2: scatter matches, advancing A->lvl2_pos[i] to the next free slot of row i
+  for (size_t j = 0; j < C->lvl1_size; ++j) {
+    size_t c_row_start = C->lvl2_pos[j];
+    size_t c_row_end = C->lvl2_pos[j + 1];
+    for (size_t c_idx = c_row_start; c_idx < c_row_end; ++c_idx) {
+      size_t i = C->lvl2_crd[c_idx];
+      value_t c_val = C->vals[c_idx];
+      size_t b_row_start = B->lvl2_pos[i];
+      size_t b_row_end = B->lvl2_pos[i + 1];
+      for (size_t b_idx = b_row_start; b_idx < b_row_end; ++b_idx) {
+        if (B->lvl2_crd[b_idx] == j) {
+          value_t b_val = B->vals[b_idx];
+          size_t nnz = A->lvl2_pos[i]++;
           A->lvl2_crd[nnz] = j;
           A->vals[nnz] = b_val * c_val;
-          A->lvl2_nnz = nnz + 1;
           break;
         }
       }
     }
-    A->lvl2_pos[j + 1] = A->lvl2_nnz;
   }
+
+  // Cursors now hold row ends: shift them back into row starts
+  for (size_t i = A->lvl1_size; i > 0; --i) {
+    A->lvl2_pos[i] = A->lvl2_pos[i - 1];
+  }
+  A->lvl2_pos[0] = 0;
+  A->lvl2_nnz = A->lvl2_pos[A->lvl1_size];
+}
+
+// Matches over all rows j of C, as counted by pass 1 of the kernel
+size_t hadamard_transpose_count(struct csr *A, struct csr *B, struct csr *C) {
+  (void)A;
+  size_t nnz = 0;
+  for (size_t j = 0; j < C->lvl1_size; ++j) {
+    for (size_t c_idx = C->lvl2_pos[j]; c_idx < C->lvl2_pos[j + 1]; ++c_idx) {
+      size_t i = C->lvl2_crd[c_idx];
+      for (size_t b_idx = B->lvl2_pos[i]; b_idx < B->lvl2_pos[i + 1]; ++b_idx) {
+        if (B->lvl2_crd[b_idx] == j) {
+          ++nnz;
+          break;
+        }
+      }
+    }
+  }
+  return nnz;
+}
+
+#if defined(PARALLEL)
+// Rows j of C are split across threads; counts and insertion cursors of A's rows are shared and updated atomically.
+// Scattered rows come out in thread order and are sorted by column afterwards.
+#define PARALLEL_SORTS_OUTPUT
+void hadamard_transpose_parallel(struct csr *A, struct csr *B, struct csr *C) {
+  // Symbolic pass: count matches per row i of A
+#pragma omp parallel for schedule(dynamic, 64)
+  for (size_t j = 0; j < C->lvl1_size; ++j) {
+    for (size_t c_idx = C->lvl2_pos[j]; c_idx < C->lvl2_pos[j + 1]; ++c_idx) {
+      size_t i = C->lvl2_crd[c_idx];
+      for (size_t b_idx = B->lvl2_pos[i]; b_idx < B->lvl2_pos[i + 1]; ++b_idx) {
+        if (B->lvl2_crd[b_idx] == j) {
+#pragma omp atomic
+          A->lvl2_pos[i + 1]++;
+          break;
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < A->lvl1_size; ++i) {
+    A->lvl2_pos[i + 1] += A->lvl2_pos[i];
+  }
+  reserve_tensor(A, A->lvl2_pos[A->lvl1_size]);
+
+  // Numeric pass: scatter matches through the shared row cursors
+#pragma omp parallel for schedule(dynamic, 64)
+  for (size_t j = 0; j < C->lvl1_size; ++j) {
+    for (size_t c_idx = C->lvl2_pos[j]; c_idx < C->lvl2_pos[j + 1]; ++c_idx) {
+      size_t i = C->lvl2_crd[c_idx];
+      for (size_t b_idx = B->lvl2_pos[i]; b_idx < B->lvl2_pos[i + 1]; ++b_idx) {
+        if (B->lvl2_crd[b_idx] == j) {
+          size_t nnz;
+#pragma omp atomic capture
+          nnz = A->lvl2_pos[i]++;
+          A->lvl2_crd[nnz] = j;
+          A->vals[nnz] = B->vals[b_idx] * C->vals[c_idx];
+          break;
+        }
+      }
+    }
+  }
+
+  for (size_t i = A->lvl1_size; i > 0; --i) {
+    A->lvl2_pos[i] = A->lvl2_pos[i - 1];
+  }
+  A->lvl2_pos[0] = 0;
+  A->lvl2_nnz = A->lvl2_pos[A->lvl1_size];
+  sort_tensor(A);
 }
 #endif
+#elif defined(SEARCH_MERGE)
+#define IMPLEMENTED
+// Iterate B(i,j) in CSR, locate C(j,i) in CSR through a transposed cursor, output A(i,j) in CSR
+// Rows of B are visited in ascending i, so within each sorted row j of C the entry C(j,i) can only lie at or after
+// the last position looked at: cursor[j] only moves forward, and C is scanned once overall.
+void hadamard_transpose(struct csr *A, struct csr *B, struct csr *C) {
+  assert(B->sorted && C->sorted);
+  index_t *cursor = workspace_alloc(C->lvl1_size * sizeof(index_t));
+  for (size_t j = 0; j < C->lvl1_size; ++j) {
+    cursor[j] = C->lvl2_pos[j];
+  }
+
+  for (size_t i = 0; i < B->lvl1_size; ++i) {
+    size_t b_row_start = B->lvl2_pos[i];
+    size_t b_row_end = B->lvl2_pos[i + 1];
+    for (size_t b_idx = b_row_start; b_idx < b_row_end; ++b_idx) {
+      size_t j = B->lvl2_crd[b_idx];
+      value_t b_val = B->vals[b_idx];
+      // Locate C(j,i): advance the cursor of row j of C past columns before i
+      size_t c_idx = cursor[j];
+      size_t c_row_end = C->lvl2_pos[j + 1];
+      while (c_idx < c_row_end && C->lvl2_crd[c_idx] < i) {
+        ++c_idx;
+      }
+      cursor[j] = c_idx;
+      if (c_idx < c_row_end && C->lvl2_crd[c_idx] == i) {
+        value_t c_val = C->vals[c_idx];
+        size_t nnz = A->lvl2_nnz;
+        GROW_OUTPUT(A, nnz + 1);
+        A->lvl2_crd[nnz] = j;
+        A->vals[nnz] = b_val * c_val;
+        A->lvl2_nnz = nnz + 1;
+      }
+    }
+    A->lvl2_pos[i + 1] = A->lvl2_nnz;
+  }
+
+  free(cursor);
+}
+
+// Matches in row i of A through the cursors, written from position offset on when emit is set
+static inline size_t merge_slice(struct csr *A, struct csr *B, struct csr *C, index_t *cursor, size_t i, size_t offset,
+                                 const bool emit) {
+  size_t count = 0;
+  for (size_t b_idx = B->lvl2_pos[i]; b_idx < B->lvl2_pos[i + 1]; ++b_idx) {
+    size_t j = B->lvl2_crd[b_idx];
+    size_t c_idx = cursor[j];
+    size_t c_end = C->lvl2_pos[j + 1];
+    while (c_idx < c_end && C->lvl2_crd[c_idx] < i) {
+      ++c_idx;
+    }
+    cursor[j] = c_idx;
+    if (c_idx < c_end && C->lvl2_crd[c_idx] == i) {
+      if (emit) {
+        A->lvl2_crd[offset + count] = j;
+        A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+      }
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Cursors start at the beginning of every row of C and sweep forward as in the serial kernel
+size_t hadamard_transpose_count(struct csr *A, struct csr *B, struct csr *C) {
+  assert(B->sorted && C->sorted);
+  index_t *cursor = workspace_alloc(C->lvl1_size * sizeof(index_t));
+  for (size_t s = 0; s < C->lvl1_size; ++s) {
+    cursor[s] = C->lvl2_pos[s];
+  }
+
+  size_t nnz = 0;
+  for (size_t i = 0; i < B->lvl1_size; ++i) {
+    nnz += merge_slice(A, B, C, cursor, i, 0, false);
+  }
+
+  free(cursor);
+  return nnz;
+}
+
+#if defined(PARALLEL)
+// Point every cursor at the first entry of its row of C with coordinate >= first
+static void seek_cursors(struct csr *C, index_t *cursor, size_t first) {
+  for (size_t s = 0; s < C->lvl1_size; ++s) {
+    size_t lo = C->lvl2_pos[s];
+    size_t hi = C->lvl2_pos[s + 1];
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (C->lvl2_crd[mid] < first)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    cursor[s] = lo;
+  }
+}
+
+// Each thread takes a contiguous block of rows of B with private cursors, positioned by binary search at the
+// start of its block
+void hadamard_transpose_parallel(struct csr *A, struct csr *B, struct csr *C) {
+  assert(B->sorted && C->sorted);
+  size_t num_slices = B->lvl1_size;
+  A->lvl2_pos[0] = 0;
+#pragma omp parallel
+  {
+    size_t num_threads = omp_get_num_threads();
+    size_t thread_id = omp_get_thread_num();
+    size_t first = num_slices * thread_id / num_threads;
+    size_t last = num_slices * (thread_id + 1) / num_threads;
+    index_t *cursor = workspace_alloc(C->lvl1_size * sizeof(index_t));
+
+    // Symbolic pass
+    seek_cursors(C, cursor, first);
+    for (size_t i = first; i < last; ++i) {
+      A->lvl2_pos[i + 1] = merge_slice(A, B, C, cursor, i, 0, false);
+    }
+
+#pragma omp barrier
+#pragma omp single
+    {
+      for (size_t s = 0; s < num_slices; ++s) {
+        A->lvl2_pos[s + 1] += A->lvl2_pos[s];
+      }
+      A->lvl2_nnz = A->lvl2_pos[num_slices];
+      reserve_tensor(A, A->lvl2_nnz);
+    }
+
+    // Numeric pass
+    seek_cursors(C, cursor, first);
+    for (size_t i = first; i < last; ++i) {
+      merge_slice(A, B, C, cursor, i, A->lvl2_pos[i], true);
+    }
+
+    free(cursor);
+  }
+}
+#endif
+#endif
 
 // =============================================================================
 // FORMAT_A=CSR, FORMAT_B=CSR, FORMAT_C=CSC
@@ -75,14 +360,15 @@ void hadamard_transpose(struct csr *A, struct csr *B, struct csc *C) {
     size_t b_row_end = B->lvl2_pos[i + 1];
     for (size_t b_idx = b_row_start; b_idx < b_row_end; ++b_idx) {
       size_t j = B->lvl2_crd[b_idx];
-      double b_val = B->vals[b_idx];
+      value_t b_val = B->vals[b_idx];
       // Locate C(j,i): search column i of C for row j
       size_t c_col_start = C->lvl2_pos[i];
       size_t c_col_end = C->lvl2_pos[i + 1];
       for (size_t c_idx = c_col_start; c_idx < c_col_end; ++c_idx) {
         if (C->lvl2_crd[c_idx] == j) {
-          double c_val = C->vals[c_idx];
+          value_t c_val = C->vals[c_idx];
           size_t nnz = A->lvl2_nnz;
+          GROW_OUTPUT(A, nnz + 1);
           A->lvl2_crd[nnz] = j;
           A->vals[nnz] = b_val * c_val;
           A->lvl2_nnz = nnz + 1;
@@ -93,6 +379,27 @@ void hadamard_transpose(struct csr *A, struct csr *B, struct csc *C) {
     A->lvl2_pos[i + 1] = A->lvl2_nnz;
   }
 }
+
+#define INDEPENDENT_SLICES
+// Matches in row i of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csr *A, struct csr *B, struct csc *C, size_t i,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  for (size_t b_idx = B->lvl2_pos[i]; b_idx < B->lvl2_pos[i + 1]; ++b_idx) {
+    size_t j = B->lvl2_crd[b_idx];
+    for (size_t c_idx = C->lvl2_pos[i]; c_idx < C->lvl2_pos[i + 1]; ++c_idx) {
+      if (C->lvl2_crd[c_idx] == j) {
+        if (emit) {
+          A->lvl2_crd[offset + count] = j;
+          A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+        }
+        ++count;
+        break;
+      }
+    }
+  }
+  return count;
+}
 #elif defined(SEARCH_B)
 #define IMPLEMENTED
 // Iterate C(j,i) in CSC, locate B(i,j) in CSR, output A(i,j) in CSR
@@ -102,14 +409,15 @@ void hadamard_transpose(struct csr *A, struct csr *B, struct csc *C) {
     size_t c_col_end = C->lvl2_pos[i + 1];
     for (size_t c_idx = c_col_start; c_idx < c_col_end; ++c_idx) {
       size_t j = C->lvl2_crd[c_idx];
-      double c_val = C->vals[c_idx];
+      value_t c_val = C->vals[c_idx];
       // Locate B(i,j): search row i of B for column j
       size_t b_row_start = B->lvl2_pos[i];
       size_t b_row_end = B->lvl2_pos[i + 1];
       for (size_t b_idx = b_row_start; b_idx < b_row_end; ++b_idx) {
         if (B->lvl2_crd[b_idx] == j) {
-          double b_val = B->vals[b_idx];
+          value_t b_val = B->vals[b_idx];
           size_t nnz = A->lvl2_nnz;
+          GROW_OUTPUT(A, nnz + 1);
           A->lvl2_crd[nnz] = j;
           A->vals[nnz] = b_val * c_val;
           A->lvl2_nnz = nnz + 1;
@@ -120,6 +428,85 @@ void hadamard_transpose(struct csr *A, struct csr *B, struct csc *C) {
     A->lvl2_pos[i + 1] = A->lvl2_nnz;
   }
 }
+
+#define INDEPENDENT_SLICES
+// Matches in row i of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csr *A, struct csr *B, struct csc *C, size_t i,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  for (size_t c_idx = C->lvl2_pos[i]; c_idx < C->lvl2_pos[i + 1]; ++c_idx) {
+    size_t j = C->lvl2_crd[c_idx];
+    for (size_t b_idx = B->lvl2_pos[i]; b_idx < B->lvl2_pos[i + 1]; ++b_idx) {
+      if (B->lvl2_crd[b_idx] == j) {
+        if (emit) {
+          A->lvl2_crd[offset + count] = j;
+          A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+        }
+        ++count;
+        break;
+      }
+    }
+  }
+  return count;
+}
+#elif defined(SEARCH_MERGE)
+#define IMPLEMENTED
+// Intersect row i of B(i,j) in CSR with column i of C(j,i) in CSC, output A(i,j) in CSR
+void hadamard_transpose(struct csr *A, struct csr *B, struct csc *C) {
+  assert(B->sorted && C->sorted);
+  for (size_t i = 0; i < B->lvl1_size; ++i) {
+    size_t b_idx = B->lvl2_pos[i];
+    size_t b_row_end = B->lvl2_pos[i + 1];
+    size_t c_idx = C->lvl2_pos[i];
+    size_t c_col_end = C->lvl2_pos[i + 1];
+    // Two-pointer merge over j; duplicates in B each pair with the first matching C(j,i)
+    while (b_idx < b_row_end && c_idx < c_col_end) {
+      size_t b_j = B->lvl2_crd[b_idx];
+      size_t c_j = C->lvl2_crd[c_idx];
+      if (b_j < c_j) {
+        ++b_idx;
+      } else if (c_j < b_j) {
+        ++c_idx;
+      } else {
+        size_t nnz = A->lvl2_nnz;
+        GROW_OUTPUT(A, nnz + 1);
+        A->lvl2_crd[nnz] = b_j;
+        A->vals[nnz] = B->vals[b_idx] * C->vals[c_idx];
+        A->lvl2_nnz = nnz + 1;
+        ++b_idx;
+      }
+    }
+    A->lvl2_pos[i + 1] = A->lvl2_nnz;
+  }
+}
+
+#define INDEPENDENT_SLICES
+// Matches in row i of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csr *A, struct csr *B, struct csc *C, size_t i,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  size_t b_idx = B->lvl2_pos[i];
+  size_t b_row_end = B->lvl2_pos[i + 1];
+  size_t c_idx = C->lvl2_pos[i];
+  size_t c_col_end = C->lvl2_pos[i + 1];
+  while (b_idx < b_row_end && c_idx < c_col_end) {
+    size_t b_j = B->lvl2_crd[b_idx];
+    size_t c_j = C->lvl2_crd[c_idx];
+    if (b_j < c_j) {
+      ++b_idx;
+    } else if (c_j < b_j) {
+      ++c_idx;
+    } else {
+      if (emit) {
+        A->lvl2_crd[offset + count] = b_j;
+        A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+      }
+      ++count;
+      ++b_idx;
+    }
+  }
+  return count;
+}
 #endif
 
 // =============================================================================
@@ -136,12 +523,13 @@ void hadamard_transpose(struct csr *A, struct csr *B, struct coo *C) {
     size_t b_row_end = B->lvl2_pos[i + 1];
     for (size_t b_idx = b_row_start; b_idx < b_row_end; ++b_idx) {
       size_t j = B->lvl2_crd[b_idx];
-      double b_val = B->vals[b_idx];
+      value_t b_val = B->vals[b_idx];
       // Locate C(j,i): search COO for entry (j,i)
       for (size_t c_idx = 0; c_idx < C->lvl1_nnz; ++c_idx) {
         if (C->lvl1_crd[c_idx] == j && C->lvl2_crd[c_idx] == i) {
-          double c_val = C->vals[c_idx];
+          value_t c_val = C->vals[c_idx];
           size_t nnz = A->lvl2_nnz;
+          GROW_OUTPUT(A, nnz + 1);
           A->lvl2_crd[nnz] = j;
           A->vals[nnz] = b_val * c_val;
           A->lvl2_nnz = nnz + 1;
@@ -152,74 +540,71 @@ void hadamard_transpose(struct csr *A, struct csr *B, struct coo *C) {
     A->lvl2_pos[i + 1] = A->lvl2_nnz;
   }
 }
-#endif
 
-// =============================================================================
-// FORMAT_A=CSR, FORMAT_B=COO, FORMAT_C=CSR
-// =============================================================================
-
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_COO) && defined(FORMAT_C_CSR)
-#if defined(SEARCH_C)
-#define IMPLEMENTED
-// Iterate B(i,j) in COO, locate C(j,i) in CSR, output A(i,j) in CSR
-void hadamard_transpose(struct csr *A, struct coo *B, struct csr *C) {
-  for (size_t i = 0; i < A->lvl1_size; ++i) {
-    for (size_t b_idx = 0; b_idx < B->lvl1_nnz; ++b_idx) {
-      if (B->lvl1_crd[b_idx] == i) {
-        size_t j = B->lvl2_crd[b_idx];
-        double b_val = B->vals[b_idx];
-        // Locate C(j,i): search row j of C for column i
-        size_t c_row_start = C->lvl2_pos[j];
-        size_t c_row_end = C->lvl2_pos[j + 1];
-        for (size_t c_idx = c_row_start; c_idx < c_row_end; ++c_idx) {
-          if (C->lvl2_crd[c_idx] == i) {
-            double c_val = C->vals[c_idx];
-            size_t nnz = A->lvl2_nnz;
-            A->lvl2_crd[nnz] = j;
-            A->vals[nnz] = b_val * c_val;
-            A->lvl2_nnz = nnz + 1;
-            break;
-          }
+#define INDEPENDENT_SLICES
+// Matches in row i of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csr *A, struct csr *B, struct coo *C, size_t i,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  for (size_t b_idx = B->lvl2_pos[i]; b_idx < B->lvl2_pos[i + 1]; ++b_idx) {
+    size_t j = B->lvl2_crd[b_idx];
+    for (size_t c_idx = 0; c_idx < C->lvl1_nnz; ++c_idx) {
+      if (C->lvl1_crd[c_idx] == j && C->lvl2_crd[c_idx] == i) {
+        if (emit) {
+          A->lvl2_crd[offset + count] = j;
+          A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
         }
+        ++count;
+        break;
       }
     }
-    A->lvl2_pos[i + 1] = A->lvl2_nnz;
   }
+  return count;
 }
-#endif
-
-// =============================================================================
-// FORMAT_A=CSR, FORMAT_B=COO, FORMAT_C=CSC
-// =============================================================================
-
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_COO) && defined(FORMAT_C_CSC)
-#if defined(SEARCH_C)
+#elif defined(SEARCH_HASH)
 #define IMPLEMENTED
-// Iterate B(i,j) in COO, locate C(j,i) in CSC, output A(i,j) in CSR
-void hadamard_transpose(struct csr *A, struct coo *B, struct csc *C) {
-  for (size_t i = 0; i < A->lvl1_size; ++i) {
-    for (size_t b_idx = 0; b_idx < B->lvl1_nnz; ++b_idx) {
-      if (B->lvl1_crd[b_idx] == i) {
-        size_t j = B->lvl2_crd[b_idx];
-        double b_val = B->vals[b_idx];
-        // Locate C(j,i): search column i of C for row j
-        size_t c_col_start = C->lvl2_pos[i];
-        size_t c_col_end = C->lvl2_pos[i + 1];
-        for (size_t c_idx = c_col_start; c_idx < c_col_end; ++c_idx) {
-          if (C->lvl2_crd[c_idx] == j) {
-            double c_val = C->vals[c_idx];
-            size_t nnz = A->lvl2_nnz;
-            A->lvl2_crd[nnz] = j;
-            A->vals[nnz] = b_val * c_val;
-            A->lvl2_nnz = nnz + 1;
-            break;
-          }
-        }
+// Iterate B(i,j) in CSR, locate C(j,i) in COO through its hash index, output A(i,j) in CSR
+void hadamard_transpose(struct csr *A, struct csr *B, struct coo *C) {
+  assert(C->index_slots);
+  for (size_t i = 0; i < B->lvl1_size; ++i) {
+    size_t b_row_start = B->lvl2_pos[i];
+    size_t b_row_end = B->lvl2_pos[i + 1];
+    for (size_t b_idx = b_row_start; b_idx < b_row_end; ++b_idx) {
+      size_t j = B->lvl2_crd[b_idx];
+      value_t b_val = B->vals[b_idx];
+      // Locate C(j,i): probe the index for entry (j,i)
+      size_t c_idx = coo_index_find(C, j, i);
+      if (c_idx != COO_INDEX_EMPTY) {
+        value_t c_val = C->vals[c_idx];
+        size_t nnz = A->lvl2_nnz;
+        GROW_OUTPUT(A, nnz + 1);
+        A->lvl2_crd[nnz] = j;
+        A->vals[nnz] = b_val * c_val;
+        A->lvl2_nnz = nnz + 1;
       }
     }
     A->lvl2_pos[i + 1] = A->lvl2_nnz;
   }
 }
+
+#define INDEPENDENT_SLICES
+// Matches in row i of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csr *A, struct csr *B, struct coo *C, size_t i,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  for (size_t b_idx = B->lvl2_pos[i]; b_idx < B->lvl2_pos[i + 1]; ++b_idx) {
+    size_t j = B->lvl2_crd[b_idx];
+    size_t c_idx = coo_index_find(C, j, i);
+    if (c_idx != COO_INDEX_EMPTY) {
+      if (emit) {
+        A->lvl2_crd[offset + count] = j;
+        A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+      }
+      ++count;
+    }
+  }
+  return count;
+}
 #endif
 
 // =============================================================================
@@ -227,32 +612,103 @@ void hadamard_transpose(struct csr *A, struct coo *B, struct csc *C) {
 // =============================================================================
 
 #elif defined(FORMAT_A_CSR) && defined(FORMAT_B_COO) && defined(FORMAT_C_COO)
-#if defined(SEARCH_C)
+#if defined(SEARCH_HASH)
 #define IMPLEMENTED
-// Iterate B(i,j) in COO, locate C(j,i) in COO, output A(i,j) in CSR
+// Iterate B(i,j) in COO, locate C(j,i) in COO through its hash index, output A(i,j) in CSR
+// B is visited once in storage order: matches are counted per row of A first, then scattered into their rows using
+// A->lvl2_pos[i] as the insertion cursor. Expects A to have been reset.
 void hadamard_transpose(struct csr *A, struct coo *B, struct coo *C) {
+  assert(C->index_slots);
+  // Pass 1: count matches per row i of A
+  for (size_t b_idx = 0; b_idx < B->lvl1_nnz; ++b_idx) {
+    size_t i = B->lvl1_crd[b_idx];
+    size_t j = B->lvl2_crd[b_idx];
+    if (coo_index_find(C, j, i) != COO_INDEX_EMPTY) {
+      A->lvl2_pos[i + 1]++;
+    }
+  }
   for (size_t i = 0; i < A->lvl1_size; ++i) {
-    for (size_t b_idx = 0; b_idx < B->lvl1_nnz; ++b_idx) {
-      if (B->lvl1_crd[b_idx] == i) {
-        size_t j = B->lvl2_crd[b_idx];
-        double b_val = B->vals[b_idx];
-        // Locate C(j,i): search COO for entry (j,i)
-        for (size_t c_idx = 0; c_idx < C->lvl1_nnz; ++c_idx) {
-          if (C->lvl1_crd[c_idx] == j && C->lvl2_crd[c_idx] == i) {
-            double c_val = C->vals[c_idx];
-            size_t nnz = A->lvl2_nnz;
-            A->lvl2_crd[nnz] = j;
-            A->vals[nnz] = b_val * c_val;
-            A->lvl2_nnz = nnz + 1;
-            break;
-          }
-        }
-      }
+    A->lvl2_pos[i + 1] += A->lvl2_pos[i];
+  }
+  reserve_tensor(A, A->lvl2_pos[A->lvl1_size]);
+
+  // Pass 2: scatter matches, advancing A->lvl2_pos[i] to the next free slot of row i
+  for (size_t b_idx = 0; b_idx < B->lvl1_nnz; ++b_idx) {
+    size_t i = B->lvl1_crd[b_idx];
+    size_t j = B->lvl2_crd[b_idx];
+    size_t c_idx = coo_index_find(C, j, i);
+    if (c_idx != COO_INDEX_EMPTY) {
+      size_t nnz = A->lvl2_pos[i]++;
+      A->lvl2_crd[nnz] = j;
+      A->vals[nnz] = B->vals[b_idx] * C->vals[c_idx];
     }
-    A->lvl2_pos[i + 1] = A->lvl2_nnz;
   }
+
+  // Cursors now hold row ends: shift them back into row starts
+  for (size_t i = A->lvl1_size; i > 0; --i) {
+    A->lvl2_pos[i] = A->lvl2_pos[i - 1];
+  }
+  A->lvl2_pos[0] = 0;
+  A->lvl2_nnz = A->lvl2_pos[A->lvl1_size];
+}
+
+// Entries of B whose transposed coordinate is in the index of C, as counted by pass 1 of the kernel
+size_t hadamard_transpose_count(struct csr *A, struct coo *B, struct coo *C) {
+  (void)A;
+  assert(C->index_slots);
+  size_t nnz = 0;
+  for (size_t b_idx = 0; b_idx < B->lvl1_nnz; ++b_idx) {
+    if (coo_index_find(C, B->lvl2_crd[b_idx], B->lvl1_crd[b_idx]) != COO_INDEX_EMPTY) {
+      ++nnz;
+    }
+  }
+  return nnz;
+}
+
+#if defined(PARALLEL)
+// Entries of B are split across threads; counts and insertion cursors of A's rows are shared and updated atomically.
+// Scattered rows come out in thread order and are sorted by column afterwards.
+#define PARALLEL_SORTS_OUTPUT
+void hadamard_transpose_parallel(struct csr *A, struct coo *B, struct coo *C) {
+  assert(C->index_slots);
+  // Symbolic pass: count matches per row i of A
+#pragma omp parallel for schedule(static)
+  for (size_t b_idx = 0; b_idx < B->lvl1_nnz; ++b_idx) {
+    size_t i = B->lvl1_crd[b_idx];
+    if (coo_index_find(C, B->lvl2_crd[b_idx], i) != COO_INDEX_EMPTY) {
+#pragma omp atomic
+      A->lvl2_pos[i + 1]++;
+    }
+  }
+  for (size_t i = 0; i < A->lvl1_size; ++i) {
+    A->lvl2_pos[i + 1] += A->lvl2_pos[i];
+  }
+  reserve_tensor(A, A->lvl2_pos[A->lvl1_size]);
+
+  // Numeric pass: scatter matches through the shared row cursors
+#pragma omp parallel for schedule(static)
+  for (size_t b_idx = 0; b_idx < B->lvl1_nnz; ++b_idx) {
+    size_t i = B->lvl1_crd[b_idx];
+    size_t j = B->lvl2_crd[b_idx];
+    size_t c_idx = coo_index_find(C, j, i);
+    if (c_idx != COO_INDEX_EMPTY) {
+      size_t nnz;
+#pragma omp atomic capture
+      nnz = A->lvl2_pos[i]++;
+      A->lvl2_crd[nnz] = j;
+      A->vals[nnz] = B->vals[b_idx] * C->vals[c_idx];
+    }
+  }
+
+  for (size_t i = A->lvl1_size; i > 0; --i) {
+    A->lvl2_pos[i] = A->lvl2_pos[i - 1];
+  }
+  A->lvl2_pos[0] = 0;
+  A->lvl2_nnz = A->lvl2_pos[A->lvl1_size];
+  sort_tensor(A);
 }
 #endif
+#endif
 
 // =============================================================================
 // FORMAT_A=CSC, FORMAT_B=CSC, FORMAT_C=CSR
@@ -268,14 +724,15 @@ void hadamard_transpose(struct csc *A, struct csc *B, struct csr *C) {
     size_t b_col_end = B->lvl2_pos[j + 1];
     for (size_t b_idx = b_col_start; b_idx < b_col_end; ++b_idx) {
       size_t i = B->lvl2_crd[b_idx];
-      double b_val = B->vals[b_idx];
+      value_t b_val = B->vals[b_idx];
       // Locate C(j,i): search row j of C for column i
       size_t c_row_start = C->lvl2_pos[j];
       size_t c_row_end = C->lvl2_pos[j + 1];
       for (size_t c_idx = c_row_start; c_idx < c_row_end; ++c_idx) {
         if (C->lvl2_crd[c_idx] == i) {
-          double c_val = C->vals[c_idx];
+          value_t c_val = C->vals[c_idx];
           size_t nnz = A->lvl2_nnz;
+          GROW_OUTPUT(A, nnz + 1);
           A->lvl2_crd[nnz] = i;
           A->vals[nnz] = b_val * c_val;
           A->lvl2_nnz = nnz + 1;
@@ -286,6 +743,85 @@ void hadamard_transpose(struct csc *A, struct csc *B, struct csr *C) {
     A->lvl2_pos[j + 1] = A->lvl2_nnz;
   }
 }
+
+#define INDEPENDENT_SLICES
+// Matches in column j of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csc *A, struct csc *B, struct csr *C, size_t j,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  for (size_t b_idx = B->lvl2_pos[j]; b_idx < B->lvl2_pos[j + 1]; ++b_idx) {
+    size_t i = B->lvl2_crd[b_idx];
+    for (size_t c_idx = C->lvl2_pos[j]; c_idx < C->lvl2_pos[j + 1]; ++c_idx) {
+      if (C->lvl2_crd[c_idx] == i) {
+        if (emit) {
+          A->lvl2_crd[offset + count] = i;
+          A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+        }
+        ++count;
+        break;
+      }
+    }
+  }
+  return count;
+}
+#elif defined(SEARCH_MERGE)
+#define IMPLEMENTED
+// Intersect column j of B(i,j) in CSC with row j of C(j,i) in CSR, output A(i,j) in CSC
+void hadamard_transpose(struct csc *A, struct csc *B, struct csr *C) {
+  assert(B->sorted && C->sorted);
+  for (size_t j = 0; j < B->lvl1_size; ++j) {
+    size_t b_idx = B->lvl2_pos[j];
+    size_t b_col_end = B->lvl2_pos[j + 1];
+    size_t c_idx = C->lvl2_pos[j];
+    size_t c_row_end = C->lvl2_pos[j + 1];
+    // Two-pointer merge over i; duplicates in B each pair with the first matching C(j,i)
+    while (b_idx < b_col_end && c_idx < c_row_end) {
+      size_t b_i = B->lvl2_crd[b_idx];
+      size_t c_i = C->lvl2_crd[c_idx];
+      if (b_i < c_i) {
+        ++b_idx;
+      } else if (c_i < b_i) {
+        ++c_idx;
+      } else {
+        size_t nnz = A->lvl2_nnz;
+        GROW_OUTPUT(A, nnz + 1);
+        A->lvl2_crd[nnz] = b_i;
+        A->vals[nnz] = B->vals[b_idx] * C->vals[c_idx];
+        A->lvl2_nnz = nnz + 1;
+        ++b_idx;
+      }
+    }
+    A->lvl2_pos[j + 1] = A->lvl2_nnz;
+  }
+}
+
+#define INDEPENDENT_SLICES
+// Matches in column j of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csc *A, struct csc *B, struct csr *C, size_t j,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  size_t b_idx = B->lvl2_pos[j];
+  size_t b_col_end = B->lvl2_pos[j + 1];
+  size_t c_idx = C->lvl2_pos[j];
+  size_t c_row_end = C->lvl2_pos[j + 1];
+  while (b_idx < b_col_end && c_idx < c_row_end) {
+    size_t b_i = B->lvl2_crd[b_idx];
+    size_t c_i = C->lvl2_crd[c_idx];
+    if (b_i < c_i) {
+      ++b_idx;
+    } else if (c_i < b_i) {
+      ++c_idx;
+    } else {
+      if (emit) {
+        A->lvl2_crd[offset + count] = b_i;
+        A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+      }
+      ++count;
+      ++b_idx;
+    }
+  }
+  return count;
+}
 #endif
 
 // =============================================================================
@@ -302,14 +838,15 @@ void hadamard_transpose(struct csc *A, struct csc *B, struct csc *C) {
     size_t b_col_end = B->lvl2_pos[j + 1];
     for (size_t b_idx = b_col_start; b_idx < b_col_end; ++b_idx) {
       size_t i = B->lvl2_crd[b_idx];
-      double b_val = B->vals[b_idx];
+      value_t b_val = B->vals[b_idx];
       // Locate C(j,i): search column i of C for row j
       size_t c_col_start = C->lvl2_pos[i];
       size_t c_col_end = C->lvl2_pos[i + 1];
       for (size_t c_idx = c_col_start; c_idx < c_col_end; ++c_idx) {
         if (C->lvl2_crd[c_idx] == j) {
-          double c_val = C->vals[c_idx];
+          value_t c_val = C->vals[c_idx];
           size_t nnz = A->lvl2_nnz;
+          GROW_OUTPUT(A, nnz + 1);
           A->lvl2_crd[nnz] = i;
           A->vals[nnz] = b_val * c_val;
           A->lvl2_nnz = nnz + 1;
@@ -320,6 +857,164 @@ void hadamard_transpose(struct csc *A, struct csc *B, struct csc *C) {
     A->lvl2_pos[j + 1] = A->lvl2_nnz;
   }
 }
+
+#define INDEPENDENT_SLICES
+// Matches in column j of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csc *A, struct csc *B, struct csc *C, size_t j,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  for (size_t b_idx = B->lvl2_pos[j]; b_idx < B->lvl2_pos[j + 1]; ++b_idx) {
+    size_t i = B->lvl2_crd[b_idx];
+    for (size_t c_idx = C->lvl2_pos[i]; c_idx < C->lvl2_pos[i + 1]; ++c_idx) {
+      if (C->lvl2_crd[c_idx] == j) {
+        if (emit) {
+          A->lvl2_crd[offset + count] = i;
+          A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+        }
+        ++count;
+        break;
+      }
+    }
+  }
+  return count;
+}
+#elif defined(SEARCH_MERGE)
+#define IMPLEMENTED
+// Iterate B(i,j) in CSC, locate C(j,i) in CSC through a transposed cursor, output A(i,j) in CSC
+// Columns of B are visited in ascending j, so within each sorted column i of C the entry C(j,i) can only lie at or
+// after the last position looked at: cursor[i] only moves forward, and C is scanned once overall.
+void hadamard_transpose(struct csc *A, struct csc *B, struct csc *C) {
+  assert(B->sorted && C->sorted);
+  index_t *cursor = workspace_alloc(C->lvl1_size * sizeof(index_t));
+  for (size_t i = 0; i < C->lvl1_size; ++i) {
+    cursor[i] = C->lvl2_pos[i];
+  }
+
+  for (size_t j = 0; j < B->lvl1_size; ++j) {
+    size_t b_col_start = B->lvl2_pos[j];
+    size_t b_col_end = B->lvl2_pos[j + 1];
+    for (size_t b_idx = b_col_start; b_idx < b_col_end; ++b_idx) {
+      size_t i = B->lvl2_crd[b_idx];
+      value_t b_val = B->vals[b_idx];
+      // Locate C(j,i): advance the cursor of column i of C past rows before j
+      size_t c_idx = cursor[i];
+      size_t c_col_end = C->lvl2_pos[i + 1];
+      while (c_idx < c_col_end && C->lvl2_crd[c_idx] < j) {
+        ++c_idx;
+      }
+      cursor[i] = c_idx;
+      if (c_idx < c_col_end && C->lvl2_crd[c_idx] == j) {
+        value_t c_val = C->vals[c_idx];
+        size_t nnz = A->lvl2_nnz;
+        GROW_OUTPUT(A, nnz + 1);
+        A->lvl2_crd[nnz] = i;
+        A->vals[nnz] = b_val * c_val;
+        A->lvl2_nnz = nnz + 1;
+      }
+    }
+    A->lvl2_pos[j + 1] = A->lvl2_nnz;
+  }
+
+  free(cursor);
+}
+
+// Matches in column j of A through the cursors, written from position offset on when emit is set
+static inline size_t merge_slice(struct csc *A, struct csc *B, struct csc *C, index_t *cursor, size_t j, size_t offset,
+                                 const bool emit) {
+  size_t count = 0;
+  for (size_t b_idx = B->lvl2_pos[j]; b_idx < B->lvl2_pos[j + 1]; ++b_idx) {
+    size_t i = B->lvl2_crd[b_idx];
+    size_t c_idx = cursor[i];
+    size_t c_end = C->lvl2_pos[i + 1];
+    while (c_idx < c_end && C->lvl2_crd[c_idx] < j) {
+      ++c_idx;
+    }
+    cursor[i] = c_idx;
+    if (c_idx < c_end && C->lvl2_crd[c_idx] == j) {
+      if (emit) {
+        A->lvl2_crd[offset + count] = i;
+        A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+      }
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Cursors start at the beginning of every column of C and sweep forward as in the serial kernel
+size_t hadamard_transpose_count(struct csc *A, struct csc *B, struct csc *C) {
+  assert(B->sorted && C->sorted);
+  index_t *cursor = workspace_alloc(C->lvl1_size * sizeof(index_t));
+  for (size_t s = 0; s < C->lvl1_size; ++s) {
+    cursor[s] = C->lvl2_pos[s];
+  }
+
+  size_t nnz = 0;
+  for (size_t j = 0; j < B->lvl1_size; ++j) {
+    nnz += merge_slice(A, B, C, cursor, j, 0, false);
+  }
+
+  free(cursor);
+  return nnz;
+}
+
+#if defined(PARALLEL)
+// Point every cursor at the first entry of its column of C with coordinate >= first
+static void seek_cursors(struct csc *C, index_t *cursor, size_t first) {
+  for (size_t s = 0; s < C->lvl1_size; ++s) {
+    size_t lo = C->lvl2_pos[s];
+    size_t hi = C->lvl2_pos[s + 1];
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (C->lvl2_crd[mid] < first)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    cursor[s] = lo;
+  }
+}
+
+// Each thread takes a contiguous block of columns of B with private cursors, positioned by binary search at the
+// start of its block
+void hadamard_transpose_parallel(struct csc *A, struct csc *B, struct csc *C) {
+  assert(B->sorted && C->sorted);
+  size_t num_slices = B->lvl1_size;
+  A->lvl2_pos[0] = 0;
+#pragma omp parallel
+  {
+    size_t num_threads = omp_get_num_threads();
+    size_t thread_id = omp_get_thread_num();
+    size_t first = num_slices * thread_id / num_threads;
+    size_t last = num_slices * (thread_id + 1) / num_threads;
+    index_t *cursor = workspace_alloc(C->lvl1_size * sizeof(index_t));
+
+    // Symbolic pass
+    seek_cursors(C, cursor, first);
+    for (size_t j = first; j < last; ++j) {
+      A->lvl2_pos[j + 1] = merge_slice(A, B, C, cursor, j, 0, false);
+    }
+
+#pragma omp barrier
+#pragma omp single
+    {
+      for (size_t s = 0; s < num_slices; ++s) {
+        A->lvl2_pos[s + 1] += A->lvl2_pos[s];
+      }
+      A->lvl2_nnz = A->lvl2_pos[num_slices];
+      reserve_tensor(A, A->lvl2_nnz);
+    }
+
+    // Numeric pass
+    seek_cursors(C, cursor, first);
+    for (size_t j = first; j < last; ++j) {
+      merge_slice(A, B, C, cursor, j, A->lvl2_pos[j], true);
+    }
+
+    free(cursor);
+  }
+}
+#endif
 #endif
 
 // =============================================================================
@@ -336,12 +1031,13 @@ void hadamard_transpose(struct csc *A, struct csc *B, struct coo *C) {
     size_t b_col_end = B->lvl2_pos[j + 1];
     for (size_t b_idx = b_col_start; b_idx < b_col_end; ++b_idx) {
       size_t i = B->lvl2_crd[b_idx];
-      double b_val = B->vals[b_idx];
+      value_t b_val = B->vals[b_idx];
       // Locate C(j,i): search COO for entry (j,i)
       for (size_t c_idx = 0; c_idx < C->lvl1_nnz; ++c_idx) {
         if (C->lvl1_crd[c_idx] == j && C->lvl2_crd[c_idx] == i) {
-          double c_val = C->vals[c_idx];
+          value_t c_val = C->vals[c_idx];
           size_t nnz = A->lvl2_nnz;
+          GROW_OUTPUT(A, nnz + 1);
           A->lvl2_crd[nnz] = i;
           A->vals[nnz] = b_val * c_val;
           A->lvl2_nnz = nnz + 1;
@@ -352,10 +1048,743 @@ void hadamard_transpose(struct csc *A, struct csc *B, struct coo *C) {
     A->lvl2_pos[j + 1] = A->lvl2_nnz;
   }
 }
+
+#define INDEPENDENT_SLICES
+// Matches in column j of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csc *A, struct csc *B, struct coo *C, size_t j,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  for (size_t b_idx = B->lvl2_pos[j]; b_idx < B->lvl2_pos[j + 1]; ++b_idx) {
+    size_t i = B->lvl2_crd[b_idx];
+    for (size_t c_idx = 0; c_idx < C->lvl1_nnz; ++c_idx) {
+      if (C->lvl1_crd[c_idx] == j && C->lvl2_crd[c_idx] == i) {
+        if (emit) {
+          A->lvl2_crd[offset + count] = i;
+          A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+        }
+        ++count;
+        break;
+      }
+    }
+  }
+  return count;
+}
+#elif defined(SEARCH_HASH)
+#define IMPLEMENTED
+// Iterate B(i,j) in CSC, locate C(j,i) in COO through its hash index, output A(i,j) in CSC
+void hadamard_transpose(struct csc *A, struct csc *B, struct coo *C) {
+  assert(C->index_slots);
+  for (size_t j = 0; j < B->lvl1_size; ++j) {
+    size_t b_col_start = B->lvl2_pos[j];
+    size_t b_col_end = B->lvl2_pos[j + 1];
+    for (size_t b_idx = b_col_start; b_idx < b_col_end; ++b_idx) {
+      size_t i = B->lvl2_crd[b_idx];
+      value_t b_val = B->vals[b_idx];
+      // Locate C(j,i): probe the index for entry (j,i)
+      size_t c_idx = coo_index_find(C, j, i);
+      if (c_idx != COO_INDEX_EMPTY) {
+        value_t c_val = C->vals[c_idx];
+        size_t nnz = A->lvl2_nnz;
+        GROW_OUTPUT(A, nnz + 1);
+        A->lvl2_crd[nnz] = i;
+        A->vals[nnz] = b_val * c_val;
+        A->lvl2_nnz = nnz + 1;
+      }
+    }
+    A->lvl2_pos[j + 1] = A->lvl2_nnz;
+  }
+}
+
+#define INDEPENDENT_SLICES
+// Matches in column j of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(struct csc *A, struct csc *B, struct coo *C, size_t j,
+                                              size_t offset, const bool emit) {
+  size_t count = 0;
+  for (size_t b_idx = B->lvl2_pos[j]; b_idx < B->lvl2_pos[j + 1]; ++b_idx) {
+    size_t i = B->lvl2_crd[b_idx];
+    size_t c_idx = coo_index_find(C, j, i);
+    if (c_idx != COO_INDEX_EMPTY) {
+      if (emit) {
+        A->lvl2_crd[offset + count] = i;
+        A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+      }
+      ++count;
+    }
+  }
+  return count;
+}
+#endif
+
+#endif
+
+// =============================================================================
+// Every other configuration: composed from per-format primitives
+// =============================================================================
+
+// One operand is iterated (B for SEARCH_C, MERGE and HASH, C for SEARCH_B) and its partner located for every entry.
+// The iterated operand comes in units: the slices of a CSR/CSC operand, single entries of a COO operand. When the
+// units are the slices of A, A is appended to in order and the driver below counts and parallelises; otherwise a
+// CSR/CSC A is built by a two-pass count/scatter through A->lvl2_pos, and a COO A takes the matches in iteration order.
+
+#if !defined(IMPLEMENTED)
+#if defined(SEARCH_MERGE) && (defined(FORMAT_B_COO) || defined(FORMAT_C_COO))
+#error "SEARCH_MERGE needs CSR or CSC operands"
+#elif defined(SEARCH_HASH) && !defined(FORMAT_C_COO)
+#error "SEARCH_HASH needs FORMAT_C=COO"
+#endif
+#define IMPLEMENTED
+
+#define NO_ENTRY SIZE_MAX
+
+// Units of B, the coordinate (i,j) of its entry k, and B(i,j) located by search
+#if defined(FORMAT_B_CSR)
+static inline size_t b_units(struct csr *B) { return B->lvl1_size; }
+static inline size_t b_begin(struct csr *B, size_t u) { return B->lvl2_pos[u]; }
+static inline size_t b_end(struct csr *B, size_t u) { return B->lvl2_pos[u + 1]; }
+static inline size_t b_row(struct csr *B, size_t u, size_t k) {
+  (void)B;
+  (void)k;
+  return u;
+}
+static inline size_t b_col(struct csr *B, size_t u, size_t k) {
+  (void)u;
+  return B->lvl2_crd[k];
+}
+// Search row i of B for column j
+static inline size_t b_locate(struct csr *B, size_t i, size_t j) {
+  for (size_t b_idx = B->lvl2_pos[i]; b_idx < B->lvl2_pos[i + 1]; ++b_idx) {
+    if (B->lvl2_crd[b_idx] == j)
+      return b_idx;
+  }
+  return NO_ENTRY;
+}
+#elif defined(FORMAT_B_CSC)
+static inline size_t b_units(struct csc *B) { return B->lvl1_size; }
+static inline size_t b_begin(struct csc *B, size_t u) { return B->lvl2_pos[u]; }
+static inline size_t b_end(struct csc *B, size_t u) { return B->lvl2_pos[u + 1]; }
+static inline size_t b_row(struct csc *B, size_t u, size_t k) {
+  (void)u;
+  return B->lvl2_crd[k];
+}
+static inline size_t b_col(struct csc *B, size_t u, size_t k) {
+  (void)B;
+  (void)k;
+  return u;
+}
+// Search column j of B for row i
+static inline size_t b_locate(struct csc *B, size_t i, size_t j) {
+  for (size_t b_idx = B->lvl2_pos[j]; b_idx < B->lvl2_pos[j + 1]; ++b_idx) {
+    if (B->lvl2_crd[b_idx] == i)
+      return b_idx;
+  }
+  return NO_ENTRY;
+}
+#elif defined(FORMAT_B_COO)
+static inline size_t b_units(struct coo *B) { return B->lvl1_nnz; }
+static inline size_t b_begin(struct coo *B, size_t u) {
+  (void)B;
+  return u;
+}
+static inline size_t b_end(struct coo *B, size_t u) {
+  (void)B;
+  return u + 1;
+}
+static inline size_t b_row(struct coo *B, size_t u, size_t k) {
+  (void)u;
+  return B->lvl1_crd[k];
+}
+static inline size_t b_col(struct coo *B, size_t u, size_t k) {
+  (void)u;
+  return B->lvl2_crd[k];
+}
+// Search all of B for entry (i,j)
+static inline size_t b_locate(struct coo *B, size_t i, size_t j) {
+  for (size_t b_idx = 0; b_idx < B->lvl1_nnz; ++b_idx) {
+    if (B->lvl1_crd[b_idx] == i && B->lvl2_crd[b_idx] == j)
+      return b_idx;
+  }
+  return NO_ENTRY;
+}
+#endif
+
+// Units of C, the coordinate (i,j) in A of its entry k (stored as C(j,i)), and C(j,i) located by search
+#if defined(FORMAT_C_CSR)
+static inline size_t c_units(struct csr *C) { return C->lvl1_size; }
+static inline size_t c_begin(struct csr *C, size_t u) { return C->lvl2_pos[u]; }
+static inline size_t c_end(struct csr *C, size_t u) { return C->lvl2_pos[u + 1]; }
+static inline size_t c_row(struct csr *C, size_t u, size_t k) {
+  (void)u;
+  return C->lvl2_crd[k];
+}
+static inline size_t c_col(struct csr *C, size_t u, size_t k) {
+  (void)C;
+  (void)k;
+  return u;
+}
+// Search row j of C for column i
+static inline size_t c_locate(struct csr *C, size_t i, size_t j) {
+  for (size_t c_idx = C->lvl2_pos[j]; c_idx < C->lvl2_pos[j + 1]; ++c_idx) {
+    if (C->lvl2_crd[c_idx] == i)
+      return c_idx;
+  }
+  return NO_ENTRY;
+}
+#elif defined(FORMAT_C_CSC)
+static inline size_t c_units(struct csc *C) { return C->lvl1_size; }
+static inline size_t c_begin(struct csc *C, size_t u) { return C->lvl2_pos[u]; }
+static inline size_t c_end(struct csc *C, size_t u) { return C->lvl2_pos[u + 1]; }
+static inline size_t c_row(struct csc *C, size_t u, size_t k) {
+  (void)C;
+  (void)k;
+  return u;
+}
+static inline size_t c_col(struct csc *C, size_t u, size_t k) {
+  (void)u;
+  return C->lvl2_crd[k];
+}
+// Search column i of C for row j
+static inline size_t c_locate(struct csc *C, size_t i, size_t j) {
+  for (size_t c_idx = C->lvl2_pos[i]; c_idx < C->lvl2_pos[i + 1]; ++c_idx) {
+    if (C->lvl2_crd[c_idx] == j)
+      return c_idx;
+  }
+  return NO_ENTRY;
+}
+#elif defined(FORMAT_C_COO)
+static inline size_t c_units(struct coo *C) { return C->lvl1_nnz; }
+static inline size_t c_begin(struct coo *C, size_t u) {
+  (void)C;
+  return u;
+}
+static inline size_t c_end(struct coo *C, size_t u) {
+  (void)C;
+  return u + 1;
+}
+static inline size_t c_row(struct coo *C, size_t u, size_t k) {
+  (void)u;
+  return C->lvl2_crd[k];
+}
+static inline size_t c_col(struct coo *C, size_t u, size_t k) {
+  (void)u;
+  return C->lvl1_crd[k];
+}
+// Probe the index of C (SEARCH_HASH) or search all of C for entry (j,i)
+static inline size_t c_locate(struct coo *C, size_t i, size_t j) {
+#if defined(SEARCH_HASH)
+  assert(C->index_slots);
+  size_t c_idx = coo_index_find(C, j, i);
+  return c_idx != COO_INDEX_EMPTY ? c_idx : NO_ENTRY;
+#else
+  for (size_t c_idx = 0; c_idx < C->lvl1_nnz; ++c_idx) {
+    if (C->lvl1_crd[c_idx] == j && C->lvl2_crd[c_idx] == i)
+      return c_idx;
+  }
+  return NO_ENTRY;
+#endif
+}
+#endif
+
+#if defined(SEARCH_MERGE)
+// C(j,i) through per-slice cursors of C that only move forward: the slice of C holding it and the coordinate sought
+#if defined(FORMAT_C_CSR)
+#define C_SLICE(i, j) (j)
+#define C_CRD(i, j) (i)
+#else
+#define C_SLICE(i, j) (i)
+#define C_CRD(i, j) (j)
+#endif
+
+static inline size_t c_merge_locate(TENSOR_C *C, index_t *cursor, size_t i, size_t j) {
+  size_t slice = C_SLICE(i, j);
+  size_t crd = C_CRD(i, j);
+  size_t c_idx = cursor[slice];
+  size_t c_end = C->lvl2_pos[slice + 1];
+  while (c_idx < c_end && C->lvl2_crd[c_idx] < crd) {
+    ++c_idx;
+  }
+  cursor[slice] = c_idx;
+  return c_idx < c_end && C->lvl2_crd[c_idx] == crd ? c_idx : NO_ENTRY;
+}
+
+// B and C in the same format: C's slices are searched for B's slice coordinate, which grows with the units, so a block
+// of units starting at first starts every cursor at the first entry >= first. Otherwise each slice of C is walked
+// alongside the unit of B with the same coordinate, from its start.
+#if (defined(FORMAT_B_CSR) && defined(FORMAT_C_CSR)) || (defined(FORMAT_B_CSC) && defined(FORMAT_C_CSC))
+#define MERGE_SEEK(first) (first)
+#else
+#define MERGE_SEEK(first) 0
+#endif
+
+static index_t *merge_cursors(TENSOR_B *B, TENSOR_C *C, size_t first) {
+  assert(B->sorted && C->sorted);
+  (void)B;
+  (void)first;
+  size_t target = MERGE_SEEK(first);
+  index_t *cursor = workspace_alloc(C->lvl1_size * sizeof(index_t));
+  for (size_t s = 0; s < C->lvl1_size; ++s) {
+    size_t lo = C->lvl2_pos[s];
+    size_t hi = C->lvl2_pos[s + 1];
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (C->lvl2_crd[mid] < target)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    cursor[s] = lo;
+  }
+  return cursor;
+}
+#else
+static inline index_t *merge_cursors(TENSOR_B *B, TENSOR_C *C, size_t first) {
+  (void)B;
+  (void)C;
+  (void)first;
+  return NULL;
+}
+#endif
+
+// Units of the iterated operand, and whether entry k of unit u has a partner: its coordinate (i,j) in A and the
+// positions of B(i,j) and C(j,i)
+#if defined(SEARCH_B)
+static inline size_t iter_units(TENSOR_B *B, TENSOR_C *C) {
+  (void)B;
+  return c_units(C);
+}
+static inline size_t iter_begin(TENSOR_B *B, TENSOR_C *C, size_t u) {
+  (void)B;
+  return c_begin(C, u);
+}
+static inline size_t iter_end(TENSOR_B *B, TENSOR_C *C, size_t u) {
+  (void)B;
+  return c_end(C, u);
+}
+static inline bool match(TENSOR_B *B, TENSOR_C *C, index_t *cursor, size_t u, size_t k, size_t *i, size_t *j,
+                         size_t *b_idx, size_t *c_idx) {
+  (void)cursor;
+  *i = c_row(C, u, k);
+  *j = c_col(C, u, k);
+  *c_idx = k;
+  *b_idx = b_locate(B, *i, *j);
+  return *b_idx != NO_ENTRY;
+}
+#else
+static inline size_t iter_units(TENSOR_B *B, TENSOR_C *C) {
+  (void)C;
+  return b_units(B);
+}
+static inline size_t iter_begin(TENSOR_B *B, TENSOR_C *C, size_t u) {
+  (void)C;
+  return b_begin(B, u);
+}
+static inline size_t iter_end(TENSOR_B *B, TENSOR_C *C, size_t u) {
+  (void)C;
+  return b_end(B, u);
+}
+static inline bool match(TENSOR_B *B, TENSOR_C *C, index_t *cursor, size_t u, size_t k, size_t *i, size_t *j,
+                         size_t *b_idx, size_t *c_idx) {
+  *i = b_row(B, u, k);
+  *j = b_col(B, u, k);
+  *b_idx = k;
+#if defined(SEARCH_MERGE)
+  *c_idx = c_merge_locate(C, cursor, *i, *j);
+#else
+  (void)cursor;
+  *c_idx = c_locate(C, *i, *j);
+#endif
+  return *c_idx != NO_ENTRY;
+}
+#endif
+
+// Slice of A holding A(i,j) and its coordinate within the slice
+#if defined(FORMAT_A_CSR)
+#define A_SLICE(i, j) (i)
+#define A_CRD(i, j) (j)
+#elif defined(FORMAT_A_CSC)
+#define A_SLICE(i, j) (j)
+#define A_CRD(i, j) (i)
+#endif
+
+// Units that are rows (columns) of A: the CSR (CSC) B iterated, or the CSC (CSR) C. MERGE carries cursors from unit
+// to unit, so its units are never computed independently.
+#if defined(SEARCH_B) ? defined(FORMAT_C_CSC) : defined(FORMAT_B_CSR)
+#define UNITS_ARE_ROWS
+#elif defined(SEARCH_B) ? defined(FORMAT_C_CSR) : defined(FORMAT_B_CSC)
+#define UNITS_ARE_COLUMNS
+#endif
+#if !defined(SEARCH_MERGE) && ((defined(FORMAT_A_CSR) && defined(UNITS_ARE_ROWS)) ||                                 \
+                               (defined(FORMAT_A_CSC) && defined(UNITS_ARE_COLUMNS)))
+#define UNITS_ARE_SLICES
+#endif
+
+#if defined(UNITS_ARE_SLICES)
+// Unit u is slice u of A
+void hadamard_transpose(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) {
+  for (size_t u = 0; u < iter_units(B, C); ++u) {
+    for (size_t k = iter_begin(B, C, u); k < iter_end(B, C, u); ++k) {
+      size_t i, j, b_idx, c_idx;
+      if (match(B, C, NULL, u, k, &i, &j, &b_idx, &c_idx)) {
+        size_t nnz = A->lvl2_nnz;
+        GROW_OUTPUT(A, nnz + 1);
+        A->lvl2_crd[nnz] = A_CRD(i, j);
+        A->vals[nnz] = B->vals[b_idx] * C->vals[c_idx];
+        A->lvl2_nnz = nnz + 1;
+      }
+    }
+    A->lvl2_pos[u + 1] = A->lvl2_nnz;
+  }
+}
+
+#define INDEPENDENT_SLICES
+// Matches in slice s of A, written from position offset on when emit is set and only counted otherwise
+static inline size_t hadamard_transpose_slice(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C, size_t s, size_t offset,
+                                              const bool emit) {
+  size_t count = 0;
+  for (size_t k = iter_begin(B, C, s); k < iter_end(B, C, s); ++k) {
+    size_t i, j, b_idx, c_idx;
+    if (match(B, C, NULL, s, k, &i, &j, &b_idx, &c_idx)) {
+      if (emit) {
+        A->lvl2_crd[offset + count] = A_CRD(i, j);
+        A->vals[offset + count] = B->vals[b_idx] * C->vals[c_idx];
+      }
+      ++count;
+    }
+  }
+  return count;
+}
+#else
+// What visit_units does with every match
+enum visit { COUNT, COUNT_SLICES, SCATTER, APPEND };
+
+// Visit the matches of units [first, last), with cursors positioned for first (MERGE). COUNT only counts them,
+// COUNT_SLICES adds them to the counts A->lvl2_pos[s + 1] of A's slices, SCATTER writes them through the insertion
+// cursors A->lvl2_pos[s], APPEND writes them to a COO A from position offset on. shared: other threads visit other
+// units of the same A at the same time. Returns the number of matches.
+static inline size_t visit_units(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C, size_t first, size_t last, size_t offset,
+                                 const enum visit visit, const bool shared) {
+  (void)offset;
+  (void)shared;
+  index_t *cursor = merge_cursors(B, C, first);
+  size_t count = 0;
+  for (size_t u = first; u < last; ++u) {
+    for (size_t k = iter_begin(B, C, u); k < iter_end(B, C, u); ++k) {
+      size_t i, j, b_idx, c_idx;
+      if (!match(B, C, cursor, u, k, &i, &j, &b_idx, &c_idx))
+        continue;
+#if defined(FORMAT_A_COO)
+      if (visit == APPEND) {
+        size_t nnz = offset + count;
+        GROW_OUTPUT(A, nnz + 1);
+        A->lvl1_crd[nnz] = i;
+        A->lvl2_crd[nnz] = j;
+        A->vals[nnz] = B->vals[b_idx] * C->vals[c_idx];
+      }
+#else
+      size_t s = A_SLICE(i, j);
+      if (visit == COUNT_SLICES) {
+#if defined(PARALLEL)
+        if (shared) {
+#pragma omp atomic
+          A->lvl2_pos[s + 1]++;
+        } else
 #endif
+          A->lvl2_pos[s + 1]++;
+      } else if (visit == SCATTER) {
+        size_t nnz;
+#if defined(PARALLEL)
+        if (shared) {
+#pragma omp atomic capture
+          nnz = A->lvl2_pos[s]++;
+        } else
+#endif
+          nnz = A->lvl2_pos[s]++;
+        A->lvl2_crd[nnz] = A_CRD(i, j);
+        A->vals[nnz] = B->vals[b_idx] * C->vals[c_idx];
+      }
+#endif
+      ++count;
+    }
+  }
+  free(cursor);
+  return count;
+}
 
+#if defined(FORMAT_A_COO)
+// Matches are appended in iteration order
+void hadamard_transpose(struct coo *A, TENSOR_B *B, TENSOR_C *C) {
+  A->lvl1_nnz = visit_units(A, B, C, 0, iter_units(B, C), 0, APPEND, false);
+}
+#else
+// Units do not follow A's slices: count the matches per slice of A first, then scatter each match into its slice
+// using A->lvl2_pos[s] as the insertion cursor. Expects A to have been reset.
+void hadamard_transpose(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) {
+  size_t num_units = iter_units(B, C);
+  // Pass 1: count matches per slice of A
+  visit_units(A, B, C, 0, num_units, 0, COUNT_SLICES, false);
+  for (size_t s = 0; s < A->lvl1_size; ++s) {
+    A->lvl2_pos[s + 1] += A->lvl2_pos[s];
+  }
+  reserve_tensor(A, A->lvl2_pos[A->lvl1_size]);
+
+  // Pass 2: scatter matches, advancing A->lvl2_pos[s] to the next free slot of slice s
+  visit_units(A, B, C, 0, num_units, 0, SCATTER, false);
+
+  // Cursors now hold slice ends: shift them back into slice starts
+  for (size_t s = A->lvl1_size; s > 0; --s) {
+    A->lvl2_pos[s] = A->lvl2_pos[s - 1];
+  }
+  A->lvl2_pos[0] = 0;
+  A->lvl2_nnz = A->lvl2_pos[A->lvl1_size];
+}
+#endif
+
+// Matches over all units, as counted by pass 1 of the kernel
+size_t hadamard_transpose_count(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) {
+  return visit_units(A, B, C, 0, iter_units(B, C), 0, COUNT, false);
+}
+
+#if defined(PARALLEL)
+// Contiguous block [first, last) of num_units units for the calling thread
+static inline void thread_block(size_t num_units, size_t *first, size_t *last) {
+  size_t num_threads = omp_get_num_threads();
+  size_t thread_id = omp_get_thread_num();
+  *first = num_units * thread_id / num_threads;
+  *last = num_units * (thread_id + 1) / num_threads;
+}
+
+#if defined(FORMAT_A_COO)
+// Each thread takes a contiguous block of units: blocks are counted, their offsets in A summed up, and every block
+// appended from its offset, so A holds the entries in the serial kernel's order
+void hadamard_transpose_parallel(struct coo *A, TENSOR_B *B, TENSOR_C *C) {
+  size_t num_units = iter_units(B, C);
+  size_t *offset = workspace_alloc((omp_get_max_threads() + 1) * sizeof(size_t));
+  offset[0] = 0;
+#pragma omp parallel
+  {
+    size_t first, last;
+    thread_block(num_units, &first, &last);
+    size_t thread_id = omp_get_thread_num();
+    offset[thread_id + 1] = visit_units(A, B, C, first, last, 0, COUNT, true);
+
+#pragma omp barrier
+#pragma omp single
+    {
+      size_t num_threads = omp_get_num_threads();
+      for (size_t t = 0; t < num_threads; ++t) {
+        offset[t + 1] += offset[t];
+      }
+      A->lvl1_nnz = offset[num_threads];
+      reserve_tensor(A, A->lvl1_nnz);
+    }
+
+    visit_units(A, B, C, first, last, offset[thread_id], APPEND, true);
+  }
+  free(offset);
+}
+#else
+// Each thread takes a contiguous block of units; counts and insertion cursors of A's slices are shared and updated
+// atomically. Scattered slices come out in thread order and are sorted afterwards.
+#define PARALLEL_SORTS_OUTPUT
+void hadamard_transpose_parallel(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) {
+  size_t num_units = iter_units(B, C);
+  // Symbolic pass: count matches per slice of A
+#pragma omp parallel
+  {
+    size_t first, last;
+    thread_block(num_units, &first, &last);
+    visit_units(A, B, C, first, last, 0, COUNT_SLICES, true);
+  }
+  for (size_t s = 0; s < A->lvl1_size; ++s) {
+    A->lvl2_pos[s + 1] += A->lvl2_pos[s];
+  }
+  reserve_tensor(A, A->lvl2_pos[A->lvl1_size]);
+
+  // Numeric pass: scatter matches through the shared slice cursors
+#pragma omp parallel
+  {
+    size_t first, last;
+    thread_block(num_units, &first, &last);
+    visit_units(A, B, C, first, last, 0, SCATTER, true);
+  }
+
+  for (size_t s = A->lvl1_size; s > 0; --s) {
+    A->lvl2_pos[s] = A->lvl2_pos[s - 1];
+  }
+  A->lvl2_pos[0] = 0;
+  A->lvl2_nnz = A->lvl2_pos[A->lvl1_size];
+  sort_tensor(A);
+}
+#endif
+#endif
+#endif
 #endif
 
 #ifndef IMPLEMENTED
 #error "Not implemented"
 #endif
+
+// =============================================================================
+// Count and parallel driver for variants whose slices of A can be computed independently
+// =============================================================================
+
+#if defined(INDEPENDENT_SLICES)
+size_t hadamard_transpose_count(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) {
+  size_t nnz = 0;
+  for (size_t s = 0; s < A->lvl1_size; ++s) {
+    nnz += hadamard_transpose_slice(A, B, C, s, 0, false);
+  }
+  return nnz;
+}
+#endif
+
+#if defined(PARALLEL) && defined(INDEPENDENT_SLICES)
+void hadamard_transpose_parallel(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) {
+  size_t num_slices = A->lvl1_size;
+
+  // Symbolic pass: count the matches of every slice
+#pragma omp parallel for schedule(dynamic, 64)
+  for (size_t s = 0; s < num_slices; ++s) {
+    A->lvl2_pos[s + 1] = hadamard_transpose_slice(A, B, C, s, 0, false);
+  }
+
+  // Prefix sum: slice counts become slice offsets
+  A->lvl2_pos[0] = 0;
+  for (size_t s = 0; s < num_slices; ++s) {
+    A->lvl2_pos[s + 1] += A->lvl2_pos[s];
+  }
+  A->lvl2_nnz = A->lvl2_pos[num_slices];
+  reserve_tensor(A, A->lvl2_nnz);
+
+  // Numeric pass: every slice writes its own range of A
+#pragma omp parallel for schedule(dynamic, 64)
+  for (size_t s = 0; s < num_slices; ++s) {
+    hadamard_transpose_slice(A, B, C, s, A->lvl2_pos[s], true);
+  }
+}
+#endif
+
+// =============================================================================
+// Batched driver, the same for every configuration
+// =============================================================================
+
+// The block of one pair in A as a tensor of its own, which the kernel fills in place: A's entries from offset on, with
+// room for exactly the pair's nnz, and for CSR/CSC the calling thread's slice positions pos, relative to offset. The
+// count makes the room exact, so the kernel never reserves and nothing of A's storage is reallocated or freed.
+static inline TENSOR_A pair_block(TENSOR_A *A, size_t size, size_t offset, size_t nnz, index_t *pos) {
+  TENSOR_A block = *A;
+  block.slab = NULL;
+  block.slab_size = 0;
+#if defined(FORMAT_A_COO)
+  (void)size;
+  (void)pos;
+  block.lvl1_nnz = 0;
+  block.lvl1_cap = nnz;
+  block.lvl1_crd = A->lvl1_crd + offset;
+  block.lvl2_crd = A->lvl2_crd + offset;
+  block.index_mask = 0;
+  block.index_slots = NULL;
+#else
+  block.lvl1_size = size;
+  block.lvl2_pos = pos;
+  memset(pos, 0, (size + 1) * sizeof(index_t));
+  block.lvl2_nnz = 0;
+  block.lvl2_cap = nnz;
+  block.lvl2_crd = A->lvl2_crd + offset;
+#endif
+  block.vals = A->vals + offset;
+  return block;
+}
+
+// Move a filled block into A's coordinates: slices from first on, entries from offset on
+static void place_pair(TENSOR_A *A, const TENSOR_A *block, size_t first, size_t offset) {
+#if defined(FORMAT_A_COO)
+  (void)A;
+  (void)offset;
+  for (size_t k = 0; k < block->lvl1_nnz; ++k) {
+    block->lvl1_crd[k] += first;
+    block->lvl2_crd[k] += first;
+  }
+#else
+  for (size_t s = 0; s < block->lvl1_size; ++s)
+    A->lvl2_pos[first + s] = offset + block->lvl2_pos[s];
+  for (size_t k = 0; k < block->lvl2_nnz; ++k)
+    block->lvl2_crd[k] += first;
+#endif
+}
+
+size_t hadamard_transpose_batch_count(TENSOR_B *const *B, TENSOR_C *const *C, const size_t *sizes, size_t count,
+                                      size_t *offsets) {
+  // hadamard_transpose_count reads only the shape of A
+#if defined(PARALLEL)
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (size_t b = 0; b < count; ++b) {
+    TENSOR_A shape = {0};
+#if !defined(FORMAT_A_COO)
+    shape.lvl1_size = sizes[b];
+#endif
+    offsets[b + 1] = hadamard_transpose_count(&shape, B[b], C[b]);
+  }
+#if defined(FORMAT_A_COO)
+  (void)sizes;
+#endif
+
+  offsets[0] = 0;
+  for (size_t b = 0; b < count; ++b)
+    offsets[b + 1] += offsets[b];
+  return offsets[count];
+}
+
+void hadamard_transpose_batch(TENSOR_A *A, TENSOR_B *const *B, TENSOR_C *const *C, const size_t *sizes, size_t count,
+                              const size_t *offsets) {
+  size_t nnz = offsets[count];
+  reserve_tensor(A, nnz);
+
+  // First slice of every pair, and the largest pair the slice positions must hold
+  size_t *first = workspace_alloc((count + 1) * sizeof(size_t));
+  size_t max_size = 0;
+  first[0] = 0;
+  for (size_t b = 0; b < count; ++b) {
+    first[b + 1] = first[b] + sizes[b];
+    if (sizes[b] > max_size)
+      max_size = sizes[b];
+  }
+
+  // Slice positions of the block each thread fills
+  int threads = 1;
+#if defined(PARALLEL)
+  threads = omp_get_max_threads();
+#endif
+  index_t *pos = workspace_alloc((size_t)threads * (max_size + 1) * sizeof(index_t));
+
+#if defined(PARALLEL)
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (size_t b = 0; b < count; ++b) {
+    int t = 0;
+#if defined(PARALLEL)
+    t = omp_get_thread_num();
+#endif
+    TENSOR_A block = pair_block(A, sizes[b], offsets[b], offsets[b + 1] - offsets[b], pos + t * (max_size + 1));
+    hadamard_transpose(&block, B[b], C[b]);
+    place_pair(A, &block, first[b], offsets[b]);
+  }
+  free(pos);
+
+#if defined(FORMAT_A_COO)
+  A->lvl1_nnz = nnz;
+#else
+  assert(A->lvl1_size == first[count]);
+  A->lvl2_pos[first[count]] = nnz;
+  A->lvl2_nnz = nnz;
+#endif
+  free(first);
+}
+
+#if defined(PARALLEL)
+#if defined(PARALLEL_SORTS_OUTPUT)
+const bool hadamard_transpose_parallel_sorts = true;
+#else
+const bool hadamard_transpose_parallel_sorts = false;
+#endif
+#endif
@@ -7,11 +7,55 @@
 // FORMAT_A: CSR, CSC, COO
 // FORMAT_B: CSR, CSC, COO
 // FORMAT_C: CSR, CSC, COO
-// SEARCH: B, C (which tensor to iterate first)
+// SEARCH: B, C (which tensor to iterate first), MERGE (co-iterate sorted B and C, CSR/CSC operands only),
+//         HASH (iterate B, locate C(j,i) through the COO index of C, FORMAT_C=COO only)
 
 // The actual implementation is selected at compile time based on the flags above.
 // Only one implementation will be compiled and linked.
 
+// PARALLEL: additionally build hadamard_transpose_parallel (OpenMP, requires -fopenmp)
+// GROWABLE_OUTPUT: appending kernels grow A geometrically instead of relying on its preallocated capacity
+// VARIANT: suffix the entry points with _<VARIANT> (e.g. -DVARIANT=csr_csr_csc_merge defines
+//          hadamard_transpose_csr_csr_csc_merge), so libhadamard can link every configuration side by side; use
+//          hadamard_dispatch.h to call them
+
+#if defined(VARIANT)
+#define VARIANT_SYMBOL(name) VARIANT_PASTE(name, VARIANT)
+#define VARIANT_PASTE(name, variant) VARIANT_PASTE_(name, variant)
+#define VARIANT_PASTE_(name, variant) name##_##variant
+#define hadamard_transpose VARIANT_SYMBOL(hadamard_transpose)
+#define hadamard_transpose_count VARIANT_SYMBOL(hadamard_transpose_count)
+#define hadamard_transpose_parallel VARIANT_SYMBOL(hadamard_transpose_parallel)
+#define hadamard_transpose_parallel_sorts VARIANT_SYMBOL(hadamard_transpose_parallel_sorts)
+#define hadamard_transpose_batch VARIANT_SYMBOL(hadamard_transpose_batch)
+#define hadamard_transpose_batch_count VARIANT_SYMBOL(hadamard_transpose_batch_count)
+#endif
+
+// Operand types selected by the FORMAT_* flags
+#if defined(FORMAT_A_CSR)
+#define TENSOR_A struct csr
+#elif defined(FORMAT_A_CSC)
+#define TENSOR_A struct csc
+#elif defined(FORMAT_A_COO)
+#define TENSOR_A struct coo
+#endif
+
+#if defined(FORMAT_B_CSR)
+#define TENSOR_B struct csr
+#elif defined(FORMAT_B_CSC)
+#define TENSOR_B struct csc
+#elif defined(FORMAT_B_COO)
+#define TENSOR_B struct coo
+#endif
+
+#if defined(FORMAT_C_CSR)
+#define TENSOR_C struct csr
+#elif defined(FORMAT_C_CSC)
+#define TENSOR_C struct csc
+#elif defined(FORMAT_C_COO)
+#define TENSOR_C struct coo
+#endif
+
 // Function signature - actual types depend on compile-time flags
 #if defined(FORMAT_A_CSR)
 #if defined(FORMAT_B_CSR)
@@ -93,4 +137,33 @@ void hadamard_transpose(struct coo *A, struct coo *B, struct coo *C);
 #endif
 #endif
 
+// Exact number of entries hadamard_transpose writes into A, for sizing A before the call. Only A's shape (lvl1_size)
+// is read, so A can be allocated with no entries and reserved afterwards. Same preconditions as hadamard_transpose.
+size_t hadamard_transpose_count(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C);
+
+// Batched hadamard_transpose for many small products: pair b multiplies B[b] and C[b], both sizes[b] x sizes[b], and
+// its result is packed into one block-diagonal A. Pair b owns slices [first, first + sizes[b]) of A, first being the
+// sum of the sizes before it, with its coordinates shifted by first, and entries [offsets[b], offsets[b + 1]) of A.
+// A CSR/CSC A needs the sum of the sizes as slices, offsets comes from hadamard_transpose_batch_count, and every pair
+// has the preconditions of hadamard_transpose. Expects A to have been reset. Each pair is computed by the serial kernel
+// directly into its block of A, so nothing is copied; PARALLEL builds spread the pairs over the threads.
+void hadamard_transpose_batch(TENSOR_A *A, TENSOR_B *const *B, TENSOR_C *const *C, const size_t *sizes, size_t count,
+                              const size_t *offsets);
+
+// Fills offsets (count + 1 entries) with the first entry of every pair in hadamard_transpose_batch's A and the total
+// in offsets[count], which is also returned
+size_t hadamard_transpose_batch_count(TENSOR_B *const *B, TENSOR_C *const *C, const size_t *sizes, size_t count,
+                                      size_t *offsets);
+
+#if defined(PARALLEL)
+// Multi-threaded hadamard_transpose: a symbolic pass counts the matches of every slice of A, a prefix sum turns the
+// counts into A->lvl2_pos, and a numeric pass fills each slice independently. A COO A is counted and filled by blocks
+// of iterated entries instead. Expects A to have been reset.
+void hadamard_transpose_parallel(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C);
+
+// Set when hadamard_transpose_parallel scatters entries into A's slices from several threads at once and then sorts
+// every slice with sort_tensor(A), a pass the serial kernel does not make; its time is part of the parallel kernel's
+extern const bool hadamard_transpose_parallel_sorts;
+#endif
+
 #endif /* HADAMARD_TRANSPOSE_H */
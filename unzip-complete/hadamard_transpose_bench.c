@@ -1,11 +1,23 @@
+#include "bench_harness.h"
 #include "hadamard_transpose.h"
+#include "perf_counters.h"
+#include "roofline.h"
 #include "tensor_formats.h"
+#include "tensor_io.h"
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/resource.h>
+#include <unistd.h>
+
+#if defined(PARALLEL)
+#include <omp.h>
+#endif
 
 // Configuration
 const unsigned int SEED = 42;
@@ -13,19 +25,29 @@ const unsigned int SEED = 42;
 const size_t MIN_SIZE = 10;
 const size_t MAX_SIZE = 100;
 const int NUM_SAMPLES = 5;
-const int NUM_WARMUP = 0;
-const int NUM_RUNS = 1;
+const int NUM_WARMUP = 1;
+const double TARGET_CV = 0.05;
+const double TIME_BUDGET_MS = 20;
 #else
 const size_t MIN_SIZE = 100;
 const size_t MAX_SIZE = 10000;
 const int NUM_SAMPLES = 20;
-const int NUM_WARMUP = 0;
-const int NUM_RUNS = 1;
+const int NUM_WARMUP = 1;
+const double TARGET_CV = 0.02;
+const double TIME_BUDGET_MS = 500;
 #endif
 
+// Timed calls per kernel (see timing_options), set up in main
+static struct timing_options timing;
+
 const double SPARSITIES[] = {0.05, 0.1, 0.25, 0.5, 0.75};
 const size_t NUM_SPARSITIES = sizeof(SPARSITIES) / sizeof(SPARSITIES[0]);
 
+#if defined(PARALLEL)
+const int THREAD_COUNTS[] = {1, 2, 4, 8};
+const size_t NUM_THREAD_COUNTS = sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]);
+#endif
+
 // Generate logarithmically-spaced sizes
 static void generate_sizes(size_t *sizes, size_t *count) {
   double log_min = log10(MIN_SIZE);
@@ -51,16 +73,545 @@ static void generate_sizes(size_t *sizes, size_t *count) {
   *count = idx;
 }
 
-// Get use CPU time in microseconds using getrusage
-static double get_cpu_time_us() {
+struct kernel_call {
+  void (*kernel)(TENSOR_A *, TENSOR_B *, TENSOR_C *);
+  TENSOR_A *A;
+  TENSOR_B *B;
+  TENSOR_C *C;
+};
+
+static void reset_output(void *arg) { reset_tensor(((struct kernel_call *)arg)->A); }
+
+static void call_kernel(void *arg) {
+  struct kernel_call *call = arg;
+  call->kernel(call->A, call->B, call->C);
+}
+
+// Time kernel calls into A, emptied before each of them
+static struct timing time_kernel(void (*kernel)(TENSOR_A *, TENSOR_B *, TENSOR_C *), TENSOR_A *A, TENSOR_B *B,
+                                 TENSOR_C *C) {
+  struct kernel_call call = {kernel, A, B, C};
+  return time_runs(&timing, reset_output, call_kernel, &call);
+}
+
+// Configuration names, derived from the compile-time flags in main
+static const char *a_fmt, *b_fmt, *c_fmt, *search;
+
+// Hardware counters around one extra kernel call per input, when $PERF_COUNTERS is set (see perf_counters.h). Their
+// CSV columns are per entry of B and stay empty for events that are off or unavailable.
+static bool counting;
+static struct perf_counters counters;
+
+static void count_kernel(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) {
+  reset_tensor(A);
+  start_perf_counters(&counters);
+  hadamard_transpose(A, B, C);
+  stop_perf_counters(&counters);
+}
+
+// CSV columns: the configuration and inputs of a row, then TIMING_COLUMNS for each timed kernel
+static void print_inputs(const char *workload, size_t size, double b_sparsity, double c_sparsity,
+                         double index_build_ms) {
+  printf("%s,%s,%s,%s,%d,%s,%s,%s,%zu,%.6g,%.6g,%.4f", a_fmt, b_fmt, c_fmt, search, INDEX_BITS, VALUE_TYPE_NAME,
+         ALLOC_NAME, workload, size, b_sparsity, c_sparsity, index_build_ms);
+}
+
+#define TIMING_COLUMNS "avg_time_ms,min_time_ms,median_time_ms,p90_time_ms,stddev_ms,runs"
+
+static void print_timing(const struct timing *t) {
+  printf(",%.6g,%.6g,%.6g,%.6g,%.6g,%d", t->mean, t->min, t->median, t->p90, t->stddev, t->runs);
+}
+
+static void print_counters(size_t b_nnz) {
+  for (int e = 0; e < NUM_PERF_COUNTERS; ++e) {
+    if (counting && counters.valid[e] && b_nnz > 0)
+      printf(",%.4g", counters.count[e] / b_nnz);
+    else
+      printf(",");
+  }
+}
+
+// Roofline columns against the peaks probed at startup (see roofline.h). Traffic is compulsory: B and C read and A
+// written once each, so the repeated scans of the search configurations make the achieved GB/s a lower bound; flops
+// are one multiply per entry of A.
+static struct roofline roofline;
+
+struct traffic {
+  size_t bytes_read, bytes_written, flops;
+};
+
+#define ROOFLINE_COLUMNS "bytes_read,bytes_written,flops,gb_per_s,gflop_per_s,roofline_pct"
+
+static void print_roofline(const struct traffic *traffic, double ms, int threads) {
+  struct roofline_point point =
+      roofline_point(&roofline, traffic->bytes_read + traffic->bytes_written, traffic->flops, ms, threads);
+  printf(",%.4g,%.4g,%.4g", point.gbs, point.gflops, point.percent);
+}
+
+// Memory columns: the footprint of B, C and A (see tensor_footprint), the bytes all tensors hold after the kernel and
+// their high-water mark over the input (index build, A's reservation and every kernel call), the resident set sampled
+// before and after each timed kernel, and the process's peak resident set so far
+#define MEMORY_COLUMNS "B_bytes,C_bytes,A_bytes,live_bytes,peak_bytes,rss_kb,max_rss_kb"
+
+struct memory {
+  size_t b_bytes, c_bytes, a_bytes;
+  size_t rss_kb; // largest sample
+};
+
+// Resident set from /proc/self/statm, 0 where it is unavailable
+static size_t rss_kb(void) {
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (!statm)
+    return 0;
+  size_t pages = 0, resident = 0;
+  if (fscanf(statm, "%zu %zu", &pages, &resident) != 2)
+    resident = 0;
+  fclose(statm);
+  return resident * (size_t)sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static void sample_rss(struct memory *memory) {
+  size_t rss = rss_kb();
+  if (rss > memory->rss_kb)
+    memory->rss_kb = rss;
+}
+
+static void print_memory(const struct memory *memory) {
   struct rusage usage;
   getrusage(RUSAGE_SELF, &usage);
-  return usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec;
+  struct tensor_memory tensors = tensor_memory();
+  printf(",%zu,%zu,%zu,%zu,%zu,%zu,%ld", memory->b_bytes, memory->c_bytes, memory->a_bytes, tensors.live_bytes,
+         tensors.peak_bytes, memory->rss_kb, usage.ru_maxrss);
 }
 
-int main() {
-  const char *a_fmt, *b_fmt, *c_fmt, *search;
+// Per-operand constructors for the compiled formats; A starts empty and is sized exactly before timing
+#if defined(FORMAT_A_CSR)
+#define allocate_A(n) allocate_csr(n, 0)
+#elif defined(FORMAT_A_CSC)
+#define allocate_A(n) allocate_csc(n, 0)
+#elif defined(FORMAT_A_COO)
+#define allocate_A(n) allocate_coo(0)
+#endif
+
+#if defined(FORMAT_A_COO)
+#define A_NNZ(A) (A)->lvl1_nnz
+#else
+#define A_NNZ(A) (A)->lvl2_nnz
+#endif
+
+#if defined(FORMAT_B_COO)
+#define B_NNZ(B) (B)->lvl1_nnz
+#else
+#define B_NNZ(B) (B)->lvl2_nnz
+#endif
+
+#if defined(FORMAT_B_CSR)
+#define cached_B cached_csr
+#define cached_B_workload cached_csr_workload
+#define cached_B_transposed cached_csr_transposed
+#define coo_to_B coo_to_csr
+#elif defined(FORMAT_B_CSC)
+#define cached_B cached_csc
+#define cached_B_workload cached_csc_workload
+#define cached_B_transposed cached_csc_transposed
+#define coo_to_B coo_to_csc
+#elif defined(FORMAT_B_COO)
+#define cached_B cached_coo
+#define cached_B_workload cached_coo_workload
+#define cached_B_transposed cached_coo_transposed
+#define coo_to_B coo_to_coo
+#endif
+
+#if defined(FORMAT_C_CSR)
+#define cached_C cached_csr
+#define cached_C_workload cached_csr_workload
+#define cached_C_transposed cached_csr_transposed
+#define coo_to_C coo_to_csr
+#elif defined(FORMAT_C_CSC)
+#define cached_C cached_csc
+#define cached_C_workload cached_csc_workload
+#define cached_C_transposed cached_csc_transposed
+#define coo_to_C coo_to_csc
+#elif defined(FORMAT_C_COO)
+#define cached_C cached_coo
+#define cached_C_workload cached_coo_workload
+#define cached_C_transposed cached_coo_transposed
+#define coo_to_C coo_to_coo
+#endif
+
+// Generated inputs come in the structures of enum workload plus "transposed": a uniform B and a C with the pattern of
+// B's transpose, so every entry of B finds its partner in C
+#define WORKLOAD_TRANSPOSED NUM_WORKLOADS
+
+// Generated inputs of workload w at size, mapped from the tensor cache where there is one. The transposed workload
+// takes B's sparsity for C too, whose pattern is B's transposed.
+static void load_inputs(const char *cache_dir, size_t w, size_t size, double b_sparsity, double c_sparsity,
+                        TENSOR_B **B, TENSOR_C **C) {
+  if (w == WORKLOAD_UNIFORM) {
+    *B = cached_B(cache_dir, size, size, b_sparsity, SEED);
+    *C = cached_C(cache_dir, size, size, c_sparsity, SEED + 1);
+  } else if (w != WORKLOAD_TRANSPOSED) {
+    *B = cached_B_workload(cache_dir, w, size, size, b_sparsity, SEED);
+    *C = cached_C_workload(cache_dir, w, size, size, c_sparsity, SEED + 1);
+  } else {
+    *B = cached_B_workload(cache_dir, WORKLOAD_UNIFORM, size, size, b_sparsity, SEED);
+    *C = cached_C_transposed(cache_dir, WORKLOAD_UNIFORM, size, size, b_sparsity, SEED, SEED + 1);
+  }
+}
+
+// Bring B and C into the shape the compiled search needs and allocate A with room for the product. Returns the time
+// of the index build, a one-off cost per C that is timed apart from the probing kernel.
+static double prepare_inputs(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) {
+#if defined(SEARCH_MERGE)
+  sort_tensor(B);
+  sort_tensor(C);
+#endif
+
+  double index_build_ms = 0.0;
+#if defined(SEARCH_HASH)
+  double index_start = get_time_us();
+  build_coo_index(C);
+  index_build_ms = (get_time_us() - index_start) / 1e3;
+#endif
+
+  reserve_tensor(A, hadamard_transpose_count(A, B, C));
+  return index_build_ms;
+}
+
+// Time one (B, C) pair of size x size inputs, print its CSV line(s) and free the tensors. workload names where the
+// inputs came from: the structure of generated inputs, the file name without .mtx for Matrix Market inputs.
+static void bench_inputs(const char *workload, size_t size, double b_sparsity, double c_sparsity, TENSOR_B *B,
+                         TENSOR_C *C) {
+  reset_tensor_memory_peak();
+  TENSOR_A *A = allocate_A(size);
+  double index_build_ms = prepare_inputs(A, B, C);
+
+  struct memory memory = {tensor_footprint(B), tensor_footprint(C), tensor_footprint(A), rss_kb()};
+  struct timing serial = time_kernel(hadamard_transpose, A, B, C);
+  sample_rss(&memory);
+  struct traffic traffic = {tensor_bytes(B) + tensor_bytes(C), tensor_bytes(A), A_NNZ(A)};
+  if (counting)
+    count_kernel(A, B, C);
+
+  // Output CSV line(s) to stdout
+#if defined(PARALLEL)
+  for (size_t t_idx = 0; t_idx < NUM_THREAD_COUNTS; ++t_idx) {
+    int threads = THREAD_COUNTS[t_idx];
+    omp_set_num_threads(threads);
+    struct timing parallel = time_kernel(hadamard_transpose_parallel, A, B, C);
+    sample_rss(&memory);
+    double speedup = parallel.median > 0.0 ? serial.median / parallel.median : 0.0;
+    print_inputs(workload, size, b_sparsity, c_sparsity, index_build_ms);
+    print_timing(&serial);
+    printf(",%zu,%zu,%zu", traffic.bytes_read, traffic.bytes_written, traffic.flops);
+    print_roofline(&traffic, serial.median, 1);
+    print_memory(&memory);
+    print_counters(B_NNZ(B));
+    printf(",%d,%d", threads, hadamard_transpose_parallel_sorts);
+    print_timing(&parallel);
+    printf(",%.3f", speedup);
+    print_roofline(&traffic, parallel.median, threads);
+    printf("\n");
+  }
+#else
+  print_inputs(workload, size, b_sparsity, c_sparsity, index_build_ms);
+  print_timing(&serial);
+  printf(",%zu,%zu,%zu", traffic.bytes_read, traffic.bytes_written, traffic.flops);
+  print_roofline(&traffic, serial.median, 1);
+  print_memory(&memory);
+  print_counters(B_NNZ(B));
+  printf("\n");
+#endif
+  fflush(stdout);
+
+  // Free tensors; ARENA_ALLOC builds keep their slabs for the next configuration
+  free_tensor(A);
+  free_tensor(B);
+  free_tensor(C);
+}
+
+static int is_mtx_file(const struct dirent *entry) {
+  size_t len = strlen(entry->d_name);
+  return len > 4 && strcmp(entry->d_name + len - 4, ".mtx") == 0;
+}
+
+// Matrix Market mode: every square *.mtx matrix M in dir, in name order, as B = C = M (so A = M o M^T)
+static void bench_mtx_dir(const char *dir) {
+  struct dirent **entries;
+  int num_entries = scandir(dir, &entries, is_mtx_file, alphasort);
+  if (num_entries < 0) {
+    fprintf(stderr, "Cannot read MTX_DIR %s: %s\n", dir, strerror(errno));
+    exit(1);
+  }
+  if (num_entries == 0)
+    fprintf(stderr, "No .mtx files in %s\n", dir);
+
+  for (int e = 0; e < num_entries; ++e) {
+    char path[PATH_MAX];
+    char workload[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, entries[e]->d_name);
+    snprintf(workload, sizeof(workload), "%.*s", (int)(strlen(entries[e]->d_name) - 4), entries[e]->d_name);
+    free(entries[e]);
+
+    size_t nrows, ncols;
+    double read_start = get_time_us();
+    struct coo *M = read_mtx(path, &nrows, &ncols);
+    if (!M)
+      continue;
+    if (nrows != ncols) {
+      fprintf(stderr, "Skipping %s: %zu x %zu is not square\n", workload, nrows, ncols);
+      free_tensor(M);
+      continue;
+    }
+    double density = nrows ? (double)M->lvl1_nnz / ((double)nrows * ncols) : 0.0;
+    fprintf(stderr, "Testing %s (%zu x %zu, %zu entries, read in %.1f ms)...\n", workload, nrows, ncols, M->lvl1_nnz,
+            (get_time_us() - read_start) / 1e3);
+
+    TENSOR_B *B = coo_to_B(M, nrows, ncols);
+    TENSOR_C *C = coo_to_C(M, nrows, ncols);
+    free_tensor(M);
+    bench_inputs(workload, nrows, density, density, B, C);
+  }
+  free(entries);
+}
+
+// Batch mode ($BENCH_BATCH): many small transposed-workload pairs, each size x size at sparsity BATCH_SPARSITY with
+// its own seeds, multiplied by a loop of hadamard_transpose calls and by one hadamard_transpose_batch call, for every
+// batch size of BATCH_SIZES and pair size of BATCH_PAIR_SIZES. Both time what a caller pays for the results of a
+// batch: the loop allocates, counts and reserves an A per pair and keeps them all until the batch is done, the batch
+// counts the offsets and fills one packed A. Batches whose B operands would hold more than BATCH_MAX_ENTRIES entries in
+// all are skipped.
+#ifdef DEBUG
+const size_t BATCH_SIZES[] = {1, 10, 100};
+const size_t BATCH_PAIR_SIZES[] = {10, 30};
+#else
+const size_t BATCH_SIZES[] = {1, 10, 100, 1000};
+const size_t BATCH_PAIR_SIZES[] = {100, 300, 1000};
+#endif
+const size_t NUM_BATCH_SIZES = sizeof(BATCH_SIZES) / sizeof(BATCH_SIZES[0]);
+const size_t NUM_BATCH_PAIR_SIZES = sizeof(BATCH_PAIR_SIZES) / sizeof(BATCH_PAIR_SIZES[0]);
+const double BATCH_SPARSITY = 0.05;
+const double BATCH_MAX_ENTRIES = 2e7;
+
+struct batch {
+  size_t count;
+  TENSOR_A **A; // the looped calls' outputs
+  TENSOR_B **B;
+  TENSOR_C **C;
+  size_t *sizes, *offsets;
+  size_t nnz; // entries of A, left by the last run
+};
+
+static void run_looped(void *arg) {
+  struct batch *batch = arg;
+  size_t nnz = 0;
+  for (size_t b = 0; b < batch->count; ++b) {
+    TENSOR_A *A = allocate_A(batch->sizes[b]);
+    reset_tensor(A);
+    reserve_tensor(A, hadamard_transpose_count(A, batch->B[b], batch->C[b]));
+    hadamard_transpose(A, batch->B[b], batch->C[b]);
+    nnz += A_NNZ(A);
+    batch->A[b] = A;
+  }
+  for (size_t b = 0; b < batch->count; ++b)
+    free_tensor(batch->A[b]);
+  batch->nnz = nnz;
+}
+
+static void run_batched(void *arg) {
+  struct batch *batch = arg;
+  size_t total = 0;
+  for (size_t b = 0; b < batch->count; ++b)
+    total += batch->sizes[b];
+  TENSOR_A *A = allocate_A(total);
+  hadamard_transpose_batch_count(batch->B, batch->C, batch->sizes, batch->count, batch->offsets);
+  hadamard_transpose_batch(A, batch->B, batch->C, batch->sizes, batch->count, batch->offsets);
+  batch->nnz = A_NNZ(A);
+  free_tensor(A);
+}
+
+static void bench_batch(size_t count, size_t size, int threads) {
+  struct batch batch = {.count = count};
+  batch.A = malloc(count * sizeof(TENSOR_A *));
+  batch.B = malloc(count * sizeof(TENSOR_B *));
+  batch.C = malloc(count * sizeof(TENSOR_C *));
+  batch.sizes = malloc(count * sizeof(size_t));
+  batch.offsets = malloc((count + 1) * sizeof(size_t));
+  size_t b_bytes = 0, c_bytes = 0;
+  // Generated in memory: a cache would fill with thousands of small pairs
+  for (size_t b = 0; b < count; ++b) {
+    unsigned int seed = SEED + 2 * (unsigned int)b;
+    batch.B[b] = cached_B_workload(NULL, WORKLOAD_UNIFORM, size, size, BATCH_SPARSITY, seed);
+    batch.C[b] = cached_C_transposed(NULL, WORKLOAD_UNIFORM, size, size, BATCH_SPARSITY, seed, seed + 1);
+    batch.sizes[b] = size;
+#if defined(SEARCH_MERGE)
+    sort_tensor(batch.B[b]);
+    sort_tensor(batch.C[b]);
+#endif
+#if defined(SEARCH_HASH)
+    build_coo_index(batch.C[b]);
+#endif
+    b_bytes += tensor_bytes(batch.B[b]);
+    c_bytes += tensor_bytes(batch.C[b]);
+  }
+
+  struct timing looped = time_runs(&timing, NULL, run_looped, &batch);
+  size_t looped_nnz = batch.nnz;
+  struct timing batched = time_runs(&timing, NULL, run_batched, &batch);
+  if (batch.nnz != looped_nnz)
+    fprintf(stderr, "Batch of %zu x %zu: batched call wrote %zu entries, looped calls %zu\n", count, size, batch.nnz,
+            looped_nnz);
+
+  double speedup = batched.median > 0.0 ? looped.median / batched.median : 0.0;
+  double pairs_per_s = batched.median > 0.0 ? count / (batched.median / 1e3) : 0.0;
+  printf("%s,%s,%s,%s,%d,%s,%s,transposed,%zu,%.6g,%zu,%d,%zu,%zu,%zu", a_fmt, b_fmt, c_fmt, search, INDEX_BITS,
+         VALUE_TYPE_NAME, ALLOC_NAME, size, BATCH_SPARSITY, count, threads, b_bytes, c_bytes, batch.nnz);
+  print_timing(&looped);
+  print_timing(&batched);
+  printf(",%.3f,%.4g\n", speedup, pairs_per_s);
+  fflush(stdout);
+
+  for (size_t b = 0; b < count; ++b) {
+    free_tensor(batch.B[b]);
+    free_tensor(batch.C[b]);
+  }
+  free(batch.A);
+  free(batch.B);
+  free(batch.C);
+  free(batch.sizes);
+  free(batch.offsets);
+}
+
+static void bench_batches(void) {
+  int threads = 1;
+#if defined(PARALLEL)
+  threads = omp_get_max_threads();
+#endif
+  fprintf(stderr, "Batches: sizes ");
+  for (size_t i = 0; i < NUM_BATCH_SIZES; ++i)
+    fprintf(stderr, "%zu%s", BATCH_SIZES[i], i < NUM_BATCH_SIZES - 1 ? ", " : "");
+  fprintf(stderr, " of ");
+  for (size_t i = 0; i < NUM_BATCH_PAIR_SIZES; ++i)
+    fprintf(stderr, "%zu%s", BATCH_PAIR_SIZES[i], i < NUM_BATCH_PAIR_SIZES - 1 ? ", " : "");
+  fprintf(stderr, " square pairs at sparsity %.2f, %d thread(s)\n", BATCH_SPARSITY, threads);
+
+  // The looped and batched timing columns carry a prefix; speedup compares their medians
+  printf("A_format,B_format,C_format,search_in,index_bits,value_type,alloc,workload,size,sparsity,batch_size,threads,"
+         "B_bytes,C_bytes,A_nnz,looped_avg_time_ms,looped_min_time_ms,looped_median_time_ms,looped_p90_time_ms,"
+         "looped_stddev_ms,looped_runs,batched_avg_time_ms,batched_min_time_ms,batched_median_time_ms,"
+         "batched_p90_time_ms,batched_stddev_ms,batched_runs,speedup,pairs_per_s\n");
+  for (size_t s = 0; s < NUM_BATCH_PAIR_SIZES; ++s) {
+    size_t size = BATCH_PAIR_SIZES[s];
+    for (size_t c = 0; c < NUM_BATCH_SIZES; ++c) {
+      size_t count = BATCH_SIZES[c];
+      if ((double)count * size * size * BATCH_SPARSITY > BATCH_MAX_ENTRIES)
+        continue;
+      fprintf(stderr, "Testing %zu pairs of size %zu...\n", count, size);
+      bench_batch(count, size, threads);
+    }
+  }
+}
+
+#if defined(PARALLEL)
+// Scaling mode ($BENCH_SCALING): hadamard_transpose_parallel on 1..$SCALING_THREADS threads (default: every CPU the
+// process may use) for every workload at size $SCALING_SIZE and sparsity $SCALING_SPARSITY. The strong sweep keeps
+// that size; the weak sweep grows it with the threads, size x (threads / $SCALING_THREADS)^(1 / WORK_EXPONENT), so
+// every thread gets the same share of work and its last run is the strong one. Speedup and efficiency are against the
+// sweep's 1-thread run: T1 / Tp and T1 / (p Tp) for the strong sweep, W T1 / Tp (scaled speedup) and W T1 / (p Tp) for
+// the weak one, where W = (n / n1)^WORK_EXPONENT is the run's work over the 1-thread run's (p when n rounds exactly).
+// Threads are placed by $OMP_PLACES and $OMP_PROC_BIND, which make bench-scaling sets from SCALING_PINNING; the pinning
+// and cpus columns record where they actually ran.
+#define SCALING_COLUMNS "scaling,pinning,cpus,threads"
+
+// Exponent of n in the kernel's work at a fixed sparsity s: each of the n^2 s entries of the iterated operand looks
+// for its partner along a slice of n s entries, or through all n^2 s entries of a COO operand, while merge cursors and
+// the hash index find it in amortized constant time. The flops column (entries of A) grows with n^2 whatever the
+// search, so it does not measure this work.
+#if defined(SEARCH_MERGE) || defined(SEARCH_HASH)
+#define WORK_EXPONENT 2
+#elif (defined(SEARCH_B) && defined(FORMAT_B_COO)) || (defined(SEARCH_C) && defined(FORMAT_C_COO))
+#define WORK_EXPONENT 4
+#else
+#define WORK_EXPONENT 3
+#endif
+
+static void scale_workload(const char *cache_dir, size_t w, int max_threads, size_t size, double sparsity, bool weak) {
+  const char *workload = w == WORKLOAD_TRANSPOSED ? "transposed" : WORKLOAD_NAMES[w];
+  TENSOR_A *A = NULL;
+  TENSOR_B *B = NULL;
+  TENSOR_C *C = NULL;
+  double index_build_ms = 0.0, base_ms = 0.0;
+  size_t base_n = size;
+  for (int threads = 1; threads <= max_threads; ++threads) {
+    size_t n = size;
+    if (weak) {
+      n = (size_t)round(size * pow((double)threads / max_threads, 1.0 / WORK_EXPONENT));
+      n = n ? n : 1;
+    }
+    if (!A) {
+      load_inputs(cache_dir, w, n, sparsity, sparsity, &B, &C);
+      A = allocate_A(n);
+      index_build_ms = prepare_inputs(A, B, C);
+    }
+
+    omp_set_num_threads(threads);
+    char cpus[8 * MAX_SCALING_THREADS];
+    thread_cpus(threads, cpus, sizeof(cpus));
+    struct timing t = time_kernel(hadamard_transpose_parallel, A, B, C);
+    struct traffic traffic = {tensor_bytes(B) + tensor_bytes(C), tensor_bytes(A), A_NNZ(A)};
+    if (threads == 1) {
+      base_ms = t.median;
+      base_n = n;
+    }
+    double ratio = t.median > 0.0 ? base_ms / t.median : 0.0;
+    double speedup = weak ? pow((double)n / base_n, WORK_EXPONENT) * ratio : ratio;
+
+    print_inputs(workload, n, sparsity, sparsity, index_build_ms);
+    printf(",%s,%s,%s,%d", weak ? "weak" : "strong", pinning(), cpus, threads);
+    print_timing(&t);
+    printf(",%.4f,%.4f", speedup, speedup / threads);
+    printf(",%zu,%zu,%zu", traffic.bytes_read, traffic.bytes_written, traffic.flops);
+    print_roofline(&traffic, t.median, threads);
+    printf("\n");
+    fflush(stdout);
+
+    if (weak || threads == max_threads) {
+      free_tensor(A);
+      free_tensor(B);
+      free_tensor(C);
+      A = NULL;
+    }
+  }
+}
 
+static void bench_scaling(void) {
+  const char *cache_dir = getenv("TENSOR_CACHE_DIR");
+  if (cache_dir && !*cache_dir)
+    cache_dir = NULL;
+  int max_threads = (int)env_or("SCALING_THREADS", omp_get_num_procs());
+  if (max_threads < 1)
+    max_threads = 1;
+  if (max_threads > MAX_SCALING_THREADS)
+    max_threads = MAX_SCALING_THREADS;
+  size_t size = (size_t)env_or("SCALING_SIZE", 2000);
+  double sparsity = env_or("SCALING_SPARSITY", 0.1);
+  fprintf(stderr, "Tensor cache: %s\n", cache_dir ? cache_dir : "(none, generating inputs)");
+  fprintf(stderr, "Scaling: 1 to %d threads, size %zu, sparsity %.2f, pinning %s, weak sizing n ~ threads^(1/%d)\n",
+          max_threads, size, sparsity, pinning(), WORK_EXPONENT);
+
+  printf("A_format,B_format,C_format,search_in,index_bits,value_type,alloc,workload,size,B_sparsity,C_sparsity,"
+         "index_build_ms," SCALING_COLUMNS "," TIMING_COLUMNS ",speedup,efficiency," ROOFLINE_COLUMNS "\n");
+  for (size_t w = 0; w <= WORKLOAD_TRANSPOSED; ++w) {
+    for (int weak = 0; weak <= 1; ++weak) {
+      fprintf(stderr, "Scaling %s (%s)...\n", w == WORKLOAD_TRANSPOSED ? "transposed" : WORKLOAD_NAMES[w],
+              weak ? "weak" : "strong");
+      scale_workload(cache_dir, w, max_threads, size, sparsity, weak);
+    }
+  }
+}
+#endif
+
+int main() {
   // Determine configuration from compile-time flags
 #if defined(FORMAT_A_CSR)
   a_fmt = "csr";
@@ -96,6 +647,10 @@ int main() {
   search = "B";
 #elif defined(SEARCH_C)
   search = "C";
+#elif defined(SEARCH_MERGE)
+  search = "merge";
+#elif defined(SEARCH_HASH)
+  search = "hash";
 #else
 #error "SEARCH not defined"
 #endif
@@ -106,112 +661,135 @@ int main() {
 #else
   fprintf(stderr, " (FULL)\n");
 #endif
-  fprintf(stderr, "Configuration: A=%s, B=%s, C=%s, SEARCH=%s\n", a_fmt, b_fmt, c_fmt, search);
+  fprintf(stderr, "Configuration: A=%s, B=%s, C=%s, SEARCH=%s, INDEX_BITS=%d, VALUE_TYPE=%s, ALLOC=%s\n", a_fmt, b_fmt,
+          c_fmt, search, INDEX_BITS, VALUE_TYPE_NAME, ALLOC_NAME);
   fprintf(stderr, "=============================\n\n");
 
-  // Generate size list
-  size_t sizes[NUM_SAMPLES];
-  size_t num_sizes;
-  generate_sizes(sizes, &num_sizes);
-
-  fprintf(stderr, "Testing sizes: ");
-  for (size_t i = 0; i < num_sizes; ++i) {
-    fprintf(stderr, "%zu%s", sizes[i], i < num_sizes - 1 ? ", " : "\n");
-  }
-
-  fprintf(stderr, "Sparsities: ");
-  for (size_t i = 0; i < NUM_SPARSITIES; ++i) {
-    fprintf(stderr, "%.2f%s", SPARSITIES[i], i < NUM_SPARSITIES - 1 ? ", " : "\n");
-  }
-
-  // Write CSV header to stdout
-  printf("A_format,B_format,C_format,search_in,size,B_sparsity,C_sparsity,avg_time_ms\n");
-
-  // Run benchmarks
-  for (size_t size_idx = 0; size_idx < num_sizes; ++size_idx) {
-    size_t size = sizes[size_idx];
-    fprintf(stderr, "Testing size %zu...\n", size);
-
-    for (size_t b_sp_idx = 0; b_sp_idx < NUM_SPARSITIES; ++b_sp_idx) {
-      double b_sparsity = SPARSITIES[b_sp_idx];
-
-      for (size_t c_sp_idx = 0; c_sp_idx < NUM_SPARSITIES; ++c_sp_idx) {
-        double c_sparsity = SPARSITIES[c_sp_idx];
-
-        // Allocate tensors based on compile-time configuration
-        size_t estimated_nnz = (size_t)(size * size * b_sparsity * c_sparsity);
-        if (estimated_nnz < 1)
-          estimated_nnz = 1;
-
-#if defined(FORMAT_A_CSR) && defined(FORMAT_B_CSR) && defined(FORMAT_C_CSR)
-        struct csr *A = allocate_csr(size, estimated_nnz);
-        struct csr *B = generate_csr(size, size, b_sparsity, SEED);
-        struct csr *C = generate_csr(size, size, c_sparsity, SEED + 1);
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_CSR) && defined(FORMAT_C_CSC)
-        struct csr *A = allocate_csr(size, estimated_nnz);
-        struct csr *B = generate_csr(size, size, b_sparsity, SEED);
-        struct csc *C = generate_csc(size, size, c_sparsity, SEED + 1);
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_CSR) && defined(FORMAT_C_COO)
-        struct csr *A = allocate_csr(size, estimated_nnz);
-        struct csr *B = generate_csr(size, size, b_sparsity, SEED);
-        struct coo *C = generate_coo(size, size, c_sparsity, SEED + 1);
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_COO) && defined(FORMAT_C_CSR)
-        struct csr *A = allocate_csr(size, estimated_nnz);
-        struct coo *B = generate_coo(size, size, b_sparsity, SEED);
-        struct csr *C = generate_csr(size, size, c_sparsity, SEED + 1);
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_COO) && defined(FORMAT_C_CSC)
-        struct csr *A = allocate_csr(size, estimated_nnz);
-        struct coo *B = generate_coo(size, size, b_sparsity, SEED);
-        struct csc *C = generate_csc(size, size, c_sparsity, SEED + 1);
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_COO) && defined(FORMAT_C_COO)
-        struct csr *A = allocate_csr(size, estimated_nnz);
-        struct coo *B = generate_coo(size, size, b_sparsity, SEED);
-        struct coo *C = generate_coo(size, size, c_sparsity, SEED + 1);
-#elif defined(FORMAT_A_CSC) && defined(FORMAT_B_CSC) && defined(FORMAT_C_CSR)
-        struct csc *A = allocate_csc(size, estimated_nnz);
-        struct csc *B = generate_csc(size, size, b_sparsity, SEED);
-        struct csr *C = generate_csr(size, size, c_sparsity, SEED + 1);
-#elif defined(FORMAT_A_CSC) && defined(FORMAT_B_CSC) && defined(FORMAT_C_CSC)
-        struct csc *A = allocate_csc(size, estimated_nnz);
-        struct csc *B = generate_csc(size, size, b_sparsity, SEED);
-        struct csc *C = generate_csc(size, size, c_sparsity, SEED + 1);
-#elif defined(FORMAT_A_CSC) && defined(FORMAT_B_CSC) && defined(FORMAT_C_COO)
-        struct csc *A = allocate_csc(size, estimated_nnz);
-        struct csc *B = generate_csc(size, size, b_sparsity, SEED);
-        struct coo *C = generate_coo(size, size, c_sparsity, SEED + 1);
-#endif
-
-        // Warmup
-        for (int w = 0; w < NUM_WARMUP; ++w) {
-          reset_tensor(A);
-          hadamard_transpose(A, B, C);
-        }
+  // $BENCH_SCALING replaces the sweep over sizes with the thread scaling runs of bench_scaling, $BENCH_BATCH with the
+  // batched runs of bench_batches
+  const char *batch_mode = getenv("BENCH_BATCH");
+  bool batching = batch_mode && *batch_mode && strcmp(batch_mode, "0") != 0;
+  bool scaling = false;
+#if defined(PARALLEL)
+  const char *scaling_mode = getenv("BENCH_SCALING");
+  scaling = scaling_mode && *scaling_mode && strcmp(scaling_mode, "0") != 0;
+  if (!scaling && !batching) {
+    fprintf(stderr, "Threads: ");
+    for (size_t i = 0; i < NUM_THREAD_COUNTS; ++i) {
+      fprintf(stderr, "%d%s", THREAD_COUNTS[i], i < NUM_THREAD_COUNTS - 1 ? ", " : "\n");
+    }
+  }
+  if (hadamard_transpose_parallel_sorts)
+    fprintf(stderr, "Parallel kernel: scatters into A and sorts its slices afterwards, within the timed call\n");
+#endif
 
-        // Benchmark runs
-        double total_time = 0.0;
-        for (int r = 0; r < NUM_RUNS; ++r) {
-          reset_tensor(A);
-          double start = get_cpu_time_us();
-          hadamard_transpose(A, B, C);
-          double end = get_cpu_time_us();
-          total_time += (end - start);
-        }
+  timing = timing_options(NUM_WARMUP, TARGET_CV, TIME_BUDGET_MS);
+  fprintf(stderr, "Timing: %d warmup call(s), %d to %d timed calls until CV <= %.3g or %.0f ms spent\n", timing.warmup,
+          MIN_RUNS, MAX_RUNS, timing.target_cv, timing.time_budget_ms);
+
+  measure_roofline(&roofline);
+  fprintf(stderr, "Roofline: %.1f GB/s STREAM triad, %.1f GFLOP/s multiply-add", roofline.bandwidth_gbs,
+          roofline.gflops);
+  if (roofline.threads > 1)
+    fprintf(stderr, " (%.1f GB/s on %d threads)", roofline.parallel_bandwidth_gbs, roofline.threads);
+  fprintf(stderr, "\n");
+
+  const char *perf = getenv("PERF_COUNTERS");
+  if (perf && *perf && strcmp(perf, "0") != 0) {
+    int opened = open_perf_counters(&counters);
+    counting = opened > 0;
+    fprintf(stderr, "Hardware counters: ");
+    for (int e = 0; e < NUM_PERF_COUNTERS; ++e)
+      fprintf(stderr, "%s%s%s", PERF_COUNTER_NAMES[e], counters.fd[e] >= 0 ? "" : " (unavailable)",
+              e < NUM_PERF_COUNTERS - 1 ? ", " : "\n");
+  }
+
+  // Write CSV header to stdout (the scaling and batched runs write their own)
+  if (!scaling && !batching) {
+    printf("A_format,B_format,C_format,search_in,index_bits,value_type,alloc,workload,size,B_sparsity,C_sparsity,"
+           "index_build_ms," TIMING_COLUMNS "," ROOFLINE_COLUMNS "," MEMORY_COLUMNS);
+    for (int e = 0; e < NUM_PERF_COUNTERS; ++e)
+      printf(",%s_per_nnz", PERF_COUNTER_NAMES[e]);
+#if defined(PARALLEL)
+    // The parallel kernel's timing and roofline columns carry a parallel_ prefix; speedup compares the medians, and
+    // parallel_sorts marks kernels whose time includes sorting the slices they scattered (see
+    // hadamard_transpose_parallel_sorts)
+    printf(",threads,parallel_sorts,parallel_avg_time_ms,parallel_min_time_ms,parallel_median_time_ms,"
+           "parallel_p90_time_ms,parallel_stddev_ms,parallel_runs,speedup,parallel_gb_per_s,parallel_gflop_per_s,"
+           "parallel_roofline_pct");
+#endif
+    printf("\n");
+  }
 
-        double avg_time_ms = (total_time / NUM_RUNS) / 1e3;
+  // A directory of Matrix Market files replaces the generated inputs
+  const char *mtx_dir = getenv("MTX_DIR");
+  if (batching) {
+    bench_batches();
+  } else if (scaling) {
+#if defined(PARALLEL)
+    bench_scaling();
+#endif
+  } else if (mtx_dir && *mtx_dir) {
+    fprintf(stderr, "Matrix Market inputs: %s\n", mtx_dir);
+    bench_mtx_dir(mtx_dir);
+  } else {
+    // Inputs are generated once and then mapped from the cache on every later run and configuration
+    const char *cache_dir = getenv("TENSOR_CACHE_DIR");
+    if (cache_dir && !*cache_dir)
+      cache_dir = NULL;
+    fprintf(stderr, "Tensor cache: %s\n", cache_dir ? cache_dir : "(none, generating inputs)");
 
-        // Output CSV line to stdout
-        printf("%s,%s,%s,%s,%zu,%.2f,%.2f,%.4f\n", a_fmt, b_fmt, c_fmt, search, size, b_sparsity, c_sparsity,
-               avg_time_ms);
-        fflush(stdout);
+    // Generate size list
+    size_t sizes[NUM_SAMPLES];
+    size_t num_sizes;
+    generate_sizes(sizes, &num_sizes);
+
+    fprintf(stderr, "Testing sizes: ");
+    for (size_t i = 0; i < num_sizes; ++i) {
+      fprintf(stderr, "%zu%s", sizes[i], i < num_sizes - 1 ? ", " : "\n");
+    }
 
-        // Free tensors
-        free_tensor(A);
-        free_tensor(B);
-        free_tensor(C);
+    fprintf(stderr, "Sparsities: ");
+    for (size_t i = 0; i < NUM_SPARSITIES; ++i) {
+      fprintf(stderr, "%.2f%s", SPARSITIES[i], i < NUM_SPARSITIES - 1 ? ", " : "\n");
+    }
+
+    fprintf(stderr, "Workloads: ");
+    for (size_t i = 0; i < NUM_WORKLOADS; ++i) {
+      fprintf(stderr, "%s, ", WORKLOAD_NAMES[i]);
+    }
+    fprintf(stderr, "transposed\n");
+
+    // Run benchmarks
+    for (size_t size_idx = 0; size_idx < num_sizes; ++size_idx) {
+      size_t size = sizes[size_idx];
+      fprintf(stderr, "Testing size %zu...\n", size);
+
+      for (size_t w = 0; w <= WORKLOAD_TRANSPOSED; ++w) {
+        const char *workload = w == WORKLOAD_TRANSPOSED ? "transposed" : WORKLOAD_NAMES[w];
+
+        for (size_t b_sp_idx = 0; b_sp_idx < NUM_SPARSITIES; ++b_sp_idx) {
+          double b_sparsity = SPARSITIES[b_sp_idx];
+
+          for (size_t c_sp_idx = 0; c_sp_idx < NUM_SPARSITIES; ++c_sp_idx) {
+            double c_sparsity = SPARSITIES[c_sp_idx];
+
+            // C's pattern, and so its sparsity, is B's in the transposed workload
+            if (w == WORKLOAD_TRANSPOSED && c_sp_idx != b_sp_idx)
+              continue;
+            TENSOR_B *B;
+            TENSOR_C *C;
+            load_inputs(cache_dir, w, size, b_sparsity, c_sparsity, &B, &C);
+            bench_inputs(workload, size, b_sparsity, c_sparsity, B, C);
+          }
+        }
       }
     }
   }
 
+  if (counting)
+    close_perf_counters(&counters);
+  release_arena_pool();
   fprintf(stderr, "\nBenchmark complete!\n");
   return 0;
 }
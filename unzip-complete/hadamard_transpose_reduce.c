@@ -0,0 +1,74 @@
+#include "hadamard_transpose_reduce.h"
+#include "sparse_access.h"
+#include <assert.h>
+#include <stdlib.h>
+
+#if !defined(TENSOR_B) || !defined(TENSOR_C)
+#error "FORMAT_B and FORMAT_C must each be CSR, CSC or COO"
+#elif defined(SEARCH_HASH) && !defined(FORMAT_C_COO)
+#error "SEARCH_HASH needs FORMAT_C=COO"
+#elif !defined(SEARCH_B) && !defined(SEARCH_C) && !defined(SEARCH_MERGE) && !defined(SEARCH_HASH)
+#error "SEARCH must be B, C, MERGE or HASH"
+#endif
+
+#if defined(SEARCH_MERGE)
+// Row i of B and column i of C hold B(i,j) and C(j,i) by ascending j: one merge per i
+void hadamard_transpose_reduce(struct dense *y, TENSOR_B *B, TENSOR_C *C) {
+  size_t n = y->lvl1_size;
+  struct lines b_rows = tensor_rows(B, n);
+  struct lines c_cols = tensor_columns(C, n);
+  for (size_t i = 0; i < n; ++i) {
+    acc_t acc = 0.0;
+    size_t b_idx = line_begin(&b_rows, i), b_end = line_end(&b_rows, i);
+    size_t c_idx = line_begin(&c_cols, i), c_end = line_end(&c_cols, i);
+    while (b_idx < b_end && c_idx < c_end) {
+      size_t b_j = b_rows.crd[b_idx], c_j = c_cols.crd[c_idx];
+      if (b_j == c_j) {
+        acc += (acc_t)line_val(&b_rows, b_idx) * line_val(&c_cols, c_idx);
+        ++b_idx;
+        ++c_idx;
+      } else if (b_j < c_j) {
+        ++b_idx;
+      } else {
+        ++c_idx;
+      }
+    }
+    y->vals[i] += acc;
+  }
+  free_lines(&b_rows);
+  free_lines(&c_cols);
+}
+#else
+// One operand in storage order, its partner located for every entry. Only some formats visit y(i) slice by slice, so
+// the sums collect in an acc_t buffer.
+void hadamard_transpose_reduce(struct dense *y, TENSOR_B *B, TENSOR_C *C) {
+  acc_t *sums = calloc(y->lvl1_size, sizeof(acc_t));
+#if defined(SEARCH_B)
+  for (size_t u = 0; u < tensor_units(C); ++u) {
+    for (size_t c_idx = unit_begin(C, u); c_idx < unit_end(C, u); ++c_idx) {
+      size_t j = entry_row(C, u, c_idx);
+      size_t i = entry_col(C, u, c_idx);
+      size_t b_idx = tensor_locate(B, i, j);
+      if (b_idx != NO_ENTRY)
+        sums[i] += (acc_t)B->vals[b_idx] * C->vals[c_idx];
+    }
+  }
+#else
+#if defined(SEARCH_HASH)
+  assert(C->index_slots);
+#endif
+  for (size_t u = 0; u < tensor_units(B); ++u) {
+    for (size_t b_idx = unit_begin(B, u); b_idx < unit_end(B, u); ++b_idx) {
+      size_t i = entry_row(B, u, b_idx);
+      size_t j = entry_col(B, u, b_idx);
+      size_t c_idx = tensor_locate(C, j, i);
+      if (c_idx != NO_ENTRY)
+        sums[i] += (acc_t)B->vals[b_idx] * C->vals[c_idx];
+    }
+  }
+#endif
+  for (size_t i = 0; i < y->lvl1_size; ++i)
+    y->vals[i] += sums[i];
+  free(sums);
+}
+#endif
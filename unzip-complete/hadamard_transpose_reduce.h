@@ -0,0 +1,35 @@
+#ifndef HADAMARD_TRANSPOSE_REDUCE_H
+#define HADAMARD_TRANSPOSE_REDUCE_H
+
+#include "tensor_formats.h"
+
+// y(i) = sum_j B(i,j) * C(j,i) over square n x n operands, into a dense y of n entries
+//
+// Compile-time configuration flags:
+// FORMAT_B: CSR, CSC, COO
+// FORMAT_C: CSR, CSC, COO
+// SEARCH: C (iterate B in storage order, locate C(j,i) by search), B (iterate C, locate B(i,j)), MERGE (co-iterate
+//         row i of B and column i of C by j; needs sorted operands: sort_tensor for CSR/CSC, row-major order for COO),
+//         HASH (iterate B, locate C(j,i) through the COO index of C, FORMAT_C=COO only)
+
+// Operand types selected by the FORMAT_* flags
+#if defined(FORMAT_B_CSR)
+#define TENSOR_B struct csr
+#elif defined(FORMAT_B_CSC)
+#define TENSOR_B struct csc
+#elif defined(FORMAT_B_COO)
+#define TENSOR_B struct coo
+#endif
+
+#if defined(FORMAT_C_CSR)
+#define TENSOR_C struct csr
+#elif defined(FORMAT_C_CSC)
+#define TENSOR_C struct csc
+#elif defined(FORMAT_C_COO)
+#define TENSOR_C struct coo
+#endif
+
+// Adds the sums to y, so y starts from reset_tensor for the plain product
+void hadamard_transpose_reduce(struct dense *y, TENSOR_B *B, TENSOR_C *C);
+
+#endif /* HADAMARD_TRANSPOSE_REDUCE_H */
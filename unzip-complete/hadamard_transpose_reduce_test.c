@@ -0,0 +1,160 @@
+#include "hadamard_transpose_reduce.h"
+#include "tensor_formats.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Operands are n x n matrices from the structured workloads; every format holds the same matrix for the same
+// arguments, so the CSR copies serve as the dense reference. C is either drawn independently of B or given the
+// pattern of B's transpose, so that every entry of B meets one of C.
+#define N 23
+#define B_SPARSITY 0.3
+#define C_SPARSITY 0.4
+
+#if defined(FORMAT_B_CSR)
+#define generate_b generate_csr_workload
+#elif defined(FORMAT_B_CSC)
+#define generate_b generate_csc_workload
+#elif defined(FORMAT_B_COO)
+#define generate_b generate_coo_workload
+#endif
+
+#if defined(FORMAT_C_CSR)
+#define generate_c generate_csr_workload
+#define generate_c_transposed generate_csr_transposed
+#elif defined(FORMAT_C_CSC)
+#define generate_c generate_csc_workload
+#define generate_c_transposed generate_csc_transposed
+#elif defined(FORMAT_C_COO)
+#define generate_c generate_coo_workload
+#define generate_c_transposed generate_coo_transposed
+#endif
+
+// Values and pattern of a CSR matrix, row-major
+struct image {
+  double vals[N * N];
+  bool present[N * N];
+};
+
+static void fill_image(struct image *image, struct csr *M) {
+  memset(image, 0, sizeof(*image));
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t idx = M->lvl2_pos[i]; idx < M->lvl2_pos[i + 1]; ++idx) {
+      image->vals[i * N + M->lvl2_crd[idx]] = M->vals[idx];
+      image->present[i * N + M->lvl2_crd[idx]] = true;
+    }
+  }
+  free_tensor(M);
+}
+
+static int verify_result(const struct dense *y, const struct image *B, const struct image *C, const char *test_name) {
+  double tolerance = sizeof(value_t) < sizeof(double) ? 1e-4 : 1e-9;
+  int passed = 1;
+  size_t matches = 0;
+  for (size_t i = 0; i < N; ++i) {
+    double expected = 0.0;
+    for (size_t j = 0; j < N; ++j) {
+      if (B->present[i * N + j] && C->present[j * N + i]) {
+        expected += B->vals[i * N + j] * C->vals[j * N + i];
+        ++matches;
+      }
+    }
+    if (fabs(y->vals[i] - expected) > tolerance * (1.0 + fabs(expected))) {
+      printf("  FAIL %s: y(%zu) is %g, expected %g\n", test_name, i, (double)y->vals[i], expected);
+      passed = 0;
+    }
+  }
+  if (passed)
+    printf("  PASS %s (%zu matches)\n", test_name, matches);
+  return passed;
+}
+
+static int verify_workload(enum workload workload, bool transposed, const char *config) {
+  static struct image b_image, c_image;
+  fill_image(&b_image, generate_csr_workload(workload, N, N, B_SPARSITY, 1));
+  TENSOR_B *B = generate_b(workload, N, N, B_SPARSITY, 1);
+  TENSOR_C *C;
+  if (transposed) {
+    fill_image(&c_image, generate_csr_transposed(workload, N, N, B_SPARSITY, 1, 2));
+    C = generate_c_transposed(workload, N, N, B_SPARSITY, 1, 2);
+  } else {
+    fill_image(&c_image, generate_csr_workload(workload, N, N, C_SPARSITY, 2));
+    C = generate_c(workload, N, N, C_SPARSITY, 2);
+  }
+#if defined(SEARCH_MERGE) && !defined(FORMAT_B_COO)
+  sort_tensor(B);
+#endif
+#if defined(SEARCH_MERGE) && !defined(FORMAT_C_COO)
+  sort_tensor(C);
+#elif defined(SEARCH_HASH)
+  build_coo_index(C);
+#endif
+
+  char test_name[96];
+  snprintf(test_name, sizeof(test_name), "%s (%s%s)", config, WORKLOAD_NAMES[workload],
+           transposed ? ", transposed" : "");
+  struct dense *y = allocate_dense(N);
+  reset_tensor(y);
+  hadamard_transpose_reduce(y, B, C);
+  int passed = verify_result(y, &b_image, &c_image, test_name);
+
+  free_tensor(y);
+  free_tensor(B);
+  free_tensor(C);
+  return passed;
+}
+
+int main() {
+  int passed = 1;
+
+  printf("Running Hadamard Transpose Reduce Test\n");
+  printf("================================\n");
+
+#if defined(FORMAT_B_CSR)
+  const char *b_fmt = "CSR";
+#elif defined(FORMAT_B_CSC)
+  const char *b_fmt = "CSC";
+#elif defined(FORMAT_B_COO)
+  const char *b_fmt = "COO";
+#endif
+
+#if defined(FORMAT_C_CSR)
+  const char *c_fmt = "CSR";
+#elif defined(FORMAT_C_CSC)
+  const char *c_fmt = "CSC";
+#elif defined(FORMAT_C_COO)
+  const char *c_fmt = "COO";
+#endif
+
+#if defined(SEARCH_B)
+  const char *search = "B";
+#elif defined(SEARCH_C)
+  const char *search = "C";
+#elif defined(SEARCH_MERGE)
+  const char *search = "MERGE";
+#elif defined(SEARCH_HASH)
+  const char *search = "HASH";
+#endif
+
+  printf("Configuration: B=%s, C=%s, SEARCH=%s\n\n", b_fmt, c_fmt, search);
+
+  char config[64];
+  snprintf(config, sizeof(config), "%s-%s-%s", b_fmt, c_fmt, search);
+  for (char *p = config; *p; ++p)
+    *p = (char)tolower((unsigned char)*p);
+
+  const enum workload workloads[] = {WORKLOAD_UNIFORM, WORKLOAD_POWER_LAW, WORKLOAD_BANDED};
+  for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); ++w) {
+    passed &= verify_workload(workloads[w], false, config);
+    passed &= verify_workload(workloads[w], true, config);
+  }
+  release_arena_pool();
+
+  printf("\n================================\n");
+  printf("Test Result: %s\n", passed ? "PASSED" : "FAILED");
+
+  return passed ? 0 : 1;
+}
@@ -1,10 +1,22 @@
 #include "hadamard_transpose.h"
 #include "tensor_formats.h"
+#include <ctype.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(PARALLEL)
+#include <omp.h>
+#endif
+
+// Entries per slice preallocated for A; GROWABLE_OUTPUT builds start from an empty A and let the kernel grow it
+#if defined(GROWABLE_OUTPUT)
+#define A_DIM2_NNZ 0
+#else
+#define A_DIM2_NNZ 5
+#endif
+
 // Helper to create a simple test CSR matrix for B
 #if defined(FORMAT_B_CSR) || defined(FORMAT_C_CSR)
 static struct csr *create_test_csr_b() {
@@ -133,7 +145,8 @@ static int verify_result_csr(struct csr *A, const char *test_name) {
 
   for (size_t i = 0; i < 3; i++) {
     if (A->lvl2_pos[i] != expected_pos[i]) {
-      printf("  FAIL %s: Row %zu pos mismatch: expected %zu, got %zu\n", test_name, i, expected_pos[i], A->lvl2_pos[i]);
+      printf("  FAIL %s: Row %zu pos mismatch: expected %zu, got %zu\n", test_name, i, expected_pos[i],
+             (size_t)A->lvl2_pos[i]);
       passed = 0;
     }
   }
@@ -141,7 +154,7 @@ static int verify_result_csr(struct csr *A, const char *test_name) {
   for (size_t idx = 0; idx < 5; idx++) {
     if (A->lvl2_crd[idx] != expected_cols[idx]) {
       printf("  FAIL %s: Entry %zu col mismatch: expected %zu, got %zu\n", test_name, idx, expected_cols[idx],
-             A->lvl2_crd[idx]);
+             (size_t)A->lvl2_crd[idx]);
       passed = 0;
     }
     if (fabs(A->vals[idx] - expected_vals[idx]) > 1e-9) {
@@ -178,7 +191,8 @@ static int verify_result_csc(struct csc *A, const char *test_name) {
 
   for (size_t j = 0; j < 3; j++) {
     if (A->lvl2_pos[j] != expected_pos[j]) {
-      printf("  FAIL %s: Col %zu pos mismatch: expected %zu, got %zu\n", test_name, j, expected_pos[j], A->lvl2_pos[j]);
+      printf("  FAIL %s: Col %zu pos mismatch: expected %zu, got %zu\n", test_name, j, expected_pos[j],
+             (size_t)A->lvl2_pos[j]);
       passed = 0;
     }
   }
@@ -186,7 +200,7 @@ static int verify_result_csc(struct csc *A, const char *test_name) {
   for (size_t idx = 0; idx < 5; idx++) {
     if (A->lvl2_crd[idx] != expected_rows[idx]) {
       printf("  FAIL %s: Entry %zu row mismatch: expected %zu, got %zu\n", test_name, idx, expected_rows[idx],
-             A->lvl2_crd[idx]);
+             (size_t)A->lvl2_crd[idx]);
       passed = 0;
     }
     if (fabs(A->vals[idx] - expected_vals[idx]) > 1e-9) {
@@ -203,6 +217,205 @@ static int verify_result_csc(struct csc *A, const char *test_name) {
 }
 #endif
 
+#if defined(FORMAT_A_COO)
+static int verify_result_coo(struct coo *A, const char *test_name) {
+  // Verify A(i,j) = B(i,j) * C(j,i) in COO format: the same entries as for CSR, in any order
+  double expected_vals[5] = {1.0, 8.0, 9.0, 8.0, 25.0};
+  size_t expected_rows[5] = {0, 0, 1, 2, 2};
+  size_t expected_cols[5] = {0, 2, 1, 0, 2};
+
+  int passed = 1;
+
+  if (A->lvl1_nnz != 5) {
+    printf("  FAIL %s: Expected 5 non-zeros, got %zu\n", test_name, A->lvl1_nnz);
+    passed = 0;
+  }
+
+  for (size_t e = 0; e < 5; e++) {
+    size_t found = 0;
+    for (size_t idx = 0; idx < A->lvl1_nnz; idx++) {
+      if (A->lvl1_crd[idx] == expected_rows[e] && A->lvl2_crd[idx] == expected_cols[e]) {
+        found++;
+        if (fabs(A->vals[idx] - expected_vals[e]) > 1e-9) {
+          printf("  FAIL %s: Entry (%zu,%zu) val mismatch: expected %.1f, got %.1f\n", test_name, expected_rows[e],
+                 expected_cols[e], expected_vals[e], A->vals[idx]);
+          passed = 0;
+        }
+      }
+    }
+    if (found != 1) {
+      printf("  FAIL %s: Entry (%zu,%zu) found %zu times\n", test_name, expected_rows[e], expected_cols[e], found);
+      passed = 0;
+    }
+  }
+
+  if (passed) {
+    printf("  PASS %s\n", test_name);
+  }
+  return passed;
+}
+#endif
+
+#if defined(TENSOR_A) && defined(TENSOR_B) && defined(TENSOR_C)
+#if defined(FORMAT_A_CSR)
+#define allocate_batch_a(n) allocate_csr(n, 0)
+#elif defined(FORMAT_A_CSC)
+#define allocate_batch_a(n) allocate_csc(n, 0)
+#elif defined(FORMAT_A_COO)
+#define allocate_batch_a(n) allocate_coo(0)
+#endif
+
+#if defined(FORMAT_B_CSR)
+#define generate_batch_b generate_csr_workload
+#elif defined(FORMAT_B_CSC)
+#define generate_batch_b generate_csc_workload
+#elif defined(FORMAT_B_COO)
+#define generate_batch_b generate_coo_workload
+#endif
+
+#if defined(FORMAT_C_CSR)
+#define generate_batch_c generate_csr_workload
+#define generate_batch_c_transposed generate_csr_transposed
+#elif defined(FORMAT_C_CSC)
+#define generate_batch_c generate_csc_workload
+#define generate_batch_c_transposed generate_csc_transposed
+#elif defined(FORMAT_C_COO)
+#define generate_batch_c generate_coo_workload
+#define generate_batch_c_transposed generate_coo_transposed
+#endif
+
+// The block of a pair in the batched A, from entry begin on, against the pair computed alone shifted by first
+static int same_block(TENSOR_A *A, TENSOR_A *pair, size_t first, size_t begin) {
+  int same = 1;
+#if defined(FORMAT_A_COO)
+  for (size_t k = 0; k < pair->lvl1_nnz; ++k)
+    same &= A->lvl1_crd[begin + k] == pair->lvl1_crd[k] + first &&
+            A->lvl2_crd[begin + k] == pair->lvl2_crd[k] + first && A->vals[begin + k] == pair->vals[k];
+#else
+  for (size_t s = 0; s < pair->lvl1_size; ++s)
+    same &= A->lvl2_pos[first + s] == begin + pair->lvl2_pos[s];
+  for (size_t k = 0; k < pair->lvl2_nnz; ++k)
+    same &= A->lvl2_crd[begin + k] == pair->lvl2_crd[k] + first && A->vals[begin + k] == pair->vals[k];
+#endif
+  return same;
+}
+
+// hadamard_transpose_batch over generated pairs of different sizes, every other one with C holding B's transposed
+// pattern so that it has matches, against hadamard_transpose on each pair alone
+#define BATCH_PAIRS 6
+static int verify_batch(const char *test_name) {
+  static const size_t sizes[BATCH_PAIRS] = {9, 1, 17, 4, 12, 5};
+  TENSOR_B *B[BATCH_PAIRS];
+  TENSOR_C *C[BATCH_PAIRS];
+  size_t offsets[BATCH_PAIRS + 1];
+  size_t total_size = 0;
+  for (unsigned int b = 0; b < BATCH_PAIRS; ++b) {
+    B[b] = generate_batch_b(WORKLOAD_UNIFORM, sizes[b], sizes[b], 0.4, b + 1);
+    C[b] = b % 2 ? generate_batch_c_transposed(WORKLOAD_UNIFORM, sizes[b], sizes[b], 0.4, b + 1, b + 100)
+                 : generate_batch_c(WORKLOAD_UNIFORM, sizes[b], sizes[b], 0.4, b + 100);
+#if defined(SEARCH_MERGE)
+    sort_tensor(B[b]);
+    sort_tensor(C[b]);
+#elif defined(SEARCH_HASH)
+    build_coo_index(C[b]);
+#endif
+    total_size += sizes[b];
+  }
+
+  TENSOR_A *A = allocate_batch_a(total_size);
+  reset_tensor(A);
+  size_t nnz = hadamard_transpose_batch_count(B, C, sizes, BATCH_PAIRS, offsets);
+  hadamard_transpose_batch(A, B, C, sizes, BATCH_PAIRS, offsets);
+#if defined(FORMAT_A_COO)
+  int passed = A->lvl1_nnz == nnz;
+#else
+  int passed = A->lvl2_nnz == nnz && A->lvl2_pos[total_size] == nnz;
+#endif
+
+  size_t first = 0;
+  for (size_t b = 0; b < BATCH_PAIRS; ++b) {
+    TENSOR_A *pair = allocate_batch_a(sizes[b]);
+    reset_tensor(pair);
+    reserve_tensor(pair, offsets[b + 1] - offsets[b]);
+    hadamard_transpose(pair, B[b], C[b]);
+#if defined(FORMAT_A_COO)
+    passed &= pair->lvl1_nnz == offsets[b + 1] - offsets[b];
+#else
+    passed &= pair->lvl2_nnz == offsets[b + 1] - offsets[b];
+#endif
+    passed &= same_block(A, pair, first, offsets[b]);
+    first += sizes[b];
+    free_tensor(pair);
+    free_tensor(B[b]);
+    free_tensor(C[b]);
+  }
+  free_tensor(A);
+
+  printf("  %s %s: hadamard_transpose_batch (%d pairs, %zu entries)\n", passed ? "PASS" : "FAIL", test_name,
+         BATCH_PAIRS, nnz);
+  return passed;
+}
+
+#if defined(PARALLEL)
+// hadamard_transpose_parallel on generated inputs of every workload, C holding B's transposed pattern so that every
+// entry matches, on 1 and 3 threads against the serial kernel: the fixture in main is too small to split unevenly
+#define PARALLEL_SIZE 150
+static int verify_parallel(const char *test_name) {
+  int passed = 1;
+  size_t nnz = 0;
+  int max_threads = omp_get_max_threads();
+  for (int w = 0; w < NUM_WORKLOADS; ++w) {
+    TENSOR_B *B = generate_batch_b(w, PARALLEL_SIZE, PARALLEL_SIZE, 0.1, 11);
+    TENSOR_C *C = generate_batch_c_transposed(w, PARALLEL_SIZE, PARALLEL_SIZE, 0.1, 11, 12);
+#if defined(SEARCH_MERGE)
+    sort_tensor(B);
+    sort_tensor(C);
+#elif defined(SEARCH_HASH)
+    build_coo_index(C);
+#endif
+    TENSOR_A *serial = allocate_batch_a(PARALLEL_SIZE);
+    reset_tensor(serial);
+    size_t count = hadamard_transpose_count(serial, B, C);
+    reserve_tensor(serial, count);
+    hadamard_transpose(serial, B, C);
+    nnz += count;
+
+    for (int threads = 1; threads <= 3; threads += 2) {
+      omp_set_num_threads(threads);
+      TENSOR_A *A = allocate_batch_a(PARALLEL_SIZE);
+      reset_tensor(A);
+      reserve_tensor(A, count);
+      hadamard_transpose_parallel(A, B, C);
+#if defined(FORMAT_A_COO)
+      passed &= A->lvl1_nnz == serial->lvl1_nnz;
+#else
+      passed &= A->lvl2_nnz == serial->lvl2_nnz && A->lvl2_pos[PARALLEL_SIZE] == serial->lvl2_nnz;
+#endif
+      passed &= same_block(A, serial, 0, 0);
+      free_tensor(A);
+    }
+    free_tensor(serial);
+    free_tensor(B);
+    free_tensor(C);
+  }
+  omp_set_num_threads(max_threads);
+
+  printf("  %s %s (parallel): generated inputs of every workload on 1 and 3 threads (%zu entries)\n",
+         passed ? "PASS" : "FAIL", test_name, nnz);
+  return passed;
+}
+#endif
+#endif
+
+static int verify_count(size_t count, size_t nnz, const char *test_name) {
+  if (count != nnz) {
+    printf("  FAIL %s: hadamard_transpose_count returned %zu, kernel wrote %zu\n", test_name, count, nnz);
+    return 0;
+  }
+  printf("  PASS %s: hadamard_transpose_count\n", test_name);
+  return 1;
+}
+
 int main() {
   int passed = 0;
 
@@ -244,6 +457,10 @@ int main() {
   const char *search = "B";
 #elif defined(SEARCH_C)
   const char *search = "C";
+#elif defined(SEARCH_MERGE)
+  const char *search = "MERGE";
+#elif defined(SEARCH_HASH)
+  const char *search = "HASH";
 #else
   const char *search = "UNDEFINED";
 #endif
@@ -251,109 +468,70 @@ int main() {
   printf("Configuration: A=%s, B=%s, C=%s, SEARCH=%s\n\n", a_fmt, b_fmt, c_fmt, search);
 
   // Allocate and run test based on compile-time configuration
-#if defined(FORMAT_A_CSR) && defined(FORMAT_B_CSR) && defined(FORMAT_C_CSR)
-  struct csr *A = allocate_csr(3, 5);
-  struct csr *B = create_test_csr_b();
-  struct csr *C = create_test_csr_c();
-  reset_tensor(A);
-  hadamard_transpose(A, B, C);
-  passed = verify_result_csr(A, "csr-csr-csr");
-  free_tensor(A);
-  free_tensor(B);
-  free_tensor(C);
-
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_CSR) && defined(FORMAT_C_CSC)
-  struct csr *A = allocate_csr(3, 5);
-  struct csr *B = create_test_csr_b();
-  struct csc *C = create_test_csc_c();
-  reset_tensor(A);
-  hadamard_transpose(A, B, C);
-  passed = verify_result_csr(A, "csr-csr-csc");
-  free_tensor(A);
-  free_tensor(B);
-  free_tensor(C);
+#if defined(FORMAT_A_CSR)
+  struct csr *A = allocate_csr(3, A_DIM2_NNZ);
+#define verify_result verify_result_csr
+#define A_NNZ(A) (A)->lvl2_nnz
+#elif defined(FORMAT_A_CSC)
+  struct csc *A = allocate_csc(3, A_DIM2_NNZ);
+#define verify_result verify_result_csc
+#define A_NNZ(A) (A)->lvl2_nnz
+#elif defined(FORMAT_A_COO)
+  struct coo *A = allocate_coo(3 * A_DIM2_NNZ);
+#define verify_result verify_result_coo
+#define A_NNZ(A) (A)->lvl1_nnz
+#endif
 
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_CSR) && defined(FORMAT_C_COO)
-  struct csr *A = allocate_csr(3, 5);
+#if defined(FORMAT_B_CSR)
   struct csr *B = create_test_csr_b();
-  struct coo *C = create_test_coo_c();
-  reset_tensor(A);
-  hadamard_transpose(A, B, C);
-  passed = verify_result_csr(A, "csr-csr-coo");
-  free_tensor(A);
-  free_tensor(B);
-  free_tensor(C);
-
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_COO) && defined(FORMAT_C_CSR)
-  struct csr *A = allocate_csr(3, 5);
+#elif defined(FORMAT_B_CSC)
+  struct csc *B = create_test_csc_b();
+#elif defined(FORMAT_B_COO)
   struct coo *B = create_test_coo_b();
-  struct csr *C = create_test_csr_c();
-  reset_tensor(A);
-  hadamard_transpose(A, B, C);
-  passed = verify_result_csr(A, "csr-coo-csr");
-  free_tensor(A);
-  free_tensor(B);
-  free_tensor(C);
+#endif
 
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_COO) && defined(FORMAT_C_CSC)
-  struct csr *A = allocate_csr(3, 5);
-  struct coo *B = create_test_coo_b();
+#if defined(FORMAT_C_CSR)
+  struct csr *C = create_test_csr_c();
+#elif defined(FORMAT_C_CSC)
   struct csc *C = create_test_csc_c();
-  reset_tensor(A);
-  hadamard_transpose(A, B, C);
-  passed = verify_result_csr(A, "csr-coo-csc");
-  free_tensor(A);
-  free_tensor(B);
-  free_tensor(C);
-
-#elif defined(FORMAT_A_CSR) && defined(FORMAT_B_COO) && defined(FORMAT_C_COO)
-  struct csr *A = allocate_csr(3, 5);
-  struct coo *B = create_test_coo_b();
+#elif defined(FORMAT_C_COO)
   struct coo *C = create_test_coo_c();
-  reset_tensor(A);
-  hadamard_transpose(A, B, C);
-  passed = verify_result_csr(A, "csr-coo-coo");
-  free_tensor(A);
-  free_tensor(B);
-  free_tensor(C);
+#endif
 
-#elif defined(FORMAT_A_CSC) && defined(FORMAT_B_CSC) && defined(FORMAT_C_CSR)
-  struct csc *A = allocate_csc(3, 5);
-  struct csc *B = create_test_csc_b();
-  struct csr *C = create_test_csr_c();
-  reset_tensor(A);
-  hadamard_transpose(A, B, C);
-  passed = verify_result_csc(A, "csc-csc-csr");
-  free_tensor(A);
-  free_tensor(B);
-  free_tensor(C);
+#if !defined(TENSOR_A) || !defined(TENSOR_B) || !defined(TENSOR_C)
+  printf("ERROR: Unsupported or missing format configuration\n");
+  return 1;
+#else
+#if defined(SEARCH_MERGE)
+  sort_tensor(B);
+  sort_tensor(C);
+#elif defined(SEARCH_HASH)
+  build_coo_index(C);
+#endif
 
-#elif defined(FORMAT_A_CSC) && defined(FORMAT_B_CSC) && defined(FORMAT_C_CSC)
-  struct csc *A = allocate_csc(3, 5);
-  struct csc *B = create_test_csc_b();
-  struct csc *C = create_test_csc_c();
-  reset_tensor(A);
-  hadamard_transpose(A, B, C);
-  passed = verify_result_csc(A, "csc-csc-csc");
-  free_tensor(A);
-  free_tensor(B);
-  free_tensor(C);
+  char test_name[64];
+  snprintf(test_name, sizeof(test_name), "%s-%s-%s", a_fmt, b_fmt, c_fmt);
+  for (char *p = test_name; *p; ++p)
+    *p = (char)tolower((unsigned char)*p);
 
-#elif defined(FORMAT_A_CSC) && defined(FORMAT_B_CSC) && defined(FORMAT_C_COO)
-  struct csc *A = allocate_csc(3, 5);
-  struct csc *B = create_test_csc_b();
-  struct coo *C = create_test_coo_c();
   reset_tensor(A);
   hadamard_transpose(A, B, C);
-  passed = verify_result_csc(A, "csc-csc-coo");
+  passed = verify_result(A, test_name);
+  passed &= verify_count(hadamard_transpose_count(A, B, C), A_NNZ(A), test_name);
+#if defined(PARALLEL)
+  char parallel_name[80];
+  snprintf(parallel_name, sizeof(parallel_name), "%s (parallel)", test_name);
+  reset_tensor(A);
+  hadamard_transpose_parallel(A, B, C);
+  passed &= verify_result(A, parallel_name);
+  passed &= verify_parallel(test_name);
+#endif
+  passed &= verify_batch(test_name);
   free_tensor(A);
   free_tensor(B);
   free_tensor(C);
-
-#else
-  printf("ERROR: Unsupported or missing format configuration\n");
-  return 1;
 #endif
+  release_arena_pool();
 
   printf("\n================================\n");
   printf("Test Result: %s\n", passed ? "PASSED" : "FAILED");
@@ -0,0 +1,335 @@
+#include "bench_harness.h"
+#include "tensor_formats.h"
+#include "tensor_io.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Benchmark of the kernels composed from sparse_access.h, one compile-time configuration per binary like
+// hadamard_transpose_bench.c, selected by KERNEL_MATMUL (matmul and matmul_hadamard), KERNEL_REDUCE
+// (hadamard_transpose_reduce) or KERNEL_PERMUTE (permute_contract) with the kernel's FORMAT_* and SEARCH flags. One
+// CSV row per kernel and input: the configuration, the input, the timing distribution and the entries the kernel
+// produced, so the rows of every configuration line up on (kernel, workload, size, sparsities).
+#if defined(KERNEL_MATMUL)
+#include "matmul.h"
+#elif defined(KERNEL_REDUCE)
+#include "hadamard_transpose_reduce.h"
+#elif defined(KERNEL_PERMUTE)
+#include "permute_contract.h"
+#else
+#error "KERNEL must be MATMUL, REDUCE or PERMUTE"
+#endif
+
+// Configuration: sizes stop earlier than hadamard_transpose_bench.c's and sparsities stay low, since the matmul
+// products grow with n * (n * sparsity)^2 and the permute_contract operands with (n * sparsity)^3
+const unsigned int SEED = 42;
+#ifdef DEBUG
+const size_t MIN_SIZE = 10;
+const size_t MAX_SIZE = 100;
+const int NUM_SAMPLES = 3;
+const int NUM_WARMUP = 1;
+const double TARGET_CV = 0.05;
+const double TIME_BUDGET_MS = 20;
+#else
+const size_t MIN_SIZE = 100;
+const size_t MAX_SIZE = 1000;
+const int NUM_SAMPLES = 5;
+const int NUM_WARMUP = 1;
+const double TARGET_CV = 0.02;
+const double TIME_BUDGET_MS = 500;
+#endif
+
+// Timed calls per kernel (see timing_options), set up in main
+static struct timing_options timing;
+
+const double SPARSITIES[] = {0.01, 0.05, 0.1};
+const size_t NUM_SPARSITIES = sizeof(SPARSITIES) / sizeof(SPARSITIES[0]);
+
+// Generate logarithmically-spaced sizes
+static void generate_sizes(size_t *sizes, size_t *count) {
+  double log_min = log10(MIN_SIZE);
+  double log_max = log10(MAX_SIZE);
+  size_t idx = 0;
+  for (int s = 0; s < NUM_SAMPLES; ++s) {
+    size_t size = (size_t)round(pow(10.0, log_min + (log_max - log_min) * s / (NUM_SAMPLES - 1)));
+    if (idx == 0 || sizes[idx - 1] != size)
+      sizes[idx++] = size;
+  }
+  *count = idx;
+}
+
+struct run_call {
+  void (*run)(void);
+};
+
+static void call_run(void *arg) { ((struct run_call *)arg)->run(); }
+
+// Time calls of run, which resets its own output
+static struct timing time_kernel(void (*run)(void)) {
+  struct run_call call = {run};
+  return time_runs(&timing, NULL, call_run, &call);
+}
+
+#define CSV_COLUMNS                                                                                                    \
+  "kernel,A_format,B_format,C_format,search_in,index_bits,value_type,alloc,workload,size,B_sparsity,C_sparsity,"      \
+  "avg_time_ms,min_time_ms,median_time_ms,p90_time_ms,stddev_ms,runs,output_nnz"
+
+// Configuration names, derived from the compile-time flags; A is "dense" for the kernels that reduce into y
+static const char *a_fmt, *b_fmt, *c_fmt, *search;
+
+static void print_row(const char *kernel, const char *workload, size_t size, double b_sparsity, double c_sparsity,
+                      const struct timing *t, size_t output_nnz) {
+  printf("%s,%s,%s,%s,%s,%d,%s,%s,%s,%zu,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%d,%zu\n", kernel, a_fmt, b_fmt, c_fmt,
+         search, INDEX_BITS, VALUE_TYPE_NAME, ALLOC_NAME, workload, size, b_sparsity, c_sparsity, t->mean, t->min,
+         t->median, t->p90, t->stddev, t->runs, output_nnz);
+  fflush(stdout);
+}
+
+#if defined(KERNEL_MATMUL) || defined(KERNEL_REDUCE)
+#if defined(FORMAT_B_CSR)
+#define cached_B_workload cached_csr_workload
+#define cached_B_transposed cached_csr_transposed
+#elif defined(FORMAT_B_CSC)
+#define cached_B_workload cached_csc_workload
+#define cached_B_transposed cached_csc_transposed
+#elif defined(FORMAT_B_COO)
+#define cached_B_workload cached_coo_workload
+#define cached_B_transposed cached_coo_transposed
+#endif
+
+#if defined(FORMAT_C_CSR)
+#define cached_C_workload cached_csr_workload
+#define cached_C_transposed cached_csr_transposed
+#elif defined(FORMAT_C_CSC)
+#define cached_C_workload cached_csc_workload
+#define cached_C_transposed cached_csc_transposed
+#elif defined(FORMAT_C_COO)
+#define cached_C_workload cached_coo_workload
+#define cached_C_transposed cached_coo_transposed
+#endif
+#endif
+
+// The operands of the input being timed, for the run functions
+#if defined(KERNEL_MATMUL)
+static TENSOR_A *A;
+static TENSOR_B *B;
+static TENSOR_C *C, *D;
+
+#if defined(FORMAT_A_CSR)
+#define allocate_A(n) allocate_csr(n, 0)
+#define A_NNZ(A) (A)->lvl2_nnz
+#elif defined(FORMAT_A_CSC)
+#define allocate_A(n) allocate_csc(n, 0)
+#define A_NNZ(A) (A)->lvl2_nnz
+#elif defined(FORMAT_A_COO)
+#define allocate_A(n) allocate_coo(0)
+#define A_NNZ(A) (A)->lvl1_nnz
+#endif
+
+static void run_matmul(void) {
+  reset_tensor(A);
+  matmul(A, B, C);
+}
+
+static void run_matmul_hadamard(void) {
+  reset_tensor(A);
+  matmul_hadamard(A, B, C, D);
+}
+
+// Both products of every structured workload, A sized exactly by the count functions before timing
+static void bench_input(const char *cache_dir, size_t w, size_t size, double b_sparsity, double c_sparsity) {
+  B = cached_B_workload(cache_dir, w, size, size, b_sparsity, SEED);
+  C = cached_C_workload(cache_dir, w, size, size, c_sparsity, SEED + 1);
+  D = cached_C_workload(cache_dir, w, size, size, c_sparsity, SEED + 2);
+  A = allocate_A(size);
+
+  reset_tensor(A);
+  reserve_tensor(A, matmul_count(A, B, C));
+  struct timing t = time_kernel(run_matmul);
+  print_row("matmul", WORKLOAD_NAMES[w], size, b_sparsity, c_sparsity, &t, A_NNZ(A));
+
+  reset_tensor(A);
+  reserve_tensor(A, matmul_hadamard_count(A, B, C, D));
+  t = time_kernel(run_matmul_hadamard);
+  print_row("matmul_hadamard", WORKLOAD_NAMES[w], size, b_sparsity, c_sparsity, &t, A_NNZ(A));
+
+  free_tensor(A);
+  free_tensor(B);
+  free_tensor(C);
+  free_tensor(D);
+}
+
+#define NUM_INPUT_WORKLOADS NUM_WORKLOADS
+#define INPUT_SPARSITIES NUM_SPARSITIES
+
+#elif defined(KERNEL_REDUCE)
+static struct dense *y;
+static TENSOR_B *B;
+static TENSOR_C *C;
+
+static void run_reduce(void) {
+  reset_tensor(y);
+  hadamard_transpose_reduce(y, B, C);
+}
+
+// Rows of y with a non-zero sum
+static size_t dense_nnz(const struct dense *y) {
+  size_t nnz = 0;
+  for (size_t i = 0; i < y->lvl1_size; ++i)
+    nnz += y->vals[i] != 0;
+  return nnz;
+}
+
+// The structured workloads plus "transposed", where C holds B's transposed pattern so every entry finds its partner
+static void bench_input(const char *cache_dir, size_t w, size_t size, double b_sparsity, double c_sparsity) {
+  bool transposed = w == NUM_WORKLOADS;
+  if (transposed && c_sparsity != b_sparsity)
+    return;
+  B = cached_B_workload(cache_dir, transposed ? WORKLOAD_UNIFORM : w, size, size, b_sparsity, SEED);
+  C = transposed ? cached_C_transposed(cache_dir, WORKLOAD_UNIFORM, size, size, b_sparsity, SEED, SEED + 1)
+                 : cached_C_workload(cache_dir, w, size, size, c_sparsity, SEED + 1);
+  y = allocate_dense(size);
+#if defined(SEARCH_MERGE) && !defined(FORMAT_B_COO)
+  sort_tensor(B);
+#endif
+#if defined(SEARCH_MERGE) && !defined(FORMAT_C_COO)
+  sort_tensor(C);
+#elif defined(SEARCH_HASH)
+  build_coo_index(C);
+#endif
+
+  struct timing t = time_kernel(run_reduce);
+  print_row("hadamard_transpose_reduce", transposed ? "transposed" : WORKLOAD_NAMES[w], size, b_sparsity,
+            transposed ? b_sparsity : c_sparsity, &t, dense_nnz(y));
+
+  free_tensor(y);
+  free_tensor(B);
+  free_tensor(C);
+}
+
+#define NUM_INPUT_WORKLOADS (NUM_WORKLOADS + 1)
+#define INPUT_SPARSITIES NUM_SPARSITIES
+
+#elif defined(KERNEL_PERMUTE)
+static struct dense *y;
+static struct csf *B, *C;
+
+static void run_permute(void) {
+  reset_tensor(y);
+  permute_contract(y, B, C);
+}
+
+static size_t dense_nnz(const struct dense *y) {
+  size_t nnz = 0;
+  for (size_t i = 0; i < y->lvl1_size; ++i)
+    nnz += y->vals[i] != 0;
+  return nnz;
+}
+
+// Uniform size^3 operands at one sparsity per level (generate_csf), so C's sparsity follows B's
+static void bench_input(const char *cache_dir, size_t w, size_t size, double b_sparsity, double c_sparsity) {
+  (void)w;
+  (void)c_sparsity;
+  B = cached_csf(cache_dir, size, size, size, b_sparsity, SEED);
+  C = cached_csf(cache_dir, size, size, size, b_sparsity, SEED + 1);
+  y = allocate_dense(size);
+
+  struct timing t = time_kernel(run_permute);
+  print_row("permute_contract", WORKLOAD_NAMES[WORKLOAD_UNIFORM], size, b_sparsity, b_sparsity, &t, dense_nnz(y));
+
+  free_tensor(y);
+  free_tensor(B);
+  free_tensor(C);
+}
+
+#define NUM_INPUT_WORKLOADS 1
+#define INPUT_SPARSITIES 1
+#endif
+
+int main() {
+#if defined(KERNEL_MATMUL)
+#if defined(FORMAT_A_CSR)
+  a_fmt = "csr";
+#elif defined(FORMAT_A_CSC)
+  a_fmt = "csc";
+#elif defined(FORMAT_A_COO)
+  a_fmt = "coo";
+#endif
+#elif defined(KERNEL_REDUCE) || defined(KERNEL_PERMUTE)
+  a_fmt = "dense";
+#endif
+
+#if defined(FORMAT_B_CSR)
+  b_fmt = "csr";
+#elif defined(FORMAT_B_CSC)
+  b_fmt = "csc";
+#elif defined(FORMAT_B_COO)
+  b_fmt = "coo";
+#elif defined(FORMAT_B_CSF)
+  b_fmt = "csf";
+#endif
+
+#if defined(FORMAT_C_CSR)
+  c_fmt = "csr";
+#elif defined(FORMAT_C_CSC)
+  c_fmt = "csc";
+#elif defined(FORMAT_C_COO)
+  c_fmt = "coo";
+#elif defined(FORMAT_C_CSF)
+  c_fmt = "csf";
+#endif
+
+#if defined(SEARCH_INNER)
+  search = "inner";
+#elif defined(SEARCH_OUTER)
+  search = "outer";
+#elif defined(SEARCH_GUSTAVSON)
+  search = "gustavson";
+#elif defined(SEARCH_B)
+  search = "B";
+#elif defined(SEARCH_C)
+  search = "C";
+#elif defined(SEARCH_MERGE)
+  search = "merge";
+#elif defined(SEARCH_HASH)
+  search = "hash";
+#endif
+
+  fprintf(stderr, "Sparse Kernels Benchmark");
+#ifdef DEBUG
+  fprintf(stderr, " (DEBUG)\n");
+#else
+  fprintf(stderr, " (FULL)\n");
+#endif
+  fprintf(stderr, "Configuration: A=%s, B=%s, C=%s, SEARCH=%s, INDEX_BITS=%d, VALUE_TYPE=%s, ALLOC=%s\n", a_fmt, b_fmt,
+          c_fmt, search, INDEX_BITS, VALUE_TYPE_NAME, ALLOC_NAME);
+  fprintf(stderr, "=============================\n\n");
+
+  timing = timing_options(NUM_WARMUP, TARGET_CV, TIME_BUDGET_MS);
+
+  const char *cache_dir = getenv("TENSOR_CACHE_DIR");
+  if (cache_dir && !*cache_dir)
+    cache_dir = NULL;
+  fprintf(stderr, "Tensor cache: %s\n", cache_dir ? cache_dir : "(none, generating inputs)");
+
+  size_t sizes[NUM_SAMPLES];
+  size_t num_sizes;
+  generate_sizes(sizes, &num_sizes);
+
+  printf(CSV_COLUMNS "\n");
+  for (size_t size_idx = 0; size_idx < num_sizes; ++size_idx) {
+    fprintf(stderr, "Testing size %zu...\n", sizes[size_idx]);
+    for (size_t w = 0; w < NUM_INPUT_WORKLOADS; ++w) {
+      for (size_t b_sp_idx = 0; b_sp_idx < NUM_SPARSITIES; ++b_sp_idx) {
+        for (size_t c_sp_idx = 0; c_sp_idx < INPUT_SPARSITIES; ++c_sp_idx)
+          bench_input(cache_dir, w, sizes[size_idx], SPARSITIES[b_sp_idx], SPARSITIES[c_sp_idx]);
+      }
+    }
+  }
+
+  release_arena_pool();
+  fprintf(stderr, "\nBenchmark complete!\n");
+  return 0;
+}
@@ -0,0 +1,379 @@
+#include "matmul.h"
+#include "sparse_access.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(TENSOR_A) || !defined(TENSOR_B) || !defined(TENSOR_C)
+#error "FORMAT_A, FORMAT_B and FORMAT_C must each be CSR, CSC or COO"
+#elif !defined(SEARCH_INNER) && !defined(SEARCH_OUTER) && !defined(SEARCH_GUSTAVSON)
+#error "SEARCH must be INNER, OUTER or GUSTAVSON"
+#endif
+
+// Appends grow A as they go in GROWABLE_OUTPUT builds; otherwise A must already have room for every entry (see
+// matmul_count)
+#if defined(GROWABLE_OUTPUT)
+#define GROW_OUTPUT(T, nnz) grow_tensor(T, nnz)
+#else
+#define GROW_OUTPUT(T, nnz)
+#endif
+
+// Slices of A: its rows for CSR and COO, its columns for CSC. A(i,j) sits in slice A_SLICE(i,j) at A_CRD(i,j).
+#if defined(FORMAT_A_CSC)
+#define A_BY_COLUMNS
+#define A_SLICE(i, j) (j)
+#define A_CRD(i, j) (i)
+#else
+#define A_SLICE(i, j) (i)
+#define A_CRD(i, j) (j)
+#endif
+
+// n of the n x n operands; an empty A contributes its slices, a COO one nothing
+static size_t operand_extent(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) {
+  size_t n = tensor_extent(A);
+  size_t n_b = tensor_extent(B);
+  size_t n_c = tensor_extent(C);
+  if (n_b > n)
+    n = n_b;
+  if (n_c > n)
+    n = n_c;
+  return n;
+}
+
+// Append the entry at coordinate crd of slice s (for a COO A: A(s, crd)) to the slice of A being built
+static inline void append(TENSOR_A *A, size_t s, size_t crd, acc_t val) {
+#if defined(FORMAT_A_COO)
+  size_t nnz = A->lvl1_nnz;
+  GROW_OUTPUT(A, nnz + 1);
+  A->lvl1_crd[nnz] = s;
+  A->lvl2_crd[nnz] = crd;
+  A->vals[nnz] = val;
+  A->lvl1_nnz = nnz + 1;
+#else
+  (void)s;
+  size_t nnz = A->lvl2_nnz;
+  GROW_OUTPUT(A, nnz + 1);
+  A->lvl2_crd[nnz] = crd;
+  A->vals[nnz] = val;
+  A->lvl2_nnz = nnz + 1;
+#endif
+}
+
+static inline void end_slice(TENSOR_A *A, size_t s) {
+#if defined(FORMAT_A_COO)
+  (void)A;
+  (void)s;
+#else
+  A->lvl2_pos[s + 1] = A->lvl2_nnz;
+#endif
+}
+
+// Distinct coordinates over the rows of A, found by a symbolic row-by-row pass whatever the loop order
+static size_t count_entries(TENSOR_B *B, TENSOR_C *C, TENSOR_C *D, size_t n, const bool hadamard) {
+  struct lines b_rows = tensor_rows(B, n);
+  struct lines c_rows = tensor_rows(C, n);
+  struct lines d_rows = hadamard ? tensor_rows(D, n) : (struct lines){0};
+  size_t *mark = calloc(n, sizeof(size_t));
+  size_t count = 0;
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t b_idx = line_begin(&b_rows, i); b_idx < line_end(&b_rows, i); ++b_idx) {
+      size_t k = b_rows.crd[b_idx];
+      for (size_t c_idx = line_begin(&c_rows, k); c_idx < line_end(&c_rows, k); ++c_idx) {
+        size_t j = c_rows.crd[c_idx];
+        if (mark[j] == i + 1 || (hadamard && line_locate(&d_rows, k, j) == NO_ENTRY))
+          continue;
+        mark[j] = i + 1;
+        ++count;
+      }
+    }
+  }
+  free(mark);
+  free_lines(&b_rows);
+  free_lines(&c_rows);
+  free_lines(&d_rows);
+  return count;
+}
+
+// =============================================================================
+// SEARCH=GUSTAVSON: slice by slice through a sparse accumulator
+// =============================================================================
+
+#if defined(SEARCH_GUSTAVSON)
+// Sums over the coordinates of one slice of A, the slice that last touched each coordinate (plus one, so a zeroed
+// marker is untouched) and the coordinates the current slice touched
+struct spa {
+  acc_t *sums;
+  size_t *mark;
+  index_t *touched;
+  size_t count;
+};
+
+static void spa_init(struct spa *spa, size_t n) {
+  spa->sums = malloc(n * sizeof(acc_t));
+  spa->mark = calloc(n, sizeof(size_t));
+  spa->touched = malloc(n * sizeof(index_t));
+  spa->count = 0;
+}
+
+static void spa_free(struct spa *spa) {
+  free(spa->sums);
+  free(spa->mark);
+  free(spa->touched);
+}
+
+static inline void spa_add(struct spa *spa, size_t s, size_t crd, acc_t val) {
+  if (spa->mark[crd] != s + 1) {
+    spa->mark[crd] = s + 1;
+    spa->sums[crd] = 0.0;
+    spa->touched[spa->count++] = crd;
+  }
+  spa->sums[crd] += val;
+}
+
+static int compare_index(const void *a, const void *b) {
+  index_t x = *(const index_t *)a, y = *(const index_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Append the coordinates slice s touched to A in ascending order and empty the touched list
+static inline void spa_flush(struct spa *spa, TENSOR_A *A, size_t s) {
+  qsort(spa->touched, spa->count, sizeof(index_t), compare_index);
+  for (size_t t = 0; t < spa->count; ++t) {
+    size_t crd = spa->touched[t];
+    append(A, s, crd, spa->sums[crd]);
+  }
+  spa->count = 0;
+}
+
+// Row i of A sums the rows k of C scaled by B(i,k), locating D(k,j) for every product. A CSC A is built column by
+// column instead: column j sums the columns k of B scaled by C(k,j), so D(k,j) is located once per entry of C.
+static void multiply(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C, TENSOR_C *D, const bool hadamard) {
+  size_t n = operand_extent(A, B, C);
+#if defined(A_BY_COLUMNS)
+  struct lines outer = tensor_columns(C, n);
+  struct lines inner = tensor_columns(B, n);
+  struct lines d_lines = hadamard ? tensor_columns(D, n) : (struct lines){0};
+#else
+  struct lines outer = tensor_rows(B, n);
+  struct lines inner = tensor_rows(C, n);
+  struct lines d_lines = hadamard ? tensor_rows(D, n) : (struct lines){0};
+#endif
+  struct spa spa;
+  spa_init(&spa, n);
+
+  for (size_t s = 0; s < n; ++s) {
+    for (size_t o_idx = line_begin(&outer, s); o_idx < line_end(&outer, s); ++o_idx) {
+      size_t k = outer.crd[o_idx];
+      acc_t o_val = line_val(&outer, o_idx);
+#if defined(A_BY_COLUMNS)
+      if (hadamard) {
+        size_t d_idx = line_locate(&d_lines, s, k);
+        if (d_idx == NO_ENTRY)
+          continue;
+        o_val *= d_lines.vals[d_idx];
+      }
+#endif
+      for (size_t i_idx = line_begin(&inner, k); i_idx < line_end(&inner, k); ++i_idx) {
+        size_t crd = inner.crd[i_idx];
+        acc_t i_val = line_val(&inner, i_idx);
+#if !defined(A_BY_COLUMNS)
+        if (hadamard) {
+          size_t d_idx = line_locate(&d_lines, k, crd);
+          if (d_idx == NO_ENTRY)
+            continue;
+          i_val *= d_lines.vals[d_idx];
+        }
+#endif
+        spa_add(&spa, s, crd, o_val * i_val);
+      }
+    }
+    spa_flush(&spa, A, s);
+    end_slice(A, s);
+  }
+
+  spa_free(&spa);
+  free_lines(&outer);
+  free_lines(&inner);
+  free_lines(&d_lines);
+}
+#endif
+
+// =============================================================================
+// SEARCH=INNER: one dot product per entry of A
+// =============================================================================
+
+#if defined(SEARCH_INNER)
+// Row i of B is scattered into a dense work vector over k, then every column j of C is walked against it, locating
+// D(k,j) for every product. A CSC A scatters column j of C (times D) instead and walks every row i of B against it.
+// Slices whose scattered line is empty are skipped.
+static void multiply(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C, TENSOR_C *D, const bool hadamard) {
+  size_t n = operand_extent(A, B, C);
+#if defined(A_BY_COLUMNS)
+  struct lines scattered = tensor_columns(C, n);
+  struct lines walked = tensor_rows(B, n);
+#else
+  struct lines scattered = tensor_rows(B, n);
+  struct lines walked = tensor_columns(C, n);
+#endif
+  struct lines d_lines = hadamard ? tensor_columns(D, n) : (struct lines){0};
+  acc_t *work = malloc(n * sizeof(acc_t));
+  size_t *mark = calloc(n, sizeof(size_t));
+
+  for (size_t s = 0; s < n; ++s) {
+    if (line_begin(&scattered, s) == line_end(&scattered, s)) {
+      end_slice(A, s);
+      continue;
+    }
+    for (size_t s_idx = line_begin(&scattered, s); s_idx < line_end(&scattered, s); ++s_idx) {
+      size_t k = scattered.crd[s_idx];
+      acc_t s_val = line_val(&scattered, s_idx);
+#if defined(A_BY_COLUMNS)
+      if (hadamard) {
+        size_t d_idx = line_locate(&d_lines, s, k);
+        if (d_idx == NO_ENTRY)
+          continue;
+        s_val *= d_lines.vals[d_idx];
+      }
+#endif
+      mark[k] = s + 1;
+      work[k] = s_val;
+    }
+
+    for (size_t crd = 0; crd < n; ++crd) {
+      acc_t sum = 0.0;
+      bool hit = false;
+      for (size_t w_idx = line_begin(&walked, crd); w_idx < line_end(&walked, crd); ++w_idx) {
+        size_t k = walked.crd[w_idx];
+        if (mark[k] != s + 1)
+          continue;
+        acc_t w_val = line_val(&walked, w_idx);
+#if !defined(A_BY_COLUMNS)
+        if (hadamard) {
+          size_t d_idx = line_locate(&d_lines, crd, k);
+          if (d_idx == NO_ENTRY)
+            continue;
+          w_val *= d_lines.vals[d_idx];
+        }
+#endif
+        sum += work[k] * w_val;
+        hit = true;
+      }
+      if (hit)
+        append(A, s, crd, sum);
+    }
+    end_slice(A, s);
+  }
+
+  free(work);
+  free(mark);
+  free_lines(&scattered);
+  free_lines(&walked);
+  free_lines(&d_lines);
+}
+#endif
+
+// =============================================================================
+// SEARCH=OUTER: expand, sort and compress
+// =============================================================================
+
+#if defined(SEARCH_OUTER)
+struct product {
+  index_t crd;
+  acc_t val;
+};
+
+static int compare_product(const void *a, const void *b) {
+  index_t x = ((const struct product *)a)->crd, y = ((const struct product *)b)->crd;
+  return (x > y) - (x < y);
+}
+
+// Column k of B times row k of C for every k: the products are counted per slice of A, scattered into their slices
+// through the counts as insertion cursors (like hadamard_transpose's two-pass kernels), then every slice is sorted by
+// coordinate and its runs summed. Holds every product at once, D(k,j) located for each.
+static void multiply(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C, TENSOR_C *D, const bool hadamard) {
+  size_t n = operand_extent(A, B, C);
+  struct lines b_cols = tensor_columns(B, n);
+  struct lines c_rows = tensor_rows(C, n);
+  struct lines d_rows = hadamard ? tensor_rows(D, n) : (struct lines){0};
+
+  // Pass 1: products per slice of A; without D every pairing is a product, so only the line lengths are needed
+  size_t *slice_pos = calloc(n + 1, sizeof(size_t));
+  for (size_t k = 0; k < n; ++k) {
+    if (!hadamard) {
+#if defined(A_BY_COLUMNS)
+      size_t b_len = line_end(&b_cols, k) - line_begin(&b_cols, k);
+      for (size_t c_idx = line_begin(&c_rows, k); c_idx < line_end(&c_rows, k); ++c_idx)
+        slice_pos[c_rows.crd[c_idx] + 1] += b_len;
+#else
+      size_t c_len = line_end(&c_rows, k) - line_begin(&c_rows, k);
+      for (size_t b_idx = line_begin(&b_cols, k); b_idx < line_end(&b_cols, k); ++b_idx)
+        slice_pos[b_cols.crd[b_idx] + 1] += c_len;
+#endif
+      continue;
+    }
+    for (size_t b_idx = line_begin(&b_cols, k); b_idx < line_end(&b_cols, k); ++b_idx) {
+      for (size_t c_idx = line_begin(&c_rows, k); c_idx < line_end(&c_rows, k); ++c_idx) {
+        if (line_locate(&d_rows, k, c_rows.crd[c_idx]) != NO_ENTRY)
+          slice_pos[A_SLICE(b_cols.crd[b_idx], c_rows.crd[c_idx]) + 1]++;
+      }
+    }
+  }
+  for (size_t s = 0; s < n; ++s)
+    slice_pos[s + 1] += slice_pos[s];
+
+  // Pass 2: scatter the products, advancing slice_pos[s] to the next free slot of slice s
+  struct product *products = malloc(slice_pos[n] * sizeof(struct product));
+  for (size_t k = 0; k < n; ++k) {
+    for (size_t b_idx = line_begin(&b_cols, k); b_idx < line_end(&b_cols, k); ++b_idx) {
+      size_t i = b_cols.crd[b_idx];
+      acc_t b_val = line_val(&b_cols, b_idx);
+      for (size_t c_idx = line_begin(&c_rows, k); c_idx < line_end(&c_rows, k); ++c_idx) {
+        size_t j = c_rows.crd[c_idx];
+        acc_t c_val = line_val(&c_rows, c_idx);
+        if (hadamard) {
+          size_t d_idx = line_locate(&d_rows, k, j);
+          if (d_idx == NO_ENTRY)
+            continue;
+          c_val *= d_rows.vals[d_idx];
+        }
+        size_t p = slice_pos[A_SLICE(i, j)]++;
+        products[p].crd = A_CRD(i, j);
+        products[p].val = b_val * c_val;
+      }
+    }
+  }
+
+  // Pass 3: cursors now hold slice ends; sort each slice and append one entry per run of equal coordinates
+  size_t start = 0;
+  for (size_t s = 0; s < n; ++s) {
+    size_t end = slice_pos[s];
+    qsort(products + start, end - start, sizeof(struct product), compare_product);
+    for (size_t p = start; p < end;) {
+      size_t crd = products[p].crd;
+      acc_t sum = 0.0;
+      for (; p < end && products[p].crd == crd; ++p)
+        sum += products[p].val;
+      append(A, s, crd, sum);
+    }
+    end_slice(A, s);
+    start = end;
+  }
+
+  free(products);
+  free(slice_pos);
+  free_lines(&b_cols);
+  free_lines(&c_rows);
+  free_lines(&d_rows);
+}
+#endif
+
+void matmul(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) { multiply(A, B, C, NULL, false); }
+
+void matmul_hadamard(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C, TENSOR_C *D) { multiply(A, B, C, D, true); }
+
+size_t matmul_count(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C) {
+  return count_entries(B, C, NULL, operand_extent(A, B, C), false);
+}
+
+size_t matmul_hadamard_count(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C, TENSOR_C *D) {
+  return count_entries(B, C, D, operand_extent(A, B, C), true);
+}
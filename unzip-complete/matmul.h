@@ -0,0 +1,59 @@
+#ifndef MATMUL_H
+#define MATMUL_H
+
+#include "tensor_formats.h"
+
+// A(i,j) = B(i,k) * C(k,j) and A(i,j) = B(i,k) * C(k,j) * D(k,j) over square n x n operands
+//
+// Compile-time configuration flags:
+// FORMAT_A: CSR, CSC, COO
+// FORMAT_B: CSR, CSC, COO
+// FORMAT_C: CSR, CSC, COO (also the format of D)
+// SEARCH: the loop order
+//   INNER: A(i,j) as the dot product of row i of B and column j of C (column j of C and row i of B for a CSC A)
+//   OUTER: the sum over k of column k of B times row k of C, expanded into A's slices, sorted and summed
+//   GUSTAVSON: row i of A as the rows k of C scaled by B(i,k), through a sparse accumulator (column j of A as the
+//              columns k of B scaled by C(k,j) for a CSC A)
+//
+// Rows or columns an operand does not store are gathered once per call (see sparse_access.h), so the format choice
+// decides which loop orders pay for a transposed view. A's slices come out sorted, a COO A in row-major order. Every
+// A(i,j) with at least one product is written, even if the products cancel.
+//
+// GROWABLE_OUTPUT: grow A as entries are appended instead of relying on its preallocated capacity (see matmul_count)
+
+// Operand types selected by the FORMAT_* flags
+#if defined(FORMAT_A_CSR)
+#define TENSOR_A struct csr
+#elif defined(FORMAT_A_CSC)
+#define TENSOR_A struct csc
+#elif defined(FORMAT_A_COO)
+#define TENSOR_A struct coo
+#endif
+
+#if defined(FORMAT_B_CSR)
+#define TENSOR_B struct csr
+#elif defined(FORMAT_B_CSC)
+#define TENSOR_B struct csc
+#elif defined(FORMAT_B_COO)
+#define TENSOR_B struct coo
+#endif
+
+#if defined(FORMAT_C_CSR)
+#define TENSOR_C struct csr
+#elif defined(FORMAT_C_CSC)
+#define TENSOR_C struct csc
+#elif defined(FORMAT_C_COO)
+#define TENSOR_C struct coo
+#endif
+
+// n is the slices of a CSR/CSC operand, or one past the largest coordinate when every operand is COO. A CSR/CSC A must
+// have n slices. Expects A to have been reset.
+void matmul(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C);
+void matmul_hadamard(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C, TENSOR_C *D);
+
+// Exact number of entries matmul (matmul_hadamard) writes into A, for sizing A before the call; the same for every
+// loop order. Only A's shape is read.
+size_t matmul_count(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C);
+size_t matmul_hadamard_count(TENSOR_A *A, TENSOR_B *B, TENSOR_C *C, TENSOR_C *D);
+
+#endif /* MATMUL_H */
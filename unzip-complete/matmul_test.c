@@ -0,0 +1,254 @@
+#include "matmul.h"
+#include "tensor_formats.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Operands are n x n matrices from the structured workloads; generate_*_workload gives every format the same matrix
+// for the same arguments, so the CSR copies serve as the dense reference
+#define N 23
+#define B_SPARSITY 0.2
+#define C_SPARSITY 0.25
+#define D_SPARSITY 0.5
+
+#if defined(FORMAT_B_CSR)
+#define generate_b generate_csr_workload
+#elif defined(FORMAT_B_CSC)
+#define generate_b generate_csc_workload
+#elif defined(FORMAT_B_COO)
+#define generate_b generate_coo_workload
+#endif
+
+#if defined(FORMAT_C_CSR)
+#define generate_c generate_csr_workload
+#elif defined(FORMAT_C_CSC)
+#define generate_c generate_csc_workload
+#elif defined(FORMAT_C_COO)
+#define generate_c generate_coo_workload
+#endif
+
+static TENSOR_A *allocate_a(size_t n) {
+#if defined(FORMAT_A_CSR)
+  return allocate_csr(n, 0);
+#elif defined(FORMAT_A_CSC)
+  return allocate_csc(n, 0);
+#else
+  (void)n;
+  return allocate_coo(0);
+#endif
+}
+
+// Values and pattern of a generated matrix, row-major
+struct image {
+  double vals[N * N];
+  bool present[N * N];
+};
+
+static void fill_image(struct image *image, enum workload workload, double sparsity, unsigned int seed) {
+  memset(image, 0, sizeof(*image));
+  struct csr *M = generate_csr_workload(workload, N, N, sparsity, seed);
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t idx = M->lvl2_pos[i]; idx < M->lvl2_pos[i + 1]; ++idx) {
+      image->vals[i * N + M->lvl2_crd[idx]] = M->vals[idx];
+      image->present[i * N + M->lvl2_crd[idx]] = true;
+    }
+  }
+  free_tensor(M);
+}
+
+// A(i,j) = sum_k B(i,k) * C(k,j) (* D(k,j)): present where at least one product is
+static void reference(struct image *A, const struct image *B, const struct image *C, const struct image *D) {
+  memset(A, 0, sizeof(*A));
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      for (size_t k = 0; k < N; ++k) {
+        if (!B->present[i * N + k] || !C->present[k * N + j] || (D && !D->present[k * N + j]))
+          continue;
+        A->vals[i * N + j] += B->vals[i * N + k] * C->vals[k * N + j] * (D ? D->vals[k * N + j] : 1.0);
+        A->present[i * N + j] = true;
+      }
+    }
+  }
+}
+
+// One entry of the result against the reference; seen catches duplicates
+static int check_entry(const struct image *expected, bool *seen, size_t i, size_t j, double val,
+                       const char *test_name) {
+  double tolerance = sizeof(value_t) < sizeof(double) ? 1e-4 : 1e-9;
+  if (i >= N || j >= N || !expected->present[i * N + j]) {
+    printf("  FAIL %s: unexpected entry (%zu,%zu)\n", test_name, i, j);
+    return 0;
+  }
+  if (seen[i * N + j]) {
+    printf("  FAIL %s: entry (%zu,%zu) written twice\n", test_name, i, j);
+    return 0;
+  }
+  seen[i * N + j] = true;
+  if (fabs(val - expected->vals[i * N + j]) > tolerance * (1.0 + fabs(expected->vals[i * N + j]))) {
+    printf("  FAIL %s: entry (%zu,%zu) is %g, expected %g\n", test_name, i, j, val, expected->vals[i * N + j]);
+    return 0;
+  }
+  return 1;
+}
+
+// Every expected entry exactly once, with ascending coordinates within each slice (row-major order for COO)
+static int verify_result(TENSOR_A *A, const struct image *expected, const char *test_name) {
+  bool seen[N * N] = {false};
+  int passed = 1;
+  size_t nnz = 0;
+#if defined(FORMAT_A_COO)
+  nnz = A->lvl1_nnz;
+  for (size_t idx = 0; idx < nnz; ++idx) {
+    size_t i = A->lvl1_crd[idx], j = A->lvl2_crd[idx];
+    if (idx > 0 && (i < A->lvl1_crd[idx - 1] || (i == A->lvl1_crd[idx - 1] && j <= A->lvl2_crd[idx - 1]))) {
+      printf("  FAIL %s: entry %zu out of row-major order\n", test_name, idx);
+      passed = 0;
+    }
+    passed &= check_entry(expected, seen, i, j, A->vals[idx], test_name);
+  }
+#else
+  nnz = A->lvl2_nnz;
+  if (A->lvl2_pos[0] != 0 || A->lvl2_pos[N] != nnz) {
+    printf("  FAIL %s: slice positions span [%zu, %zu), expected [0, %zu)\n", test_name, (size_t)A->lvl2_pos[0],
+           (size_t)A->lvl2_pos[N], nnz);
+    return 0;
+  }
+  for (size_t s = 0; s < N; ++s) {
+    for (size_t idx = A->lvl2_pos[s]; idx < A->lvl2_pos[s + 1]; ++idx) {
+      size_t crd = A->lvl2_crd[idx];
+      if (idx > A->lvl2_pos[s] && crd <= A->lvl2_crd[idx - 1]) {
+        printf("  FAIL %s: slice %zu not strictly ascending at entry %zu\n", test_name, s, idx);
+        passed = 0;
+      }
+#if defined(FORMAT_A_CSR)
+      passed &= check_entry(expected, seen, s, crd, A->vals[idx], test_name);
+#else
+      passed &= check_entry(expected, seen, crd, s, A->vals[idx], test_name);
+#endif
+    }
+  }
+#endif
+
+  size_t expected_nnz = 0;
+  for (size_t e = 0; e < N * N; ++e)
+    expected_nnz += expected->present[e];
+  if (nnz != expected_nnz) {
+    printf("  FAIL %s: expected %zu non-zeros, got %zu\n", test_name, expected_nnz, nnz);
+    passed = 0;
+  }
+  if (passed)
+    printf("  PASS %s\n", test_name);
+  return passed;
+}
+
+static int verify_count(size_t count, size_t nnz, const char *test_name) {
+  if (count != nnz) {
+    printf("  FAIL %s: count returned %zu, kernel wrote %zu\n", test_name, count, nnz);
+    return 0;
+  }
+  printf("  PASS %s: count\n", test_name);
+  return 1;
+}
+
+#if defined(FORMAT_A_COO)
+#define A_NNZ(A) (A)->lvl1_nnz
+#else
+#define A_NNZ(A) (A)->lvl2_nnz
+#endif
+
+// matmul and matmul_hadamard on one workload, A sized by the count functions
+static int verify_workload(enum workload workload, const char *config) {
+  static struct image b_image, c_image, d_image, expected;
+  fill_image(&b_image, workload, B_SPARSITY, 1);
+  fill_image(&c_image, workload, C_SPARSITY, 2);
+  fill_image(&d_image, workload, D_SPARSITY, 3);
+  TENSOR_B *B = generate_b(workload, N, N, B_SPARSITY, 1);
+  TENSOR_C *C = generate_c(workload, N, N, C_SPARSITY, 2);
+  TENSOR_C *D = generate_c(workload, N, N, D_SPARSITY, 3);
+  TENSOR_A *A = allocate_a(N);
+  int passed = 1;
+
+  char test_name[96];
+  snprintf(test_name, sizeof(test_name), "matmul %s (%s)", config, WORKLOAD_NAMES[workload]);
+  reference(&expected, &b_image, &c_image, NULL);
+  reset_tensor(A);
+  size_t count = matmul_count(A, B, C);
+  reserve_tensor(A, count);
+  matmul(A, B, C);
+  passed &= verify_result(A, &expected, test_name);
+  passed &= verify_count(count, A_NNZ(A), test_name);
+
+  snprintf(test_name, sizeof(test_name), "matmul_hadamard %s (%s)", config, WORKLOAD_NAMES[workload]);
+  reference(&expected, &b_image, &c_image, &d_image);
+  reset_tensor(A);
+  count = matmul_hadamard_count(A, B, C, D);
+  reserve_tensor(A, count);
+  matmul_hadamard(A, B, C, D);
+  passed &= verify_result(A, &expected, test_name);
+  passed &= verify_count(count, A_NNZ(A), test_name);
+
+  free_tensor(A);
+  free_tensor(B);
+  free_tensor(C);
+  free_tensor(D);
+  return passed;
+}
+
+int main() {
+  int passed = 1;
+
+  printf("Running Matmul Test\n");
+  printf("================================\n");
+
+#if defined(FORMAT_A_CSR)
+  const char *a_fmt = "CSR";
+#elif defined(FORMAT_A_CSC)
+  const char *a_fmt = "CSC";
+#elif defined(FORMAT_A_COO)
+  const char *a_fmt = "COO";
+#endif
+
+#if defined(FORMAT_B_CSR)
+  const char *b_fmt = "CSR";
+#elif defined(FORMAT_B_CSC)
+  const char *b_fmt = "CSC";
+#elif defined(FORMAT_B_COO)
+  const char *b_fmt = "COO";
+#endif
+
+#if defined(FORMAT_C_CSR)
+  const char *c_fmt = "CSR";
+#elif defined(FORMAT_C_CSC)
+  const char *c_fmt = "CSC";
+#elif defined(FORMAT_C_COO)
+  const char *c_fmt = "COO";
+#endif
+
+#if defined(SEARCH_INNER)
+  const char *search = "INNER";
+#elif defined(SEARCH_OUTER)
+  const char *search = "OUTER";
+#elif defined(SEARCH_GUSTAVSON)
+  const char *search = "GUSTAVSON";
+#endif
+
+  printf("Configuration: A=%s, B=%s, C=%s, SEARCH=%s\n\n", a_fmt, b_fmt, c_fmt, search);
+
+  char config[64];
+  snprintf(config, sizeof(config), "%s-%s-%s-%s", a_fmt, b_fmt, c_fmt, search);
+  for (char *p = config; *p; ++p)
+    *p = (char)tolower((unsigned char)*p);
+
+  const enum workload workloads[] = {WORKLOAD_UNIFORM, WORKLOAD_POWER_LAW, WORKLOAD_BANDED};
+  for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); ++w)
+    passed &= verify_workload(workloads[w], config);
+  release_arena_pool();
+
+  printf("\n================================\n");
+  printf("Test Result: %s\n", passed ? "PASSED" : "FAILED");
+
+  return passed ? 0 : 1;
+}
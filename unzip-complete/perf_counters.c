@@ -0,0 +1,82 @@
+#include "perf_counters.h"
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const char *const PERF_COUNTER_NAMES[NUM_PERF_COUNTERS] = {"cycles",     "instructions", "llc_loads",
+                                                           "llc_misses", "dtlb_misses",  "branch_misses"};
+
+#define HW_CACHE_EVENT(cache, op, result)                                                                              \
+  (PERF_COUNT_HW_CACHE_##cache | PERF_COUNT_HW_CACHE_OP_##op << 8 | PERF_COUNT_HW_CACHE_RESULT_##result << 16)
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+} PERF_EVENTS[NUM_PERF_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, HW_CACHE_EVENT(LL, READ, ACCESS)},
+    {PERF_TYPE_HW_CACHE, HW_CACHE_EVENT(LL, READ, MISS)},
+    {PERF_TYPE_HW_CACHE, HW_CACHE_EVENT(DTLB, READ, MISS)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+// Value, time enabled and time running (PERF_FORMAT_TOTAL_TIME_*)
+struct perf_read {
+  uint64_t value;
+  uint64_t time_enabled;
+  uint64_t time_running;
+};
+
+int open_perf_counters(struct perf_counters *counters) {
+  int opened = 0;
+  for (int e = 0; e < NUM_PERF_COUNTERS; ++e) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_EVENTS[e].type;
+    attr.config = PERF_EVENTS[e].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    counters->fd[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    counters->valid[e] = false;
+    counters->count[e] = 0.0;
+    if (counters->fd[e] >= 0)
+      opened++;
+  }
+  return opened;
+}
+
+void close_perf_counters(struct perf_counters *counters) {
+  for (int e = 0; e < NUM_PERF_COUNTERS; ++e) {
+    if (counters->fd[e] >= 0)
+      close(counters->fd[e]);
+    counters->fd[e] = -1;
+  }
+}
+
+void start_perf_counters(struct perf_counters *counters) {
+  for (int e = 0; e < NUM_PERF_COUNTERS; ++e) {
+    if (counters->fd[e] >= 0) {
+      ioctl(counters->fd[e], PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters->fd[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void stop_perf_counters(struct perf_counters *counters) {
+  for (int e = 0; e < NUM_PERF_COUNTERS; ++e)
+    if (counters->fd[e] >= 0)
+      ioctl(counters->fd[e], PERF_EVENT_IOC_DISABLE, 0);
+
+  for (int e = 0; e < NUM_PERF_COUNTERS; ++e) {
+    struct perf_read r;
+    counters->valid[e] = counters->fd[e] >= 0 && read(counters->fd[e], &r, sizeof(r)) == sizeof(r) &&
+                         r.time_running > 0;
+    counters->count[e] = counters->valid[e] ? (double)r.value * r.time_enabled / r.time_running : 0.0;
+  }
+}
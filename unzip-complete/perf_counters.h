@@ -0,0 +1,36 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hardware event counts of the calling thread through perf_event_open, user space only. Every event is opened on its
+// own, so an event the CPU, the kernel or perf_event_paranoid does not allow is left out without losing the others;
+// events the PMU cannot count together are multiplexed and scaled to the time they were enabled.
+enum perf_counter {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_LLC_LOADS,
+  PERF_LLC_MISSES,
+  PERF_DTLB_MISSES,
+  PERF_BRANCH_MISSES,
+  NUM_PERF_COUNTERS
+};
+
+extern const char *const PERF_COUNTER_NAMES[NUM_PERF_COUNTERS]; // CSV names: cycles, instructions, ...
+
+struct perf_counters {
+  int fd[NUM_PERF_COUNTERS];       // -1 for an event that could not be opened
+  double count[NUM_PERF_COUNTERS]; // counts of the last start/stop interval, scaled for multiplexing
+  bool valid[NUM_PERF_COUNTERS];   // count holds a measurement (the event was open and got scheduled)
+};
+
+// Open every event, disabled; returns the number opened (0 when perf_event_open is unavailable)
+int open_perf_counters(struct perf_counters *counters);
+void close_perf_counters(struct perf_counters *counters);
+
+// Reset and enable the open events; stop disables them and reads the counts into count and valid
+void start_perf_counters(struct perf_counters *counters);
+void stop_perf_counters(struct perf_counters *counters);
+
+#endif /* PERF_COUNTERS_H */
@@ -0,0 +1,171 @@
+#include "permute_contract.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(SEARCH_B) && !defined(SEARCH_C) && !defined(SEARCH_MERGE)
+#error "SEARCH must be B, C or MERGE"
+#endif
+
+#define NO_ENTRY SIZE_MAX
+
+// generate_csf lays out the same number of fibers in every slice: slice s holds fibers [s * f, (s + 1) * f), and
+// lvl2_pos[fiber] indexes the fiber's entries in lvl3_crd
+static inline size_t fibers_per_slice(const struct csf *T) { return T->lvl1_nnz ? T->lvl2_nnz / T->lvl1_nnz : 0; }
+
+#if defined(SEARCH_B) || defined(SEARCH_C)
+// Fiber of slice s at coordinate crd, or NO_ENTRY
+static inline size_t locate_fiber(const struct csf *T, size_t s, size_t crd) {
+  size_t f = fibers_per_slice(T);
+  for (size_t fiber = s * f; fiber < (s + 1) * f; ++fiber) {
+    if (T->lvl2_crd[fiber] == crd)
+      return fiber;
+  }
+  return NO_ENTRY;
+}
+
+// Entry of fiber at coordinate crd, or NO_ENTRY
+static inline size_t locate_entry(const struct csf *T, size_t fiber, size_t crd) {
+  for (size_t idx = T->lvl2_pos[fiber]; idx < T->lvl2_pos[fiber + 1]; ++idx) {
+    if (T->lvl3_crd[idx] == crd)
+      return idx;
+  }
+  return NO_ENTRY;
+}
+#endif
+
+#if defined(SEARCH_MERGE)
+// Slice-local transposed view of C(i,:,:): row j holds the entries (k, C(i,k,j)) by ascending k
+struct view {
+  size_t num_j;    // one past the largest j of C
+  index_t *pos;    // size: num_j + 1
+  index_t *crd;    // size: largest slice of C
+  value_t *vals;   // size: largest slice of C
+};
+
+static void view_init(struct view *view, const struct csf *C) {
+  size_t f = fibers_per_slice(C);
+  size_t max_slice_nnz = 0;
+  for (size_t s = 0; s < C->lvl1_nnz; ++s) {
+    size_t slice_nnz = C->lvl2_pos[(s + 1) * f] - C->lvl2_pos[s * f];
+    if (slice_nnz > max_slice_nnz)
+      max_slice_nnz = slice_nnz;
+  }
+  view->num_j = 0;
+  for (size_t idx = 0; idx < C->lvl3_nnz; ++idx) {
+    if (C->lvl3_crd[idx] >= view->num_j)
+      view->num_j = C->lvl3_crd[idx] + 1;
+  }
+  view->pos = malloc((view->num_j + 1) * sizeof(index_t));
+  view->crd = malloc(max_slice_nnz * sizeof(index_t));
+  view->vals = malloc(max_slice_nnz * sizeof(value_t));
+}
+
+static void view_free(struct view *view) {
+  free(view->pos);
+  free(view->crd);
+  free(view->vals);
+}
+
+// Counting sort of slice s of C by j; the fibers come by ascending k, so every row does too. Leaves row j in
+// [pos[j], pos[j + 1]).
+static void view_build(struct view *view, const struct csf *C, size_t s) {
+  size_t f = fibers_per_slice(C);
+  size_t first = C->lvl2_pos[s * f], last = C->lvl2_pos[(s + 1) * f];
+  memset(view->pos, 0, (view->num_j + 1) * sizeof(index_t));
+  for (size_t idx = first; idx < last; ++idx)
+    view->pos[C->lvl3_crd[idx] + 1]++;
+  for (size_t j = 0; j < view->num_j; ++j)
+    view->pos[j + 1] += view->pos[j];
+
+  // Scatter, advancing pos[j] to the next free slot of row j, then shift the cursors back into row starts
+  for (size_t fiber = s * f; fiber < (s + 1) * f; ++fiber) {
+    size_t k = C->lvl2_crd[fiber];
+    for (size_t idx = C->lvl2_pos[fiber]; idx < C->lvl2_pos[fiber + 1]; ++idx) {
+      size_t dst = view->pos[C->lvl3_crd[idx]]++;
+      view->crd[dst] = k;
+      view->vals[dst] = C->vals[idx];
+    }
+  }
+  for (size_t j = view->num_j; j > 0; --j)
+    view->pos[j] = view->pos[j - 1];
+  view->pos[0] = 0;
+}
+#endif
+
+// Contribution of slice b_s of B and c_s of C, which share the coordinate i
+static acc_t contract_slice(const struct csf *B, const struct csf *C, size_t b_s, size_t c_s, void *workspace) {
+  acc_t acc = 0.0;
+#if defined(SEARCH_C)
+  (void)workspace;
+  size_t f = fibers_per_slice(B);
+  for (size_t b_fiber = b_s * f; b_fiber < (b_s + 1) * f; ++b_fiber) {
+    size_t j = B->lvl2_crd[b_fiber];
+    for (size_t b_idx = B->lvl2_pos[b_fiber]; b_idx < B->lvl2_pos[b_fiber + 1]; ++b_idx) {
+      size_t c_fiber = locate_fiber(C, c_s, B->lvl3_crd[b_idx]);
+      size_t c_idx = c_fiber != NO_ENTRY ? locate_entry(C, c_fiber, j) : NO_ENTRY;
+      if (c_idx != NO_ENTRY)
+        acc += (acc_t)B->vals[b_idx] * C->vals[c_idx];
+    }
+  }
+#elif defined(SEARCH_B)
+  (void)workspace;
+  size_t f = fibers_per_slice(C);
+  for (size_t c_fiber = c_s * f; c_fiber < (c_s + 1) * f; ++c_fiber) {
+    size_t k = C->lvl2_crd[c_fiber];
+    for (size_t c_idx = C->lvl2_pos[c_fiber]; c_idx < C->lvl2_pos[c_fiber + 1]; ++c_idx) {
+      size_t b_fiber = locate_fiber(B, b_s, C->lvl3_crd[c_idx]);
+      size_t b_idx = b_fiber != NO_ENTRY ? locate_entry(B, b_fiber, k) : NO_ENTRY;
+      if (b_idx != NO_ENTRY)
+        acc += (acc_t)B->vals[b_idx] * C->vals[c_idx];
+    }
+  }
+#elif defined(SEARCH_MERGE)
+  struct view *view = workspace;
+  view_build(view, C, c_s);
+  size_t f = fibers_per_slice(B);
+  for (size_t b_fiber = b_s * f; b_fiber < (b_s + 1) * f; ++b_fiber) {
+    size_t j = B->lvl2_crd[b_fiber];
+    if (j >= view->num_j)
+      continue;
+    size_t b_idx = B->lvl2_pos[b_fiber], b_end = B->lvl2_pos[b_fiber + 1];
+    size_t v_idx = view->pos[j], v_end = view->pos[j + 1];
+    while (b_idx < b_end && v_idx < v_end) {
+      size_t b_k = B->lvl3_crd[b_idx], v_k = view->crd[v_idx];
+      if (b_k == v_k) {
+        acc += (acc_t)B->vals[b_idx] * view->vals[v_idx];
+        ++b_idx;
+        ++v_idx;
+      } else if (b_k < v_k) {
+        ++b_idx;
+      } else {
+        ++v_idx;
+      }
+    }
+  }
+#endif
+  return acc;
+}
+
+// The slices of B and C are walked together by ascending i
+void permute_contract(struct dense *y, struct csf *B, struct csf *C) {
+  void *workspace = NULL;
+#if defined(SEARCH_MERGE)
+  struct view view;
+  view_init(&view, C);
+  workspace = &view;
+#endif
+  size_t c_s = 0;
+  for (size_t b_s = 0; b_s < B->lvl1_nnz; ++b_s) {
+    size_t i = B->lvl1_crd[b_s];
+    while (c_s < C->lvl1_nnz && C->lvl1_crd[c_s] < i)
+      ++c_s;
+    if (c_s == C->lvl1_nnz)
+      break;
+    if (C->lvl1_crd[c_s] == i)
+      y->vals[i] += contract_slice(B, C, b_s, c_s, workspace);
+  }
+#if defined(SEARCH_MERGE)
+  view_free(&view);
+#endif
+}
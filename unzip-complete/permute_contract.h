@@ -0,0 +1,28 @@
+#ifndef PERMUTE_CONTRACT_H
+#define PERMUTE_CONTRACT_H
+
+#include "tensor_formats.h"
+
+// y(i) = sum_j sum_k B(i,j,k) * C(i,k,j) over CSF operands, into a dense y indexed by i
+//
+// Compile-time configuration flags:
+// FORMAT_B: CSF
+// FORMAT_C: CSF (the only 3D format, so the loop order is the only choice)
+// SEARCH: C (iterate B, locate fiber k of C(i,:,:) and j within it), B (iterate C, locate fiber j of B(i,:,:) and k
+//         within it), MERGE (per slice i, C's entries are re-indexed by j through a counting sort; every fiber j of B
+//         is then merged with row j of that view by ascending k)
+//
+// Slices, fibers and entries must have ascending coordinates, as generate_csf and load_csf give them; slices i present
+// in only one operand contribute nothing.
+
+#if !defined(FORMAT_B_CSF) || !defined(FORMAT_C_CSF)
+#error "permute_contract needs FORMAT_B=CSF and FORMAT_C=CSF"
+#endif
+
+#define TENSOR_B struct csf
+#define TENSOR_C struct csf
+
+// Adds the sums to y, so y starts from reset_tensor for the plain contraction. y needs an entry per slice coordinate i.
+void permute_contract(struct dense *y, struct csf *B, struct csf *C);
+
+#endif /* PERMUTE_CONTRACT_H */
@@ -0,0 +1,98 @@
+#include "permute_contract.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// B is I x J x K and C is I x K x J; the dense images index them as B[i][j][k] and C[i][k][j]
+#define MAX_DIM 12
+
+struct image {
+  double vals[MAX_DIM * MAX_DIM * MAX_DIM];
+  bool present[MAX_DIM * MAX_DIM * MAX_DIM];
+};
+
+static void fill_image(struct image *image, const struct csf *T, size_t n2, size_t n3) {
+  memset(image, 0, sizeof(*image));
+  size_t f = T->lvl1_nnz ? T->lvl2_nnz / T->lvl1_nnz : 0;
+  for (size_t s = 0; s < T->lvl1_nnz; ++s) {
+    for (size_t fiber = s * f; fiber < (s + 1) * f; ++fiber) {
+      for (size_t idx = T->lvl2_pos[fiber]; idx < T->lvl2_pos[fiber + 1]; ++idx) {
+        size_t e = (T->lvl1_crd[s] * n2 + T->lvl2_crd[fiber]) * n3 + T->lvl3_crd[idx];
+        image->vals[e] = T->vals[idx];
+        image->present[e] = true;
+      }
+    }
+  }
+}
+
+// y(i) = sum_j sum_k B(i,j,k) * C(i,k,j) on dims I x J x K at one sparsity
+static int verify_contraction(size_t ni, size_t nj, size_t nk, double sparsity, const char *config) {
+  static struct image b_image, c_image;
+  struct csf *B = generate_csf(ni, nj, nk, sparsity, 1);
+  struct csf *C = generate_csf(ni, nk, nj, sparsity, 2);
+  fill_image(&b_image, B, nj, nk);
+  fill_image(&c_image, C, nk, nj);
+
+  struct dense *y = allocate_dense(ni);
+  reset_tensor(y);
+  permute_contract(y, B, C);
+
+  char test_name[96];
+  snprintf(test_name, sizeof(test_name), "%s (%zux%zux%zu, sparsity %.2f)", config, ni, nj, nk, sparsity);
+  double tolerance = sizeof(value_t) < sizeof(double) ? 1e-4 : 1e-9;
+  int passed = 1;
+  size_t matches = 0;
+  for (size_t i = 0; i < ni; ++i) {
+    double expected = 0.0;
+    for (size_t j = 0; j < nj; ++j) {
+      for (size_t k = 0; k < nk; ++k) {
+        size_t b = (i * nj + j) * nk + k, c = (i * nk + k) * nj + j;
+        if (b_image.present[b] && c_image.present[c]) {
+          expected += b_image.vals[b] * c_image.vals[c];
+          ++matches;
+        }
+      }
+    }
+    if (fabs(y->vals[i] - expected) > tolerance * (1.0 + fabs(expected))) {
+      printf("  FAIL %s: y(%zu) is %g, expected %g\n", test_name, i, (double)y->vals[i], expected);
+      passed = 0;
+    }
+  }
+  if (passed)
+    printf("  PASS %s (%zu matches)\n", test_name, matches);
+
+  free_tensor(y);
+  free_tensor(B);
+  free_tensor(C);
+  return passed;
+}
+
+int main() {
+  int passed = 1;
+
+  printf("Running Permute Contract Test\n");
+  printf("================================\n");
+
+#if defined(SEARCH_B)
+  const char *search = "B", *config = "csf-csf-b";
+#elif defined(SEARCH_C)
+  const char *search = "C", *config = "csf-csf-c";
+#elif defined(SEARCH_MERGE)
+  const char *search = "MERGE", *config = "csf-csf-merge";
+#endif
+
+  printf("Configuration: B=CSF, C=CSF, SEARCH=%s\n\n", search);
+
+  passed &= verify_contraction(12, 10, 9, 0.5, config);
+  passed &= verify_contraction(8, 6, 6, 0.8, config);
+  passed &= verify_contraction(12, 12, 12, 1.0, config);
+  passed &= verify_contraction(10, 3, 11, 0.9, config);
+  release_arena_pool();
+
+  printf("\n================================\n");
+  printf("Test Result: %s\n", passed ? "PASSED" : "FAILED");
+
+  return passed ? 0 : 1;
+}
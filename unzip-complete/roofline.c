@@ -0,0 +1,144 @@
+#include "roofline.h"
+#include "bench_harness.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+// 3 x 64 MiB of doubles: several times the last-level cache of any current CPU, as STREAM asks
+#define STREAM_ELEMENTS ((size_t)1 << 23)
+#define STREAM_PASSES 10
+#define STREAM_SCALAR 3.0
+
+// Independent multiply-add chains per pass, enough to fill the vector FMA pipelines after vectorization
+#define FLOP_LANES 64
+#define FLOP_PASSES 2000000
+
+// Best triad bandwidth in GB/s on the calling thread, or on every thread with parallel set
+static double stream_triad(double *a, const double *b, const double *c, int parallel) {
+  double best = 0.0;
+  for (int p = 0; p < STREAM_PASSES; ++p) {
+    double start = get_time_us() / 1e6;
+    if (parallel) {
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+      for (size_t i = 0; i < STREAM_ELEMENTS; ++i)
+        a[i] = b[i] + STREAM_SCALAR * c[i];
+    } else {
+      for (size_t i = 0; i < STREAM_ELEMENTS; ++i)
+        a[i] = b[i] + STREAM_SCALAR * c[i];
+    }
+    double seconds = get_time_us() / 1e6 - start;
+    double gbs = seconds > 0.0 ? 3.0 * sizeof(double) * STREAM_ELEMENTS / seconds / 1e9 : 0.0;
+    if (gbs > best)
+      best = gbs;
+  }
+  return best;
+}
+
+static volatile double flop_sink;
+
+static double multiply_add_peak(void) {
+  double x[FLOP_LANES];
+  for (int k = 0; k < FLOP_LANES; ++k)
+    x[k] = k;
+  double start = get_time_us() / 1e6;
+  // x converges to 1, so no lane overflows or goes subnormal
+  for (long p = 0; p < FLOP_PASSES; ++p)
+    for (int k = 0; k < FLOP_LANES; ++k)
+      x[k] = x[k] * 0.999999 + 0.000001;
+  double seconds = get_time_us() / 1e6 - start;
+  double sum = 0.0;
+  for (int k = 0; k < FLOP_LANES; ++k)
+    sum += x[k];
+  flop_sink = sum;
+  return seconds > 0.0 ? 2.0 * FLOP_LANES * FLOP_PASSES / seconds / 1e9 : 0.0;
+}
+
+static void probe_roofline(struct roofline *roofline) {
+  double *a = malloc(STREAM_ELEMENTS * sizeof(double));
+  double *b = malloc(STREAM_ELEMENTS * sizeof(double));
+  double *c = malloc(STREAM_ELEMENTS * sizeof(double));
+
+  // First touch with the parallel triad's schedule, so each thread's pages are local to it
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+  for (size_t i = 0; i < STREAM_ELEMENTS; ++i) {
+    a[i] = 0.0;
+    b[i] = 1.0;
+    c[i] = 2.0;
+  }
+
+  roofline->threads = 1;
+#if defined(_OPENMP)
+  roofline->threads = omp_get_max_threads();
+#endif
+  roofline->bandwidth_gbs = env_or("ROOFLINE_GBS", 0.0);
+  if (roofline->bandwidth_gbs <= 0.0)
+    roofline->bandwidth_gbs = stream_triad(a, b, c, 0);
+  roofline->parallel_bandwidth_gbs = roofline->bandwidth_gbs;
+  if (roofline->threads > 1) {
+    double parallel = stream_triad(a, b, c, 1);
+    if (parallel > roofline->parallel_bandwidth_gbs)
+      roofline->parallel_bandwidth_gbs = parallel;
+  }
+  roofline->gflops = env_or("ROOFLINE_GFLOPS", 0.0);
+  if (roofline->gflops <= 0.0)
+    roofline->gflops = multiply_add_peak();
+
+  free(a);
+  free(b);
+  free(c);
+}
+
+// The probes run in a child process where possible, so their arrays stay out of the caller's peak resident set
+void measure_roofline(struct roofline *roofline) {
+  int fds[2];
+  if (pipe(fds) == 0) {
+    pid_t child = fork();
+    if (child == 0) {
+      close(fds[0]);
+      probe_roofline(roofline);
+      ssize_t written = write(fds[1], roofline, sizeof(*roofline));
+      _exit(written == (ssize_t)sizeof(*roofline) ? 0 : 1);
+    }
+    close(fds[1]);
+    bool received = child > 0 && read(fds[0], roofline, sizeof(*roofline)) == (ssize_t)sizeof(*roofline);
+    close(fds[0]);
+    if (child > 0)
+      waitpid(child, NULL, 0);
+    if (received)
+      return;
+  }
+  probe_roofline(roofline);
+}
+
+struct roofline_point roofline_point(const struct roofline *roofline, double bytes, double flops, double ms,
+                                     int threads) {
+  struct roofline_point point = {0};
+  if (ms <= 0.0)
+    return point;
+  point.gbs = bytes / ms / 1e6;
+  point.gflops = flops / ms / 1e6;
+
+  // Compute scales with the threads up to the probed ones; bandwidth until the parallel triad's
+  if (threads < 1)
+    threads = 1;
+  if (threads > roofline->threads)
+    threads = roofline->threads;
+  double bandwidth = threads * roofline->bandwidth_gbs;
+  if (bandwidth > roofline->parallel_bandwidth_gbs)
+    bandwidth = roofline->parallel_bandwidth_gbs;
+  double compute = threads * roofline->gflops;
+
+  double memory_share = bandwidth > 0.0 ? point.gbs / bandwidth : 0.0;
+  double compute_share = compute > 0.0 ? point.gflops / compute : 0.0;
+  point.percent = 100.0 * (memory_share > compute_share ? memory_share : compute_share);
+  return point;
+}
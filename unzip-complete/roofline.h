@@ -0,0 +1,30 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <stddef.h>
+
+// Peaks of this machine for roofline reporting, probed once at startup: memory bandwidth with a STREAM triad
+// (a[i] = b[i] + s * c[i] over arrays well past the last-level cache, best of several passes, 24 bytes per element as
+// STREAM counts them) and double multiply-add throughput on independent chains. Under OpenMP the triad also runs on
+// every thread. $ROOFLINE_GBS and $ROOFLINE_GFLOPS replace the probed single-thread peaks, e.g. to compare runs against
+// the same roof.
+struct roofline {
+  double bandwidth_gbs;          // STREAM triad, one thread
+  double parallel_bandwidth_gbs; // STREAM triad on every thread (bandwidth_gbs without OpenMP)
+  double gflops;                 // multiply-add peak, one thread
+  int threads;                   // threads of the parallel triad (1 without OpenMP)
+};
+
+void measure_roofline(struct roofline *roofline);
+
+// Achieved GB/s and GFLOP/s of a kernel call that moved bytes and performed flops in ms milliseconds on threads
+// threads, and their percentage of the roof at the call's arithmetic intensity: min(compute peak, intensity x
+// bandwidth), which comes out as the larger of the two peak fractions
+struct roofline_point {
+  double gbs, gflops, percent;
+};
+
+struct roofline_point roofline_point(const struct roofline *roofline, double bytes, double flops, double ms,
+                                     int threads);
+
+#endif /* ROOFLINE_H */
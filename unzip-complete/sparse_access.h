@@ -0,0 +1,221 @@
+#ifndef SPARSE_ACCESS_H
+#define SPARSE_ACCESS_H
+
+#include "tensor_formats.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Format-independent access to square 2D operands, for the kernels composed from it (matmul.h,
+// hadamard_transpose_reduce.h): the entries in storage order, an entry located by its coordinate, and the rows or
+// columns of an operand whatever its format.
+
+#define NO_ENTRY SIZE_MAX
+
+// Extent of a square operand: the slices of CSR/CSC, one past the largest coordinate of COO
+static inline size_t _csr_extent(const struct csr *tensor) { return tensor->lvl1_size; }
+static inline size_t _csc_extent(const struct csc *tensor) { return tensor->lvl1_size; }
+static inline size_t _coo_extent(const struct coo *tensor) {
+  size_t extent = 0;
+  for (size_t idx = 0; idx < tensor->lvl1_nnz; ++idx) {
+    if (tensor->lvl1_crd[idx] >= extent)
+      extent = tensor->lvl1_crd[idx] + 1;
+    if (tensor->lvl2_crd[idx] >= extent)
+      extent = tensor->lvl2_crd[idx] + 1;
+  }
+  return extent;
+}
+
+#define tensor_extent(T)                                                                                               \
+  _Generic((T), struct csr *: _csr_extent, struct csc *: _csc_extent, struct coo *: _coo_extent)(T)
+
+// Storage order: units are the slices of CSR/CSC and the single entries of COO; entry k of unit u is (row, col)
+static inline size_t _csr_units(const struct csr *tensor) { return tensor->lvl1_size; }
+static inline size_t _csc_units(const struct csc *tensor) { return tensor->lvl1_size; }
+static inline size_t _coo_units(const struct coo *tensor) { return tensor->lvl1_nnz; }
+static inline size_t _csr_unit_begin(const struct csr *tensor, size_t u) { return tensor->lvl2_pos[u]; }
+static inline size_t _csc_unit_begin(const struct csc *tensor, size_t u) { return tensor->lvl2_pos[u]; }
+static inline size_t _coo_unit_begin(const struct coo *tensor, size_t u) {
+  (void)tensor;
+  return u;
+}
+static inline size_t _csr_unit_end(const struct csr *tensor, size_t u) { return tensor->lvl2_pos[u + 1]; }
+static inline size_t _csc_unit_end(const struct csc *tensor, size_t u) { return tensor->lvl2_pos[u + 1]; }
+static inline size_t _coo_unit_end(const struct coo *tensor, size_t u) {
+  (void)tensor;
+  return u + 1;
+}
+static inline size_t _csr_entry_row(const struct csr *tensor, size_t u, size_t k) {
+  (void)tensor;
+  (void)k;
+  return u;
+}
+static inline size_t _csc_entry_row(const struct csc *tensor, size_t u, size_t k) {
+  (void)u;
+  return tensor->lvl2_crd[k];
+}
+static inline size_t _coo_entry_row(const struct coo *tensor, size_t u, size_t k) {
+  (void)u;
+  return tensor->lvl1_crd[k];
+}
+static inline size_t _csr_entry_col(const struct csr *tensor, size_t u, size_t k) {
+  (void)u;
+  return tensor->lvl2_crd[k];
+}
+static inline size_t _csc_entry_col(const struct csc *tensor, size_t u, size_t k) {
+  (void)tensor;
+  (void)k;
+  return u;
+}
+static inline size_t _coo_entry_col(const struct coo *tensor, size_t u, size_t k) {
+  (void)u;
+  return tensor->lvl2_crd[k];
+}
+
+#define tensor_units(T) _Generic((T), struct csr *: _csr_units, struct csc *: _csc_units, struct coo *: _coo_units)(T)
+#define unit_begin(T, u)                                                                                               \
+  _Generic((T), struct csr *: _csr_unit_begin, struct csc *: _csc_unit_begin, struct coo *: _coo_unit_begin)(T, u)
+#define unit_end(T, u)                                                                                                 \
+  _Generic((T), struct csr *: _csr_unit_end, struct csc *: _csc_unit_end, struct coo *: _coo_unit_end)(T, u)
+#define entry_row(T, u, k)                                                                                             \
+  _Generic((T), struct csr *: _csr_entry_row, struct csc *: _csc_entry_row, struct coo *: _coo_entry_row)(T, u, k)
+#define entry_col(T, u, k)                                                                                             \
+  _Generic((T), struct csr *: _csr_entry_col, struct csc *: _csc_entry_col, struct coo *: _coo_entry_col)(T, u, k)
+
+// Position of the first entry stored at (row, col), or NO_ENTRY: a search of row (CSR) or column (CSC), a probe of the
+// COO index when it is built (see build_coo_index) and a search of every entry otherwise
+static inline size_t _csr_locate(const struct csr *tensor, size_t row, size_t col) {
+  for (size_t idx = tensor->lvl2_pos[row]; idx < tensor->lvl2_pos[row + 1]; ++idx) {
+    if (tensor->lvl2_crd[idx] == col)
+      return idx;
+  }
+  return NO_ENTRY;
+}
+
+static inline size_t _csc_locate(const struct csc *tensor, size_t row, size_t col) {
+  for (size_t idx = tensor->lvl2_pos[col]; idx < tensor->lvl2_pos[col + 1]; ++idx) {
+    if (tensor->lvl2_crd[idx] == row)
+      return idx;
+  }
+  return NO_ENTRY;
+}
+
+static inline size_t _coo_locate(const struct coo *tensor, size_t row, size_t col) {
+  if (tensor->index_slots) {
+    size_t idx = coo_index_find(tensor, row, col);
+    return idx != COO_INDEX_EMPTY ? idx : NO_ENTRY;
+  }
+  for (size_t idx = 0; idx < tensor->lvl1_nnz; ++idx) {
+    if (tensor->lvl1_crd[idx] == row && tensor->lvl2_crd[idx] == col)
+      return idx;
+  }
+  return NO_ENTRY;
+}
+
+#define tensor_locate(T, row, col)                                                                                     \
+  _Generic((T), struct csr *: _csr_locate, struct csc *: _csc_locate, struct coo *: _coo_locate)(T, row, col)
+
+// The rows or columns of an operand as lines: line l holds the entries [pos[l], pos[l + 1]), entry e at coordinate
+// crd[e] along the line, stored at position perm[e] of the operand (at e when perm is NULL). Lines the format stores
+// point into the tensor; the others are gathered by a counting sort that keeps storage order within each line, so
+// they come out sorted when the operand is sorted (sort_tensor, or COO in row-major order).
+struct lines {
+  size_t count;
+  const index_t *pos;  // size: count + 1
+  const index_t *crd;  // size: entries
+  const index_t *perm; // size: entries, NULL for stored lines
+  const value_t *vals; // the operand's values
+  index_t *owned;      // gathered lines: one block holding pos, crd and perm, NULL otherwise
+};
+
+static inline size_t line_begin(const struct lines *lines, size_t l) { return lines->pos[l]; }
+static inline size_t line_end(const struct lines *lines, size_t l) { return lines->pos[l + 1]; }
+static inline size_t line_entry(const struct lines *lines, size_t e) { return lines->perm ? lines->perm[e] : e; }
+static inline value_t line_val(const struct lines *lines, size_t e) { return lines->vals[line_entry(lines, e)]; }
+
+// Position in the operand of the first entry of line l at coordinate crd, or NO_ENTRY
+static inline size_t line_locate(const struct lines *lines, size_t l, size_t crd) {
+  for (size_t e = lines->pos[l]; e < lines->pos[l + 1]; ++e) {
+    if (lines->crd[e] == crd)
+      return line_entry(lines, e);
+  }
+  return NO_ENTRY;
+}
+
+static inline struct lines stored_lines(size_t count, const index_t *pos, const index_t *crd, const value_t *vals) {
+  struct lines lines = {.count = count, .pos = pos, .crd = crd, .perm = NULL, .vals = vals, .owned = NULL};
+  return lines;
+}
+
+// count lines over nnz entries in storage order: entry e belongs to line line_crd[e] at coordinate other_crd[e] along
+// it. For a compressed operand (pos != NULL) the other coordinate is the slice holding the entry, one of slices.
+static inline struct lines gather_lines(size_t count, size_t nnz, size_t slices, const index_t *pos,
+                                        const index_t *line_crd, const index_t *other_crd, const value_t *vals) {
+  struct lines lines = {.count = count, .vals = vals};
+  lines.owned = malloc((count + 1 + 2 * nnz) * sizeof(index_t));
+  index_t *line_pos = lines.owned;
+  index_t *crd = line_pos + count + 1;
+  index_t *perm = crd + nnz;
+  memset(line_pos, 0, (count + 1) * sizeof(index_t));
+  for (size_t e = 0; e < nnz; ++e)
+    line_pos[line_crd[e] + 1]++;
+  for (size_t l = 0; l < count; ++l)
+    line_pos[l + 1] += line_pos[l];
+
+  // Scatter, advancing line_pos[l] to the next free slot of line l, then shift the cursors back into line starts
+  if (pos) {
+    for (size_t s = 0; s < slices; ++s) {
+      for (size_t e = pos[s]; e < pos[s + 1]; ++e) {
+        size_t dst = line_pos[line_crd[e]]++;
+        crd[dst] = s;
+        perm[dst] = e;
+      }
+    }
+  } else {
+    for (size_t e = 0; e < nnz; ++e) {
+      size_t dst = line_pos[line_crd[e]]++;
+      crd[dst] = other_crd[e];
+      perm[dst] = e;
+    }
+  }
+  for (size_t l = count; l > 0; --l)
+    line_pos[l] = line_pos[l - 1];
+  line_pos[0] = 0;
+
+  lines.pos = line_pos;
+  lines.crd = crd;
+  lines.perm = perm;
+  return lines;
+}
+
+// Rows and columns of an n x n operand
+static inline struct lines _csr_rows(const struct csr *tensor, size_t n) {
+  (void)n;
+  return stored_lines(tensor->lvl1_size, tensor->lvl2_pos, tensor->lvl2_crd, tensor->vals);
+}
+static inline struct lines _csr_columns(const struct csr *tensor, size_t n) {
+  return gather_lines(n, tensor->lvl2_nnz, tensor->lvl1_size, tensor->lvl2_pos, tensor->lvl2_crd, NULL, tensor->vals);
+}
+static inline struct lines _csc_rows(const struct csc *tensor, size_t n) {
+  return gather_lines(n, tensor->lvl2_nnz, tensor->lvl1_size, tensor->lvl2_pos, tensor->lvl2_crd, NULL, tensor->vals);
+}
+static inline struct lines _csc_columns(const struct csc *tensor, size_t n) {
+  (void)n;
+  return stored_lines(tensor->lvl1_size, tensor->lvl2_pos, tensor->lvl2_crd, tensor->vals);
+}
+static inline struct lines _coo_rows(const struct coo *tensor, size_t n) {
+  return gather_lines(n, tensor->lvl1_nnz, 0, NULL, tensor->lvl1_crd, tensor->lvl2_crd, tensor->vals);
+}
+static inline struct lines _coo_columns(const struct coo *tensor, size_t n) {
+  return gather_lines(n, tensor->lvl1_nnz, 0, NULL, tensor->lvl2_crd, tensor->lvl1_crd, tensor->vals);
+}
+
+#define tensor_rows(T, n) _Generic((T), struct csr *: _csr_rows, struct csc *: _csc_rows, struct coo *: _coo_rows)(T, n)
+#define tensor_columns(T, n)                                                                                           \
+  _Generic((T), struct csr *: _csr_columns, struct csc *: _csc_columns, struct coo *: _coo_columns)(T, n)
+
+static inline void free_lines(struct lines *lines) {
+  free(lines->owned);
+  lines->owned = NULL;
+}
+
+#endif /* SPARSE_ACCESS_H */
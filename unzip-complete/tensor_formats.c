@@ -1,43 +1,448 @@
 #include "tensor_formats.h"
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+
+// Counter-based random numbers: draw c of a stream is the splitmix64 finalizer applied to key + c * golden ratio, so it
+// depends only on (seed, level, stream, c). Generators give every slice its own stream and fill slices in parallel with
+// the same output for any thread count.
+struct rng {
+  uint64_t key;
+  uint64_t counter;
+};
+
+static inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// Stream of slice `stream` at tensor level `level`; streams of different levels of one tensor do not overlap
+static inline struct rng rng_stream(unsigned int seed, uint64_t level, uint64_t stream) {
+  struct rng rng = {mix64(mix64((uint64_t)seed << 8 | level) + stream * 0x9E3779B97F4A7C15ULL), 0};
+  return rng;
+}
+
+static inline uint64_t rng_next(struct rng *rng) { return mix64(rng->key + ++rng->counter * 0x9E3779B97F4A7C15ULL); }
+
+// Uniform in [0, n) by multiply-shift (bias below n / 2^64)
+static inline size_t rng_uniform(struct rng *rng, size_t n) {
+  return (size_t)(((unsigned __int128)rng_next(rng) * n) >> 64);
+}
+
+// Uniform in [0, 1)
+static inline value_t rng_value(struct rng *rng) { return (value_t)((rng_next(rng) >> 11) * 0x1.0p-53); }
+
+// k distinct coordinates of [0, n) in ascending order into crd: Floyd's sampling marks them in bitmap (n bits, zero on
+// entry), then a word scan collects them and clears bitmap again. O(k + n / 64).
+static void sample_sorted(struct rng *rng, size_t n, size_t k, uint64_t *bitmap, index_t *crd) {
+  for (size_t j = n - k; j < n; ++j) {
+    size_t t = rng_uniform(rng, j + 1);
+    size_t pick = (bitmap[t >> 6] >> (t & 63)) & 1 ? j : t;
+    bitmap[pick >> 6] |= (uint64_t)1 << (pick & 63);
+  }
+  size_t out = 0;
+  for (size_t w = 0; out < k; ++w) {
+    uint64_t word = bitmap[w];
+    bitmap[w] = 0;
+    for (; word; word &= word - 1)
+      crd[out++] = (w << 6) + __builtin_ctzll(word);
+  }
+}
+
+// Slice s of [0, num_slices) gets pos[s + 1] - pos[s] sorted, distinct coordinates of [0, extent) (shifted by offset[s]
+// if offset is not NULL) and (if vals is not NULL) as many values, all drawn from stream (seed, level, s)
+static void fill_slices(unsigned int seed, uint64_t level, size_t num_slices, size_t extent, const index_t *pos,
+                        const index_t *offset, index_t *crd, value_t *vals) {
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+  {
+    uint64_t *bitmap = _tensor_alloc((extent + 63) / 64 * sizeof(uint64_t), true);
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 64)
+#endif
+    for (size_t s = 0; s < num_slices; ++s) {
+      struct rng rng = rng_stream(seed, level, s);
+      size_t start = pos[s];
+      size_t end = pos[s + 1];
+      sample_sorted(&rng, extent, end - start, bitmap, crd + start);
+      if (offset)
+        for (size_t e = start; e < end; ++e)
+          crd[e] += offset[s];
+      if (vals)
+        for (size_t e = start; e < end; ++e)
+          vals[e] = rng_value(&rng);
+    }
+    free(bitmap);
+  }
+}
+
+// pos[s] = s * per_slice for s in [0, num_slices]
+static void fill_uniform_pos(index_t *pos, size_t num_slices, size_t per_slice) {
+  for (size_t s = 0; s <= num_slices; ++s)
+    pos[s] = s * per_slice;
+}
+
+static inline void swap_entry(index_t *crd, value_t *vals, size_t a, size_t b) {
+  index_t crd_tmp = crd[a];
+  crd[a] = crd[b];
+  crd[b] = crd_tmp;
+  value_t val_tmp = vals[a];
+  vals[a] = vals[b];
+  vals[b] = val_tmp;
+}
+
+// Sort crd[0..n) ascending, permuting vals alongside. Insertion sort keeps equal coordinates in their original order
+// on short slices; longer slices are partitioned around a median-of-three pivot first.
+static void sort_crd_vals(index_t *crd, value_t *vals, size_t n) {
+  while (n > 16) {
+    size_t mid = n / 2;
+    if (crd[mid] < crd[0])
+      swap_entry(crd, vals, mid, 0);
+    if (crd[n - 1] < crd[0])
+      swap_entry(crd, vals, n - 1, 0);
+    if (crd[n - 1] < crd[mid])
+      swap_entry(crd, vals, n - 1, mid);
+    index_t pivot = crd[mid];
+
+    size_t lo = 0, hi = n - 1;
+    for (;;) {
+      while (crd[lo] < pivot)
+        ++lo;
+      while (pivot < crd[hi])
+        --hi;
+      if (lo >= hi)
+        break;
+      swap_entry(crd, vals, lo, hi);
+      ++lo;
+      --hi;
+    }
+
+    // Recurse into the smaller half, loop on the larger one
+    size_t left_n = hi + 1;
+    if (left_n < n - left_n) {
+      sort_crd_vals(crd, vals, left_n);
+      crd += left_n;
+      vals += left_n;
+      n -= left_n;
+    } else {
+      sort_crd_vals(crd + left_n, vals + left_n, n - left_n);
+      n = left_n;
+    }
+  }
+
+  for (size_t i = 1; i < n; ++i) {
+    index_t crd_i = crd[i];
+    value_t val_i = vals[i];
+    size_t k = i;
+    while (k > 0 && crd[k - 1] > crd_i) {
+      crd[k] = crd[k - 1];
+      vals[k] = vals[k - 1];
+      --k;
+    }
+    crd[k] = crd_i;
+    vals[k] = val_i;
+  }
+}
+
+// ============================================================================
+// Storage allocation
+// ============================================================================
+
+// Allocation accounting (see struct tensor_memory)
+static struct tensor_memory memory;
+
+void _count_tensor_alloc(size_t bytes) {
+  memory.live_bytes += bytes;
+  memory.allocations++;
+  if (memory.live_bytes > memory.peak_bytes)
+    memory.peak_bytes = memory.live_bytes;
+}
+
+void _count_tensor_free(size_t bytes) { memory.live_bytes -= bytes; }
+
+struct tensor_memory tensor_memory(void) { return memory; }
+
+void reset_tensor_memory_peak(void) { memory.peak_bytes = memory.live_bytes; }
+
+// One array of a tensor: where its pointer lives, how many bytes it needs, how many leading bytes survive a resize
+// and whether a fresh allocation starts zeroed
+struct storage_seg {
+  void **ptr;
+  size_t bytes;
+  size_t keep;
+  bool zero;
+};
+
+// The allocate/reserve/grow functions return no status, so running out of memory ends the program here instead of
+// leaving a tensor with NULL arrays behind
+static void storage_failed(size_t bytes) {
+  fprintf(stderr, "tensor storage: cannot allocate %zu bytes: %s\n", bytes, strerror(errno));
+  exit(1);
+}
+
+void *_tensor_alloc(size_t bytes, bool zero) {
+  void *ptr = zero ? calloc(bytes, 1) : malloc(bytes);
+  if (!ptr && bytes > 0)
+    storage_failed(bytes);
+  return ptr;
+}
+
+#if defined(ARENA_ALLOC)
+
+#define ARENA_ALIGN 64
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+#define ARENA_POOL_SIZE 16
+
+static inline size_t round_up(size_t bytes, size_t align) { return (bytes + align - 1) & ~(align - 1); }
+
+// Freed slabs kept for the next tensor of a similar size, so repeated allocate/free cycles (one per benchmark
+// configuration) reuse already faulted-in memory. Allocation happens outside the parallel kernels, so no locking.
+static struct {
+  void *base;
+  size_t size;
+} arena_pool[ARENA_POOL_SIZE];
+static size_t arena_pool_len = 0;
+
+// Smallest pooled slab of at least bytes, or a new one
+static void *arena_acquire(size_t bytes, size_t *slab_size) {
+  size_t best = arena_pool_len;
+  for (size_t i = 0; i < arena_pool_len; ++i)
+    if (arena_pool[i].size >= bytes && (best == arena_pool_len || arena_pool[i].size < arena_pool[best].size))
+      best = i;
+  if (best < arena_pool_len) {
+    void *base = arena_pool[best].base;
+    *slab_size = arena_pool[best].size;
+    arena_pool[best] = arena_pool[--arena_pool_len];
+    return base;
+  }
 
-static inline double rand_double() { return (double)rand() / RAND_MAX; }
+  size_t align = ARENA_ALIGN;
+#if defined(HUGEPAGES)
+  if (bytes >= HUGE_PAGE_SIZE)
+    align = HUGE_PAGE_SIZE;
+#endif
+  size_t size = round_up(bytes > 0 ? bytes : 1, align);
+  void *base = NULL;
+  int err = posix_memalign(&base, align, size);
+  if (err != 0) {
+    errno = err;
+    return NULL;
+  }
+#if defined(HUGEPAGES)
+  // Advisory only: without transparent huge page support the slab stays on base pages
+  if (align == HUGE_PAGE_SIZE)
+    madvise(base, size, MADV_HUGEPAGE);
+#endif
+  *slab_size = size;
+  return base;
+}
+
+static void arena_release(void *base, size_t size) {
+  if (!base)
+    return;
+  if (arena_pool_len == ARENA_POOL_SIZE) {
+    free(base);
+    return;
+  }
+  arena_pool[arena_pool_len].base = base;
+  arena_pool[arena_pool_len].size = size;
+  ++arena_pool_len;
+}
+
+void release_arena_pool(void) {
+  for (size_t i = 0; i < arena_pool_len; ++i)
+    free(arena_pool[i].base);
+  arena_pool_len = 0;
+}
+
+// Lay the segments out back to back in one slab, each starting on an ARENA_ALIGN boundary
+static void *arena_carve(struct storage_seg *segs, size_t n, size_t *slab_size) {
+  size_t total = 0;
+  for (size_t s = 0; s < n; ++s)
+    total += round_up(segs[s].bytes, ARENA_ALIGN);
+
+  char *base = arena_acquire(total, slab_size);
+  if (!base)
+    storage_failed(total);
+  size_t offset = 0;
+  for (size_t s = 0; s < n; ++s) {
+    void *old = *segs[s].ptr;
+    *segs[s].ptr = base + offset;
+    if (old && segs[s].keep)
+      memcpy(*segs[s].ptr, old, segs[s].keep);
+    else if (segs[s].zero)
+      memset(*segs[s].ptr, 0, segs[s].bytes);
+    offset += round_up(segs[s].bytes, ARENA_ALIGN);
+  }
+  return base;
+}
+
+static void storage_alloc(struct storage_seg *segs, size_t n, void **slab, size_t *slab_size) {
+  for (size_t s = 0; s < n; ++s)
+    *segs[s].ptr = NULL;
+  *slab = arena_carve(segs, n, slab_size);
+  _count_tensor_alloc(*slab_size);
+}
+
+// Move the segments into a larger slab, keeping their leading bytes
+static void storage_resize(struct storage_seg *segs, size_t n, void **slab, size_t *slab_size) {
+  void *old_slab = *slab;
+  size_t old_size = *slab_size;
+  *slab = arena_carve(segs, n, slab_size);
+  _count_tensor_alloc(*slab_size);
+  arena_release(old_slab, old_size);
+  _count_tensor_free(old_size);
+}
+
+static void storage_free_owned(void **ptrs, size_t n, void *slab, size_t slab_size) {
+  (void)ptrs;
+  (void)n;
+  arena_release(slab, slab_size);
+}
+
+#else
+
+void release_arena_pool(void) {}
+
+static void storage_alloc(struct storage_seg *segs, size_t n, void **slab, size_t *slab_size) {
+  size_t total = 0;
+  for (size_t s = 0; s < n; ++s) {
+    *segs[s].ptr = _tensor_alloc(segs[s].bytes, segs[s].zero);
+    total += segs[s].bytes;
+  }
+  _count_tensor_alloc(total);
+  *slab = NULL;
+  *slab_size = 0;
+}
+
+// Arrays whose size does not change stay where they are
+static void storage_resize(struct storage_seg *segs, size_t n, void **slab, size_t *slab_size) {
+  (void)slab;
+  (void)slab_size;
+  for (size_t s = 0; s < n; ++s) {
+    if (segs[s].bytes != segs[s].keep) {
+      void *grown = realloc(*segs[s].ptr, segs[s].bytes);
+      if (!grown && segs[s].bytes > 0)
+        storage_failed(segs[s].bytes);
+      *segs[s].ptr = grown;
+      _count_tensor_alloc(segs[s].bytes);
+      _count_tensor_free(segs[s].keep);
+    }
+  }
+}
+
+static void storage_free_owned(void **ptrs, size_t n, void *slab, size_t slab_size) {
+  (void)slab;
+  (void)slab_size;
+  for (size_t s = 0; s < n; ++s)
+    free(ptrs[s]);
+}
+
+#endif
+
+// Loaded tensors point into a file mapping instead of owning their arrays. Callers uncount the tensor's footprint.
+static void storage_free(void **ptrs, size_t n, void *slab, size_t slab_size, bool mapped) {
+  if (mapped)
+    munmap(slab, slab_size);
+  else
+    storage_free_owned(ptrs, n, slab, slab_size);
+}
+
+// Compressed 2D storage shared by CSR and CSC: lvl2_pos (lvl1_size + 1), lvl2_crd and vals (cap, vals zeroed)
+static void alloc_compressed(index_t **pos, index_t **crd, value_t **vals, size_t lvl1_size, size_t cap, void **slab,
+                             size_t *slab_size) {
+  struct storage_seg segs[] = {
+      {(void **)pos, (lvl1_size + 1) * sizeof(index_t), 0, false},
+      {(void **)crd, cap * sizeof(index_t), 0, false},
+      {(void **)vals, cap * sizeof(value_t), 0, true},
+  };
+  storage_alloc(segs, 3, slab, slab_size);
+}
+
+static void reserve_compressed(index_t **pos, index_t **crd, value_t **vals, size_t lvl1_size, size_t old_cap,
+                               size_t cap, void **slab, size_t *slab_size) {
+  size_t pos_bytes = (lvl1_size + 1) * sizeof(index_t);
+  struct storage_seg segs[] = {
+      {(void **)pos, pos_bytes, pos_bytes, false},
+      {(void **)crd, cap * sizeof(index_t), old_cap * sizeof(index_t), false},
+      {(void **)vals, cap * sizeof(value_t), old_cap * sizeof(value_t), false},
+  };
+  storage_resize(segs, 3, slab, slab_size);
+}
 
-static inline size_t rand_size_t() {
-  size_t result = 0;
-  for (size_t i = 0; i < sizeof(size_t); ++i)
-    result = (result << 8) | (rand() & 0xFF);
-  return result;
+static void alloc_coo(struct coo *tensor, size_t cap) {
+  struct storage_seg segs[] = {
+      {(void **)&tensor->lvl1_crd, cap * sizeof(index_t), 0, false},
+      {(void **)&tensor->lvl2_crd, cap * sizeof(index_t), 0, false},
+      {(void **)&tensor->vals, cap * sizeof(value_t), 0, true},
+  };
+  storage_alloc(segs, 3, &tensor->slab, &tensor->slab_size);
+  tensor->mapped = false;
+  tensor->lvl1_cap = cap;
 }
 
-static inline size_t rand_uniform(size_t n) { return rand_size_t() % n; }
+static void alloc_csf(struct csf *tensor) {
+  struct storage_seg segs[] = {
+      {(void **)&tensor->lvl1_crd, tensor->lvl1_nnz * sizeof(index_t), 0, false},
+      {(void **)&tensor->lvl2_crd, tensor->lvl2_nnz * sizeof(index_t), 0, false},
+      {(void **)&tensor->lvl2_pos, (tensor->lvl2_nnz + 1) * sizeof(index_t), 0, false},
+      {(void **)&tensor->lvl3_crd, tensor->lvl3_nnz * sizeof(index_t), 0, false},
+      {(void **)&tensor->vals, tensor->lvl3_nnz * sizeof(value_t), 0, true},
+  };
+  storage_alloc(segs, 5, &tensor->slab, &tensor->slab_size);
+  tensor->mapped = false;
+  tensor->lvl3_pos = NULL;
+}
 
 // ============================================================================
 // Dense tensor utilities
 // ============================================================================
 
 struct dense *allocate_dense(size_t n) {
-  struct dense *tensor = malloc(sizeof(struct dense));
+  struct dense *tensor = _tensor_alloc(sizeof(struct dense), false);
   tensor->lvl1_size = n;
-  tensor->vals = calloc(n, sizeof(double));
+  tensor->vals = _tensor_alloc(n * sizeof(value_t), true);
+  _count_tensor_alloc(n * sizeof(value_t));
+  tensor->slab = NULL;
+  tensor->slab_size = 0;
+  tensor->mapped = false;
   return tensor;
 }
 
+size_t _dense_footprint(const struct dense *tensor) {
+  return tensor->mapped ? tensor->slab_size : tensor->lvl1_size * sizeof(value_t);
+}
+
 void _free_dense(struct dense *tensor) {
   if (tensor) {
-    free(tensor->vals);
+    _count_tensor_free(_dense_footprint(tensor));
+    if (tensor->mapped)
+      munmap(tensor->slab, tensor->slab_size);
+    else
+      free(tensor->vals);
     free(tensor);
   }
 }
 
-void _reset_dense(struct dense *tensor) { memset(tensor->vals, 0, tensor->lvl1_size * sizeof(double)); }
+void _reset_dense(struct dense *tensor) { memset(tensor->vals, 0, tensor->lvl1_size * sizeof(value_t)); }
 
 struct dense *generate_dense(size_t n, unsigned int seed) {
-  srand(seed);
   struct dense *tensor = allocate_dense(n);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
   for (size_t i = 0; i < n; ++i) {
-    tensor->vals[i] = rand_double();
+    struct rng rng = rng_stream(seed, 1, i);
+    tensor->vals[i] = rng_value(&rng);
   }
   return tensor;
 }
@@ -47,58 +452,70 @@ struct dense *generate_dense(size_t n, unsigned int seed) {
 // ============================================================================
 
 struct csr *allocate_csr(size_t ndim1, size_t dim2_nnz) {
-  struct csr *tensor = malloc(sizeof(struct csr));
+  struct csr *tensor = _tensor_alloc(sizeof(struct csr), false);
   tensor->lvl1_size = ndim1;
-  tensor->lvl2_pos = malloc((ndim1 + 1) * sizeof(size_t));
-  tensor->lvl2_pos[0] = 0;
-
   tensor->lvl2_nnz = ndim1 * dim2_nnz;
-  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(size_t));
-  tensor->vals = calloc(tensor->lvl2_nnz, sizeof(double));
+  tensor->lvl2_cap = tensor->lvl2_nnz;
+  tensor->sorted = false;
+  tensor->mapped = false;
+  alloc_compressed(&tensor->lvl2_pos, &tensor->lvl2_crd, &tensor->vals, ndim1, tensor->lvl2_cap, &tensor->slab,
+                   &tensor->slab_size);
+  tensor->lvl2_pos[0] = 0;
   return tensor;
 }
 
+size_t _csr_footprint(const struct csr *tensor) {
+  if (tensor->slab)
+    return tensor->slab_size;
+  return (tensor->lvl1_size + 1) * sizeof(index_t) + tensor->lvl2_cap * (sizeof(index_t) + sizeof(value_t));
+}
+
 void _free_csr(struct csr *tensor) {
   if (tensor) {
-    free(tensor->lvl2_pos);
-    free(tensor->lvl2_crd);
-    free(tensor->vals);
+    _count_tensor_free(_csr_footprint(tensor));
+    void *arrays[] = {tensor->lvl2_pos, tensor->lvl2_crd, tensor->vals};
+    storage_free(arrays, 3, tensor->slab, tensor->slab_size, tensor->mapped);
     free(tensor);
   }
 }
 
 void _reset_csr(struct csr *tensor) {
   tensor->lvl2_nnz = 0;
-  memset(tensor->lvl2_pos, 0, (tensor->lvl1_size + 1) * sizeof(size_t));
+  memset(tensor->lvl2_pos, 0, (tensor->lvl1_size + 1) * sizeof(index_t));
 }
 
-struct csr *generate_csr(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
-  srand(seed);
+void _reserve_csr(struct csr *tensor, size_t nnz) {
+  if (nnz <= tensor->lvl2_cap)
+    return;
+  reserve_compressed(&tensor->lvl2_pos, &tensor->lvl2_crd, &tensor->vals, tensor->lvl1_size, tensor->lvl2_cap, nnz,
+                     &tensor->slab, &tensor->slab_size);
+  tensor->lvl2_cap = nnz;
+}
 
-  struct csr *tensor = malloc(sizeof(struct csr));
-  tensor->lvl1_size = ndim1;
-  tensor->lvl2_pos = malloc((ndim1 + 1) * sizeof(size_t));
-  tensor->lvl2_pos[0] = 0;
+void _sort_csr(struct csr *tensor) {
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (size_t row = 0; row < tensor->lvl1_size; ++row) {
+    size_t start = tensor->lvl2_pos[row];
+    size_t end = tensor->lvl2_pos[row + 1];
+    sort_crd_vals(tensor->lvl2_crd + start, tensor->vals + start, end - start);
+  }
+  tensor->sorted = true;
+}
 
+// Exactly dim2_nnz distinct non-zeros per row, sorted by column
+struct csr *generate_csr(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
   size_t dim2_nnz = (size_t)(ndim2 * sparsity);
   if (dim2_nnz < 1)
     dim2_nnz = 1;
   if (dim2_nnz > ndim2)
     dim2_nnz = ndim2;
 
-  tensor->lvl2_nnz = ndim1 * dim2_nnz;
-  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(size_t));
-  tensor->vals = calloc(tensor->lvl2_nnz, sizeof(double));
-
-  for (size_t lvl1_idx = 0; lvl1_idx < ndim1; ++lvl1_idx) {
-    // Generate exactly dim2_nnz non-zeros per row
-    for (size_t dim2_n = 0; dim2_n < dim2_nnz; ++dim2_n) {
-      size_t lvl2_idx = lvl1_idx * dim2_nnz + dim2_n;
-      tensor->lvl2_crd[lvl2_idx] = rand_uniform(ndim2);
-      tensor->vals[lvl2_idx] = rand_double();
-    }
-    tensor->lvl2_pos[lvl1_idx + 1] = (lvl1_idx + 1) * dim2_nnz;
-  }
+  struct csr *tensor = allocate_csr(ndim1, dim2_nnz);
+  fill_uniform_pos(tensor->lvl2_pos, ndim1, dim2_nnz);
+  fill_slices(seed, 2, ndim1, ndim2, tensor->lvl2_pos, NULL, tensor->lvl2_crd, tensor->vals);
+  tensor->sorted = true;
   return tensor;
 }
 
@@ -107,58 +524,70 @@ struct csr *generate_csr(size_t ndim1, size_t ndim2, double sparsity, unsigned i
 // ============================================================================
 
 struct csc *allocate_csc(size_t ndim2, size_t dim2_nnz) {
-  struct csc *tensor = malloc(sizeof(struct csc));
+  struct csc *tensor = _tensor_alloc(sizeof(struct csc), false);
   tensor->lvl1_size = ndim2; // CSC stores by columns
-  tensor->lvl2_pos = malloc((ndim2 + 1) * sizeof(size_t));
-  tensor->lvl2_pos[0] = 0;
-
   tensor->lvl2_nnz = ndim2 * dim2_nnz;
-  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(size_t));
-  tensor->vals = calloc(tensor->lvl2_nnz, sizeof(double));
+  tensor->lvl2_cap = tensor->lvl2_nnz;
+  tensor->sorted = false;
+  tensor->mapped = false;
+  alloc_compressed(&tensor->lvl2_pos, &tensor->lvl2_crd, &tensor->vals, ndim2, tensor->lvl2_cap, &tensor->slab,
+                   &tensor->slab_size);
+  tensor->lvl2_pos[0] = 0;
   return tensor;
 }
 
+size_t _csc_footprint(const struct csc *tensor) {
+  if (tensor->slab)
+    return tensor->slab_size;
+  return (tensor->lvl1_size + 1) * sizeof(index_t) + tensor->lvl2_cap * (sizeof(index_t) + sizeof(value_t));
+}
+
 void _free_csc(struct csc *tensor) {
   if (tensor) {
-    free(tensor->lvl2_pos);
-    free(tensor->lvl2_crd);
-    free(tensor->vals);
+    _count_tensor_free(_csc_footprint(tensor));
+    void *arrays[] = {tensor->lvl2_pos, tensor->lvl2_crd, tensor->vals};
+    storage_free(arrays, 3, tensor->slab, tensor->slab_size, tensor->mapped);
     free(tensor);
   }
 }
 
 void _reset_csc(struct csc *tensor) {
   tensor->lvl2_nnz = 0;
-  memset(tensor->lvl2_pos, 0, (tensor->lvl1_size + 1) * sizeof(size_t));
+  memset(tensor->lvl2_pos, 0, (tensor->lvl1_size + 1) * sizeof(index_t));
 }
 
-struct csc *generate_csc(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
-  srand(seed);
+void _reserve_csc(struct csc *tensor, size_t nnz) {
+  if (nnz <= tensor->lvl2_cap)
+    return;
+  reserve_compressed(&tensor->lvl2_pos, &tensor->lvl2_crd, &tensor->vals, tensor->lvl1_size, tensor->lvl2_cap, nnz,
+                     &tensor->slab, &tensor->slab_size);
+  tensor->lvl2_cap = nnz;
+}
 
-  struct csc *tensor = malloc(sizeof(struct csc));
-  tensor->lvl1_size = ndim2; // number of columns
-  tensor->lvl2_pos = malloc((ndim2 + 1) * sizeof(size_t));
-  tensor->lvl2_pos[0] = 0;
+void _sort_csc(struct csc *tensor) {
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (size_t col = 0; col < tensor->lvl1_size; ++col) {
+    size_t start = tensor->lvl2_pos[col];
+    size_t end = tensor->lvl2_pos[col + 1];
+    sort_crd_vals(tensor->lvl2_crd + start, tensor->vals + start, end - start);
+  }
+  tensor->sorted = true;
+}
 
+// Exactly dim1_nnz distinct non-zeros per column, sorted by row
+struct csc *generate_csc(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
   size_t dim1_nnz = (size_t)(ndim1 * sparsity);
   if (dim1_nnz < 1)
     dim1_nnz = 1;
   if (dim1_nnz > ndim1)
     dim1_nnz = ndim1;
 
-  tensor->lvl2_nnz = ndim2 * dim1_nnz;
-  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(size_t));
-  tensor->vals = calloc(tensor->lvl2_nnz, sizeof(double));
-
-  for (size_t col = 0; col < ndim2; ++col) {
-    // Generate exactly dim1_nnz non-zeros per column
-    for (size_t dim1_n = 0; dim1_n < dim1_nnz; ++dim1_n) {
-      size_t lvl2_idx = col * dim1_nnz + dim1_n;
-      tensor->lvl2_crd[lvl2_idx] = rand_uniform(ndim1); // row index
-      tensor->vals[lvl2_idx] = rand_double();
-    }
-    tensor->lvl2_pos[col + 1] = (col + 1) * dim1_nnz;
-  }
+  struct csc *tensor = allocate_csc(ndim2, dim1_nnz); // one slice per column
+  fill_uniform_pos(tensor->lvl2_pos, ndim2, dim1_nnz);
+  fill_slices(seed, 2, ndim2, ndim1, tensor->lvl2_pos, NULL, tensor->lvl2_crd, tensor->vals);
+  tensor->sorted = true;
   return tensor;
 }
 
@@ -167,43 +596,112 @@ struct csc *generate_csc(size_t ndim1, size_t ndim2, double sparsity, unsigned i
 // ============================================================================
 
 struct coo *allocate_coo(size_t nnz) {
-  struct coo *tensor = malloc(sizeof(struct coo));
+  struct coo *tensor = _tensor_alloc(sizeof(struct coo), false);
   tensor->lvl1_nnz = nnz;
-  tensor->lvl1_crd = malloc(nnz * sizeof(size_t));
-  tensor->lvl2_crd = malloc(nnz * sizeof(size_t));
-  tensor->vals = calloc(nnz, sizeof(double));
+  alloc_coo(tensor, nnz);
+  tensor->index_mask = 0;
+  tensor->index_slots = NULL;
   return tensor;
 }
 
+static size_t coo_index_bytes(const struct coo *tensor) {
+  return tensor->index_slots ? (tensor->index_mask + 1) * sizeof(index_t) : 0;
+}
+
+size_t _coo_footprint(const struct coo *tensor) {
+  size_t storage = tensor->slab ? tensor->slab_size : tensor->lvl1_cap * (2 * sizeof(index_t) + sizeof(value_t));
+  return storage + coo_index_bytes(tensor);
+}
+
 void _free_coo(struct coo *tensor) {
   if (tensor) {
-    free(tensor->lvl1_crd);
-    free(tensor->lvl2_crd);
-    free(tensor->vals);
+    _count_tensor_free(_coo_footprint(tensor));
+    void *arrays[] = {tensor->lvl1_crd, tensor->lvl2_crd, tensor->vals};
+    storage_free(arrays, 3, tensor->slab, tensor->slab_size, tensor->mapped);
+    free(tensor->index_slots);
     free(tensor);
   }
 }
 
-void _reset_coo(struct coo *tensor) { tensor->lvl1_nnz = 0; }
+void _reset_coo(struct coo *tensor) {
+  tensor->lvl1_nnz = 0;
+  // The index no longer describes the entries
+  _count_tensor_free(coo_index_bytes(tensor));
+  free(tensor->index_slots);
+  tensor->index_slots = NULL;
+  tensor->index_mask = 0;
+}
 
-struct coo *generate_coo(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
-  srand(seed);
+void _reserve_coo(struct coo *tensor, size_t nnz) {
+  if (nnz <= tensor->lvl1_cap)
+    return;
+  size_t old_cap = tensor->lvl1_cap;
+  struct storage_seg segs[] = {
+      {(void **)&tensor->lvl1_crd, nnz * sizeof(index_t), old_cap * sizeof(index_t), false},
+      {(void **)&tensor->lvl2_crd, nnz * sizeof(index_t), old_cap * sizeof(index_t), false},
+      {(void **)&tensor->vals, nnz * sizeof(value_t), old_cap * sizeof(value_t), false},
+  };
+  storage_resize(segs, 3, &tensor->slab, &tensor->slab_size);
+  tensor->lvl1_cap = nnz;
+}
+
+void build_coo_index(struct coo *tensor) {
+  // Keep the load factor at or below 1/2
+  size_t num_slots = 2;
+  while (num_slots < 2 * tensor->lvl1_nnz)
+    num_slots <<= 1;
+
+  _count_tensor_free(coo_index_bytes(tensor));
+  free(tensor->index_slots);
+  tensor->index_mask = num_slots - 1;
+  tensor->index_slots = _tensor_alloc(num_slots * sizeof(index_t), false);
+  _count_tensor_alloc(num_slots * sizeof(index_t));
+  memset(tensor->index_slots, 0xFF, num_slots * sizeof(index_t));
+
+  // Insert in position order and skip duplicates, so lookups return the first entry like a linear scan would
+  for (size_t pos = 0; pos < tensor->lvl1_nnz; ++pos) {
+    size_t crd1 = tensor->lvl1_crd[pos];
+    size_t crd2 = tensor->lvl2_crd[pos];
+    size_t slot = coo_index_hash(crd1, crd2) & tensor->index_mask;
+    for (;;) {
+      size_t other = tensor->index_slots[slot];
+      if (other == COO_INDEX_EMPTY) {
+        tensor->index_slots[slot] = pos;
+        break;
+      }
+      if (tensor->lvl1_crd[other] == crd1 && tensor->lvl2_crd[other] == crd2)
+        break;
+      slot = (slot + 1) & tensor->index_mask;
+    }
+  }
+}
 
+// nnz = ndim1 * ndim2 * sparsity distinct non-zeros in row-major order, spread over the rows as evenly as possible
+struct coo *generate_coo(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
   size_t nnz = (size_t)(ndim1 * ndim2 * sparsity);
   if (nnz < 1)
     nnz = 1;
-
-  struct coo *tensor = malloc(sizeof(struct coo));
-  tensor->lvl1_nnz = nnz;
-  tensor->lvl1_crd = malloc(nnz * sizeof(size_t));
-  tensor->lvl2_crd = malloc(nnz * sizeof(size_t));
-  tensor->vals = calloc(nnz, sizeof(double));
-
-  for (size_t idx = 0; idx < nnz; ++idx) {
-    tensor->lvl1_crd[idx] = rand_uniform(ndim1);
-    tensor->lvl2_crd[idx] = rand_uniform(ndim2);
-    tensor->vals[idx] = rand_double();
-  }
+  if (nnz > ndim1 * ndim2)
+    nnz = ndim1 * ndim2;
+
+  struct coo *tensor = allocate_coo(nnz);
+  if (nnz == 0)
+    return tensor;
+
+  // The first nnz % ndim1 rows hold one entry more than the others
+  index_t *pos = _tensor_alloc((ndim1 + 1) * sizeof(index_t), false);
+  size_t per_row = nnz / ndim1, extra = nnz % ndim1;
+  for (size_t row = 0; row <= ndim1; ++row)
+    pos[row] = row * per_row + (row < extra ? row : extra);
+  fill_slices(seed, 2, ndim1, ndim2, pos, NULL, tensor->lvl2_crd, tensor->vals);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (size_t row = 0; row < ndim1; ++row)
+    for (size_t idx = pos[row]; idx < pos[row + 1]; ++idx)
+      tensor->lvl1_crd[idx] = row;
+  free(pos);
 
   return tensor;
 }
@@ -213,28 +711,28 @@ struct coo *generate_coo(size_t ndim1, size_t ndim2, double sparsity, unsigned i
 // ============================================================================
 
 struct csf *allocate_csf(size_t ndim1, size_t dim2_nnz, size_t dim3_nnz) {
-  struct csf *tensor = malloc(sizeof(struct csf));
+  struct csf *tensor = _tensor_alloc(sizeof(struct csf), false);
   tensor->lvl1_nnz = ndim1;
-  tensor->lvl1_crd = malloc(ndim1 * sizeof(size_t));
-
   tensor->lvl2_nnz = ndim1 * dim2_nnz;
-  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(size_t));
-  tensor->lvl2_pos = malloc((tensor->lvl2_nnz + 1) * sizeof(size_t));
-  tensor->lvl2_pos[0] = 0;
-
   tensor->lvl3_nnz = tensor->lvl2_nnz * dim3_nnz;
-  tensor->lvl3_crd = malloc(tensor->lvl3_nnz * sizeof(size_t));
-  tensor->vals = calloc(tensor->lvl3_nnz, sizeof(double));
+  alloc_csf(tensor);
+  tensor->lvl2_pos[0] = 0;
   return tensor;
 }
 
+// Heap CSF arrays are sized by the entry counts allocate_csf and generate_csf set
+size_t _csf_footprint(const struct csf *tensor) {
+  if (tensor->slab)
+    return tensor->slab_size;
+  return (tensor->lvl1_nnz + 2 * tensor->lvl2_nnz + 1) * sizeof(index_t) +
+         tensor->lvl3_nnz * (sizeof(index_t) + sizeof(value_t));
+}
+
 void _free_csf(struct csf *tensor) {
   if (tensor) {
-    free(tensor->lvl1_crd);
-    free(tensor->lvl2_crd);
-    free(tensor->lvl2_pos);
-    free(tensor->lvl3_crd);
-    free(tensor->vals);
+    _count_tensor_free(_csf_footprint(tensor));
+    void *arrays[] = {tensor->lvl1_crd, tensor->lvl2_crd, tensor->lvl2_pos, tensor->lvl3_crd, tensor->vals};
+    storage_free(arrays, 5, tensor->slab, tensor->slab_size, tensor->mapped);
     free(tensor);
   }
 }
@@ -243,12 +741,10 @@ void _reset_csf(struct csf *tensor) {
   tensor->lvl1_nnz = 0;
   tensor->lvl2_nnz = 0;
   tensor->lvl3_nnz = 0;
-  memset(tensor->lvl2_pos, 0, sizeof(size_t));
+  memset(tensor->lvl2_pos, 0, sizeof(index_t));
 }
 
 struct csf *generate_csf(size_t ndim1, size_t ndim2, size_t ndim3, double sparsity, unsigned int seed) {
-  srand(seed);
-
   size_t dim1_nnz = (size_t)(ndim1 * sparsity);
   if (dim1_nnz < 1)
     dim1_nnz = 1;
@@ -267,34 +763,238 @@ struct csf *generate_csf(size_t ndim1, size_t ndim2, size_t ndim3, double sparsi
   if (dim3_nnz > ndim3)
     dim3_nnz = ndim3;
 
-  struct csf *tensor = malloc(sizeof(struct csf));
-  tensor->lvl1_nnz = dim1_nnz;
-  tensor->lvl1_crd = malloc(dim1_nnz * sizeof(size_t));
+  // Sorted, distinct coordinates at every level: the dim1_nnz slices, dim2_nnz fibers per slice, dim3_nnz elements per
+  // fiber; lvl2_pos holds the fibers' element positions
+  struct csf *tensor = allocate_csf(dim1_nnz, dim2_nnz, dim3_nnz);
+  index_t *slice_pos = _tensor_alloc((dim1_nnz + 1) * sizeof(index_t), false);
+  index_t lvl1_pos[2] = {0, dim1_nnz};
+  fill_uniform_pos(slice_pos, dim1_nnz, dim2_nnz);
+  fill_uniform_pos(tensor->lvl2_pos, tensor->lvl2_nnz, dim3_nnz);
+  fill_slices(seed, 1, 1, ndim1, lvl1_pos, NULL, tensor->lvl1_crd, NULL);
+  fill_slices(seed, 2, dim1_nnz, ndim2, slice_pos, NULL, tensor->lvl2_crd, NULL);
+  fill_slices(seed, 3, tensor->lvl2_nnz, ndim3, tensor->lvl2_pos, NULL, tensor->lvl3_crd, tensor->vals);
+  free(slice_pos);
 
-  tensor->lvl2_nnz = dim1_nnz * dim2_nnz; // total fibers
-  tensor->lvl2_pos = malloc((tensor->lvl2_nnz + 1) * sizeof(size_t));
-  tensor->lvl2_pos[0] = 0;
-  tensor->lvl2_crd = malloc(tensor->lvl2_nnz * sizeof(size_t));
-
-  tensor->lvl3_nnz = tensor->lvl2_nnz * dim3_nnz; // total elements
-  tensor->lvl3_crd = malloc(tensor->lvl3_nnz * sizeof(size_t));
-  tensor->vals = calloc(tensor->lvl3_nnz, sizeof(double));
-
-  for (size_t lvl1_idx = 0; lvl1_idx < dim1_nnz; ++lvl1_idx) {
-    tensor->lvl1_crd[lvl1_idx] = rand_uniform(ndim1);
-    // Generate exactly dim2_nnz fibers per slice
-    for (size_t dim2_n = 0; dim2_n < dim2_nnz; ++dim2_n) {
-      size_t lvl2_idx = lvl1_idx * dim2_nnz + dim2_n;
-      tensor->lvl2_crd[lvl2_idx] = rand_uniform(ndim2);
-      // Generate exactly dim3_nnz elements per fiber
-      for (size_t dim3_n = 0; dim3_n < dim3_nnz; ++dim3_n) {
-        size_t lvl3_idx = lvl2_idx * dim3_nnz + dim3_n;
-        tensor->lvl3_crd[lvl3_idx] = rand_uniform(ndim3);
-        tensor->vals[lvl3_idx] = rand_double();
-      }
-      tensor->lvl2_pos[lvl2_idx + 1] = (lvl2_idx + 1) * dim3_nnz;
+  return tensor;
+}
+
+// ============================================================================
+// Structured workloads
+// ============================================================================
+
+const char *const WORKLOAD_NAMES[NUM_WORKLOADS] = {"uniform", "power_law", "banded", "block_diagonal"};
+
+// Zipf exponent of the power-law row degrees: the rank-k row gets a share proportional to (k + 1)^-POWER_LAW_EXPONENT
+#define POWER_LAW_EXPONENT 1.0
+
+// Power-law degrees in pos (pos[r + 1] - pos[r] for row r) adding up to ndim1 * row_nnz like the uniform workload.
+// The scale of the Zipf shares is bisected so the degrees, clamped to [1, ndim2], reach that total; the heaviest rows
+// give back the rounding excess, and the ranks go to the rows in a random order.
+static void power_law_pos(size_t ndim1, size_t ndim2, size_t row_nnz, unsigned int seed, index_t *pos) {
+  size_t total = ndim1 * row_nnz;
+  double *share = _tensor_alloc(ndim1 * sizeof(double), false);
+  size_t *degree = _tensor_alloc(ndim1 * sizeof(size_t), false);
+  for (size_t k = 0; k < ndim1; ++k)
+    share[k] = pow((double)(k + 1), -POWER_LAW_EXPONENT);
+
+  double lo = 0, hi = ndim2 * pow((double)ndim1, POWER_LAW_EXPONENT);
+  for (int iter = 0; iter < 64; ++iter) {
+    double scale = (lo + hi) / 2;
+    size_t sum = 0;
+    for (size_t k = 0; k < ndim1; ++k) {
+      double d = share[k] * scale;
+      sum += d < 1 ? 1 : d > ndim2 ? ndim2 : (size_t)d;
+    }
+    if (sum >= total)
+      hi = scale;
+    else
+      lo = scale;
+  }
+  size_t sum = 0;
+  for (size_t k = 0; k < ndim1; ++k) {
+    double d = share[k] * hi;
+    degree[k] = d < 1 ? 1 : d > ndim2 ? ndim2 : (size_t)d;
+    sum += degree[k];
+  }
+  for (size_t k = 0; sum > total; k = k + 1 < ndim1 ? k + 1 : 0)
+    if (degree[k] > 1) {
+      --degree[k];
+      --sum;
     }
+
+  // Fisher-Yates shuffle of the ranks over the rows
+  struct rng rng = rng_stream(seed, 1, 0);
+  for (size_t k = ndim1; k > 1; --k) {
+    size_t other = rng_uniform(&rng, k);
+    size_t tmp = degree[k - 1];
+    degree[k - 1] = degree[other];
+    degree[other] = tmp;
+  }
+  pos[0] = 0;
+  for (size_t row = 0; row < ndim1; ++row)
+    pos[row + 1] = pos[row] + degree[row];
+  free(degree);
+  free(share);
+}
+
+// Row pattern of the workload's ndim1 x ndim2 matrix: row r holds pos[r + 1] - pos[r] of the *width columns starting
+// at the returned offset[r] (NULL: at column 0)
+static index_t *workload_pos(enum workload workload, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed,
+                             index_t *pos, size_t *width) {
+  size_t row_nnz = (size_t)(ndim2 * sparsity);
+  if (row_nnz < 1)
+    row_nnz = 1;
+  if (row_nnz > ndim2)
+    row_nnz = ndim2;
+
+  *width = ndim2;
+  if (workload == WORKLOAD_POWER_LAW) {
+    power_law_pos(ndim1, ndim2, row_nnz, seed, pos);
+    return NULL;
+  }
+  fill_uniform_pos(pos, ndim1, row_nnz);
+  if (workload == WORKLOAD_UNIFORM)
+    return NULL;
+
+  // Banded: a window twice the row's entries, centered on the diagonal and clamped to the columns. Block-diagonal:
+  // row blocks matched to column blocks of at least twice the row's entries (one block once sparsity passes 1/4).
+  index_t *offset = _tensor_alloc(ndim1 * sizeof(index_t), false);
+  if (workload == WORKLOAD_BANDED) {
+    *width = 2 * row_nnz < ndim2 ? 2 * row_nnz : ndim2;
+    for (size_t row = 0; row < ndim1; ++row) {
+      size_t center = (2 * row + 1) * ndim2 / (2 * ndim1);
+      size_t start = center > *width / 2 ? center - *width / 2 : 0;
+      offset[row] = start < ndim2 - *width ? start : ndim2 - *width;
+    }
+  } else {
+    size_t num_blocks = ndim2 / (2 * row_nnz);
+    if (num_blocks < 1)
+      num_blocks = 1;
+    *width = ndim2 / num_blocks;
+    for (size_t row = 0; row < ndim1; ++row)
+      offset[row] = row * num_blocks / ndim1 * *width;
+  }
+  return offset;
+}
+
+// Slice s of a compressed tensor gets its pos[s + 1] - pos[s] values redrawn from stream (seed, level, s)
+static void fill_values(unsigned int seed, uint64_t level, size_t num_slices, const index_t *pos, value_t *vals) {
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (size_t s = 0; s < num_slices; ++s) {
+    struct rng rng = rng_stream(seed, level, s);
+    for (size_t e = pos[s]; e < pos[s + 1]; ++e)
+      vals[e] = rng_value(&rng);
   }
+}
+
+// Counting-sort transpose of num_slices compressed slices over extent coordinates into extent slices; scanning the
+// slices in order leaves every output slice sorted
+static void transpose_compressed(size_t num_slices, size_t extent, const index_t *pos, const index_t *crd,
+                                 const value_t *vals, index_t *t_pos, index_t *t_crd, value_t *t_vals) {
+  memset(t_pos, 0, (extent + 1) * sizeof(index_t));
+  for (size_t e = 0; e < pos[num_slices]; ++e)
+    ++t_pos[crd[e] + 1];
+  for (size_t t = 0; t < extent; ++t)
+    t_pos[t + 1] += t_pos[t];
+  for (size_t s = 0; s < num_slices; ++s)
+    for (size_t e = pos[s]; e < pos[s + 1]; ++e) {
+      size_t dst = t_pos[crd[e]]++;
+      t_crd[dst] = s;
+      t_vals[dst] = vals[e];
+    }
+  // t_pos[t] now holds the end of slice t
+  memmove(t_pos + 1, t_pos, extent * sizeof(index_t));
+  t_pos[0] = 0;
+}
+
+static struct coo *rows_to_coo(const struct csr *rows) {
+  struct coo *tensor = allocate_coo(rows->lvl2_nnz);
+  memcpy(tensor->lvl2_crd, rows->lvl2_crd, rows->lvl2_nnz * sizeof(index_t));
+  memcpy(tensor->vals, rows->vals, rows->lvl2_nnz * sizeof(value_t));
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (size_t row = 0; row < rows->lvl1_size; ++row)
+    for (size_t idx = rows->lvl2_pos[row]; idx < rows->lvl2_pos[row + 1]; ++idx)
+      tensor->lvl1_crd[idx] = row;
+  return tensor;
+}
+
+struct csr *generate_csr_workload(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int seed) {
+  struct csr *tensor = allocate_csr(ndim1, 0);
+  size_t width;
+  index_t *offset = workload_pos(workload, ndim1, ndim2, sparsity, seed, tensor->lvl2_pos, &width);
+  _reserve_csr(tensor, tensor->lvl2_pos[ndim1]);
+  tensor->lvl2_nnz = tensor->lvl2_pos[ndim1];
+  fill_slices(seed, 2, ndim1, width, tensor->lvl2_pos, offset, tensor->lvl2_crd, tensor->vals);
+  free(offset);
+  tensor->sorted = true;
+  return tensor;
+}
+
+struct csc *generate_csc_workload(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int seed) {
+  struct csr *rows = generate_csr_workload(workload, ndim1, ndim2, sparsity, seed);
+  struct csc *tensor = allocate_csc(ndim2, 0);
+  _reserve_csc(tensor, rows->lvl2_nnz);
+  tensor->lvl2_nnz = rows->lvl2_nnz;
+  transpose_compressed(ndim1, ndim2, rows->lvl2_pos, rows->lvl2_crd, rows->vals, tensor->lvl2_pos, tensor->lvl2_crd,
+                       tensor->vals);
+  _free_csr(rows);
+  tensor->sorted = true;
+  return tensor;
+}
+
+struct coo *generate_coo_workload(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int seed) {
+  struct csr *rows = generate_csr_workload(workload, ndim1, ndim2, sparsity, seed);
+  struct coo *tensor = rows_to_coo(rows);
+  _free_csr(rows);
+  return tensor;
+}
+
+struct csr *generate_csr_transposed(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                    unsigned int pattern_seed, unsigned int seed) {
+  // Values are drawn per row of the pattern, i.e. per column of the result, like generate_csc_transposed
+  struct csr *pattern = generate_csr_workload(workload, ndim2, ndim1, sparsity, pattern_seed);
+  fill_values(seed, 2, ndim2, pattern->lvl2_pos, pattern->vals);
+  struct csr *tensor = allocate_csr(ndim1, 0);
+  _reserve_csr(tensor, pattern->lvl2_nnz);
+  tensor->lvl2_nnz = pattern->lvl2_nnz;
+  transpose_compressed(ndim2, ndim1, pattern->lvl2_pos, pattern->lvl2_crd, pattern->vals, tensor->lvl2_pos,
+                       tensor->lvl2_crd, tensor->vals);
+  _free_csr(pattern);
+  tensor->sorted = true;
+  return tensor;
+}
+
+struct csc *generate_csc_transposed(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                    unsigned int pattern_seed, unsigned int seed) {
+  // Column j of the transpose is row j of the pattern: take over its arrays as they are
+  struct csr *pattern = generate_csr_workload(workload, ndim2, ndim1, sparsity, pattern_seed);
+  struct csc *tensor = _tensor_alloc(sizeof(struct csc), false);
+  tensor->lvl1_size = pattern->lvl1_size;
+  tensor->lvl2_pos = pattern->lvl2_pos;
+  tensor->lvl2_nnz = pattern->lvl2_nnz;
+  tensor->lvl2_crd = pattern->lvl2_crd;
+  tensor->lvl2_cap = pattern->lvl2_cap;
+  tensor->sorted = true;
+  tensor->vals = pattern->vals;
+  tensor->slab = pattern->slab;
+  tensor->slab_size = pattern->slab_size;
+  tensor->mapped = pattern->mapped;
+  free(pattern);
+  fill_values(seed, 2, ndim2, tensor->lvl2_pos, tensor->vals);
+  return tensor;
+}
 
+struct coo *generate_coo_transposed(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                    unsigned int pattern_seed, unsigned int seed) {
+  struct csr *rows = generate_csr_transposed(workload, ndim1, ndim2, sparsity, pattern_seed, seed);
+  struct coo *tensor = rows_to_coo(rows);
+  _free_csr(rows);
   return tensor;
 }
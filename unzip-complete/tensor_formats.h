@@ -1,13 +1,67 @@
 #ifndef FORMATS_H
 #define FORMATS_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+// Width of the stored coordinates and positions (lvl*_crd, lvl*_pos, COO index slots): -DINDEX_BITS=32 halves the
+// index traffic of the locate loops for tensors with fewer than 2^32 rows, columns and entries. Counts and loop
+// variables stay size_t.
+#if !defined(INDEX_BITS)
+#define INDEX_BITS 64
+#endif
+
+#if INDEX_BITS == 32
+typedef uint32_t index_t;
+#define INDEX_MAX UINT32_MAX
+#elif INDEX_BITS == 64
+typedef uint64_t index_t;
+#define INDEX_MAX UINT64_MAX
+#else
+#error "INDEX_BITS must be 32 or 64"
+#endif
+
+// Type of the stored values (vals) and of reductions over them: double by default, -DVALUE_FLOAT stores and
+// accumulates in float, -DVALUE_MIXED stores in float and accumulates in double
+#if defined(VALUE_FLOAT) && defined(VALUE_MIXED)
+#error "VALUE_FLOAT and VALUE_MIXED are mutually exclusive"
+#elif defined(VALUE_FLOAT)
+typedef float value_t;
+typedef float acc_t;
+#define VALUE_TYPE_NAME "float"
+#elif defined(VALUE_MIXED)
+typedef float value_t;
+typedef double acc_t;
+#define VALUE_TYPE_NAME "mixed"
+#else
+typedef double value_t;
+typedef double acc_t;
+#define VALUE_TYPE_NAME "double"
+#endif
+
+// Backing of the sparse tensors' arrays: separate heap blocks by default, -DARENA_ALLOC carves pos, crd and vals out of
+// one 64-byte aligned slab per tensor and recycles freed slabs, -DHUGEPAGES (with ARENA_ALLOC) additionally aligns
+// slabs of 2 MiB or more to 2 MiB and asks for transparent huge pages
+#if defined(HUGEPAGES) && !defined(ARENA_ALLOC)
+#error "HUGEPAGES requires ARENA_ALLOC"
+#elif defined(HUGEPAGES)
+#define ALLOC_NAME "hugepage"
+#elif defined(ARENA_ALLOC)
+#define ALLOC_NAME "arena"
+#else
+#define ALLOC_NAME "heap"
+#endif
 
 // 1D Dense Vector
 struct dense {
   size_t lvl1_size; // Dense
 
-  double *vals; // values (size: lvl1_size)
+  value_t *vals; // values (size: lvl1_size)
+
+  void *slab;       // load_dense: file mapping holding vals, NULL otherwise
+  size_t slab_size; // bytes in slab
+  bool mapped;      // slab is a file mapping (see tensor_io.h)
 };
 
 // 2D Compressed Sparse Row (CSR) format
@@ -16,11 +70,17 @@ struct csr {
   size_t lvl1_size; // size: number of rows
 
   // Level 2: Compressed
-  size_t *lvl2_pos; // size: lvl1_size + 1
+  index_t *lvl2_pos; // size: lvl1_size + 1
   size_t lvl2_nnz;
-  size_t *lvl2_crd; // size: lvl2_nnz
+  index_t *lvl2_crd; // size: lvl2_nnz
+  size_t lvl2_cap;   // entries lvl2_crd and vals have room for (see reserve_tensor)
+  bool sorted;       // lvl2_crd ascending within each row (see sort_tensor)
 
-  double *vals; // size: lvl2_nnz
+  value_t *vals; // size: lvl2_nnz
+
+  void *slab;       // ARENA_ALLOC: block holding lvl2_pos, lvl2_crd and vals, NULL otherwise
+  size_t slab_size; // bytes in slab
+  bool mapped;      // slab is a file mapping (see tensor_io.h)
 };
 
 // 2D Compressed Sparse Column (CSC) format
@@ -29,44 +89,84 @@ struct csc {
   size_t lvl1_size; // size: number of columns
 
   // Level 2: Compressed
-  size_t *lvl2_pos; // size: lvl1_size + 1
+  index_t *lvl2_pos; // size: lvl1_size + 1
   size_t lvl2_nnz;
-  size_t *lvl2_crd; // size: lvl2_nnz
+  index_t *lvl2_crd; // size: lvl2_nnz
+  size_t lvl2_cap;   // entries lvl2_crd and vals have room for (see reserve_tensor)
+  bool sorted;       // lvl2_crd ascending within each column (see sort_tensor)
+
+  value_t *vals; // size: lvl2_nnz
 
-  double *vals; // size: lvl2_nnz
+  void *slab;       // ARENA_ALLOC: block holding lvl2_pos, lvl2_crd and vals, NULL otherwise
+  size_t slab_size; // bytes in slab
+  bool mapped;      // slab is a file mapping (see tensor_io.h)
 };
 
 // 3D Compressed Sparse Fiber (CSF) format
 struct csf {
   // Level 1: Comrpessed
   size_t lvl1_nnz;
-  size_t *lvl1_crd; // size: lvl1_nnz
+  index_t *lvl1_crd; // size: lvl1_nnz
 
   // Level 2: Compressed
-  size_t *lvl2_pos; // size: lvl1_nnz + 1
+  index_t *lvl2_pos; // size: lvl1_nnz + 1
   size_t lvl2_nnz;
-  size_t *lvl2_crd; // size: lvl2_nnz
+  index_t *lvl2_crd; // size: lvl2_nnz
 
   // Level 3: Comrpessed
-  size_t *lvl3_pos; // size: lvl2_nnz + 1
+  index_t *lvl3_pos; // size: lvl2_nnz + 1
   size_t lvl3_nnz;
-  size_t *lvl3_crd; // size: lvl3_nnz
+  index_t *lvl3_crd; // size: lvl3_nnz
+
+  value_t *vals; // size: lvl3_nnz
 
-  double *vals; // size: lvl3_nnz
+  void *slab;       // ARENA_ALLOC: block holding every array above, NULL otherwise
+  size_t slab_size; // bytes in slab
+  bool mapped;      // slab is a file mapping (see tensor_io.h)
 };
 
 // 2D Coordinate (COO) format
 struct coo {
   // Level 1: Compressed (non-unique)
   size_t lvl1_nnz;
-  size_t *lvl1_crd; // size: lvl1_nnz
+  index_t *lvl1_crd; // size: lvl1_nnz
+  size_t lvl1_cap;   // entries lvl1_crd, lvl2_crd and vals have room for (see reserve_tensor)
 
   // Level 2: Singleton
-  size_t *lvl2_crd; // size: lvl1_nnz
+  index_t *lvl2_crd; // size: lvl1_nnz
+
+  value_t *vals;
+
+  // Optional open-addressing index (lvl1_crd, lvl2_crd) -> position (see build_coo_index)
+  size_t index_mask;    // number of slots - 1
+  index_t *index_slots; // size: index_mask + 1, COO_INDEX_EMPTY for unused slots, NULL if not built
 
-  double *vals;
+  void *slab;       // ARENA_ALLOC: block holding lvl1_crd, lvl2_crd and vals (not index_slots), NULL otherwise
+  size_t slab_size; // bytes in slab
+  bool mapped;      // slab is a file mapping (see tensor_io.h)
 };
 
+#define COO_INDEX_EMPTY ((size_t)INDEX_MAX)
+
+static inline size_t coo_index_hash(size_t crd1, size_t crd2) {
+  size_t h = crd1 * 0x9E3779B97F4A7C15ULL ^ crd2;
+  h ^= h >> 32;
+  h *= 0xD6E8FEB86659FD93ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+// Position of the first entry stored at (crd1, crd2), or COO_INDEX_EMPTY if there is none
+static inline size_t coo_index_find(const struct coo *tensor, size_t crd1, size_t crd2) {
+  size_t slot = coo_index_hash(crd1, crd2) & tensor->index_mask;
+  for (;;) {
+    size_t pos = tensor->index_slots[slot];
+    if (pos == COO_INDEX_EMPTY || (tensor->lvl1_crd[pos] == crd1 && tensor->lvl2_crd[pos] == crd2))
+      return pos;
+    slot = (slot + 1) & tensor->index_mask;
+  }
+}
+
 #define reset_tensor(T)                                                                                                \
   _Generic((T),                                                                                                        \
       struct dense *: _reset_dense,                                                                                    \
@@ -83,6 +183,21 @@ struct coo {
       struct coo *: _free_coo,                                                                                         \
       struct csf *: _free_csf)(T)
 
+// Sort coordinates within each compressed slice and mark the tensor as sorted
+#define sort_tensor(T) _Generic((T), struct csr *: _sort_csr, struct csc *: _sort_csc)(T)
+
+// Make room for at least nnz entries, reallocating to exactly nnz if the tensor has less
+#define reserve_tensor(T, nnz)                                                                                         \
+  _Generic((T), struct csr *: _reserve_csr, struct csc *: _reserve_csc, struct coo *: _reserve_coo)(T, nnz)
+
+// Make room for at least nnz entries, at least doubling the capacity when it has to grow so appends are amortized O(1)
+#define grow_tensor(T, nnz)                                                                                            \
+  _Generic((T), struct csr *: _grow_csr, struct csc *: _grow_csc, struct coo *: _grow_coo)(T, nnz)
+
+// Version of the generate_* output: bumped whenever the same arguments produce different tensors, so cached inputs of
+// an older version are regenerated (see tensor_io.h)
+#define GENERATOR_VERSION 2
+
 // Internal utility function declarations (use generic macros below instead)
 
 // Dense utilities
@@ -96,18 +211,24 @@ struct csr *allocate_csr(size_t ndim1, size_t dim2_nnz);
 struct csr *generate_csr(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed);
 void _free_csr(struct csr *tensor);
 void _reset_csr(struct csr *tensor);
+void _sort_csr(struct csr *tensor);
+void _reserve_csr(struct csr *tensor, size_t nnz);
 
 // CSC utilities
 struct csc *allocate_csc(size_t ndim2, size_t dim2_nnz);
 struct csc *generate_csc(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed);
 void _free_csc(struct csc *tensor);
 void _reset_csc(struct csc *tensor);
+void _sort_csc(struct csc *tensor);
+void _reserve_csc(struct csc *tensor, size_t nnz);
 
 // COO utilities
 struct coo *allocate_coo(size_t nnz);
 struct coo *generate_coo(size_t ndim1, size_t ndim2, double sparsity, unsigned int seed);
 void _free_coo(struct coo *tensor);
 void _reset_coo(struct coo *tensor);
+void _reserve_coo(struct coo *tensor, size_t nnz);
+void build_coo_index(struct coo *tensor);
 
 // CSF utilities
 struct csf *allocate_csf(size_t ndim1, size_t dim2_nnz, size_t dim3_nnz);
@@ -115,4 +236,106 @@ struct csf *generate_csf(size_t ndim1, size_t ndim2, size_t ndim3, double sparsi
 void _free_csf(struct csf *tensor);
 void _reset_csf(struct csf *tensor);
 
+// Structured workloads: an ndim1 x ndim2 matrix generated row by row, with the uniform workload's ndim1 * ndim2 *
+// sparsity non-zeros (at least one per row) arranged differently. Every format holds the same matrix for the same
+// arguments; coordinates are distinct and sorted like generate_*.
+enum workload {
+  WORKLOAD_UNIFORM,        // ndim2 * sparsity random columns in every row, the pattern of generate_csr
+  WORKLOAD_POWER_LAW,      // Zipf-distributed row degrees (a few dense rows, a long tail of near-empty ones)
+  WORKLOAD_BANDED,         // every row within a band around the diagonal twice as wide as its entries
+  WORKLOAD_BLOCK_DIAGONAL, // square-ish diagonal blocks, each about half full
+};
+
+#define NUM_WORKLOADS 4
+
+extern const char *const WORKLOAD_NAMES[NUM_WORKLOADS]; // "uniform", "power_law", "banded", "block_diagonal"
+
+struct csr *generate_csr_workload(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int seed);
+struct csc *generate_csc_workload(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int seed);
+struct coo *generate_coo_workload(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int seed);
+
+// ndim1 x ndim2 matrix with the pattern of the transpose of generate_*_workload(workload, ndim2, ndim1, sparsity,
+// pattern_seed) and values drawn from seed: as hadamard_transpose's C for that B, every entry of B meets one of C
+struct csr *generate_csr_transposed(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                    unsigned int pattern_seed, unsigned int seed);
+struct csc *generate_csc_transposed(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                    unsigned int pattern_seed, unsigned int seed);
+struct coo *generate_coo_transposed(enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                    unsigned int pattern_seed, unsigned int seed);
+
+// Return the slabs kept for reuse by ARENA_ALLOC builds to the system (no-op otherwise)
+void release_arena_pool(void);
+
+// Allocation accounting of tensor storage: every pos, crd and vals array, COO index, arena slab and file mapping a
+// tensor holds, at its allocated size. Pooled arena slabs are not live. Like the arena pool, the counters are updated
+// outside the parallel kernels, without locking.
+struct tensor_memory {
+  size_t live_bytes;  // held by tensors now
+  size_t peak_bytes;  // high-water mark of live_bytes since the start or the last reset_tensor_memory_peak
+  size_t allocations; // allocations and reallocations so far
+};
+
+struct tensor_memory tensor_memory(void);
+void reset_tensor_memory_peak(void);
+
+// Counter updates, for storage allocated outside tensor_formats.c (the file mappings of tensor_io.c)
+void _count_tensor_alloc(size_t bytes);
+void _count_tensor_free(size_t bytes);
+
+// malloc, or calloc when zero is set, ending the program like tensor storage does when it fails: for the tensor structs,
+// the COO index and the scratch arrays of the generators and of tensor_io.c. Free with free().
+void *_tensor_alloc(size_t bytes, bool zero);
+
+// Bytes of storage a tensor holds: its capacity rather than its entry count, the whole slab or file mapping when it
+// has one, and a built COO index
+size_t _dense_footprint(const struct dense *tensor);
+size_t _csr_footprint(const struct csr *tensor);
+size_t _csc_footprint(const struct csc *tensor);
+size_t _coo_footprint(const struct coo *tensor);
+size_t _csf_footprint(const struct csf *tensor);
+
+#define tensor_footprint(T)                                                                                            \
+  _Generic((T),                                                                                                        \
+      struct dense *: _dense_footprint,                                                                                \
+      struct csr *: _csr_footprint,                                                                                    \
+      struct csc *: _csc_footprint,                                                                                    \
+      struct coo *: _coo_footprint,                                                                                    \
+      struct csf *: _csf_footprint)(T)
+
+// Growth checks sit on the kernels' append paths, so only the reallocation is out of line
+static inline void _grow_csr(struct csr *tensor, size_t nnz) {
+  if (nnz > tensor->lvl2_cap)
+    _reserve_csr(tensor, nnz > 2 * tensor->lvl2_cap ? nnz : 2 * tensor->lvl2_cap);
+}
+
+static inline void _grow_csc(struct csc *tensor, size_t nnz) {
+  if (nnz > tensor->lvl2_cap)
+    _reserve_csc(tensor, nnz > 2 * tensor->lvl2_cap ? nnz : 2 * tensor->lvl2_cap);
+}
+
+static inline void _grow_coo(struct coo *tensor, size_t nnz) {
+  if (nnz > tensor->lvl1_cap)
+    _reserve_coo(tensor, nnz > 2 * tensor->lvl1_cap ? nnz : 2 * tensor->lvl1_cap);
+}
+
+// Bytes in the pos, crd and vals arrays up to the current entry count, plus a built COO index: the traffic of
+// streaming the tensor once, as the benchmarks' roofline columns count it
+static inline size_t _csr_bytes(const struct csr *tensor) {
+  return (tensor->lvl1_size + 1) * sizeof(index_t) + tensor->lvl2_nnz * (sizeof(index_t) + sizeof(value_t));
+}
+
+static inline size_t _csc_bytes(const struct csc *tensor) {
+  return (tensor->lvl1_size + 1) * sizeof(index_t) + tensor->lvl2_nnz * (sizeof(index_t) + sizeof(value_t));
+}
+
+static inline size_t _coo_bytes(const struct coo *tensor) {
+  size_t index = tensor->index_slots ? (tensor->index_mask + 1) * sizeof(index_t) : 0;
+  return tensor->lvl1_nnz * (2 * sizeof(index_t) + sizeof(value_t)) + index;
+}
+
+#define tensor_bytes(T) _Generic((T), struct csr *: _csr_bytes, struct csc *: _csc_bytes, struct coo *: _coo_bytes)(T)
+
 #endif /* FORMATS_H */
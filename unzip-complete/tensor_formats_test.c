@@ -0,0 +1,198 @@
+#include "tensor_formats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+// The generators of tensor_formats.c on their own, once rather than in every configuration's test. Generated inputs
+// are canonical (coordinates strictly ascending within every slice, so distinct) and depend on the seed only, so
+// generating on 1 and on 3 threads gives the same tensors.
+
+static int ascending(const index_t *crd, size_t start, size_t end, size_t extent) {
+  for (size_t k = start; k < end; ++k)
+    if (crd[k] >= extent || (k > start && crd[k] <= crd[k - 1]))
+      return 0;
+  return 1;
+}
+
+static int same_arrays(const void *a, const void *b, size_t bytes) { return memcmp(a, b, bytes) == 0; }
+
+static void generate_threads(int threads) {
+#if defined(_OPENMP)
+  omp_set_num_threads(threads);
+#else
+  (void)threads;
+#endif
+}
+
+// The uniform generators fill every slice with the same number of entries
+static int verify_generators(void) {
+  int passed = 1;
+
+  generate_threads(1);
+  struct csr *csr = generate_csr(60, 50, 0.3, 7);
+  struct csc *csc = generate_csc(50, 60, 0.3, 7);
+  struct coo *coo = generate_coo(60, 50, 0.3, 7);
+  struct csf *csf = generate_csf(12, 10, 9, 0.5, 7);
+  generate_threads(3);
+  struct csr *csr2 = generate_csr(60, 50, 0.3, 7);
+  struct csc *csc2 = generate_csc(50, 60, 0.3, 7);
+  struct coo *coo2 = generate_coo(60, 50, 0.3, 7);
+  struct csf *csf2 = generate_csf(12, 10, 9, 0.5, 7);
+
+  passed &= csr->sorted && csr->lvl2_nnz == 60 * 15;
+  for (size_t row = 0; row < 60; ++row)
+    passed &= csr->lvl2_pos[row + 1] - csr->lvl2_pos[row] == 15 &&
+              ascending(csr->lvl2_crd, csr->lvl2_pos[row], csr->lvl2_pos[row + 1], 50);
+  passed &= csc->sorted && csc->lvl2_nnz == 60 * 15;
+  for (size_t col = 0; col < 60; ++col)
+    passed &= csc->lvl2_pos[col + 1] - csc->lvl2_pos[col] == 15 &&
+              ascending(csc->lvl2_crd, csc->lvl2_pos[col], csc->lvl2_pos[col + 1], 50);
+  passed &= coo->lvl1_nnz == 900;
+  for (size_t k = 0; k < coo->lvl1_nnz; ++k)
+    passed &= coo->lvl1_crd[k] < 60 && coo->lvl2_crd[k] < 50 &&
+              (k == 0 || coo->lvl1_crd[k] > coo->lvl1_crd[k - 1] ||
+               (coo->lvl1_crd[k] == coo->lvl1_crd[k - 1] && coo->lvl2_crd[k] > coo->lvl2_crd[k - 1]));
+  passed &= ascending(csf->lvl1_crd, 0, csf->lvl1_nnz, 12);
+  for (size_t slice = 0; slice < csf->lvl1_nnz; ++slice)
+    passed &= ascending(csf->lvl2_crd, slice * 5, (slice + 1) * 5, 10);
+  for (size_t fiber = 0; fiber < csf->lvl2_nnz; ++fiber)
+    passed &= ascending(csf->lvl3_crd, csf->lvl2_pos[fiber], csf->lvl2_pos[fiber + 1], 9);
+
+  passed &= same_arrays(csr->lvl2_crd, csr2->lvl2_crd, csr->lvl2_nnz * sizeof(index_t)) &&
+            same_arrays(csr->vals, csr2->vals, csr->lvl2_nnz * sizeof(value_t));
+  passed &= same_arrays(csc->lvl2_crd, csc2->lvl2_crd, csc->lvl2_nnz * sizeof(index_t)) &&
+            same_arrays(csc->vals, csc2->vals, csc->lvl2_nnz * sizeof(value_t));
+  passed &= same_arrays(coo->lvl1_crd, coo2->lvl1_crd, coo->lvl1_nnz * sizeof(index_t)) &&
+            same_arrays(coo->lvl2_crd, coo2->lvl2_crd, coo->lvl1_nnz * sizeof(index_t)) &&
+            same_arrays(coo->vals, coo2->vals, coo->lvl1_nnz * sizeof(value_t));
+  passed &= same_arrays(csf->lvl3_crd, csf2->lvl3_crd, csf->lvl3_nnz * sizeof(index_t)) &&
+            same_arrays(csf->vals, csf2->vals, csf->lvl3_nnz * sizeof(value_t));
+
+  free_tensor(csr);
+  free_tensor(csc);
+  free_tensor(coo);
+  free_tensor(csf);
+  free_tensor(csr2);
+  free_tensor(csc2);
+  free_tensor(coo2);
+  free_tensor(csf2);
+
+  printf("  %s generators: sorted, distinct and thread-count independent\n", passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+// Dense row-major image of a generated ndim1 x ndim2 matrix: the value of every entry, -1 where there is none
+// (generated values lie in [0, 1)). set_entry fails on a repeated or out-of-range coordinate.
+static value_t *empty_image(size_t ndim1, size_t ndim2) {
+  value_t *image = malloc(ndim1 * ndim2 * sizeof(value_t));
+  for (size_t k = 0; k < ndim1 * ndim2; ++k)
+    image[k] = -1;
+  return image;
+}
+
+static int set_entry(value_t *image, size_t ndim1, size_t ndim2, size_t row, size_t col, value_t val) {
+  if (row >= ndim1 || col >= ndim2 || image[row * ndim2 + col] >= 0)
+    return 0;
+  image[row * ndim2 + col] = val;
+  return 1;
+}
+
+// Every format of a structured workload holds the same matrix, with the uniform workload's number of entries; the
+// transposed generators hold the transposed pattern
+static int verify_workloads(void) {
+  const size_t ndim1 = 40, ndim2 = 30;
+  int passed = 1;
+
+  for (int w = 0; w < NUM_WORKLOADS; ++w) {
+    generate_threads(1);
+    struct csr *csr = generate_csr_workload(w, ndim1, ndim2, 0.2, 3);
+    generate_threads(3);
+    struct csr *csr2 = generate_csr_workload(w, ndim1, ndim2, 0.2, 3);
+    struct csc *csc = generate_csc_workload(w, ndim1, ndim2, 0.2, 3);
+    struct coo *coo = generate_coo_workload(w, ndim1, ndim2, 0.2, 3);
+    struct csr *csr_t = generate_csr_transposed(w, ndim2, ndim1, 0.2, 3, 4);
+    struct csc *csc_t = generate_csc_transposed(w, ndim2, ndim1, 0.2, 3, 4);
+    struct coo *coo_t = generate_coo_transposed(w, ndim2, ndim1, 0.2, 3, 4);
+
+    value_t *image = empty_image(ndim1, ndim2), *image_csc = empty_image(ndim1, ndim2),
+            *image_coo = empty_image(ndim1, ndim2);
+    value_t *image_t = empty_image(ndim2, ndim1), *image_csc_t = empty_image(ndim2, ndim1),
+            *image_coo_t = empty_image(ndim2, ndim1);
+
+    passed &= csr->sorted && csc->sorted && csr_t->sorted && csc_t->sorted && csr->lvl2_nnz == ndim1 * 6 &&
+              csc->lvl2_nnz == csr->lvl2_nnz && coo->lvl1_nnz == csr->lvl2_nnz && csr_t->lvl2_nnz == csr->lvl2_nnz &&
+              csc_t->lvl2_nnz == csr->lvl2_nnz && coo_t->lvl1_nnz == csr->lvl2_nnz;
+    passed &= same_arrays(csr->lvl2_pos, csr2->lvl2_pos, (ndim1 + 1) * sizeof(index_t)) &&
+              same_arrays(csr->lvl2_crd, csr2->lvl2_crd, csr->lvl2_nnz * sizeof(index_t)) &&
+              same_arrays(csr->vals, csr2->vals, csr->lvl2_nnz * sizeof(value_t));
+    for (size_t row = 0; row < ndim1; ++row) {
+      passed &= ascending(csr->lvl2_crd, csr->lvl2_pos[row], csr->lvl2_pos[row + 1], ndim2);
+      for (size_t k = csr->lvl2_pos[row]; k < csr->lvl2_pos[row + 1]; ++k)
+        passed &= set_entry(image, ndim1, ndim2, row, csr->lvl2_crd[k], csr->vals[k]);
+    }
+    for (size_t col = 0; col < ndim2; ++col) {
+      passed &= ascending(csc->lvl2_crd, csc->lvl2_pos[col], csc->lvl2_pos[col + 1], ndim1);
+      for (size_t k = csc->lvl2_pos[col]; k < csc->lvl2_pos[col + 1]; ++k)
+        passed &= set_entry(image_csc, ndim1, ndim2, csc->lvl2_crd[k], col, csc->vals[k]);
+    }
+    for (size_t k = 0; k < coo->lvl1_nnz; ++k)
+      passed &= set_entry(image_coo, ndim1, ndim2, coo->lvl1_crd[k], coo->lvl2_crd[k], coo->vals[k]);
+    for (size_t row = 0; row < ndim2; ++row) {
+      passed &= ascending(csr_t->lvl2_crd, csr_t->lvl2_pos[row], csr_t->lvl2_pos[row + 1], ndim1);
+      for (size_t k = csr_t->lvl2_pos[row]; k < csr_t->lvl2_pos[row + 1]; ++k)
+        passed &= set_entry(image_t, ndim2, ndim1, row, csr_t->lvl2_crd[k], csr_t->vals[k]);
+    }
+    for (size_t col = 0; col < ndim1; ++col) {
+      passed &= ascending(csc_t->lvl2_crd, csc_t->lvl2_pos[col], csc_t->lvl2_pos[col + 1], ndim2);
+      for (size_t k = csc_t->lvl2_pos[col]; k < csc_t->lvl2_pos[col + 1]; ++k)
+        passed &= set_entry(image_csc_t, ndim2, ndim1, csc_t->lvl2_crd[k], col, csc_t->vals[k]);
+    }
+    for (size_t k = 0; k < coo_t->lvl1_nnz; ++k)
+      passed &= set_entry(image_coo_t, ndim2, ndim1, coo_t->lvl1_crd[k], coo_t->lvl2_crd[k], coo_t->vals[k]);
+
+    passed &= same_arrays(image, image_csc, ndim1 * ndim2 * sizeof(value_t)) &&
+              same_arrays(image, image_coo, ndim1 * ndim2 * sizeof(value_t)) &&
+              same_arrays(image_t, image_csc_t, ndim1 * ndim2 * sizeof(value_t)) &&
+              same_arrays(image_t, image_coo_t, ndim1 * ndim2 * sizeof(value_t));
+    for (size_t row = 0; row < ndim1; ++row)
+      for (size_t col = 0; col < ndim2; ++col)
+        passed &= (image[row * ndim2 + col] >= 0) == (image_t[col * ndim1 + row] >= 0);
+
+    free(image);
+    free(image_csc);
+    free(image_coo);
+    free(image_t);
+    free(image_csc_t);
+    free(image_coo_t);
+    free_tensor(csr);
+    free_tensor(csr2);
+    free_tensor(csc);
+    free_tensor(coo);
+    free_tensor(csr_t);
+    free_tensor(csc_t);
+    free_tensor(coo_t);
+  }
+
+  printf("  %s workloads: every format holds the same matrix, transposed generators its transpose\n",
+         passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+int main() {
+  int passed = 1;
+
+  printf("Running Tensor Formats Test\n");
+  printf("===========================\n");
+
+  passed &= verify_generators();
+  passed &= verify_workloads();
+
+  release_arena_pool();
+  printf("\n===========================\n");
+  printf("Test Result: %s\n", passed ? "PASSED" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,976 @@
+#include "tensor_io.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+// Tag in cache file names: tensors generated with another index width, value size or generator version are different
+// files
+#define CACHE_TAG_FMT "idx%d_f%d_g%d"
+#define CACHE_TAG_ARGS INDEX_BITS, (int)(8 * sizeof(value_t)), GENERATOR_VERSION
+
+static inline size_t round_up(size_t bytes, size_t align) { return (bytes + align - 1) & ~(align - 1); }
+
+// ============================================================================
+// Save
+// ============================================================================
+
+struct section {
+  const void *data;
+  size_t bytes;
+};
+
+// Fill in the header's layout, write it and the sections to a temporary file next to path and rename it into place,
+// so concurrent readers of path see either no file or a complete one
+static int write_tensor_file(const char *path, struct tensor_file_header *header, const struct section *sections,
+                             size_t num_sections) {
+  memcpy(header->magic, TENSOR_FILE_MAGIC, sizeof(header->magic));
+  header->version = TENSOR_FILE_VERSION;
+  header->index_bytes = sizeof(index_t);
+  header->value_bytes = sizeof(value_t);
+
+  size_t offset = round_up(sizeof(*header), TENSOR_FILE_ALIGN);
+  for (size_t s = 0; s < num_sections; ++s) {
+    header->offset[s] = offset;
+    header->bytes[s] = sections[s].bytes;
+    offset += round_up(sections[s].bytes, TENSOR_FILE_ALIGN);
+  }
+
+  char tmp_path[PATH_MAX];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(tmp_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  FILE *file = fopen(tmp_path, "wb");
+  if (!file)
+    return -1;
+
+  static const char padding[TENSOR_FILE_ALIGN] = {0};
+  bool ok = fwrite(header, sizeof(*header), 1, file) == 1;
+  size_t written = sizeof(*header);
+  for (size_t s = 0; ok && s < num_sections; ++s) {
+    size_t pad = header->offset[s] - written;
+    ok = fwrite(padding, 1, pad, file) == pad;
+    if (ok && sections[s].bytes > 0)
+      ok = fwrite(sections[s].data, 1, sections[s].bytes, file) == sections[s].bytes;
+    written = header->offset[s] + sections[s].bytes;
+  }
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    int err = errno;
+    unlink(tmp_path);
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+int _save_dense(const struct dense *tensor, const char *path) {
+  struct tensor_file_header header = {.format = TENSOR_FILE_DENSE, .sizes = {tensor->lvl1_size}};
+  struct section sections[] = {{tensor->vals, tensor->lvl1_size * sizeof(value_t)}};
+  return write_tensor_file(path, &header, sections, 1);
+}
+
+// CSR and CSC share their layout and differ only in the format tag
+static int save_compressed(uint32_t format, size_t lvl1_size, size_t lvl2_nnz, bool sorted, const index_t *pos,
+                           const index_t *crd, const value_t *vals, const char *path) {
+  struct tensor_file_header header = {
+      .format = format, .sizes = {lvl1_size, lvl2_nnz}, .flags = sorted ? TENSOR_FILE_SORTED : 0};
+  struct section sections[] = {
+      {pos, (lvl1_size + 1) * sizeof(index_t)},
+      {crd, lvl2_nnz * sizeof(index_t)},
+      {vals, lvl2_nnz * sizeof(value_t)},
+  };
+  return write_tensor_file(path, &header, sections, 3);
+}
+
+int _save_csr(const struct csr *tensor, const char *path) {
+  return save_compressed(TENSOR_FILE_CSR, tensor->lvl1_size, tensor->lvl2_nnz, tensor->sorted, tensor->lvl2_pos,
+                         tensor->lvl2_crd, tensor->vals, path);
+}
+
+int _save_csc(const struct csc *tensor, const char *path) {
+  return save_compressed(TENSOR_FILE_CSC, tensor->lvl1_size, tensor->lvl2_nnz, tensor->sorted, tensor->lvl2_pos,
+                         tensor->lvl2_crd, tensor->vals, path);
+}
+
+int _save_coo(const struct coo *tensor, const char *path) {
+  struct tensor_file_header header = {.format = TENSOR_FILE_COO, .sizes = {tensor->lvl1_nnz}};
+  struct section sections[] = {
+      {tensor->lvl1_crd, tensor->lvl1_nnz * sizeof(index_t)},
+      {tensor->lvl2_crd, tensor->lvl1_nnz * sizeof(index_t)},
+      {tensor->vals, tensor->lvl1_nnz * sizeof(value_t)},
+  };
+  return write_tensor_file(path, &header, sections, 3);
+}
+
+int _save_csf(const struct csf *tensor, const char *path) {
+  struct tensor_file_header header = {.format = TENSOR_FILE_CSF,
+                                      .sizes = {tensor->lvl1_nnz, tensor->lvl2_nnz, tensor->lvl3_nnz}};
+  struct section sections[] = {
+      {tensor->lvl1_crd, tensor->lvl1_nnz * sizeof(index_t)},
+      {tensor->lvl2_pos, (tensor->lvl2_nnz + 1) * sizeof(index_t)},
+      {tensor->lvl2_crd, tensor->lvl2_nnz * sizeof(index_t)},
+      {tensor->lvl3_crd, tensor->lvl3_nnz * sizeof(index_t)},
+      {tensor->vals, tensor->lvl3_nnz * sizeof(value_t)},
+  };
+  return write_tensor_file(path, &header, sections, 5);
+}
+
+// ============================================================================
+// Load
+// ============================================================================
+
+// Map path privately and check that it holds a tensor of the given format whose sections lie inside the file.
+// Returns the header at the start of the mapping, or NULL.
+static struct tensor_file_header *map_tensor_file(const char *path, uint32_t format, size_t num_sections,
+                                                  size_t *map_size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct tensor_file_header)) {
+    close(fd);
+    return NULL;
+  }
+
+  int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+  // Fault the pages in now rather than inside the first timed kernel call
+  flags |= MAP_POPULATE;
+#endif
+  void *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, flags, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  size_t size = st.st_size;
+  struct tensor_file_header *header = base;
+  bool ok = memcmp(header->magic, TENSOR_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+            header->version == TENSOR_FILE_VERSION && header->format == format &&
+            header->index_bytes == sizeof(index_t) && header->value_bytes == sizeof(value_t);
+  for (size_t s = 0; ok && s < num_sections; ++s)
+    ok = header->offset[s] % TENSOR_FILE_ALIGN == 0 && header->offset[s] <= size &&
+         header->bytes[s] <= size - header->offset[s];
+  if (!ok) {
+    munmap(base, size);
+    return NULL;
+  }
+  *map_size = size;
+  return header;
+}
+
+// Address of section s if it holds exactly bytes, NULL otherwise
+static void *section_at(struct tensor_file_header *header, size_t s, size_t bytes) {
+  return header->bytes[s] == bytes ? (char *)header + header->offset[s] : NULL;
+}
+
+struct dense *load_dense(const char *path) {
+  size_t map_size;
+  struct tensor_file_header *header = map_tensor_file(path, TENSOR_FILE_DENSE, 1, &map_size);
+  if (!header)
+    return NULL;
+  size_t n = header->sizes[0];
+  value_t *vals = section_at(header, 0, n * sizeof(value_t));
+  if (!vals) {
+    munmap(header, map_size);
+    return NULL;
+  }
+
+  struct dense *tensor = _tensor_alloc(sizeof(struct dense), false);
+  tensor->lvl1_size = n;
+  tensor->vals = vals;
+  tensor->slab = header;
+  tensor->slab_size = map_size;
+  tensor->mapped = true;
+  _count_tensor_alloc(map_size);
+  return tensor;
+}
+
+// CSR and CSC sections: lvl2_pos, lvl2_crd, vals. Returns false (and unmaps) if a section has the wrong size.
+static bool map_compressed(struct tensor_file_header *header, size_t map_size, index_t **pos, index_t **crd,
+                           value_t **vals) {
+  size_t lvl1_size = header->sizes[0];
+  size_t lvl2_nnz = header->sizes[1];
+  *pos = section_at(header, 0, (lvl1_size + 1) * sizeof(index_t));
+  *crd = section_at(header, 1, lvl2_nnz * sizeof(index_t));
+  *vals = section_at(header, 2, lvl2_nnz * sizeof(value_t));
+  if (*pos && *crd && *vals)
+    return true;
+  munmap(header, map_size);
+  return false;
+}
+
+struct csr *load_csr(const char *path) {
+  size_t map_size;
+  struct tensor_file_header *header = map_tensor_file(path, TENSOR_FILE_CSR, 3, &map_size);
+  index_t *pos, *crd;
+  value_t *vals;
+  if (!header || !map_compressed(header, map_size, &pos, &crd, &vals))
+    return NULL;
+
+  struct csr *tensor = _tensor_alloc(sizeof(struct csr), false);
+  tensor->lvl1_size = header->sizes[0];
+  tensor->lvl2_pos = pos;
+  tensor->lvl2_nnz = header->sizes[1];
+  tensor->lvl2_crd = crd;
+  tensor->lvl2_cap = tensor->lvl2_nnz;
+  tensor->sorted = header->flags & TENSOR_FILE_SORTED;
+  tensor->vals = vals;
+  tensor->slab = header;
+  tensor->slab_size = map_size;
+  tensor->mapped = true;
+  _count_tensor_alloc(map_size);
+  return tensor;
+}
+
+struct csc *load_csc(const char *path) {
+  size_t map_size;
+  struct tensor_file_header *header = map_tensor_file(path, TENSOR_FILE_CSC, 3, &map_size);
+  index_t *pos, *crd;
+  value_t *vals;
+  if (!header || !map_compressed(header, map_size, &pos, &crd, &vals))
+    return NULL;
+
+  struct csc *tensor = _tensor_alloc(sizeof(struct csc), false);
+  tensor->lvl1_size = header->sizes[0];
+  tensor->lvl2_pos = pos;
+  tensor->lvl2_nnz = header->sizes[1];
+  tensor->lvl2_crd = crd;
+  tensor->lvl2_cap = tensor->lvl2_nnz;
+  tensor->sorted = header->flags & TENSOR_FILE_SORTED;
+  tensor->vals = vals;
+  tensor->slab = header;
+  tensor->slab_size = map_size;
+  tensor->mapped = true;
+  _count_tensor_alloc(map_size);
+  return tensor;
+}
+
+struct coo *load_coo(const char *path) {
+  size_t map_size;
+  struct tensor_file_header *header = map_tensor_file(path, TENSOR_FILE_COO, 3, &map_size);
+  if (!header)
+    return NULL;
+  size_t nnz = header->sizes[0];
+  index_t *lvl1_crd = section_at(header, 0, nnz * sizeof(index_t));
+  index_t *lvl2_crd = section_at(header, 1, nnz * sizeof(index_t));
+  value_t *vals = section_at(header, 2, nnz * sizeof(value_t));
+  if (!lvl1_crd || !lvl2_crd || !vals) {
+    munmap(header, map_size);
+    return NULL;
+  }
+
+  struct coo *tensor = _tensor_alloc(sizeof(struct coo), false);
+  tensor->lvl1_nnz = nnz;
+  tensor->lvl1_crd = lvl1_crd;
+  tensor->lvl1_cap = nnz;
+  tensor->lvl2_crd = lvl2_crd;
+  tensor->vals = vals;
+  tensor->index_mask = 0;
+  tensor->index_slots = NULL;
+  tensor->slab = header;
+  tensor->slab_size = map_size;
+  tensor->mapped = true;
+  _count_tensor_alloc(map_size);
+  return tensor;
+}
+
+struct csf *load_csf(const char *path) {
+  size_t map_size;
+  struct tensor_file_header *header = map_tensor_file(path, TENSOR_FILE_CSF, 5, &map_size);
+  if (!header)
+    return NULL;
+  size_t lvl1_nnz = header->sizes[0];
+  size_t lvl2_nnz = header->sizes[1];
+  size_t lvl3_nnz = header->sizes[2];
+  index_t *lvl1_crd = section_at(header, 0, lvl1_nnz * sizeof(index_t));
+  index_t *lvl2_pos = section_at(header, 1, (lvl2_nnz + 1) * sizeof(index_t));
+  index_t *lvl2_crd = section_at(header, 2, lvl2_nnz * sizeof(index_t));
+  index_t *lvl3_crd = section_at(header, 3, lvl3_nnz * sizeof(index_t));
+  value_t *vals = section_at(header, 4, lvl3_nnz * sizeof(value_t));
+  if (!lvl1_crd || !lvl2_pos || !lvl2_crd || !lvl3_crd || !vals) {
+    munmap(header, map_size);
+    return NULL;
+  }
+
+  struct csf *tensor = _tensor_alloc(sizeof(struct csf), false);
+  tensor->lvl1_nnz = lvl1_nnz;
+  tensor->lvl1_crd = lvl1_crd;
+  tensor->lvl2_pos = lvl2_pos;
+  tensor->lvl2_nnz = lvl2_nnz;
+  tensor->lvl2_crd = lvl2_crd;
+  tensor->lvl3_pos = NULL;
+  tensor->lvl3_nnz = lvl3_nnz;
+  tensor->lvl3_crd = lvl3_crd;
+  tensor->vals = vals;
+  tensor->slab = header;
+  tensor->slab_size = map_size;
+  tensor->mapped = true;
+  _count_tensor_alloc(map_size);
+  return tensor;
+}
+
+// ============================================================================
+// Cache directory
+// ============================================================================
+
+// dir/<name>_<tag>.bin into path (PATH_MAX bytes); false if it does not fit
+static bool cache_path(char *path, const char *dir, const char *name_fmt, ...) {
+  char name[PATH_MAX];
+  va_list args;
+  va_start(args, name_fmt);
+  int len = vsnprintf(name, sizeof(name), name_fmt, args);
+  va_end(args);
+  return len < (int)sizeof(name) &&
+         snprintf(path, PATH_MAX, "%s/%s_" CACHE_TAG_FMT ".bin", dir, name, CACHE_TAG_ARGS) < PATH_MAX;
+}
+
+// A cache that cannot be written only costs the next run a regeneration, so failures are reported and otherwise ignored
+static bool cache_dir_ready(const char *dir) {
+  if (mkdir(dir, 0777) == 0 || errno == EEXIST)
+    return true;
+  fprintf(stderr, "Warning: cannot create tensor cache %s: %s\n", dir, strerror(errno));
+  return false;
+}
+
+static bool cache_saved(const char *path, int status) {
+  if (status != 0)
+    fprintf(stderr, "Warning: cannot save %s: %s\n", path, strerror(errno));
+  return status == 0;
+}
+
+// On a miss the generated tensor is saved and mapped back, so the first run times the same backing as later ones
+
+static struct csr *cache_store_csr(const char *dir, const char *path, struct csr *tensor) {
+  struct csr *loaded = cache_dir_ready(dir) && cache_saved(path, save_tensor(tensor, path)) ? load_csr(path) : NULL;
+  if (!loaded)
+    return tensor;
+  free_tensor(tensor);
+  return loaded;
+}
+
+static struct csc *cache_store_csc(const char *dir, const char *path, struct csc *tensor) {
+  struct csc *loaded = cache_dir_ready(dir) && cache_saved(path, save_tensor(tensor, path)) ? load_csc(path) : NULL;
+  if (!loaded)
+    return tensor;
+  free_tensor(tensor);
+  return loaded;
+}
+
+static struct coo *cache_store_coo(const char *dir, const char *path, struct coo *tensor) {
+  struct coo *loaded = cache_dir_ready(dir) && cache_saved(path, save_tensor(tensor, path)) ? load_coo(path) : NULL;
+  if (!loaded)
+    return tensor;
+  free_tensor(tensor);
+  return loaded;
+}
+
+static struct dense *cache_store_dense(const char *dir, const char *path, struct dense *tensor) {
+  struct dense *loaded = cache_dir_ready(dir) && cache_saved(path, save_tensor(tensor, path)) ? load_dense(path) : NULL;
+  if (!loaded)
+    return tensor;
+  free_tensor(tensor);
+  return loaded;
+}
+
+static struct csf *cache_store_csf(const char *dir, const char *path, struct csf *tensor) {
+  struct csf *loaded = cache_dir_ready(dir) && cache_saved(path, save_tensor(tensor, path)) ? load_csf(path) : NULL;
+  if (!loaded)
+    return tensor;
+  free_tensor(tensor);
+  return loaded;
+}
+
+struct dense *cached_dense(const char *dir, size_t n, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "dense_%zu_seed%u", n, seed))
+    return generate_dense(n, seed);
+  struct dense *tensor = load_dense(path);
+  if (tensor)
+    return tensor;
+
+  return cache_store_dense(dir, path, generate_dense(n, seed));
+}
+
+struct csr *cached_csr(const char *dir, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "csr_%zux%zu_sp%g_seed%u", ndim1, ndim2, sparsity, seed))
+    return generate_csr(ndim1, ndim2, sparsity, seed);
+  struct csr *tensor = load_csr(path);
+  if (tensor)
+    return tensor;
+  return cache_store_csr(dir, path, generate_csr(ndim1, ndim2, sparsity, seed));
+}
+
+struct csc *cached_csc(const char *dir, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "csc_%zux%zu_sp%g_seed%u", ndim1, ndim2, sparsity, seed))
+    return generate_csc(ndim1, ndim2, sparsity, seed);
+  struct csc *tensor = load_csc(path);
+  if (tensor)
+    return tensor;
+  return cache_store_csc(dir, path, generate_csc(ndim1, ndim2, sparsity, seed));
+}
+
+struct coo *cached_coo(const char *dir, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "coo_%zux%zu_sp%g_seed%u", ndim1, ndim2, sparsity, seed))
+    return generate_coo(ndim1, ndim2, sparsity, seed);
+  struct coo *tensor = load_coo(path);
+  if (tensor)
+    return tensor;
+  return cache_store_coo(dir, path, generate_coo(ndim1, ndim2, sparsity, seed));
+}
+
+struct csf *cached_csf(const char *dir, size_t ndim1, size_t ndim2, size_t ndim3, double sparsity, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "csf_%zux%zux%zu_sp%g_seed%u", ndim1, ndim2, ndim3, sparsity, seed))
+    return generate_csf(ndim1, ndim2, ndim3, sparsity, seed);
+  struct csf *tensor = load_csf(path);
+  if (tensor)
+    return tensor;
+  return cache_store_csf(dir, path, generate_csf(ndim1, ndim2, ndim3, sparsity, seed));
+}
+
+struct csr *cached_csr_workload(const char *dir, enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir ||
+      !cache_path(path, dir, "csr_%s_%zux%zu_sp%g_seed%u", WORKLOAD_NAMES[workload], ndim1, ndim2, sparsity, seed))
+    return generate_csr_workload(workload, ndim1, ndim2, sparsity, seed);
+  struct csr *tensor = load_csr(path);
+  if (tensor)
+    return tensor;
+  return cache_store_csr(dir, path, generate_csr_workload(workload, ndim1, ndim2, sparsity, seed));
+}
+
+struct csc *cached_csc_workload(const char *dir, enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir ||
+      !cache_path(path, dir, "csc_%s_%zux%zu_sp%g_seed%u", WORKLOAD_NAMES[workload], ndim1, ndim2, sparsity, seed))
+    return generate_csc_workload(workload, ndim1, ndim2, sparsity, seed);
+  struct csc *tensor = load_csc(path);
+  if (tensor)
+    return tensor;
+  return cache_store_csc(dir, path, generate_csc_workload(workload, ndim1, ndim2, sparsity, seed));
+}
+
+struct coo *cached_coo_workload(const char *dir, enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir ||
+      !cache_path(path, dir, "coo_%s_%zux%zu_sp%g_seed%u", WORKLOAD_NAMES[workload], ndim1, ndim2, sparsity, seed))
+    return generate_coo_workload(workload, ndim1, ndim2, sparsity, seed);
+  struct coo *tensor = load_coo(path);
+  if (tensor)
+    return tensor;
+  return cache_store_coo(dir, path, generate_coo_workload(workload, ndim1, ndim2, sparsity, seed));
+}
+
+struct csr *cached_csr_transposed(const char *dir, enum workload workload, size_t ndim1, size_t ndim2,
+                                  double sparsity, unsigned int pattern_seed, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "csr_%s_t_%zux%zu_sp%g_seed%u_%u", WORKLOAD_NAMES[workload], ndim1, ndim2,
+                          sparsity, pattern_seed, seed))
+    return generate_csr_transposed(workload, ndim1, ndim2, sparsity, pattern_seed, seed);
+  struct csr *tensor = load_csr(path);
+  if (tensor)
+    return tensor;
+  tensor = generate_csr_transposed(workload, ndim1, ndim2, sparsity, pattern_seed, seed);
+  return cache_store_csr(dir, path, tensor);
+}
+
+struct csc *cached_csc_transposed(const char *dir, enum workload workload, size_t ndim1, size_t ndim2,
+                                  double sparsity, unsigned int pattern_seed, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "csc_%s_t_%zux%zu_sp%g_seed%u_%u", WORKLOAD_NAMES[workload], ndim1, ndim2,
+                          sparsity, pattern_seed, seed))
+    return generate_csc_transposed(workload, ndim1, ndim2, sparsity, pattern_seed, seed);
+  struct csc *tensor = load_csc(path);
+  if (tensor)
+    return tensor;
+  tensor = generate_csc_transposed(workload, ndim1, ndim2, sparsity, pattern_seed, seed);
+  return cache_store_csc(dir, path, tensor);
+}
+
+struct coo *cached_coo_transposed(const char *dir, enum workload workload, size_t ndim1, size_t ndim2,
+                                  double sparsity, unsigned int pattern_seed, unsigned int seed) {
+  char path[PATH_MAX];
+  if (!dir || !cache_path(path, dir, "coo_%s_t_%zux%zu_sp%g_seed%u_%u", WORKLOAD_NAMES[workload], ndim1, ndim2,
+                          sparsity, pattern_seed, seed))
+    return generate_coo_transposed(workload, ndim1, ndim2, sparsity, pattern_seed, seed);
+  struct coo *tensor = load_coo(path);
+  if (tensor)
+    return tensor;
+  tensor = generate_coo_transposed(workload, ndim1, ndim2, sparsity, pattern_seed, seed);
+  return cache_store_coo(dir, path, tensor);
+}
+
+// ============================================================================
+// Matrix Market
+// ============================================================================
+
+enum mtx_symmetry { MTX_GENERAL, MTX_SYMMETRIC, MTX_SKEW_SYMMETRIC };
+
+struct mtx_header {
+  size_t nrows, ncols, nnz; // size line: entry lines in the file, before symmetric expansion
+  bool pattern;             // no value column
+  enum mtx_symmetry symmetry;
+};
+
+// Entry lines per parallel chunk are balanced by bytes; files below this size are parsed as one chunk
+#define MTX_MIN_CHUNK_BYTES ((size_t)1 << 16)
+
+// Significant digits that round-trip value_t through text
+#define MTX_VALUE_DIGITS (sizeof(value_t) == sizeof(float) ? 9 : 17)
+
+static inline const char *skip_blanks(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    ++p;
+  return p;
+}
+
+static inline const char *line_end(const char *p, const char *end) {
+  if (p >= end)
+    return end;
+  const char *newline = memchr(p, '\n', (size_t)(end - p));
+  return newline ? newline : end;
+}
+
+// Blank lines and % comments carry no entry
+static inline bool is_entry_line(const char *p, const char *end) {
+  p = skip_blanks(p, end);
+  return p < end && *p != '%' && *p != '\n';
+}
+
+// Copy the next whitespace-delimited token of [*p, end) into buf (NUL-terminated) and advance *p past it
+static bool next_token(const char **p, const char *end, char *buf, size_t len) {
+  const char *start = skip_blanks(*p, end);
+  const char *q = start;
+  while (q < end && *q != ' ' && *q != '\t' && *q != '\r' && *q != '\n')
+    ++q;
+  if (q == start || (size_t)(q - start) >= len)
+    return false;
+  memcpy(buf, start, q - start);
+  buf[q - start] = '\0';
+  *p = q;
+  return true;
+}
+
+static bool parse_size(const char **p, const char *end, size_t *out) {
+  const char *q = skip_blanks(*p, end);
+  if (q == end || *q < '0' || *q > '9')
+    return false;
+  size_t value = 0;
+  for (; q < end && *q >= '0' && *q <= '9'; ++q)
+    value = value * 10 + (*q - '0');
+  *p = q;
+  *out = value;
+  return true;
+}
+
+static bool parse_real(const char **p, const char *end, double *out) {
+  char buf[64];
+  char *parsed;
+  if (!next_token(p, end, buf, sizeof(buf)))
+    return false;
+  *out = strtod(buf, &parsed);
+  return *parsed == '\0';
+}
+
+// Parse the banner, comments and size line; returns the first byte after the size line, or NULL
+static const char *parse_mtx_header(const char *p, const char *end, struct mtx_header *header, const char *path) {
+  char object[32], format[32], field[32], symmetry[32];
+  const char *eol = line_end(p, end);
+  if (!next_token(&p, eol, object, sizeof(object)) || strcmp(object, "%%MatrixMarket") != 0 ||
+      !next_token(&p, eol, object, sizeof(object)) || !next_token(&p, eol, format, sizeof(format)) ||
+      !next_token(&p, eol, field, sizeof(field)) || !next_token(&p, eol, symmetry, sizeof(symmetry))) {
+    fprintf(stderr, "%s: missing %%%%MatrixMarket banner\n", path);
+    return NULL;
+  }
+  if (strcasecmp(object, "matrix") != 0 || strcasecmp(format, "coordinate") != 0) {
+    fprintf(stderr, "%s: only coordinate matrices are supported (got %s %s)\n", path, object, format);
+    return NULL;
+  }
+  header->pattern = strcasecmp(field, "pattern") == 0;
+  if (!header->pattern && strcasecmp(field, "real") != 0 && strcasecmp(field, "double") != 0 &&
+      strcasecmp(field, "integer") != 0) {
+    fprintf(stderr, "%s: unsupported field %s\n", path, field);
+    return NULL;
+  }
+  if (strcasecmp(symmetry, "general") == 0) {
+    header->symmetry = MTX_GENERAL;
+  } else if (strcasecmp(symmetry, "symmetric") == 0) {
+    header->symmetry = MTX_SYMMETRIC;
+  } else if (strcasecmp(symmetry, "skew-symmetric") == 0) {
+    header->symmetry = MTX_SKEW_SYMMETRIC;
+  } else {
+    fprintf(stderr, "%s: unsupported symmetry %s\n", path, symmetry);
+    return NULL;
+  }
+
+  // Comments run up to the size line
+  p = eol < end ? eol + 1 : end;
+  while (p < end && !is_entry_line(p, end)) {
+    eol = line_end(p, end);
+    p = eol < end ? eol + 1 : end;
+  }
+  eol = line_end(p, end);
+  if (!parse_size(&p, eol, &header->nrows) || !parse_size(&p, eol, &header->ncols) ||
+      !parse_size(&p, eol, &header->nnz)) {
+    fprintf(stderr, "%s: missing size line\n", path);
+    return NULL;
+  }
+  if (header->nrows > INDEX_MAX || header->ncols > INDEX_MAX) {
+    fprintf(stderr, "%s: %zu x %zu does not fit INDEX_BITS=%d\n", path, header->nrows, header->ncols, INDEX_BITS);
+    return NULL;
+  }
+  // Positions count the entries of both triangles of symmetric files (see coo_to_csr)
+  size_t expand = header->symmetry == MTX_GENERAL ? 1 : 2;
+  if (header->nnz > INDEX_MAX / expand) {
+    fprintf(stderr, "%s: %zu entries do not fit INDEX_BITS=%d\n", path, header->nnz, INDEX_BITS);
+    return NULL;
+  }
+  return eol < end ? eol + 1 : end;
+}
+
+static size_t count_entry_lines(const char *p, const char *end) {
+  size_t count = 0;
+  while (p < end) {
+    const char *eol = line_end(p, end);
+    count += is_entry_line(p, eol);
+    p = eol < end ? eol + 1 : end;
+  }
+  return count;
+}
+
+// Parse the entry lines of [p, end) into tensor from position pos on; *emitted counts the entries written
+static bool parse_mtx_entries(const char *p, const char *end, const struct mtx_header *header, struct coo *tensor,
+                              size_t pos, size_t *emitted) {
+  size_t start = pos;
+  while (p < end) {
+    const char *eol = line_end(p, end);
+    if (is_entry_line(p, eol)) {
+      size_t row, col;
+      double val = 1.0;
+      if (!parse_size(&p, eol, &row) || !parse_size(&p, eol, &col) || row < 1 || row > header->nrows || col < 1 ||
+          col > header->ncols || (!header->pattern && !parse_real(&p, eol, &val)))
+        return false;
+
+      tensor->lvl1_crd[pos] = row - 1;
+      tensor->lvl2_crd[pos] = col - 1;
+      tensor->vals[pos] = (value_t)val;
+      ++pos;
+      if (header->symmetry != MTX_GENERAL && row != col) {
+        tensor->lvl1_crd[pos] = col - 1;
+        tensor->lvl2_crd[pos] = row - 1;
+        tensor->vals[pos] = (value_t)(header->symmetry == MTX_SKEW_SYMMETRIC ? -val : val);
+        ++pos;
+      }
+    }
+    p = eol < end ? eol + 1 : end;
+  }
+  *emitted = pos - start;
+  return true;
+}
+
+struct coo *read_mtx(const char *path, size_t *nrows, size_t *ncols) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+    fprintf(stderr, "%s: %s\n", path, fd < 0 ? strerror(errno) : "empty file");
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  size_t size = st.st_size;
+  const char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+  const char *end = base + size;
+
+  struct mtx_header header;
+  const char *data = parse_mtx_header(base, end, &header, path);
+  if (!data) {
+    munmap((void *)base, size);
+    return NULL;
+  }
+
+  // Chunk boundaries move forward to the next line start, so every line belongs to exactly one chunk
+  size_t num_chunks = 1;
+#if defined(_OPENMP)
+  num_chunks = 4 * (size_t)omp_get_max_threads();
+#endif
+  if ((size_t)(end - data) < num_chunks * MTX_MIN_CHUNK_BYTES)
+    num_chunks = (end - data) / MTX_MIN_CHUNK_BYTES + 1;
+  const char **chunk = _tensor_alloc((num_chunks + 1) * sizeof(*chunk), false);
+  size_t *lines = _tensor_alloc((num_chunks + 1) * sizeof(size_t), true);
+  size_t *emitted = _tensor_alloc(num_chunks * sizeof(size_t), true);
+  chunk[0] = data;
+  chunk[num_chunks] = end;
+  for (size_t c = 1; c < num_chunks; ++c) {
+    const char *p = data + (end - data) * c / num_chunks;
+    if (p < chunk[c - 1])
+      p = chunk[c - 1];
+    if (p > data && p[-1] != '\n') {
+      p = line_end(p, end);
+      p = p < end ? p + 1 : end;
+    }
+    chunk[c] = p;
+  }
+
+  // Pass 1: entry lines per chunk, prefix-summed into each chunk's first line
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (size_t c = 0; c < num_chunks; ++c)
+    lines[c + 1] = count_entry_lines(chunk[c], chunk[c + 1]);
+  for (size_t c = 0; c < num_chunks; ++c)
+    lines[c + 1] += lines[c];
+
+  struct coo *tensor = NULL;
+  if (lines[num_chunks] != header.nnz) {
+    fprintf(stderr, "%s: size line announces %zu entries, found %zu\n", path, header.nnz, lines[num_chunks]);
+    goto done;
+  }
+
+  // Pass 2: parse each chunk into its own range (room for both triangles), then close the gaps
+  size_t expand = header.symmetry == MTX_GENERAL ? 1 : 2;
+  tensor = allocate_coo(expand * header.nnz);
+  bool failed = false;
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1) reduction(|| : failed)
+#endif
+  for (size_t c = 0; c < num_chunks; ++c)
+    failed = !parse_mtx_entries(chunk[c], chunk[c + 1], &header, tensor, expand * lines[c], &emitted[c]) || failed;
+  if (failed) {
+    fprintf(stderr, "%s: malformed or out-of-range entry\n", path);
+    free_tensor(tensor);
+    tensor = NULL;
+    goto done;
+  }
+
+  size_t nnz = 0;
+  for (size_t c = 0; c < num_chunks; ++c) {
+    size_t from = expand * lines[c];
+    if (from != nnz) {
+      memmove(tensor->lvl1_crd + nnz, tensor->lvl1_crd + from, emitted[c] * sizeof(index_t));
+      memmove(tensor->lvl2_crd + nnz, tensor->lvl2_crd + from, emitted[c] * sizeof(index_t));
+      memmove(tensor->vals + nnz, tensor->vals + from, emitted[c] * sizeof(value_t));
+    }
+    nnz += emitted[c];
+  }
+  tensor->lvl1_nnz = nnz;
+  *nrows = header.nrows;
+  *ncols = header.ncols;
+
+done:
+  free(chunk);
+  free(lines);
+  free(emitted);
+  munmap((void *)base, size);
+  return tensor;
+}
+
+// Longest formatted entry line: two 20-digit coordinates, a value and separators
+#define MTX_LINE_MAX 96
+
+// Format the entries in parallel chunks and write them in order behind the banner and size line. Chunks go in rounds
+// of one per thread, each formatted into that round's buffer slot, so the buffers stay at threads x chunk whatever nnz.
+static int write_mtx_entries(const char *path, size_t nrows, size_t ncols, size_t nnz, const index_t *rows,
+                             const index_t *cols, const value_t *vals) {
+  char tmp_path[PATH_MAX];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(tmp_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  FILE *file = fopen(tmp_path, "w");
+  if (!file)
+    return -1;
+  bool ok = fprintf(file, "%%%%MatrixMarket matrix coordinate real general\n%zu %zu %zu\n", nrows, ncols, nnz) > 0;
+
+  const size_t chunk_entries = 1 << 16;
+  size_t num_chunks = (nnz + chunk_entries - 1) / chunk_entries;
+  size_t slots = 1;
+#if defined(_OPENMP)
+  slots = (size_t)omp_get_max_threads();
+#endif
+  if (slots > num_chunks)
+    slots = num_chunks ? num_chunks : 1;
+  char *buffer = _tensor_alloc(slots * chunk_entries * MTX_LINE_MAX + 1, false);
+  size_t *length = _tensor_alloc(slots * sizeof(size_t), false);
+  for (size_t round = 0; ok && round < num_chunks; round += slots) {
+    size_t round_chunks = round + slots < num_chunks ? slots : num_chunks - round;
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (size_t slot = 0; slot < round_chunks; ++slot) {
+      char *out = buffer + slot * chunk_entries * MTX_LINE_MAX;
+      size_t len = 0;
+      size_t start = (round + slot) * chunk_entries;
+      size_t stop = start + chunk_entries < nnz ? start + chunk_entries : nnz;
+      for (size_t k = start; k < stop; ++k)
+        len += snprintf(out + len, MTX_LINE_MAX, "%zu %zu %.*g\n", (size_t)rows[k] + 1, (size_t)cols[k] + 1,
+                        (int)MTX_VALUE_DIGITS, (double)vals[k]);
+      length[slot] = len;
+    }
+    for (size_t slot = 0; ok && slot < round_chunks; ++slot)
+      ok = fwrite(buffer + slot * chunk_entries * MTX_LINE_MAX, 1, length[slot], file) == length[slot];
+  }
+  free(buffer);
+  free(length);
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    int err = errno;
+    unlink(tmp_path);
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+// Slice coordinate of every entry of a compressed tensor
+static index_t *expand_pos(const index_t *pos, size_t num_slices, size_t nnz) {
+  index_t *slice = _tensor_alloc(nnz * sizeof(index_t), false);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (size_t s = 0; s < num_slices; ++s)
+    for (size_t k = pos[s]; k < pos[s + 1]; ++k)
+      slice[k] = s;
+  return slice;
+}
+
+int _write_mtx_csr(const struct csr *tensor, size_t nrows, size_t ncols, const char *path) {
+  index_t *rows = expand_pos(tensor->lvl2_pos, tensor->lvl1_size, tensor->lvl2_nnz);
+  int status = write_mtx_entries(path, nrows, ncols, tensor->lvl2_nnz, rows, tensor->lvl2_crd, tensor->vals);
+  free(rows);
+  return status;
+}
+
+int _write_mtx_csc(const struct csc *tensor, size_t nrows, size_t ncols, const char *path) {
+  index_t *cols = expand_pos(tensor->lvl2_pos, tensor->lvl1_size, tensor->lvl2_nnz);
+  int status = write_mtx_entries(path, nrows, ncols, tensor->lvl2_nnz, tensor->lvl2_crd, cols, tensor->vals);
+  free(cols);
+  return status;
+}
+
+int _write_mtx_coo(const struct coo *tensor, size_t nrows, size_t ncols, const char *path) {
+  return write_mtx_entries(path, nrows, ncols, tensor->lvl1_nnz, tensor->lvl1_crd, tensor->lvl2_crd, tensor->vals);
+}
+
+// ============================================================================
+// COO conversion
+// ============================================================================
+
+// Counting sort of the entries into num_slices slices keyed by key[] (rows for CSR, columns for CSC): atomic
+// histogram, prefix sum into pos, atomic scatter. The order within a slice depends on the schedule until the caller
+// sorts the slices.
+static void compress_entries(size_t nnz, const index_t *key, const index_t *other, const value_t *vals,
+                             size_t num_slices, index_t *pos, index_t *crd, value_t *out_vals) {
+  memset(pos, 0, (num_slices + 1) * sizeof(index_t));
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+  for (size_t k = 0; k < nnz; ++k) {
+#if defined(_OPENMP)
+#pragma omp atomic
+#endif
+    ++pos[key[k] + 1];
+  }
+  for (size_t s = 0; s < num_slices; ++s)
+    pos[s + 1] += pos[s];
+
+  index_t *cursor = _tensor_alloc(num_slices * sizeof(index_t), false);
+  memcpy(cursor, pos, num_slices * sizeof(index_t));
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+  for (size_t k = 0; k < nnz; ++k) {
+    index_t dst;
+#if defined(_OPENMP)
+#pragma omp atomic capture
+#endif
+    dst = cursor[key[k]]++;
+    crd[dst] = other[k];
+    out_vals[dst] = vals[k];
+  }
+  free(cursor);
+}
+
+struct csr *coo_to_csr(const struct coo *coo, size_t nrows, size_t ncols) {
+  (void)ncols;
+  struct csr *tensor = allocate_csr(nrows, 0);
+  reserve_tensor(tensor, coo->lvl1_nnz);
+  tensor->lvl2_nnz = coo->lvl1_nnz;
+  compress_entries(coo->lvl1_nnz, coo->lvl1_crd, coo->lvl2_crd, coo->vals, nrows, tensor->lvl2_pos,
+                   tensor->lvl2_crd, tensor->vals);
+  sort_tensor(tensor);
+  return tensor;
+}
+
+struct csc *coo_to_csc(const struct coo *coo, size_t nrows, size_t ncols) {
+  (void)nrows;
+  struct csc *tensor = allocate_csc(ncols, 0);
+  reserve_tensor(tensor, coo->lvl1_nnz);
+  tensor->lvl2_nnz = coo->lvl1_nnz;
+  compress_entries(coo->lvl1_nnz, coo->lvl2_crd, coo->lvl1_crd, coo->vals, ncols, tensor->lvl2_pos,
+                   tensor->lvl2_crd, tensor->vals);
+  sort_tensor(tensor);
+  return tensor;
+}
+
+struct coo *coo_to_coo(const struct coo *coo, size_t nrows, size_t ncols) {
+  (void)nrows;
+  (void)ncols;
+  struct coo *tensor = allocate_coo(coo->lvl1_nnz);
+  memcpy(tensor->lvl1_crd, coo->lvl1_crd, coo->lvl1_nnz * sizeof(index_t));
+  memcpy(tensor->lvl2_crd, coo->lvl2_crd, coo->lvl1_nnz * sizeof(index_t));
+  memcpy(tensor->vals, coo->vals, coo->lvl1_nnz * sizeof(value_t));
+  return tensor;
+}
+
+// Expand the slices of a CSR or CSC matrix into row-major (CSR) or column-major (CSC) COO entries
+static void expand_slices(size_t num_slices, const index_t *pos, const index_t *crd, const value_t *vals,
+                          index_t *slice_crd, index_t *other_crd, value_t *out_vals) {
+  memcpy(other_crd, crd, pos[num_slices] * sizeof(index_t));
+  memcpy(out_vals, vals, pos[num_slices] * sizeof(value_t));
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (size_t s = 0; s < num_slices; ++s)
+    for (size_t k = pos[s]; k < pos[s + 1]; ++k)
+      slice_crd[k] = s;
+}
+
+struct coo *csr_to_coo(const struct csr *csr) {
+  struct coo *tensor = allocate_coo(csr->lvl2_nnz);
+  expand_slices(csr->lvl1_size, csr->lvl2_pos, csr->lvl2_crd, csr->vals, tensor->lvl1_crd, tensor->lvl2_crd,
+                tensor->vals);
+  return tensor;
+}
+
+struct coo *csc_to_coo(const struct csc *csc) {
+  struct coo *tensor = allocate_coo(csc->lvl2_nnz);
+  expand_slices(csc->lvl1_size, csc->lvl2_pos, csc->lvl2_crd, csc->vals, tensor->lvl2_crd, tensor->lvl1_crd,
+                tensor->vals);
+  return tensor;
+}
@@ -0,0 +1,110 @@
+#ifndef TENSOR_IO_H
+#define TENSOR_IO_H
+
+#include "tensor_formats.h"
+#include <stdint.h>
+
+// Binary tensor file: a fixed header followed by the tensor's arrays, each starting on a TENSOR_FILE_ALIGN byte
+// boundary. Loading maps the file privately and points the struct's arrays into the mapping, so a load costs no copy
+// and no parsing; pages written later (sort_tensor, reset_tensor) are copied on write and never reach the file.
+// Loaded tensors are inputs: they can be sorted, indexed and reset, but not reserved or grown.
+#define TENSOR_FILE_MAGIC "UNZIPTNS"
+#define TENSOR_FILE_VERSION 1
+#define TENSOR_FILE_ALIGN 64
+#define TENSOR_FILE_SECTIONS 5
+
+enum tensor_file_format {
+  TENSOR_FILE_DENSE = 1,
+  TENSOR_FILE_CSR = 2,
+  TENSOR_FILE_CSC = 3,
+  TENSOR_FILE_COO = 4,
+  TENSOR_FILE_CSF = 5,
+};
+
+#define TENSOR_FILE_SORTED 1 // flags: lvl2_crd ascending within each slice (CSR/CSC)
+
+struct tensor_file_header {
+  char magic[8];        // TENSOR_FILE_MAGIC, not NUL-terminated
+  uint32_t version;     // TENSOR_FILE_VERSION
+  uint32_t format;      // enum tensor_file_format
+  uint32_t index_bytes; // sizeof(index_t) of the writer, must match the reader
+  uint32_t value_bytes; // sizeof(value_t) of the writer, must match the reader
+  uint64_t sizes[4];    // lvl*_size / lvl*_nnz of the format, in struct order
+  uint64_t flags;       // TENSOR_FILE_* flags
+
+  // Arrays in struct order; offsets count from the start of the file
+  uint64_t offset[TENSOR_FILE_SECTIONS];
+  uint64_t bytes[TENSOR_FILE_SECTIONS];
+};
+
+// Write a tensor to path, replacing it atomically; returns 0 on success and -1 (with errno set) on failure
+#define save_tensor(T, path)                                                                                           \
+  _Generic((T),                                                                                                        \
+      struct dense *: _save_dense,                                                                                     \
+      struct csr *: _save_csr,                                                                                         \
+      struct csc *: _save_csc,                                                                                         \
+      struct coo *: _save_coo,                                                                                         \
+      struct csf *: _save_csf)(T, path)
+
+int _save_dense(const struct dense *tensor, const char *path);
+int _save_csr(const struct csr *tensor, const char *path);
+int _save_csc(const struct csc *tensor, const char *path);
+int _save_coo(const struct coo *tensor, const char *path);
+int _save_csf(const struct csf *tensor, const char *path);
+
+// Map a tensor written by save_tensor; NULL if the file is missing, truncated, of another format or written with
+// another INDEX_BITS / value type
+struct dense *load_dense(const char *path);
+struct csr *load_csr(const char *path);
+struct csc *load_csc(const char *path);
+struct coo *load_coo(const char *path);
+struct csf *load_csf(const char *path);
+
+// generate_* backed by a cache directory: load the tensor if an earlier run saved it, otherwise generate and save it.
+// A NULL dir generates without caching.
+struct dense *cached_dense(const char *dir, size_t n, unsigned int seed);
+struct csr *cached_csr(const char *dir, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed);
+struct csc *cached_csc(const char *dir, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed);
+struct coo *cached_coo(const char *dir, size_t ndim1, size_t ndim2, double sparsity, unsigned int seed);
+struct csf *cached_csf(const char *dir, size_t ndim1, size_t ndim2, size_t ndim3, double sparsity, unsigned int seed);
+struct csr *cached_csr_workload(const char *dir, enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                unsigned int seed);
+struct csc *cached_csc_workload(const char *dir, enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                unsigned int seed);
+struct coo *cached_coo_workload(const char *dir, enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                unsigned int seed);
+struct csr *cached_csr_transposed(const char *dir, enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int pattern_seed, unsigned int seed);
+struct csc *cached_csc_transposed(const char *dir, enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int pattern_seed, unsigned int seed);
+struct coo *cached_coo_transposed(const char *dir, enum workload workload, size_t ndim1, size_t ndim2, double sparsity,
+                                  unsigned int pattern_seed, unsigned int seed);
+
+// Matrix Market (.mtx) coordinate files. The reader maps the file, splits the entry lines into chunks and parses
+// them in parallel into COO with 0-based coordinates; pattern files get value 1, symmetric and skew-symmetric files
+// are expanded to both triangles. Returns NULL (after reporting why on stderr) for unsupported or malformed files.
+struct coo *read_mtx(const char *path, size_t *nrows, size_t *ncols);
+
+// Write a matrix as a "coordinate real general" .mtx file, formatting the entry lines in parallel; returns 0 on
+// success and -1 (with errno set) on failure
+#define write_mtx(T, nrows, ncols, path)                                                                               \
+  _Generic((T),                                                                                                        \
+      struct csr *: _write_mtx_csr,                                                                                    \
+      struct csc *: _write_mtx_csc,                                                                                    \
+      struct coo *: _write_mtx_coo)(T, nrows, ncols, path)
+
+int _write_mtx_csr(const struct csr *tensor, size_t nrows, size_t ncols, const char *path);
+int _write_mtx_csc(const struct csc *tensor, size_t nrows, size_t ncols, const char *path);
+int _write_mtx_coo(const struct coo *tensor, size_t nrows, size_t ncols, const char *path);
+
+// Build an nrows x ncols matrix in another format from COO entries in any order. CSR and CSC come out sorted (a
+// parallel counting sort by slice, then sort_tensor); the COO conversion is a copy. Duplicates are kept.
+struct csr *coo_to_csr(const struct coo *coo, size_t nrows, size_t ncols);
+struct csc *coo_to_csc(const struct coo *coo, size_t nrows, size_t ncols);
+struct coo *coo_to_coo(const struct coo *coo, size_t nrows, size_t ncols);
+
+// The entries of a CSR (CSC) matrix as COO, in row-major (column-major) order
+struct coo *csr_to_coo(const struct csr *csr);
+struct coo *csc_to_coo(const struct csc *csc);
+
+#endif /* TENSOR_IO_H */
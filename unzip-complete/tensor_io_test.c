@@ -0,0 +1,246 @@
+#include "tensor_io.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Writes generated tensors with save_tensor (directly and through the cached_* cache) and write_mtx, reads them back
+// with load_* and read_mtx and compares them with the originals. The
+// kernel tests build their inputs in memory, so a fault of the file layer shows up here rather than as a kernel's.
+
+#define NDIM1 37
+#define NDIM2 29
+
+// The file every round trip writes and maps back. save_tensor replaces it atomically, so earlier mappings keep the
+// tensors they were loaded from.
+static char path[] = "/tmp/tensor_io_test_XXXXXX";
+
+// Save T to path and map it back with load (load_csr, ...); NULL if either fails
+#define save_and_load(T, load) (save_tensor(T, path) == 0 ? load(path) : NULL)
+
+// Write T to path as Matrix Market and read its entries back; NULL if either fails or the size line differs
+#define write_and_read(T, nrows, ncols) (write_mtx(T, nrows, ncols, path) == 0 ? reread(nrows, ncols) : NULL)
+
+static struct coo *reread(size_t nrows, size_t ncols) {
+  size_t read_nrows, read_ncols;
+  struct coo *coo = read_mtx(path, &read_nrows, &read_ncols);
+  if (coo && (read_nrows != nrows || read_ncols != ncols)) {
+    free_tensor(coo);
+    return NULL;
+  }
+  return coo;
+}
+
+static int same_arrays(const void *a, const void *b, size_t bytes) { return memcmp(a, b, bytes) == 0; }
+
+// CSR and CSC: the same slices, coordinates and values
+static int same_compressed(size_t lvl1_size, const index_t *pos, const index_t *crd, const value_t *vals,
+                           size_t lvl1_size2, const index_t *pos2, const index_t *crd2, const value_t *vals2) {
+  size_t nnz = pos[lvl1_size];
+  return lvl1_size == lvl1_size2 && same_arrays(pos, pos2, (lvl1_size + 1) * sizeof(index_t)) &&
+         same_arrays(crd, crd2, nnz * sizeof(index_t)) && same_arrays(vals, vals2, nnz * sizeof(value_t));
+}
+
+static int same_csr(const struct csr *a, const struct csr *b) {
+  return a->lvl2_nnz == b->lvl2_nnz && a->sorted == b->sorted &&
+         same_compressed(a->lvl1_size, a->lvl2_pos, a->lvl2_crd, a->vals, b->lvl1_size, b->lvl2_pos, b->lvl2_crd,
+                         b->vals);
+}
+
+static int same_csc(const struct csc *a, const struct csc *b) {
+  return a->lvl2_nnz == b->lvl2_nnz && a->sorted == b->sorted &&
+         same_compressed(a->lvl1_size, a->lvl2_pos, a->lvl2_crd, a->vals, b->lvl1_size, b->lvl2_pos, b->lvl2_crd,
+                         b->vals);
+}
+
+static int same_coo(const struct coo *a, const struct coo *b) {
+  return a->lvl1_nnz == b->lvl1_nnz && same_arrays(a->lvl1_crd, b->lvl1_crd, a->lvl1_nnz * sizeof(index_t)) &&
+         same_arrays(a->lvl2_crd, b->lvl2_crd, a->lvl1_nnz * sizeof(index_t)) &&
+         same_arrays(a->vals, b->vals, a->lvl1_nnz * sizeof(value_t));
+}
+
+static int same_csf(const struct csf *a, const struct csf *b) {
+  return a->lvl1_nnz == b->lvl1_nnz && a->lvl2_nnz == b->lvl2_nnz && a->lvl3_nnz == b->lvl3_nnz &&
+         same_arrays(a->lvl1_crd, b->lvl1_crd, a->lvl1_nnz * sizeof(index_t)) &&
+         same_arrays(a->lvl2_pos, b->lvl2_pos, (a->lvl2_nnz + 1) * sizeof(index_t)) &&
+         same_arrays(a->lvl2_crd, b->lvl2_crd, a->lvl2_nnz * sizeof(index_t)) &&
+         same_arrays(a->lvl3_crd, b->lvl3_crd, a->lvl3_nnz * sizeof(index_t)) &&
+         same_arrays(a->vals, b->vals, a->lvl3_nnz * sizeof(value_t));
+}
+
+static int same_dense(const struct dense *a, const struct dense *b) {
+  return a->lvl1_size == b->lvl1_size && same_arrays(a->vals, b->vals, a->lvl1_size * sizeof(value_t));
+}
+
+// Every format survives save_tensor and load_*, mapped rather than copied
+static int verify_save_load(void) {
+  struct dense *dense = generate_dense(NDIM1, 1);
+  struct csr *csr = generate_csr(NDIM1, NDIM2, 0.3, 2);
+  struct csc *csc = generate_csc(NDIM1, NDIM2, 0.3, 3);
+  struct coo *coo = generate_coo(NDIM1, NDIM2, 0.3, 4);
+  struct csf *csf = generate_csf(9, 8, 7, 0.5, 5);
+  csc->sorted = false; // the flag is stored, not recomputed
+
+  struct dense *dense2 = save_and_load(dense, load_dense);
+  struct csr *csr2 = save_and_load(csr, load_csr);
+  struct csc *csc2 = save_and_load(csc, load_csc);
+  struct coo *coo2 = save_and_load(coo, load_coo);
+  struct csf *csf2 = save_and_load(csf, load_csf);
+
+  int passed = dense2 && dense2->mapped && same_dense(dense, dense2);
+  passed &= csr2 && csr2->mapped && same_csr(csr, csr2);
+  passed &= csc2 && csc2->mapped && same_csc(csc, csc2);
+  passed &= coo2 && coo2->mapped && same_coo(coo, coo2);
+  passed &= csf2 && csf2->mapped && same_csf(csf, csf2);
+  printf("  %s save/load: dense, csr, csc, coo and csf round trip\n", passed ? "PASS" : "FAIL");
+
+  free_tensor(dense);
+  free_tensor(csr);
+  free_tensor(csc);
+  free_tensor(coo);
+  free_tensor(csf);
+  if (dense2)
+    free_tensor(dense2);
+  if (csr2)
+    free_tensor(csr2);
+  if (csc2)
+    free_tensor(csc2);
+  if (coo2)
+    free_tensor(coo2);
+  if (csf2)
+    free_tensor(csf2);
+
+  // The last file written holds the CSF tensor, unmapped by now
+  int rejected = !load_csr(path) && !load_coo(path) && !load_dense(path);
+  rejected &= truncate(path, sizeof(struct tensor_file_header) + 8) == 0 && !load_csf(path);
+  printf("  %s save/load: files of another format or truncated are rejected\n", rejected ? "PASS" : "FAIL");
+  return passed && rejected;
+}
+
+// The cached_* generators save on a miss and map on a hit, returning what generate_* does either way
+static int verify_cache(void) {
+  char dir[] = "/tmp/tensor_io_cache_XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 0;
+  }
+
+  struct dense *dense = generate_dense(NDIM1, 6);
+  struct csr *csr = generate_csr(NDIM1, NDIM2, 0.3, 7);
+  struct csf *csf = generate_csf(9, 8, 7, 0.5, 8);
+  int passed = 1;
+  for (int run = 0; run < 2; ++run) {
+    struct dense *dense2 = cached_dense(dir, NDIM1, 6);
+    struct csr *csr2 = cached_csr(dir, NDIM1, NDIM2, 0.3, 7);
+    struct csf *csf2 = cached_csf(dir, 9, 8, 7, 0.5, 8);
+    passed &= dense2->mapped && same_dense(dense, dense2) && csr2->mapped && same_csr(csr, csr2) && csf2->mapped &&
+              same_csf(csf, csf2);
+    free_tensor(dense2);
+    free_tensor(csr2);
+    free_tensor(csf2);
+  }
+  free_tensor(dense);
+  free_tensor(csr);
+  free_tensor(csf);
+
+  size_t files = 0;
+  DIR *entries = opendir(dir);
+  for (struct dirent *entry; entries && (entry = readdir(entries));) {
+    char file[sizeof(dir) + 256];
+    if (entry->d_name[0] != '.' && snprintf(file, sizeof(file), "%s/%s", dir, entry->d_name) < (int)sizeof(file))
+      files += unlink(file) == 0;
+  }
+  if (entries)
+    closedir(entries);
+  rmdir(dir);
+  passed &= files == 3;
+
+  printf("  %s cache: dense, csr and csf generated, saved once and mapped back\n", passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+// Replace path with a hand-written .mtx file
+static int write_text(const char *text) {
+  FILE *file = fopen(path, "w");
+  if (!file)
+    return 0;
+  int written = fputs(text, file) >= 0;
+  return fclose(file) == 0 && written;
+}
+
+// The Matrix Market writers and reader round trip every format exactly, and the reader expands symmetric pattern files
+// and rejects malformed ones
+static int verify_mtx(void) {
+  struct csr *csr = generate_csr(NDIM1, NDIM2, 0.3, 9);
+  struct csc *csc = generate_csc(NDIM1, NDIM2, 0.3, 10);
+  struct coo *coo = generate_coo(NDIM1, NDIM2, 0.3, 11);
+
+  // write_mtx(csc) writes column by column, so the entries come back in CSC order
+  struct coo *csr_entries = write_and_read(csr, NDIM1, NDIM2);
+  struct coo *csc_entries = write_and_read(csc, NDIM1, NDIM2);
+  struct coo *coo_entries = write_and_read(coo, NDIM1, NDIM2);
+  struct csr *csr2 = csr_entries ? coo_to_csr(csr_entries, NDIM1, NDIM2) : NULL;
+  struct csc *csc2 = csc_entries ? coo_to_csc(csc_entries, NDIM1, NDIM2) : NULL;
+
+  int passed = csr2 && same_csr(csr, csr2) && csc2 && same_csc(csc, csc2) && coo_entries && same_coo(coo, coo_entries);
+  printf("  %s mtx: csr, csc and coo round trip through write_mtx and read_mtx\n", passed ? "PASS" : "FAIL");
+
+  // (2,1) mirrored to (1,2), (3,3) on the diagonal kept once; values 1
+  int expanded = write_text("%%MatrixMarket matrix coordinate pattern symmetric\n% comment\n3 3 2\n2 1\n3 3\n");
+  size_t nrows, ncols;
+  struct coo *symmetric = expanded ? read_mtx(path, &nrows, &ncols) : NULL;
+  struct csr *symmetric_csr = symmetric ? coo_to_csr(symmetric, 3, 3) : NULL;
+  expanded &= symmetric_csr && nrows == 3 && ncols == 3 && symmetric_csr->lvl2_nnz == 3 &&
+              symmetric_csr->lvl2_pos[1] == 1 && symmetric_csr->lvl2_crd[0] == 1 && symmetric_csr->lvl2_pos[2] == 2 &&
+              symmetric_csr->lvl2_crd[1] == 0 && symmetric_csr->lvl2_crd[2] == 2 && symmetric_csr->vals[0] == 1 &&
+              symmetric_csr->vals[1] == 1 && symmetric_csr->vals[2] == 1;
+  int rejected = write_text("%%MatrixMarket matrix coordinate real general\n3 3 1\n4 1 2.5\n") &&
+                 !read_mtx(path, &nrows, &ncols);
+  printf("  %s mtx: symmetric pattern files expanded, out-of-range entries rejected\n",
+         expanded && rejected ? "PASS" : "FAIL");
+
+  free_tensor(csr);
+  free_tensor(csc);
+  free_tensor(coo);
+  struct coo *read[] = {csr_entries, csc_entries, coo_entries, symmetric};
+  for (size_t r = 0; r < sizeof(read) / sizeof(read[0]); ++r)
+    if (read[r])
+      free_tensor(read[r]);
+  if (csr2)
+    free_tensor(csr2);
+  if (csc2)
+    free_tensor(csc2);
+  if (symmetric_csr)
+    free_tensor(symmetric_csr);
+  return passed && expanded && rejected;
+}
+
+int main() {
+  int passed = 1;
+
+  printf("Running Tensor I/O Test\n");
+  printf("=======================\n");
+
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  passed &= verify_save_load();
+  passed &= verify_mtx();
+  unlink(path);
+  passed &= verify_cache();
+
+  // Every tensor above was freed, mapped ones included
+  int released = tensor_memory().live_bytes == 0;
+  printf("  %s tensor memory: every tensor released\n", released ? "PASS" : "FAIL");
+  passed &= released;
+
+  release_arena_pool();
+  printf("\n=======================\n");
+  printf("Test Result: %s\n", passed ? "PASSED" : "FAILED");
+  return passed ? 0 : 1;
+}